@@ -0,0 +1,74 @@
+#pragma once
+
+#include <openssl/evp.h>
+
+#include <cstdlib>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace gateway
+{
+
+// AES-128-GCM of the dlms-frames with OpenSSL, the host counterpart of mbedtls_gcm_auth_decrypt() in DlmsMeter
+// The meter sends no authentication tag, so only the ciphertext is processed ( same as on the device ).
+// The cipher context is created once, a frame does not allocate.
+class AesGcm
+{
+public:
+    static constexpr size_t KEY_LENGTH = 16;
+    static constexpr size_t IV_LENGTH = 12;
+
+    explicit AesGcm(const uint8_t key[KEY_LENGTH])
+        : m_context(EVP_CIPHER_CTX_new())
+    {
+        EVP_DecryptInit_ex(m_context, EVP_aes_128_gcm(), nullptr, key, nullptr);
+    }
+
+    ~AesGcm()
+    {
+        EVP_CIPHER_CTX_free(m_context);
+    }
+
+    AesGcm(const AesGcm&) = delete;
+    AesGcm& operator=(const AesGcm&) = delete;
+
+    // Key as 32 hex digits, e.g. from a config file
+    static bool ParseKey(const std::string& text, uint8_t key[KEY_LENGTH])
+    {
+        if (text.size() != 2 * KEY_LENGTH)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < KEY_LENGTH; i++)
+        {
+            char* end = nullptr;
+            const std::string byte = text.substr(2 * i, 2);
+            key[i] = static_cast<uint8_t>(std::strtoul(byte.c_str(), &end, 16));
+            if (end != byte.c_str() + 2)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Decrypt(const uint8_t iv[IV_LENGTH], const uint8_t* input, size_t length, uint8_t* output)
+    {
+        int outputLength = 0;
+        return EVP_DecryptInit_ex(m_context, nullptr, nullptr, nullptr, iv) == 1
+               && EVP_DecryptUpdate(m_context, output, &outputLength, input, static_cast<int>(length)) == 1
+               && static_cast<size_t>(outputLength) == length;
+    }
+
+    // For tests and benchmarks: builds the ciphertext of a frame, GCM decryption is the same operation
+    bool Encrypt(const uint8_t iv[IV_LENGTH], const uint8_t* input, size_t length, uint8_t* output)
+    {
+        return Decrypt(iv, input, length, output);
+    }
+
+private:
+    EVP_CIPHER_CTX* m_context;
+};
+
+} // namespace gateway
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "meter_pipeline.h"
+#include "./esphome-dlms-meter/espdm_capture.h"
+
+namespace gateway
+{
+
+// Replays a capture of the meter link ( see espdm_capture.h ) through a MeterPipeline, as fast as possible
+// The records are processed in place ( e.g. from a MappedFile ), the clock of the pipeline is the time of the
+// record, so the stale policy and the timing see the time of the capture.
+class CaptureReplay : public esphome::espdm::Clock
+{
+public:
+    CaptureReplay(const uint8_t* data, size_t size)
+        : m_reader(data, size)
+    { }
+
+    uint32_t Millis() const override
+    {
+        return m_timeMs;
+    }
+    uint32_t Micros() const override
+    {
+        return m_timeMs * 1000;
+    }
+
+    // Continues with the given frame ( 0: first frame ), returns false if the capture has less frames
+    bool SeekFrame(uint32_t frame)
+    {
+        return m_reader.SeekFrame(frame);
+    }
+
+    // Feeds all records into the pipeline, returns the number of bytes
+    size_t Run(MeterPipeline& pipeline)
+    {
+        pipeline.SetClock(*this);
+        size_t bytes = 0;
+        esphome::espdm::CaptureReader::Record record;
+        while (m_reader.NextRecord(record))
+        {
+            m_timeMs = record.timeMs;
+            // The buffers of the pipeline are reserved for chunks of READ_CHUNK_SIZE
+            for (size_t offset = 0; offset < record.length; offset += MeterPipeline::READ_CHUNK_SIZE)
+            {
+                const size_t rest = record.length - offset;
+                const size_t length = rest < MeterPipeline::READ_CHUNK_SIZE ? rest : MeterPipeline::READ_CHUNK_SIZE;
+                pipeline.AddMeterData(&record.data[offset], length);
+            }
+            bytes += record.length;
+        }
+        return bytes;
+    }
+
+    const esphome::espdm::CaptureReader& GetReader() const
+    {
+        return m_reader;
+    }
+
+private:
+    esphome::espdm::CaptureReader m_reader;
+    uint32_t m_timeMs{0};
+};
+
+} // namespace gateway
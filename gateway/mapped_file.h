@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdio>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace gateway
+{
+
+// Read only memory mapping of a file, e.g. a capture of the meter link ( see espdm_capture.h )
+// The pages are loaded by the kernel while they are read, a capture of many days is not read into memory at once.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    bool Open(const char* fileName)
+    {
+        Close();
+        const int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            perror(fileName);
+            return false;
+        }
+        struct stat status;
+        if (fstat(fd, &status) != 0 || status.st_size <= 0)
+        {
+            fprintf(stderr, "%s: empty or unreadable file\n", fileName);
+            close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping stays valid
+        if (data == MAP_FAILED)
+        {
+            perror("mmap");
+            return false;
+        }
+        // Read once from begin to end, the kernel reads ahead and drops pages behind
+        madvise(data, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+        m_data = static_cast<const uint8_t*>(data);
+        m_size = static_cast<size_t>(status.st_size);
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_data != nullptr)
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+            m_data = nullptr;
+            m_size = 0;
+        }
+    }
+
+    const uint8_t* GetData() const
+    {
+        return m_data;
+    }
+    size_t GetSize() const
+    {
+        return m_size;
+    }
+
+private:
+    const uint8_t* m_data{nullptr};
+    size_t m_size{0};
+};
+
+} // namespace gateway
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "aes_gcm.h"
+#include "transport.h"
+#include "meter_model_bridge.h"
+#include "./esphome-dlms-meter/espdm_clock.h"
+#include "./esphome-dlms-meter/espdm_dlms_frame.h"
+#include "./esphome-dlms-meter/espdm_link_statistics.h"
+#include "./esphome-dlms-meter/espdm_mbus.h"
+#include "./esphome-dlms-meter/espdm_obis_decoder.h"
+
+#include <memory>
+#include <vector>
+
+namespace gateway
+{
+
+// One meter -> Sunspec pipeline of the gateway: M-Bus/DLMS frames of the meter link are decoded into a MeterModel,
+// which is served by a Modbus RTU server on the modbus link. Same processing as DlmsMeter and SmartMeter.
+// All buffers are reserved in the constructor, the memory of a pipeline does not grow with the traffic.
+class MeterPipeline
+{
+public:
+    // Bytes read per call, bounds the buffers of the mbus and modbus parser
+    static constexpr size_t READ_CHUNK_SIZE = 256;
+    static constexpr size_t MBUS_FRAME_MAX_LENGTH = 6 + 255;
+    // Same default as the stale policy of the SmartMeter
+    static constexpr uint32_t STALE_MAX_AGE_MS = 30 * 1000;
+
+    // The address of the epoll event of a link
+    struct LinkEvent
+    {
+        MeterPipeline* pipeline;
+        bool meter; // else modbus
+    };
+
+    MeterPipeline(const uint8_t key[AesGcm::KEY_LENGTH], uint8_t modbusAddress)
+        : m_aes(key)
+        , m_meterModel(modbusAddress)
+        , m_modbusServer(modbusAddress,
+                         [this](uint8_t functionCode, const esphome::modbus::ModbusServer::RequestRead& request) {
+                             return esphome::sm::ReadMeterModel(m_meterModel, functionCode, request,
+                                                                m_clock->Millis());
+                         })
+        , m_meterEvent{this, true}
+        , m_modbusEvent{this, false}
+    {
+        m_mbusPayload.reserve(MBUS_FRAME_MAX_LENGTH);
+        m_plaintext.reserve(esphome::espdm::DlmsFrame::MAX_LENGTH);
+        m_modbusServer.ReserveRxBuffer(2 * esphome::modbus::ModbusServer::READ_CHUNK_SIZE);
+        m_meterModel.SetStalePolicy({STALE_MAX_AGE_MS, sunspec::StaleAction::DEVICE_FAILURE});
+        // The mbus parser buffers at most one chunk and one incomplete frame
+        m_mbus.Reserve(READ_CHUNK_SIZE + MBUS_FRAME_MAX_LENGTH);
+    }
+
+    // Time source of the stale policy and the Modbus response delay, default: the system clock
+    void SetClock(const esphome::espdm::Clock& clock)
+    {
+        m_clock = &clock;
+        m_modbusServer.SetClock(clock);
+    }
+
+    void SetLinks(std::unique_ptr<Transport> meterLink, std::unique_ptr<Transport> modbusLink)
+    {
+        m_meterLink = std::move(meterLink);
+        m_modbusLink = std::move(modbusLink);
+        m_modbusServer.SetStream(*m_modbusLink);
+    }
+
+    // Line of the Modbus requests and responses, set by SetLinks(), e.g. a buffer of the tests
+    void SetModbusStream(esphome::espdm::ByteStream& stream)
+    {
+        m_modbusServer.SetStream(stream);
+    }
+
+    Transport* GetMeterLink()
+    {
+        return m_meterLink.get();
+    }
+
+    Transport* GetModbusLink()
+    {
+        return m_modbusLink.get();
+    }
+
+    LinkEvent* GetLinkEvent(bool meter)
+    {
+        return meter ? &m_meterEvent : &m_modbusEvent;
+    }
+
+    // Called by epoll if data is available, returns false if the link is closed
+    bool OnMeterReadable()
+    {
+        uint8_t buffer[READ_CHUNK_SIZE];
+        size_t length;
+        while ((length = m_meterLink->Read(buffer, sizeof(buffer))) > 0)
+        {
+            AddMeterData(buffer, length);
+        }
+        return !m_meterLink->IsFailed();
+    }
+
+    bool OnModbusReadable()
+    {
+        ProcessModbus();
+        return !m_modbusLink->IsFailed();
+    }
+
+    // Processes bytes of the meter link, a complete frame updates the MeterModel
+    void AddMeterData(const uint8_t* data, size_t length)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            m_mbus.AddFrameData(data[i]);
+        }
+        while (m_mbus.GetPayload(m_mbusPayload))
+        {
+            m_linkStatistics.mbusFrames++;
+            esphome::espdm::AbortReason reason;
+            const auto result = m_dlmsFrame.AddMbusPayload(m_mbusPayload, reason);
+            if (result == esphome::espdm::DlmsFrame::Result::ABORTED)
+            {
+                m_linkStatistics.AddAbort(reason);
+            }
+            else if (result == esphome::espdm::DlmsFrame::Result::COMPLETE)
+            {
+                DecodeFrame();
+            }
+        }
+    }
+
+    // Processes the requests of the modbus stream, the responses are written to it
+    void ProcessModbus()
+    {
+        m_modbusServer.ProcessRequest();
+    }
+
+    const sunspec::MeterModel& GetMeterModel() const
+    {
+        return m_meterModel;
+    }
+
+    // Of the last decoded frame
+    const esphome::espdm::MeterData& GetMeterData() const
+    {
+        return m_meterData;
+    }
+
+    const esphome::espdm::LinkStatistics& GetLinkStatistics() const
+    {
+        return m_linkStatistics;
+    }
+
+    uint32_t GetResyncCount() const
+    {
+        return m_mbus.GetResyncCount();
+    }
+
+private:
+    const esphome::espdm::Clock* m_clock{&esphome::espdm::SystemClock::Get()};
+    esphome::espdm::MbusProtocol m_mbus;
+    esphome::espdm::DlmsFrame m_dlmsFrame;
+    esphome::espdm::ObisDecoder m_obisDecoder;
+    AesGcm m_aes;
+    sunspec::MeterModel m_meterModel;
+    esphome::modbus::ModbusServer m_modbusServer;
+    std::vector<uint8_t> m_mbusPayload;
+    std::vector<uint8_t> m_plaintext;
+    esphome::espdm::MeterData m_meterData;
+    esphome::espdm::LinkStatistics m_linkStatistics;
+    std::unique_ptr<Transport> m_meterLink;
+    std::unique_ptr<Transport> m_modbusLink;
+    LinkEvent m_meterEvent;
+    LinkEvent m_modbusEvent;
+
+    void DecodeFrame()
+    {
+        uint8_t iv[esphome::espdm::DlmsFrame::IV_LENGTH];
+        m_dlmsFrame.GetIv(iv);
+        m_linkStatistics.AddFrameCounter(m_dlmsFrame.GetFrameCounter());
+        m_plaintext.resize(m_dlmsFrame.GetMessageLength());
+        const bool decrypted
+            = m_aes.Decrypt(iv, m_dlmsFrame.GetCiphertext(), m_plaintext.size(), m_plaintext.data());
+        m_dlmsFrame.Clear();
+
+        esphome::espdm::MeterData data;
+        if (!decrypted
+            || m_obisDecoder.Decode(m_plaintext.data(), m_plaintext.size(), data)
+                   != esphome::espdm::ObisDecoder::Result::OK)
+        {
+            m_linkStatistics.AddAbort(esphome::espdm::AbortReason::DECODE_FAILED);
+            return;
+        }
+        m_linkStatistics.decodedFrames++;
+        esphome::espdm::ObisDecoder::Complete(data);
+        m_meterData = data;
+        esphome::sm::SetMeterData(m_meterModel, data);
+        m_meterModel.SetUpdateTime(m_clock->Millis());
+    }
+};
+
+} // namespace gateway
@@ -0,0 +1,90 @@
+// Reads a capture of the meter link, downloaded from "http://<device>/capture.bin" ( see espdm_capture.h )
+// Usage: smart_meter_capture <capture file> [key, 32 hex digits or -] [first frame]
+//   without key ( or - ): prints the frames, one line per frame: "<frame> <time in ms> <length>"
+//   with key: replays the capture through a gateway pipeline ( mbus, decrypt, decode, Sunspec ) and prints the link
+//   statistics, e.g. to reproduce a problem of the device on the host, errors of the parsers are logged to stderr
+// The file is memory mapped, a capture of many days is not read into memory at once.
+#include "esphome_host.h"
+#include "capture_replay.h"
+#include "mapped_file.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+int PrintFrames(esphome::espdm::CaptureReader& reader, uint32_t firstFrame)
+{
+    std::vector<uint8_t> bytes;
+    uint32_t timeMs = 0;
+    for (uint32_t frame = firstFrame; reader.NextFrame(bytes, timeMs); frame++)
+    {
+        printf("%u %u %zu\n", frame, timeMs, bytes.size());
+    }
+    return 0;
+}
+
+int Replay(const gateway::MappedFile& file, const uint8_t key[gateway::AesGcm::KEY_LENGTH], uint32_t firstFrame)
+{
+    gateway::MeterPipeline pipeline(key, 1);
+    gateway::CaptureReplay replay(file.GetData(), file.GetSize());
+    if (firstFrame > 0)
+    {
+        replay.SeekFrame(firstFrame);
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    const size_t bytes = replay.Run(pipeline);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    const auto& statistics = pipeline.GetLinkStatistics();
+    printf("mbus frames %u, decoded %u, aborted %u, lost %u, resyncs %u\n", statistics.mbusFrames,
+           statistics.decodedFrames, statistics.GetAbortCount(), statistics.lostFrames, pipeline.GetResyncCount());
+    printf("%zu bytes in %.3fs ( %.1f MB/s )\n", bytes, seconds, seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        fprintf(stderr, "Usage: %s <capture file> [key, 32 hex digits or -] [first frame]\n", argv[0]);
+        return 1;
+    }
+    esphome::host::SetLogLevel(esphome::host::LogLevel::ERROR);
+    gateway::MappedFile file;
+    if (!file.Open(argv[1]))
+    {
+        return 1;
+    }
+    esphome::espdm::CaptureReader reader(file.GetData(), file.GetSize());
+    const size_t blockCount = reader.GetBlockCount();
+    if (blockCount == 0)
+    {
+        fprintf(stderr, "%s: no capture\n", argv[1]);
+        return 1;
+    }
+    fprintf(stderr, "%zu blocks, %u frames\n", blockCount, reader.GetFrameCount());
+
+    const uint32_t firstFrame = argc == 4 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 0;
+    if (firstFrame > 0 && !reader.SeekFrame(firstFrame))
+    {
+        fprintf(stderr, "No frame %u\n", firstFrame);
+        return 1;
+    }
+    if (argc == 2 || std::string(argv[2]) == "-")
+    {
+        return PrintFrames(reader, firstFrame);
+    }
+    uint8_t key[gateway::AesGcm::KEY_LENGTH];
+    if (!gateway::AesGcm::ParseKey(argv[2], key))
+    {
+        fprintf(stderr, "Invalid key\n");
+        return 1;
+    }
+    return Replay(file, key, firstFrame);
+}
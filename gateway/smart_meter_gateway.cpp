@@ -0,0 +1,198 @@
+// Linux gateway: runs independent meter -> Sunspec pipelines, one per line of the config file
+// Usage: smart_meter_gateway <config file>
+// Config, one pipeline per line, '#' starts a comment:
+//   <meter link> <modbus link> <key, 32 hex digits> [modbus address, default 1]
+//   e.g. serial:/dev/ttyUSB0:2400:8N1 serial:/dev/ttyUSB1:9600:8N1 00112233445566778899AABBCCDDEEFF 1
+// Links see Transport::Create(). A closed or failed link is reopened every RECONNECT_INTERVAL_MS.
+// Errors of the links and parsers are logged to stderr.
+#include "esphome_host.h"
+#include "meter_pipeline.h"
+
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/epoll.h>
+
+namespace
+{
+constexpr int RECONNECT_INTERVAL_MS = 5000;
+constexpr uint32_t STATUS_INTERVAL_MS = 60 * 1000;
+constexpr int MAX_EVENTS = 64;
+
+volatile std::sig_atomic_t g_running = 1;
+
+bool LoadConfig(const char* fileName, std::vector<std::unique_ptr<gateway::MeterPipeline>>& pipelines)
+{
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        fprintf(stderr, "Can not open config file %s\n", fileName);
+        return false;
+    }
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string meter, modbus, keyText, addressText;
+        if (!(fields >> meter))
+        {
+            continue; // empty line
+        }
+        fields >> modbus >> keyText >> addressText;
+        const unsigned long address = addressText.empty() ? 1 : std::strtoul(addressText.c_str(), nullptr, 10);
+        uint8_t key[gateway::AesGcm::KEY_LENGTH];
+        auto meterLink = gateway::Transport::Create(meter);
+        auto modbusLink = gateway::Transport::Create(modbus);
+        if (!meterLink || !modbusLink || !gateway::AesGcm::ParseKey(keyText, key) || address < 1 || address > 247)
+        {
+            fprintf(stderr, "%s:%d: invalid pipeline\n", fileName, lineNumber);
+            return false;
+        }
+        pipelines.emplace_back(new gateway::MeterPipeline(key, static_cast<uint8_t>(address)));
+        pipelines.back()->SetLinks(std::move(meterLink), std::move(modbusLink));
+    }
+    return true;
+}
+
+class Gateway
+{
+public:
+    explicit Gateway(std::vector<std::unique_ptr<gateway::MeterPipeline>>& pipelines)
+        : m_pipelines(pipelines)
+        , m_epoll(epoll_create1(EPOLL_CLOEXEC))
+    { }
+
+    ~Gateway()
+    {
+        close(m_epoll);
+    }
+
+    int Run()
+    {
+        if (m_epoll < 0)
+        {
+            perror("epoll_create1");
+            return 1;
+        }
+        OpenLinks();
+        uint32_t statusMs = esphome::millis();
+        epoll_event events[MAX_EVENTS];
+        while (g_running)
+        {
+            const int count = epoll_wait(m_epoll, events, MAX_EVENTS, RECONNECT_INTERVAL_MS);
+            for (int i = 0; i < count; i++)
+            {
+                auto* event = static_cast<gateway::MeterPipeline::LinkEvent*>(events[i].data.ptr);
+                const bool open
+                    = event->meter ? event->pipeline->OnMeterReadable() : event->pipeline->OnModbusReadable();
+                if (!open || (events[i].events & (EPOLLHUP | EPOLLERR)) != 0)
+                {
+                    CloseLink(*event);
+                }
+            }
+            if (m_closedLinks > 0 && esphome::millis() - m_reconnectMs >= RECONNECT_INTERVAL_MS)
+            {
+                OpenLinks();
+            }
+            if (esphome::millis() - statusMs >= STATUS_INTERVAL_MS)
+            {
+                statusMs = esphome::millis();
+                PrintStatus();
+            }
+        }
+        return 0;
+    }
+
+private:
+    std::vector<std::unique_ptr<gateway::MeterPipeline>>& m_pipelines;
+    int m_epoll;
+    size_t m_closedLinks{0};
+    uint32_t m_reconnectMs{0};
+
+    gateway::Transport* GetLink(const gateway::MeterPipeline::LinkEvent& event)
+    {
+        return event.meter ? event.pipeline->GetMeterLink() : event.pipeline->GetModbusLink();
+    }
+
+    void OpenLinks()
+    {
+        m_reconnectMs = esphome::millis();
+        m_closedLinks = 0;
+        for (auto& pipeline : m_pipelines)
+        {
+            for (const bool meter : {true, false})
+            {
+                auto* event = pipeline->GetLinkEvent(meter);
+                gateway::Transport* link = GetLink(*event);
+                if (link->GetFd() >= 0)
+                {
+                    continue;
+                }
+                epoll_event watch = {};
+                watch.events = EPOLLIN;
+                watch.data.ptr = event;
+                if (!link->Open() || epoll_ctl(m_epoll, EPOLL_CTL_ADD, link->GetFd(), &watch) != 0)
+                {
+                    link->Close();
+                    m_closedLinks++;
+                    fprintf(stderr, "Can not open %s, retry in %ds\n", link->GetSpec().c_str(),
+                            RECONNECT_INTERVAL_MS / 1000);
+                    continue;
+                }
+                fprintf(stderr, "Opened %s\n", link->GetSpec().c_str());
+            }
+        }
+    }
+
+    void CloseLink(const gateway::MeterPipeline::LinkEvent& event)
+    {
+        gateway::Transport* link = GetLink(event);
+        fprintf(stderr, "Closed %s\n", link->GetSpec().c_str());
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, link->GetFd(), nullptr);
+        link->Close();
+        if (m_closedLinks++ == 0)
+        {
+            m_reconnectMs = esphome::millis();
+        }
+    }
+
+    void PrintStatus()
+    {
+        for (auto& pipeline : m_pipelines)
+        {
+            const auto& statistics = pipeline->GetLinkStatistics();
+            fprintf(stderr, "%s: mbus frames %u, decoded %u, aborted %u, lost %u, resyncs %u\n",
+                    pipeline->GetMeterLink()->GetSpec().c_str(), statistics.mbusFrames, statistics.decodedFrames,
+                    statistics.GetAbortCount(), statistics.lostFrames, pipeline->GetResyncCount());
+        }
+    }
+};
+
+void OnSignal(int)
+{
+    g_running = 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <config file>\n", argv[0]);
+        return 1;
+    }
+    esphome::host::SetLogLevel(esphome::host::LogLevel::ERROR);
+    std::vector<std::unique_ptr<gateway::MeterPipeline>> pipelines;
+    if (!LoadConfig(argv[1], pipelines) || pipelines.empty())
+    {
+        return 1;
+    }
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    std::signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "Smart meter gateway, %zu pipelines\n", pipelines.size());
+    return Gateway(pipelines).Run();
+}
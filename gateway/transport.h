@@ -0,0 +1,342 @@
+#pragma once
+
+#include "./esphome-dlms-meter/espdm_byte_stream.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace gateway
+{
+
+// Non blocking byte stream of a meter or Modbus line, the file descriptor is watched with epoll
+// Created from a spec, see Create().
+class Transport : public esphome::espdm::ByteStream
+{
+public:
+    virtual ~Transport()
+    {
+        Close();
+    }
+
+    // spec:
+    //   "serial:<device>:<baud>[:8N1|8E1]" e.g. "serial:/dev/ttyUSB0:2400:8N1" ( termios, default
+    //   8N1: the Kaifa M-Bus line, as the mbus uart of the device )
+    //   "pty:<link>" pseudo terminal, the slave is linked to <link>, for simulators and tests
+    //   "tcp:<host>:<port>" e.g. a RS485 to ethernet converter
+    // Returns nullptr if the spec is invalid, the transport is opened with Open()
+    static std::unique_ptr<Transport> Create(const std::string& spec);
+
+    virtual bool Open() = 0;
+
+    void Close()
+    {
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+            m_fd = -1;
+        }
+        m_failed = false;
+    }
+
+    // True if the line is closed by the peer or failed since it was opened, it has to be reopened
+    bool IsFailed() const
+    {
+        return m_failed;
+    }
+
+    int GetFd() const
+    {
+        return m_fd;
+    }
+
+    const std::string& GetSpec() const
+    {
+        return m_spec;
+    }
+
+    // Returns the number of bytes read, 0 if none are available or the line is closed or failed, see IsFailed()
+    size_t Read(uint8_t* data, size_t size) override
+    {
+        const ssize_t length = read(m_fd, data, size);
+        if (length > 0)
+        {
+            return static_cast<size_t>(length);
+        }
+        if (length == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            m_failed = true; // 0: end of stream
+        }
+        return 0;
+    }
+
+    // Writes all, waits at most WRITE_TIMEOUT_MS for the line ( a Modbus response is < 256 bytes )
+    bool Write(const uint8_t* data, size_t size) override
+    {
+        while (size > 0)
+        {
+            const ssize_t length = write(m_fd, data, size);
+            if (length > 0)
+            {
+                data += length;
+                size -= static_cast<size_t>(length);
+                continue;
+            }
+            if (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                return false;
+            }
+            pollfd writable = {m_fd, POLLOUT, 0};
+            if (poll(&writable, 1, WRITE_TIMEOUT_MS) <= 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+protected:
+    static constexpr int WRITE_TIMEOUT_MS = 100;
+
+    int m_fd{-1};
+    bool m_failed{false};
+    std::string m_spec;
+
+    static bool SetNonBlocking(int fd)
+    {
+        const int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+    }
+};
+
+// termios serial port, raw mode
+class SerialTransport : public Transport
+{
+public:
+    SerialTransport(const std::string& device, uint32_t baud, bool evenParity)
+        : m_device(device)
+        , m_baud(baud)
+        , m_evenParity(evenParity)
+    { }
+
+    bool Open() override
+    {
+        Close();
+        const speed_t speed = GetSpeed(m_baud);
+        m_fd = open(m_device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (m_fd < 0 || speed == B0)
+        {
+            Close();
+            return false;
+        }
+        termios settings;
+        if (tcgetattr(m_fd, &settings) != 0)
+        {
+            Close();
+            return false;
+        }
+        cfmakeraw(&settings);
+        cfsetispeed(&settings, speed);
+        cfsetospeed(&settings, speed);
+        settings.c_cflag |= CLOCAL | CREAD;
+        settings.c_cflag &= ~(CSTOPB | PARODD | PARENB);
+        if (m_evenParity)
+        {
+            settings.c_cflag |= PARENB;
+        }
+        settings.c_cc[VMIN] = 0;
+        settings.c_cc[VTIME] = 0;
+        if (tcsetattr(m_fd, TCSANOW, &settings) != 0)
+        {
+            Close();
+            return false;
+        }
+        tcflush(m_fd, TCIOFLUSH);
+        return true;
+    }
+
+private:
+    std::string m_device;
+    uint32_t m_baud;
+    bool m_evenParity;
+
+    static speed_t GetSpeed(uint32_t baud)
+    {
+        switch (baud)
+        {
+        case 1200:
+            return B1200;
+        case 2400:
+            return B2400;
+        case 4800:
+            return B4800;
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        case 115200:
+            return B115200;
+        default:
+            return B0;
+        }
+    }
+};
+
+// Master side of a pseudo terminal, the slave device is linked to m_link
+// The slave stays open here, so the master does not see a hang up if the peer closes it.
+class PtyTransport : public Transport
+{
+public:
+    explicit PtyTransport(const std::string& link)
+        : m_link(link)
+    { }
+
+    ~PtyTransport() override
+    {
+        ClosePty();
+    }
+
+    bool Open() override
+    {
+        ClosePty();
+        m_fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (m_fd < 0 || grantpt(m_fd) != 0 || unlockpt(m_fd) != 0 || !SetNonBlocking(m_fd))
+        {
+            ClosePty();
+            return false;
+        }
+        const char* slaveName = ptsname(m_fd);
+        m_slaveFd = slaveName != nullptr ? open(slaveName, O_RDWR | O_NOCTTY | O_CLOEXEC) : -1;
+        termios settings;
+        if (m_slaveFd < 0 || tcgetattr(m_slaveFd, &settings) != 0)
+        {
+            ClosePty();
+            return false;
+        }
+        cfmakeraw(&settings);
+        tcsetattr(m_slaveFd, TCSANOW, &settings);
+        unlink(m_link.c_str());
+        if (symlink(slaveName, m_link.c_str()) != 0)
+        {
+            ClosePty();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string m_link;
+    int m_slaveFd{-1};
+
+    void ClosePty()
+    {
+        if (m_slaveFd >= 0)
+        {
+            close(m_slaveFd);
+            m_slaveFd = -1;
+            unlink(m_link.c_str());
+        }
+        Close();
+    }
+};
+
+// TCP client, e.g. to a serial server
+class TcpTransport : public Transport
+{
+public:
+    TcpTransport(const std::string& host, const std::string& port)
+        : m_host(host)
+        , m_port(port)
+    { }
+
+    bool Open() override
+    {
+        Close();
+        addrinfo hints = {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(m_host.c_str(), m_port.c_str(), &hints, &addresses) != 0)
+        {
+            return false;
+        }
+        for (addrinfo* address = addresses; address != nullptr && m_fd < 0; address = address->ai_next)
+        {
+            m_fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+            if (m_fd >= 0 && connect(m_fd, address->ai_addr, address->ai_addrlen) != 0)
+            {
+                Close();
+            }
+        }
+        freeaddrinfo(addresses);
+        if (m_fd < 0 || !SetNonBlocking(m_fd))
+        {
+            Close();
+            return false;
+        }
+        // Modbus responses are small, send them at once
+        const int noDelay = 1;
+        setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        return true;
+    }
+
+private:
+    std::string m_host;
+    std::string m_port;
+};
+
+inline std::unique_ptr<Transport> Transport::Create(const std::string& spec)
+{
+    // Split at ':', at most 4 fields
+    std::string fields[4];
+    size_t count = 0;
+    size_t begin = 0;
+    while (count < 4)
+    {
+        const size_t end = spec.find(':', begin);
+        fields[count++] = spec.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+        if (end == std::string::npos)
+        {
+            break;
+        }
+        begin = end + 1;
+    }
+
+    std::unique_ptr<Transport> transport;
+    if (fields[0] == "serial" && count >= 3 && (count == 3 || fields[3] == "8N1" || fields[3] == "8E1"))
+    {
+        transport.reset(new SerialTransport(fields[1], static_cast<uint32_t>(std::strtoul(fields[2].c_str(), nullptr, 10)),
+                                            count == 4 && fields[3] == "8E1"));
+    }
+    else if (fields[0] == "pty" && count == 2 && !fields[1].empty())
+    {
+        transport.reset(new PtyTransport(fields[1]));
+    }
+    else if (fields[0] == "tcp" && count == 3)
+    {
+        transport.reset(new TcpTransport(fields[1], fields[2]));
+    }
+    if (transport)
+    {
+        transport->m_spec = spec;
+    }
+    return transport;
+}
+
+} // namespace gateway
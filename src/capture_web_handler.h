@@ -0,0 +1,157 @@
+#pragma once
+
+#include "esphome.h"
+#include "./esphome-dlms-meter/espdm_capture.h"
+#include "ram_budget.h"
+#if defined(ESP32)
+    #include "esp_heap_caps.h"
+#endif
+
+#include <memory>
+#include <mutex>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Capture of the raw bytes of the meter link ( see espdm_capture.h ), downloaded as "http://<device>/capture.bin"
+// The memory is allocated when the capture is enabled the first time: in PSRAM if available ( ~1MB, hours of Kaifa
+// frames ), else a few blocks in RAM as far as the free heap allows ( see RamBudget, <= 16KB, ~30s ). Read the file
+// with "smart_meter_capture".
+// Note: the bytes are added by the processing task, the web server runs in an other task, the ring is protected by a
+// mutex
+class CaptureWebHandler : public AsyncWebHandler, public espdm::CaptureSink
+{
+public:
+    static constexpr const char* URL = "/capture.bin";
+    static constexpr size_t PSRAM_BLOCK_COUNT = 256;
+    static constexpr size_t RAM_MIN_BLOCK_COUNT = 2;
+    static constexpr size_t RAM_MAX_BLOCK_COUNT = 4;
+    static constexpr uint32_t RAM_BUDGET_PERCENT = 50;
+
+    void Register()
+    {
+        web_server_base::global_web_server_base->add_handler(this);
+    }
+
+    // Returns false if the memory is not available
+    bool Allocate()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_ring)
+        {
+            return true;
+        }
+        size_t blockCount = PSRAM_BLOCK_COUNT;
+        uint8_t* memory = nullptr;
+#if defined(ESP32)
+        memory = static_cast<uint8_t*>(heap_caps_malloc(blockCount * espdm::capture::BLOCK_SIZE, MALLOC_CAP_SPIRAM));
+#endif
+        if (memory == nullptr)
+        {
+            RamBudget budget(GetFreeHeap(), RAM_RESERVE);
+            blockCount = budget.Take(RAM_MIN_BLOCK_COUNT * espdm::capture::BLOCK_SIZE,
+                                     RAM_MAX_BLOCK_COUNT * espdm::capture::BLOCK_SIZE, RAM_BUDGET_PERCENT)
+                         / espdm::capture::BLOCK_SIZE;
+            memory = blockCount > 0 ? static_cast<uint8_t*>(malloc(blockCount * espdm::capture::BLOCK_SIZE)) : nullptr;
+        }
+        if (memory == nullptr)
+        {
+            ESP_LOGE("sm", "No memory for the capture of the meter link");
+            return false;
+        }
+        // Note: never freed, the processing task may still use it
+        m_ring.reset(new espdm::CaptureRing(memory, blockCount));
+        ESP_LOGI("sm", "Capture of the meter link: %u bytes ( %u blocks )",
+                 static_cast<unsigned>(blockCount * espdm::capture::BLOCK_SIZE), static_cast<unsigned>(blockCount));
+        return true;
+    }
+
+    void AddData(uint32_t timeMs, const uint8_t* data, size_t length) override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_ring)
+        {
+            m_ring->AddData(timeMs, data, length);
+        }
+    }
+
+    void MarkFrameEnd() override
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_ring)
+        {
+            m_ring->MarkFrameEnd();
+        }
+    }
+
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        return request->method() == HTTP_GET && request->url() == URL;
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        auto download = std::make_shared<Download>();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_ring || m_ring->GetNextSequence() == 0)
+            {
+                request->send(404, "text/plain", "No capture, enable it first");
+                return;
+            }
+            download->sequence = m_ring->GetFirstSequence();
+            download->endSequence = m_ring->GetNextSequence();
+        }
+        auto response = request->beginChunkedResponse(
+            "application/octet-stream", [this, download](uint8_t* buffer, size_t maxLength, size_t index) -> size_t {
+                return FillChunk(*download, buffer, maxLength);
+            });
+        response->addHeader("Content-Disposition", "attachment; filename=\"capture.bin\"");
+        request->send(response);
+    }
+
+private:
+    // The blocks at the begin of the download, a block may span chunks
+    struct Download
+    {
+        uint32_t sequence{0};
+        uint32_t endSequence{0};
+        size_t offset{0}; // in the block
+    };
+
+    std::unique_ptr<espdm::CaptureRing> m_ring;
+    std::mutex m_mutex;
+
+    size_t FillChunk(Download& download, uint8_t* buffer, size_t maxLength)
+    {
+        size_t length = 0;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // returns 0 at the end, this finishes the response
+        while (length < maxLength && download.sequence < download.endSequence)
+        {
+            const uint8_t* block = m_ring->GetBlock(download.sequence);
+            if (block == nullptr)
+            {
+                // overwritten meanwhile, the file continues with the oldest block
+                download.sequence = m_ring->GetFirstSequence();
+                download.offset = 0;
+                continue;
+            }
+            const size_t count = std::min(maxLength - length, espdm::capture::BLOCK_SIZE - download.offset);
+            std::memcpy(&buffer[length], &block[download.offset], count);
+            length += count;
+            download.offset += count;
+            if (download.offset == espdm::capture::BLOCK_SIZE)
+            {
+                download.sequence++;
+                download.offset = 0;
+            }
+        }
+        return length;
+    }
+};
+
+} // namespace sm
+} // namespace esphome
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "./esphome-dlms-meter/espdm_meter_data.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+constexpr size_t TIMESPAN_TEXT_SIZE = 24;
+
+// e.g. "1d 02:03:04", a negative timespan is shown as 0
+inline void FormatTimespan(char* text, size_t size, int64_t seconds)
+{
+    if (seconds < 0)
+    {
+        seconds = 0;
+    }
+    const int64_t secPerDay = 24 * 60 * 60;
+    const int secondOfDay = static_cast<int>(seconds % secPerDay);
+    snprintf(text, size, "%ldd %02d:%02d:%02d", static_cast<long>(seconds / secPerDay), secondOfDay / 3600,
+             secondOfDay % 3600 / 60, secondOfDay % 60);
+}
+
+// Energy counted since a begin reading of the meter, updated incrementally per frame
+// The texts are only formatted if a value changed ( resolution Wh ), so unchanged frames cost a few compares.
+class EnergyInterval
+{
+public:
+    static constexpr size_t TEXT_SIZE = 24;
+
+    void SetBegin(int64_t plusWh, int64_t minusWh)
+    {
+        m_beginPlus = plusWh;
+        m_beginMinus = minusWh;
+        m_valid = true;
+        m_formatted = false;
+    }
+
+    // Date of the begin reading ( local time of the meter ), the duration is counted from it
+    void SetBeginDate(const espdm::MeterTimestamp& date)
+    {
+        m_beginSeconds = date.ToSeconds();
+    }
+
+    // Seconds from the begin date until the timestamp of a frame, the meter is the clock ( no time sync needed )
+    int64_t GetDurationSeconds(const espdm::MeterTimestamp& now) const
+    {
+        return now.ToSeconds() - m_beginSeconds;
+    }
+
+    void Invalidate()
+    {
+        m_valid = false;
+    }
+
+    bool IsValid() const
+    {
+        return m_valid;
+    }
+
+    // Meter readings in Wh, returns true if a value changed since the last call
+    bool Update(int64_t plusWh, int64_t minusWh)
+    {
+        if (!m_valid)
+        {
+            return false;
+        }
+        const int64_t plus = plusWh - m_beginPlus;
+        const int64_t minus = minusWh - m_beginMinus;
+        if (m_formatted && plus == m_plus && minus == m_minus)
+        {
+            return false;
+        }
+        m_plus = plus;
+        m_minus = minus;
+        m_formatted = true;
+        FormatKWh(m_plusText, m_plus);
+        FormatKWh(m_minusText, m_minus);
+        FormatKWh(m_sumText, m_plus - m_minus);
+        return true;
+    }
+
+    int64_t GetPlus() const
+    {
+        return m_plus;
+    }
+
+    int64_t GetMinus() const
+    {
+        return m_minus;
+    }
+
+    int64_t GetSum() const
+    {
+        return m_plus - m_minus;
+    }
+
+    // e.g. "12.345kWh", valid after the first Update()
+    const char* GetPlusText() const
+    {
+        return m_plusText;
+    }
+
+    const char* GetMinusText() const
+    {
+        return m_minusText;
+    }
+
+    const char* GetSumText() const
+    {
+        return m_sumText;
+    }
+
+private:
+    int64_t m_beginPlus{0};
+    int64_t m_beginMinus{0};
+    int64_t m_beginSeconds{0};
+    int64_t m_plus{0};
+    int64_t m_minus{0};
+    bool m_valid{false};
+    bool m_formatted{false}; // texts match m_plus and m_minus
+    char m_plusText[TEXT_SIZE]{};
+    char m_minusText[TEXT_SIZE]{};
+    char m_sumText[TEXT_SIZE]{};
+
+    static void FormatKWh(char* text, int64_t wh)
+    {
+        snprintf(text, TEXT_SIZE, "%.3fkWh", wh * 0.001);
+    }
+};
+
+// Energy of the current day, month and year ( local time of the meter )
+// A period begins with the first frame of a new date, the begin readings are kept in State to be persisted.
+class CalendarEnergy
+{
+public:
+    enum Period
+    {
+        Day,
+        Month,
+        Year,
+        PeriodCount
+    };
+
+    struct State
+    {
+        uint16_t year{0}; // 0: no period started yet
+        uint8_t month{0};
+        uint8_t day{0};
+        int64_t beginPlus[PeriodCount]{}; // Wh
+        int64_t beginMinus[PeriodCount]{};
+    };
+
+    void Restore(const State& state)
+    {
+        m_state = state;
+        if (m_state.year == 0)
+        {
+            return;
+        }
+        for (size_t i = 0; i < PeriodCount; i++)
+        {
+            m_intervals[i].SetBegin(m_state.beginPlus[i], m_state.beginMinus[i]);
+        }
+    }
+
+    const State& GetState() const
+    {
+        return m_state;
+    }
+
+    const EnergyInterval& Get(Period period) const
+    {
+        return m_intervals[period];
+    }
+
+    // Returns true if a period began, the state should be persisted then
+    bool Update(const espdm::MeterTimestamp& timestamp, int64_t plusWh, int64_t minusWh)
+    {
+        bool began = false;
+        if (timestamp.IsValid())
+        {
+            // A new year begins all periods, a new month the month and day
+            const bool newYear = timestamp.year != m_state.year;
+            const bool newMonth = newYear || timestamp.month != m_state.month;
+            const bool newDay = newMonth || timestamp.day != m_state.day;
+            const bool begins[PeriodCount] = {newDay, newMonth, newYear};
+            for (size_t i = 0; i < PeriodCount; i++)
+            {
+                if (begins[i])
+                {
+                    m_state.beginPlus[i] = plusWh;
+                    m_state.beginMinus[i] = minusWh;
+                    m_intervals[i].SetBegin(plusWh, minusWh);
+                    began = true;
+                }
+            }
+            m_state.year = timestamp.year;
+            m_state.month = timestamp.month;
+            m_state.day = timestamp.day;
+        }
+        for (auto& interval : m_intervals)
+        {
+            interval.Update(plusWh, minusWh);
+        }
+        return began;
+    }
+
+private:
+    State m_state;
+    EnergyInterval m_intervals[PeriodCount];
+};
+
+} // namespace sm
+} // namespace esphome
@@ -1,10 +1,11 @@
 #include "espdm.h"
-#include "espdm_dlms.h"
 #include "espdm_obis.h"
 #if defined(ESP8266)
     #include <bearssl/bearssl.h>
 #endif
 
+#include <algorithm>
+
 namespace
 {
 const char ESPDM_VERSION[] = {"0.9.1"};
@@ -14,482 +15,515 @@ const char TAG[] = {"espdm"};
 namespace esphome
 {
 
-void PublishSensorState(sensor::Sensor& sensor, float value, float impossibleLimit = 0.0f)
+namespace espdm
 {
-    if (impossibleLimit != 0.0f && value > impossibleLimit)
+constexpr uint32_t PUBLISH_MAX_INTERVAL_MS = 5 * 60 * 1000;
+constexpr uint32_t ENERGY_PUBLISH_MIN_INTERVAL_MS = 30 * 1000;
+constexpr uint32_t LINK_PUBLISH_INTERVAL_MS = 60 * 1000;
+#if defined(ESP32)
+constexpr uint32_t PROCESSING_TASK_STACK_SIZE = 6144;
+constexpr UBaseType_t PROCESSING_TASK_PRIORITY = 1;
+constexpr uint32_t PROCESSING_TASK_PERIOD_MS = 10;
+#endif
+
+DlmsMeter::DlmsMeter(ByteStream& stream)
+    : m_stream(stream)
+{
+    for (size_t i = 0; i < PUBLISH_ENTRY_COUNT; i++)
     {
-        ESP_LOGE(TAG, "%s value[%f] is greater than limit[%f]. Set it to 0.0.", sensor.get_name().c_str(), value,
-                 impossibleLimit);
-        value = 0.0f;
+        m_publishPolicies[i] = PUBLISH_ENTRIES[i].policy;
     }
-    sensor.publish_state(value);
 }
 
-namespace espdm
-{
-constexpr auto IMPOSSIBLE_VOLTAGE_LIMIT = 300.0f;
-constexpr auto IMPOSSIBLE_CURRENT_LIMIT = 32.0f; // No more than 32Ampere for normal house
-constexpr auto IMPOSSIBLE_POWER_LIMIT = IMPOSSIBLE_CURRENT_LIMIT * 230.0f * 3.0f;
-
-DlmsMeter::DlmsMeter(uart::UARTComponent* parent)
-    : uart::UARTDevice(parent)
-{ }
-
 void DlmsMeter::setup()
 {
     ESP_LOGI(TAG, "DLMS smart meter component v%s started", ESPDM_VERSION);
 }
 
+// Sensors published in the PUBLISH stage, one changed sensor per step
+// Note: esphome has no batch publish, every publish_state() notifies the web server, api and mqtt per entity.
+// The changes of one frame are batched where it is possible: one decision pass, one mqtt json, one notify.
+// Default policy: deadband in the resolution shown, energy at most every 30s, all at least every 5min
+const DlmsMeter::PublishEntry DlmsMeter::PUBLISH_ENTRIES[PUBLISH_ENTRY_COUNT] = {
+    {[](const MeterData& data) { return MeterData::ToVolt(data.voltageL1); }, &DlmsMeter::voltage_l1,
+     {0.5f, 0, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return MeterData::ToVolt(data.voltageL2); }, &DlmsMeter::voltage_l2,
+     {0.5f, 0, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return MeterData::ToVolt(data.voltageL3); }, &DlmsMeter::voltage_l3,
+     {0.5f, 0, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return MeterData::ToAmpere(data.currentL1); }, &DlmsMeter::current_l1,
+     {0.05f, 0, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return MeterData::ToAmpere(data.currentL2); }, &DlmsMeter::current_l2,
+     {0.05f, 0, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return MeterData::ToAmpere(data.currentL3); }, &DlmsMeter::current_l3,
+     {0.05f, 0, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return static_cast<float>(data.activePowerPlus); }, &DlmsMeter::active_power_plus,
+     {5.0f, 0, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return static_cast<float>(data.activePowerMinus); }, &DlmsMeter::active_power_minus,
+     {5.0f, 0, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return static_cast<float>(data.activeEnergyPlus); }, &DlmsMeter::active_energy_plus,
+     {1.0f, ENERGY_PUBLISH_MIN_INTERVAL_MS, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return static_cast<float>(data.activeEnergyMinus); },
+     &DlmsMeter::active_energy_minus, {1.0f, ENERGY_PUBLISH_MIN_INTERVAL_MS, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return static_cast<float>(data.reactiveEnergyPlus); },
+     &DlmsMeter::reactive_energy_plus, {1.0f, ENERGY_PUBLISH_MIN_INTERVAL_MS, PUBLISH_MAX_INTERVAL_MS}},
+    {[](const MeterData& data) { return static_cast<float>(data.reactiveEnergyMinus); },
+     &DlmsMeter::reactive_energy_minus, {1.0f, ENERGY_PUBLISH_MIN_INTERVAL_MS, PUBLISH_MAX_INTERVAL_MS}},
+};
+
 void DlmsMeter::loop()
 {
-    while (available()) // Read while data is available
+    // Run all pending work at once
+    while (RunStep())
     {
-        uint8_t c(0);
-        this->read_byte(&c);
-        m_mbus.AddFrameData(c);
     }
+}
 
-    std::vector<uint8_t> mbusPayload; // Contains the data of the payload
-    while (m_mbus.GetPayload(mbusPayload))
+bool DlmsMeter::RunStep()
+{
+    while (m_processingStatisticsQueue.Pop(m_statistics))
     {
-        ESP_LOGD(TAG, "mbusPayload.size() = %d bytes", mbusPayload.size());
-        log_packet(m_dlmsData);
+    }
 
-        // trim mbusPayload to work with original code where first 5 bytes were skipped
-        const auto originalCodeRemovedByte = 5;
-        m_dlmsData.insert(m_dlmsData.end(), mbusPayload.begin() + originalCodeRemovedByte, mbusPayload.end());
+    // Also published if no frames are received
+    if (!m_publishing && m_clock->Millis() - m_linkPublishMs >= LINK_PUBLISH_INTERVAL_MS)
+    {
+        PublishLinkStatistics();
+    }
 
-        // Verify and parse DLMS header
-        // Always abort parsing if the data do not match the protocol
+    // Publishing of a decoded frame goes first
+    if (!m_publishing && m_decodedFrames.Pop(m_data))
+    {
+        SelectChangedValues();
+        m_publishIndex = 0;
+        m_publishStage = m_publishMask != 0 ? Stage::PUBLISH : Stage::NOTIFY;
+        m_publishing = true;
+    }
 
-        ESP_LOGV(TAG, "Parsing DLMS header");
+    if (m_publishing)
+    {
+        RunStage(m_publishStage);
+    }
+    else if (!m_processingTaskRunning)
+    {
+        RunStage(m_stage);
+    }
 
-        if (m_dlmsData.size() < 20) // If the payload is too short we need to abort
-        {
-            ESP_LOGE(TAG, "DLMS: Payload too short");
-            return AbortDlmsParsing();
-        }
+    return m_publishing || !m_decodedFrames.Empty() || (!m_processingTaskRunning && m_stage != Stage::RECEIVE);
+}
 
-        if (m_dlmsData[DLMS_CIPHER_OFFSET] != 0xDB) // Only general-glo-ciphering is supported (0xDB)
+void DlmsMeter::RunStage(Stage stage)
+{
+    const uint32_t start = m_clock->Micros();
+    switch (stage)
+    {
+    case Stage::RECEIVE:
+        ReceiveData();
+        break;
+    case Stage::FRAME:
+        ParseFrame();
+        break;
+    case Stage::DECRYPT:
+        Decrypt();
+        break;
+    case Stage::DECODE:
+        Decode();
+        break;
+    case Stage::PUBLISH:
+        PublishNextValue();
+        break;
+    case Stage::NOTIFY:
+        Notify();
+        break;
+    default:
+        break;
+    }
+    const uint32_t durationUs = m_clock->Micros() - start;
+    if (static_cast<size_t>(stage) < PROCESSING_STAGE_COUNT)
+    {
+        UpdateProcessingStatistics(stage, durationUs);
+    }
+    else
+    {
+        auto& timing = m_publishTimings[static_cast<size_t>(stage) - PROCESSING_STAGE_COUNT];
+        timing.lastUs = durationUs;
+        timing.maxUs = std::max(timing.maxUs, durationUs);
+    }
+}
+
+void DlmsMeter::UpdateProcessingStatistics(Stage stage, uint32_t durationUs)
+{
+    // Note: runs in the processing task, if it is started. The loop only reads the copies of the queue.
+    ProcessingStatistics& statistics = m_processingStatistics;
+    if (m_resetProcessingTimings.exchange(false))
+    {
+        for (auto& timing : statistics.timings)
         {
-            ESP_LOGE(TAG, "DLMS: Unsupported cipher");
-            return AbortDlmsParsing();
+            timing = StageTiming();
         }
+    }
+    auto& timing = statistics.timings[static_cast<size_t>(stage)];
+    timing.lastUs = durationUs;
+    timing.maxUs = std::max(timing.maxUs, durationUs);
+    if (stage == Stage::DECRYPT)
+    {
+        statistics.link.decryptUs = durationUs;
+    }
+    else if (stage == Stage::DECODE)
+    {
+        statistics.link.decodeUs = durationUs;
+    }
+    // A RECEIVE without data changes nothing worth a copy
+    if (stage != Stage::RECEIVE || m_stage != Stage::RECEIVE)
+    {
+        m_processingStatisticsChanged = true;
+    }
+    // Handed over when the received data is processed, retried if the loop has not taken the last copies yet
+    if (m_processingStatisticsChanged && m_stage == Stage::RECEIVE)
+    {
+        statistics.resyncCount = m_framer.GetResyncCount();
+        m_processingStatisticsChanged = !m_processingStatisticsQueue.Push(statistics);
+    }
+}
 
-        uint8_t systitleLength = m_dlmsData[DLMS_SYST_OFFSET];
+#if defined(ESP32) && !defined(CONFIG_FREERTOS_UNICORE)
+void DlmsMeter::StartProcessingTask(BaseType_t core)
+{
+    if (m_processingTaskRunning)
+    {
+        return;
+    }
+    // Note: the loop must not run processing stages anymore, otherwise the SpscQueue has two producers
+    m_processingTaskRunning = xTaskCreatePinnedToCore(&DlmsMeter::ProcessingTask, "dlms", PROCESSING_TASK_STACK_SIZE,
+                                                      this, PROCESSING_TASK_PRIORITY, NULL, core)
+                              == pdPASS;
+    ESP_LOGI(TAG, "DLMS processing task started on core %d: %s", core, m_processingTaskRunning ? "yes" : "no");
+}
 
-        if (systitleLength != 0x08) // Only system titles with length of 8 are supported
+void DlmsMeter::ProcessingTask(void* parameter)
+{
+    auto meter = static_cast<DlmsMeter*>(parameter);
+    for (;;)
+    {
+        do
         {
-            ESP_LOGE(TAG, "DLMS: Unsupported system title length");
-            return AbortDlmsParsing();
-        }
+            meter->RunStage(meter->m_stage);
+        } while (meter->m_stage != Stage::RECEIVE);
+        // Kaifa sends with 2400 baud => ~2.4 bytes per ms, uart buffer is large enough
+        vTaskDelay(pdMS_TO_TICKS(PROCESSING_TASK_PERIOD_MS));
+    }
+}
+#endif
 
-        uint16_t messageLength = m_dlmsData[DLMS_LENGTH_OFFSET];
-        int headerOffset = 0;
+void DlmsMeter::SetClock(const Clock& clock)
+{
+    m_clock = &clock;
+}
 
-        if (messageLength == 0x82)
-        {
-            ESP_LOGV(TAG, "DLMS: Message length > 127");
+const DlmsMeter::StageTiming& DlmsMeter::GetStageTiming(Stage stage) const
+{
+    const size_t index = static_cast<size_t>(stage);
+    return index < PROCESSING_STAGE_COUNT ? m_statistics.timings[index]
+                                          : m_publishTimings[index - PROCESSING_STAGE_COUNT];
+}
 
-            memcpy(&messageLength, &m_dlmsData[DLMS_LENGTH_OFFSET + 1], 2);
-            messageLength = swap_uint16(messageLength);
+void DlmsMeter::ResetStageTimings()
+{
+    for (auto& timing : m_statistics.timings)
+    {
+        timing = StageTiming();
+    }
+    for (auto& timing : m_publishTimings)
+    {
+        timing = StageTiming();
+    }
+    // The processing side resets its own timings with the next stage
+    m_resetProcessingTimings = true;
+}
 
-            headerOffset = DLMS_HEADER_EXT_OFFSET; // Header is now 2 bytes longer due to length > 127
-        }
-        else
-        {
-            ESP_LOGV(TAG, "DLMS: Message length <= 127");
-        }
+const LinkStatistics& DlmsMeter::GetLinkStatistics() const
+{
+    return m_statistics.link;
+}
 
-        messageLength
-            -= DLMS_LENGTH_CORRECTION; // Correct message length due to part of header being included in length
+uint32_t DlmsMeter::GetResyncCount() const
+{
+    return m_statistics.resyncCount;
+}
 
-        if (m_dlmsData.size() - DLMS_HEADER_LENGTH - headerOffset != messageLength)
+void DlmsMeter::ReceiveData()
+{
+    CaptureSink* capture = m_capture.load();
+    uint8_t buffer[64]; // also the chunk of the capture
+    size_t length;
+    bool received = false;
+    while ((length = m_stream.Read(buffer, sizeof(buffer))) > 0) // Read while data is available
+    {
+        for (size_t i = 0; i < length; i++)
         {
-            // Note: Kaifa309M sends multiple(2) mbus-frames for one dlms-frame, this is normal flow.
-            ESP_LOGD(TAG, "DLMS: Frame[%d] has not enough data yet, current length[%d]", messageLength,
-                     m_dlmsData.size() - DLMS_HEADER_LENGTH - headerOffset);
-            continue; // Wait for more data to come
+            m_framer.AddFrameData(buffer[i]);
         }
-
-        // Now we have enough data for the dlms frame.
-
-        if (m_dlmsData[headerOffset + DLMS_SECBYTE_OFFSET] != 0x21) // Only certain security suite is supported (0x21)
+        received = true;
+        if (capture != nullptr)
         {
-            ESP_LOGE(TAG, "DLMS: Unsupported security control byte");
-            return AbortDlmsParsing();
+            capture->AddData(m_clock->Millis(), buffer, length);
         }
+    }
+    if (received)
+    {
+        m_stage = Stage::FRAME;
+    }
+}
+
+void DlmsMeter::ParseFrame()
+{
+    if (!m_framer.GetPayload(m_framePayload))
+    {
+        m_stage = Stage::RECEIVE;
+        return;
+    }
 
-        // Decryption
+    m_processingStatistics.link.mbusFrames++;
+    ESP_LOGD(TAG, "framePayload.size() = %d bytes", m_framePayload.size());
+    if (m_onReceiveFramePayload)
+    {
+        m_onReceiveFramePayload(m_framePayload.data(), m_framePayload.size());
+    }
+    CaptureSink* capture = m_capture.load();
+    if (capture != nullptr)
+    {
+        capture->MarkFrameEnd();
+    }
+
+    AbortReason reason;
+    switch (m_dlmsFrame.AddPayload(m_framePayload, METER_LINK_DLMS_OFFSET, reason))
+    {
+    case DlmsFrame::Result::COMPLETE:
+        m_stage = Stage::DECRYPT;
+        break;
+    case DlmsFrame::Result::ABORTED:
+        AbortDlmsParsing(reason);
+        break;
+    default:
+        break; // Wait for more data to come
+    }
+}
 
-        ESP_LOGV(TAG, "Decrypting payload");
+void DlmsMeter::Decrypt()
+{
+    ESP_LOGV(TAG, "Decrypting payload");
 
-        uint8_t iv[12]; // Reserve space for the IV, always 12 bytes
-        // Copy system title to IV (System title is before length; no header offset needed!)
-        // Add 1 to the offset in order to skip the system title length byte
-        memcpy(&iv[0], &m_dlmsData[DLMS_SYST_OFFSET + 1], systitleLength);
-        memcpy(&iv[8], &m_dlmsData[headerOffset + DLMS_FRAMECOUNTER_OFFSET],
-               DLMS_FRAMECOUNTER_LENGTH); // Copy frame counter to IV
+    const uint16_t messageLength = m_dlmsFrame.GetMessageLength();
+    uint8_t iv[DlmsFrame::IV_LENGTH]; // system title and frame counter
+    m_dlmsFrame.GetIv(iv);
+    m_processingStatistics.link.AddFrameCounter(m_dlmsFrame.GetFrameCounter());
 
-        std::vector<uint8_t> plaintext(messageLength);
+    m_plaintext.resize(messageLength);
+    std::vector<uint8_t>& plaintext = m_plaintext;
 
 #if defined(ESP8266)
-        memcpy(&plaintext[0], &m_dlmsData[headerOffset + DLMS_PAYLOAD_OFFSET], messageLength);
-        br_gcm_context gcmCtx;
-        br_aes_ct_ctr_keys bc;
-        br_aes_ct_ctr_init(&bc, this->key, this->keyLength);
-        br_gcm_init(&gcmCtx, &bc.vtable, br_ghash_ctmul32);
-        br_gcm_reset(&gcmCtx, iv, sizeof(iv));
-        br_gcm_flip(&gcmCtx);
-        br_gcm_run(&gcmCtx, 0, &plaintext[0], messageLength);
+    memcpy(&plaintext[0], m_dlmsFrame.GetCiphertext(), messageLength);
+    br_gcm_context gcmCtx;
+    br_aes_ct_ctr_keys bc;
+    br_aes_ct_ctr_init(&bc, this->key, this->keyLength);
+    br_gcm_init(&gcmCtx, &bc.vtable, br_ghash_ctmul32);
+    br_gcm_reset(&gcmCtx, iv, sizeof(iv));
+    br_gcm_flip(&gcmCtx);
+    br_gcm_run(&gcmCtx, 0, &plaintext[0], messageLength);
 #elif defined(ESP32)
-        mbedtls_gcm_init(&this->aes);
-        mbedtls_gcm_setkey(&this->aes, MBEDTLS_CIPHER_ID_AES, this->key, this->keyLength * 8);
+    mbedtls_gcm_init(&this->aes);
+    mbedtls_gcm_setkey(&this->aes, MBEDTLS_CIPHER_ID_AES, this->key, this->keyLength * 8);
 
-        mbedtls_gcm_auth_decrypt(&this->aes, messageLength, iv, sizeof(iv), NULL, 0, NULL, 0,
-                                 &m_dlmsData[headerOffset + DLMS_PAYLOAD_OFFSET], &plaintext[0]);
+    mbedtls_gcm_auth_decrypt(&this->aes, messageLength, iv, sizeof(iv), NULL, 0, NULL, 0,
+                             m_dlmsFrame.GetCiphertext(), &plaintext[0]);
 
-        mbedtls_gcm_free(&this->aes);
+    mbedtls_gcm_free(&this->aes);
 #else
     #error "Invalid Platform"
 #endif
 
-        if (plaintext[0] != 0x0F || plaintext[5] != 0x0C)
-        {
-            ESP_LOGE(TAG, "OBIS: Packet was decrypted but data is invalid");
-            return AbortDlmsParsing();
-        }
-
-        // Decoding
-
-        ESP_LOGV(TAG, "Decoding payload");
-
-        int currentPosition = DECODER_START_OFFSET;
+    m_dlmsFrame.Clear();
+    m_stage = Stage::DECODE;
+}
 
-        do
-        {
-            if (plaintext[currentPosition + OBIS_TYPE_OFFSET] != DataType::OctetString)
-            {
-                ESP_LOGE(TAG, "OBIS: Unsupported OBIS header type");
-                return AbortDlmsParsing();
-            }
+void DlmsMeter::Decode()
+{
+    m_stage = Stage::FRAME; // there may be more mbus-frames already received
 
-            uint8_t obisCodeLength = plaintext[currentPosition + OBIS_LENGTH_OFFSET];
+    MeterData data;
+    if (m_obisDecoder.Decode(&m_plaintext[0], m_plaintext.size(), data) != ObisDecoder::Result::OK)
+    {
+        return AbortDlmsParsing(AbortReason::DECODE_FAILED);
+    }
+    m_processingStatistics.link.decodedFrames++;
+    ESP_LOGD(TAG, "Received valid data");
 
-            if (obisCodeLength != 0x06)
-            {
-                ESP_LOGE(TAG, "OBIS: Unsupported OBIS header length");
-                return AbortDlmsParsing();
-            }
+    ObisDecoder::Complete(data);
 
-            uint8_t obisCode[obisCodeLength];
-            memcpy(&obisCode[0], &plaintext[currentPosition + OBIS_CODE_OFFSET],
-                   obisCodeLength); // Copy OBIS code to array
+    if (!m_decodedFrames.Push(data))
+    {
+        ESP_LOGW(TAG, "DLMS: Frame dropped, publishing is too slow");
+    }
+}
 
-            currentPosition += obisCodeLength + 2; // Advance past code, position and type
+void DlmsMeter::SelectChangedValues()
+{
+    // Decide for all sensors at once, so the changes of one frame are published together
+    const uint32_t now = m_clock->Millis();
+    m_publishMask = 0;
+    for (size_t i = 0; i < PUBLISH_ENTRY_COUNT; i++)
+    {
+        // Sensors are optional
+        if (this->*PUBLISH_ENTRIES[i].sensor != NULL
+            && m_publishThrottles[i].ShouldPublish(m_publishPolicies[i], PUBLISH_ENTRIES[i].value(m_data), now))
+        {
+            m_publishMask |= 1UL << i;
+        }
+    }
+}
 
-            uint8_t dataType = plaintext[currentPosition];
-            currentPosition++; // Advance past data type
+void DlmsMeter::PublishNextValue()
+{
+    while (m_publishIndex < PUBLISH_ENTRY_COUNT && (m_publishMask & (1UL << m_publishIndex)) == 0)
+    {
+        m_publishIndex++;
+    }
+    if (m_publishIndex < PUBLISH_ENTRY_COUNT)
+    {
+        const auto& entry = PUBLISH_ENTRIES[m_publishIndex];
+        (this->*entry.sensor)->publish_state(entry.value(m_data));
+        m_publishIndex++;
+    }
+    if ((m_publishMask >> m_publishIndex) == 0)
+    {
+        m_publishStage = Stage::NOTIFY;
+    }
+}
 
-            uint8_t dataLength = 0x00;
+void DlmsMeter::Notify()
+{
+    m_publishing = false;
+    const MeterData& data = m_data;
+    if (data.timestamp.IsValid())
+    {
+        m_lastMeterSeconds = data.timestamp.ToSeconds();
+    }
 
-            CodeType codeType = CodeType::Unknown;
+#if defined(USE_MQTT)
+    // One batched message, only if a sensor has changed
+    char timestamp[21] = {0}; // 0000-00-00T00:00:00Z
+    if (m_publishMask != 0 && data.timestamp.IsValid())
+    {
+        const auto& ts = data.timestamp;
+        sprintf(timestamp, "%04u-%02u-%02uT%02u:%02u:%02uZ", ts.year, ts.month, ts.day, ts.hour, ts.minute,
+                ts.second);
+        if (this->timestamp != NULL)
+        {
+            this->timestamp->publish_state(timestamp);
+        }
+    }
 
-            if (obisCode[OBIS_A] == Medium::Electricity)
-            {
-                // Compare C and D against code
-                if (memcmp(&obisCode[OBIS_C], ESPDM_VOLTAGE_L1, 2) == 0)
-                {
-                    codeType = CodeType::VoltageL1;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_VOLTAGE_L2, 2) == 0)
-                {
-                    codeType = CodeType::VoltageL2;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_VOLTAGE_L3, 2) == 0)
-                {
-                    codeType = CodeType::VoltageL3;
-                }
-
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_CURRENT_L1, 2) == 0)
-                {
-                    codeType = CodeType::CurrentL1;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_CURRENT_L2, 2) == 0)
-                {
-                    codeType = CodeType::CurrentL2;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_CURRENT_L3, 2) == 0)
-                {
-                    codeType = CodeType::CurrentL3;
-                }
-
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_ACTIVE_POWER_PLUS, 2) == 0)
-                {
-                    codeType = CodeType::ActivePowerPlus;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_ACTIVE_POWER_MINUS, 2) == 0)
-                {
-                    codeType = CodeType::ActivePowerMinus;
-                }
-
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_ACTIVE_ENERGY_PLUS, 2) == 0)
-                {
-                    codeType = CodeType::ActiveEnergyPlus;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_ACTIVE_ENERGY_MINUS, 2) == 0)
-                {
-                    codeType = CodeType::ActiveEnergyMinus;
-                }
-
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_REACTIVE_ENERGY_PLUS, 2) == 0)
-                {
-                    codeType = CodeType::ReactiveEnergyPlus;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_REACTIVE_ENERGY_MINUS, 2) == 0)
-                {
-                    codeType = CodeType::ReactiveEnergyMinus;
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "OBIS: Unsupported OBIS code");
-                }
-            }
-            else if (obisCode[OBIS_A] == Medium::Abstract)
-            {
-                if (memcmp(&obisCode[OBIS_C], ESPDM_TIMESTAMP, 2) == 0)
-                {
-                    codeType = CodeType::Timestamp;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_SERIAL_NUMBER, 2) == 0)
-                {
-                    codeType = CodeType::SerialNumber;
-                }
-                else if (memcmp(&obisCode[OBIS_C], ESPDM_DEVICE_NAME, 2) == 0)
-                {
-                    codeType = CodeType::DeviceName;
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "OBIS: Unsupported OBIS code");
-                }
-            }
-            else
+    if (m_publishMask != 0 && this->mqtt_client != NULL)
+    {
+        // Note: energy in kWh, same as the sensors
+        this->mqtt_client->publish_json(this->topic.c_str(), [&data, &timestamp](JsonObject root) {
+            root["voltage_l1"] = MeterData::ToVolt(data.voltageL1);
+            root["voltage_l2"] = MeterData::ToVolt(data.voltageL2);
+            root["voltage_l3"] = MeterData::ToVolt(data.voltageL3);
+            root["current_l1"] = MeterData::ToAmpere(data.currentL1);
+            root["current_l2"] = MeterData::ToAmpere(data.currentL2);
+            root["current_l3"] = MeterData::ToAmpere(data.currentL3);
+            root["active_power_plus"] = data.activePowerPlus;
+            root["active_power_minus"] = data.activePowerMinus;
+            root["active_energy_plus"] = data.activeEnergyPlus * 0.001;
+            root["active_energy_minus"] = data.activeEnergyMinus * 0.001;
+            root["reactive_energy_plus"] = data.reactiveEnergyPlus * 0.001;
+            root["reactive_energy_minus"] = data.reactiveEnergyMinus * 0.001;
+            if (data.timestamp.IsValid())
             {
-                ESP_LOGE(TAG, "OBIS: Unsupported OBIS medium");
-                return AbortDlmsParsing();
+                root["timestamp"] = timestamp;
             }
-
-            uint8_t uint8Value;
-            uint16_t uint16Value;
-            uint32_t uint32Value;
-            float floatValue;
-
-            switch (dataType)
-            {
-            case DataType::DoubleLongUnsigned:
-                dataLength = 4;
-
-                memcpy(&uint32Value, &plaintext[currentPosition], 4); // Copy bytes to integer
-                uint32Value = swap_uint32(uint32Value); // Swap bytes
-
-                floatValue = uint32Value; // Ignore decimal digits for now
-
-                if (codeType == CodeType::ActivePowerPlus && this->active_power_plus != NULL
-                    && this->active_power_plus->state != floatValue)
-                    PublishSensorState(*active_power_plus, floatValue, IMPOSSIBLE_POWER_LIMIT);
-                else if (codeType == CodeType::ActivePowerMinus && this->active_power_minus != NULL
-                         && this->active_power_minus->state != floatValue)
-                    PublishSensorState(*active_power_minus, floatValue, IMPOSSIBLE_POWER_LIMIT);
-
-                else if (codeType == CodeType::ActiveEnergyPlus && this->active_energy_plus != NULL
-                         && this->active_energy_plus->state != floatValue)
-                    this->active_energy_plus->publish_state(floatValue);
-                else if (codeType == CodeType::ActiveEnergyMinus && this->active_energy_minus != NULL
-                         && this->active_energy_minus->state != floatValue)
-                    this->active_energy_minus->publish_state(floatValue);
-
-                else if (codeType == CodeType::ReactiveEnergyPlus && this->reactive_energy_plus != NULL
-                         && this->reactive_energy_plus->state != floatValue)
-                    this->reactive_energy_plus->publish_state(floatValue);
-                else if (codeType == CodeType::ReactiveEnergyMinus && this->reactive_energy_minus != NULL
-                         && this->reactive_energy_minus->state != floatValue)
-                    this->reactive_energy_minus->publish_state(floatValue);
-
-                break;
-            case DataType::LongUnsigned:
-                dataLength = 2;
-
-                memcpy(&uint16Value, &plaintext[currentPosition], 2); // Copy bytes to integer
-                uint16Value = swap_uint16(uint16Value); // Swap bytes
-
-                if (plaintext[currentPosition + 5] == Accuracy::SingleDigit)
-                    floatValue = uint16Value / 10.0; // Divide by 10 to get decimal places
-                else if (plaintext[currentPosition + 5] == Accuracy::DoubleDigit)
-                    floatValue = uint16Value / 100.0; // Divide by 100 to get decimal places
-                else
-                    floatValue = uint16Value; // No decimal places
-
-                if (codeType == CodeType::VoltageL1 && this->voltage_l1 != NULL
-                    && this->voltage_l1->state != floatValue)
-                    PublishSensorState(*voltage_l1, floatValue, IMPOSSIBLE_VOLTAGE_LIMIT);
-                else if (codeType == CodeType::VoltageL2 && this->voltage_l2 != NULL
-                         && this->voltage_l2->state != floatValue)
-                    PublishSensorState(*voltage_l2, floatValue, IMPOSSIBLE_VOLTAGE_LIMIT);
-                else if (codeType == CodeType::VoltageL3 && this->voltage_l3 != NULL
-                         && this->voltage_l3->state != floatValue)
-                    PublishSensorState(*voltage_l3, floatValue, IMPOSSIBLE_VOLTAGE_LIMIT);
-
-                else if (codeType == CodeType::CurrentL1 && this->current_l1 != NULL
-                         && this->current_l1->state != floatValue)
-                    PublishSensorState(*current_l1, floatValue, IMPOSSIBLE_CURRENT_LIMIT);
-                else if (codeType == CodeType::CurrentL2 && this->current_l2 != NULL
-                         && this->current_l2->state != floatValue)
-                    PublishSensorState(*current_l2, floatValue, IMPOSSIBLE_CURRENT_LIMIT);
-                else if (codeType == CodeType::CurrentL3 && this->current_l3 != NULL
-                         && this->current_l3->state != floatValue)
-                    PublishSensorState(*current_l3, floatValue, IMPOSSIBLE_CURRENT_LIMIT);
-
-                break;
-            case DataType::OctetString:
-                dataLength = plaintext[currentPosition];
-                currentPosition++; // Advance past string length
-
-                if (codeType == CodeType::Timestamp) // Handle timestamp generation
-                {
-                    char timestamp[21]; // 0000-00-00T00:00:00Z
-
-                    uint16_t year;
-                    uint8_t month;
-                    uint8_t day;
-
-                    uint8_t hour;
-                    uint8_t minute;
-                    uint8_t second;
-
-                    memcpy(&uint16Value, &plaintext[currentPosition], 2);
-                    year = swap_uint16(uint16Value);
-
-                    memcpy(&month, &plaintext[currentPosition + 2], 1);
-                    memcpy(&day, &plaintext[currentPosition + 3], 1);
-
-                    memcpy(&hour, &plaintext[currentPosition + 5], 1);
-                    memcpy(&minute, &plaintext[currentPosition + 6], 1);
-                    memcpy(&second, &plaintext[currentPosition + 7], 1);
-
-                    sprintf(timestamp, "%04u-%02u-%02uT%02u:%02u:%02uZ", year, month, day, hour, minute, second);
-
-#if defined(USE_MQTT)
-                    this->timestamp->publish_state(timestamp);
+        });
+    }
 #endif
-                }
-
-                break;
-            default:
-                ESP_LOGE(TAG, "OBIS: Unsupported OBIS data type");
-                return AbortDlmsParsing();
-            }
-
-            currentPosition += dataLength; // Skip data length
-
-            currentPosition += 2; // Skip break after data
-
-            if (plaintext[currentPosition] == 0x0F) // There is still additional data for this type, skip it
-                currentPosition
-                    += 6; // Skip additional data and additional break; this will jump out of bounds on last frame
-        } while (currentPosition <= messageLength); // Loop until arrived at end
-
-        ESP_LOGD(TAG, "Received valid data");
-        m_dlmsData.clear();
 
-        // Apply sign to current to show the direction of current flow
-        if ((active_power_plus->state - active_power_minus->state) < 0.0f)
-        {
-            // Providing power to grid ( Einspeisung ) => negative current flow
-            current_l1->publish_state(-current_l1->state);
-            current_l2->publish_state(-current_l2->state);
-            current_l3->publish_state(-current_l3->state);
-        }
+    if (m_onReceiveMeterData)
+    {
+        m_onReceiveMeterData(data);
+    }
+}
 
-#if defined(USE_MQTT)
-        if (this->mqtt_client != NULL)
+void DlmsMeter::PublishLinkStatistics()
+{
+    m_linkPublishMs = m_clock->Millis();
+    const LinkStatistics& statistics = m_statistics.link;
+    if (this->frames_received != NULL)
+    {
+        this->frames_received->publish_state(statistics.mbusFrames);
+    }
+    if (this->frames_decoded != NULL)
+    {
+        this->frames_decoded->publish_state(statistics.decodedFrames);
+    }
+    if (this->frames_aborted != NULL)
+    {
+        this->frames_aborted->publish_state(statistics.GetAbortCount());
+    }
+    if (this->mbus_resyncs != NULL)
+    {
+        this->mbus_resyncs->publish_state(m_statistics.resyncCount);
+    }
+    if (this->frames_lost != NULL)
+    {
+        this->frames_lost->publish_state(statistics.lostFrames);
+    }
+    if (this->decrypt_time != NULL && statistics.decryptUs != 0)
+    {
+        this->decrypt_time->publish_state(statistics.decryptUs / 1000.0f);
+    }
+    if (this->decode_time != NULL && statistics.decodeUs != 0)
+    {
+        this->decode_time->publish_state(statistics.decodeUs / 1000.0f);
+    }
+    if (this->abort_reasons != NULL)
+    {
+        const uint32_t* aborts = statistics.aborts;
+        char text[112] = {0};
+        sprintf(text, "short %u, cipher %u, title %u, security %u, decode %u, long %u",
+                aborts[static_cast<size_t>(AbortReason::PAYLOAD_TOO_SHORT)],
+                aborts[static_cast<size_t>(AbortReason::UNSUPPORTED_CIPHER)],
+                aborts[static_cast<size_t>(AbortReason::UNSUPPORTED_SYSTEM_TITLE)],
+                aborts[static_cast<size_t>(AbortReason::UNSUPPORTED_SECURITY_BYTE)],
+                aborts[static_cast<size_t>(AbortReason::DECODE_FAILED)],
+                aborts[static_cast<size_t>(AbortReason::FRAME_TOO_LONG)]);
+        if (!this->abort_reasons->has_state() || this->abort_reasons->state != text)
         {
-            this->mqtt_client->publish_json(this->topic.c_str(), [=](JsonObject root) {
-                if (this->voltage_l1 != NULL)
-                {
-                    root["voltage_l1"] = this->voltage_l1->state;
-                    root["voltage_l2"] = this->voltage_l2->state;
-                    root["voltage_l3"] = this->voltage_l3->state;
-                }
-
-                if (this->current_l1 != NULL)
-                {
-                    root["current_l1"] = this->current_l1->state;
-                    root["current_l2"] = this->current_l2->state;
-                    root["current_l3"] = this->current_l3->state;
-                }
-
-                if (this->active_power_plus != NULL)
-                {
-                    root["active_power_plus"] = this->active_power_plus->state;
-                    root["active_power_minus"] = this->active_power_minus->state;
-                }
-
-                if (this->active_energy_plus != NULL)
-                {
-                    root["active_energy_plus"] = this->active_energy_plus->state;
-                    root["active_energy_minus"] = this->active_energy_minus->state;
-                }
-
-                if (this->reactive_energy_plus != NULL)
-                {
-                    root["reactive_energy_plus"] = this->reactive_energy_plus->state;
-                    root["reactive_energy_minus"] = this->reactive_energy_minus->state;
-                }
-
-                if (this->timestamp != NULL)
-                {
-                    root["timestamp"] = this->timestamp->state;
-                }
-            });
+            this->abort_reasons->publish_state(text);
         }
-#endif
-
-        // Note: Extension expects all sensors
-        if (m_onReceiveMeterData)
+    }
+    if (this->data_age != NULL && this->clock != NULL && m_lastMeterSeconds != 0)
+    {
+        // Both are local time, grows if no frames are received
+        auto now = this->clock->now();
+        if (now.is_valid())
         {
-            MeterData data;
-            data.voltageL1 = voltage_l1->state;
-            data.voltageL2 = voltage_l2->state;
-            data.voltageL3 = voltage_l3->state;
-            data.currentL1 = current_l1->state;
-            data.currentL2 = current_l2->state;
-            data.currentL3 = current_l3->state;
-            data.activePowerPlus = active_power_plus->state;
-            data.activePowerMinus = active_power_minus->state;
-            data.activeEnergyPlus = active_energy_plus->state;
-            data.activeEnergyMinus = active_energy_minus->state;
-            data.reactiveEnergyPlus = reactive_energy_plus->state;
-            data.reactiveEnergyMinus = reactive_energy_minus->state;
-            m_onReceiveMeterData(data);
+            MeterTimestamp nowTimestamp;
+            nowTimestamp.year = now.year;
+            nowTimestamp.month = now.month;
+            nowTimestamp.day = now.day_of_month;
+            nowTimestamp.hour = now.hour;
+            nowTimestamp.minute = now.minute;
+            nowTimestamp.second = now.second;
+            this->data_age->publish_state(static_cast<float>(nowTimestamp.ToSeconds() - m_lastMeterSeconds));
         }
     }
 }
 
-void DlmsMeter::AbortDlmsParsing()
-{
-    m_dlmsData.clear();
-}
-
-uint16_t DlmsMeter::swap_uint16(uint16_t val)
-{
-    return (val << 8) | (val >> 8);
-}
-
-uint32_t DlmsMeter::swap_uint32(uint32_t val)
+void DlmsMeter::AbortDlmsParsing(AbortReason reason)
 {
-    val = ((val << 8) & 0xFF00FF00) | ((val >> 8) & 0xFF00FF);
-    return (val << 16) | (val >> 16);
+    m_processingStatistics.link.AddAbort(reason);
+    m_dlmsFrame.Clear();
+    m_stage = Stage::RECEIVE;
 }
 
 void DlmsMeter::set_key(uint8_t key[], size_t keyLength)
@@ -530,6 +564,34 @@ void DlmsMeter::set_reactive_energy_sensors(sensor::Sensor* reactive_energy_plus
     this->reactive_energy_minus = reactive_energy_minus;
 }
 
+void DlmsMeter::set_link_counter_sensors(sensor::Sensor* frames_received, sensor::Sensor* frames_decoded,
+                                         sensor::Sensor* frames_aborted, sensor::Sensor* mbus_resyncs,
+                                         sensor::Sensor* frames_lost)
+{
+    this->frames_received = frames_received;
+    this->frames_decoded = frames_decoded;
+    this->frames_aborted = frames_aborted;
+    this->mbus_resyncs = mbus_resyncs;
+    this->frames_lost = frames_lost;
+}
+
+void DlmsMeter::set_link_timing_sensors(sensor::Sensor* decrypt_time, sensor::Sensor* decode_time)
+{
+    this->decrypt_time = decrypt_time;
+    this->decode_time = decode_time;
+}
+
+void DlmsMeter::set_data_age_sensor(sensor::Sensor* data_age, time::RealTimeClock* clock)
+{
+    this->data_age = data_age;
+    this->clock = clock;
+}
+
+void DlmsMeter::set_abort_reasons_sensor(text_sensor::TextSensor* abort_reasons)
+{
+    this->abort_reasons = abort_reasons;
+}
+
 #if defined(USE_MQTT)
 void DlmsMeter::set_timestamp_sensor(text_sensor::TextSensor* timestamp)
 {
@@ -543,14 +605,30 @@ void DlmsMeter::enable_mqtt(mqtt::MQTTClientComponent* mqtt_client, const char*
 }
 #endif
 
-void DlmsMeter::log_packet(std::vector<uint8_t> data)
+void DlmsMeter::RegisterForMeterData(DlmsMeter::OnReceiveMeterData onReceive)
+{
+    m_onReceiveMeterData = onReceive;
+}
+
+void DlmsMeter::RegisterForFramePayload(DlmsMeter::OnReceiveFramePayload onReceive)
 {
-    ESP_LOGD(TAG, format_hex_pretty(data).c_str());
+    m_onReceiveFramePayload = onReceive;
 }
 
-void DlmsMeter::RegisterForMeterData(DlmsMeter::OnReceiveMeterData onReceive)
+void DlmsMeter::SetCapture(CaptureSink* capture)
 {
-    m_onReceiveMeterData = onReceive;
+    m_capture.store(capture);
+}
+
+void DlmsMeter::SetPublishPolicy(sensor::Sensor* sensor, const PublishPolicy& policy)
+{
+    for (size_t i = 0; i < PUBLISH_ENTRY_COUNT; i++)
+    {
+        if (sensor != NULL && this->*PUBLISH_ENTRIES[i].sensor == sensor)
+        {
+            m_publishPolicies[i] = policy;
+        }
+    }
 }
 
 } // namespace espdm
@@ -2,103 +2,96 @@
 
 #include "esphome.h"
 #if defined(ESP32)
+    #include "freertos/FreeRTOS.h"
+    #include "freertos/task.h"
     #include "mbedtls/gcm.h"
 #endif
+#include "espdm_byte_stream.h"
+#include "espdm_capture.h"
+#include "espdm_clock.h"
+#include "espdm_dlms_frame.h"
+#include "espdm_hdlc.h"
+#include "espdm_link_statistics.h"
 #include "espdm_mbus.h"
+#include "espdm_meter_data.h"
+#include "espdm_obis_decoder.h"
+#include "espdm_publish_throttle.h"
+#include "espdm_spsc_queue.h"
 
-#include <math.h>
+#include <atomic>
 
 namespace esphome
 {
 namespace espdm
 {
-constexpr float SQRT3 = 1.732050808f;
 
-class DlmsMeter : public Component, public uart::UARTDevice
+// Framing of the meter link: M-Bus long frames ( Kaifa, default ) or HDLC ( build flag -DESPDM_HDLC )
+// METER_LINK_DLMS_OFFSET: bytes before the dlms-frame in the payload of the framer
+#if defined(ESPDM_HDLC)
+using MeterLinkFramer = HdlcProtocol;
+constexpr size_t METER_LINK_DLMS_OFFSET = HdlcProtocol::DLMS_OFFSET;
+#else
+using MeterLinkFramer = MbusProtocol;
+constexpr size_t METER_LINK_DLMS_OFFSET = MeterProfile::MBUS_DLMS_OFFSET;
+#endif
+
+class DlmsMeter : public Component
 {
 public:
-    struct MeterData
+    using MeterData = espdm::MeterData;
+    using OnReceiveMeterData = std::function<void(const MeterData& data)>;
+    using OnReceiveFramePayload = std::function<void(const uint8_t* data, size_t length)>;
+
+    // Processing of a dlms-frame is split in stages, which are executed in resumable steps
+    // RECEIVE - DECODE: processing, runs in the loop or in the processing task
+    // PUBLISH - NOTIFY: publishing of the decoded values, always runs in the loop
+    enum class Stage : uint8_t
     {
-        void GetVoltage(float& value1, float& value2, float& value3) const
-        {
-            value1 = voltageL1;
-            value2 = voltageL2;
-            value3 = voltageL3;
-        }
-        float GetAverageVoltage() const
-        {
-            int count(0);
-            count += voltageL1 != 0.0f ? 1 : 0;
-            count += voltageL2 != 0.0f ? 1 : 0;
-            count += voltageL3 != 0.0f ? 1 : 0;
-
-            return count == 0 ? 0.0f : (voltageL1 + voltageL2 + voltageL3) / static_cast<float>(count);
-        }
-        void GetCurrent(float& total, float& value1, float& value2, float& value3) const
-        {
-            value1 = currentL1;
-            value2 = currentL2;
-            value3 = currentL3;
-            total = value1 + value2 + value3;
-        }
-        void GetApparentPower(float& total, float& value1, float& value2, float& value3) const
-        {
-            // Scheinleistung
-            value1 = voltageL1 * currentL1;
-            value2 = voltageL2 * currentL2;
-            value3 = voltageL3 * currentL3;
-            total = value1 + value2 + value3;
-        }
-        void GetPower(float& total, float& value1, float& value2, float& value3) const
-        {
-            // Wirkleistung
-            const auto powerFactor = GetPowerFactor();
-            value1 = voltageL1 * currentL1 * powerFactor;
-            value2 = voltageL2 * currentL2 * powerFactor;
-            value3 = voltageL3 * currentL3 * powerFactor;
-            total = value1 + value2 + value3;
-        }
-        void GetReactivePower(float& total, float& value1, float& value2, float& value3) const
-        {
-            // Blindleistung
-            const auto reactivePowerFactor = 1.0f - GetPowerFactor();
-            value1 = voltageL1 * currentL1 * reactivePowerFactor;
-            value2 = voltageL2 * currentL2 * reactivePowerFactor;
-            value3 = voltageL3 * currentL3 * reactivePowerFactor;
-            total = value1 + value2 + value3;
-        }
-        float GetPowerFactor() const
-        {
-            float total(0.0f), value1(0.0f), value2(0.0f), value3(0.0f);
-            GetApparentPower(total, value1, value2, value3);
-            // cos-phi = Wirkleistung / Scheinleistung
-            return total != 0.0f ? std::fabs((activePowerPlus - activePowerMinus) / total) : 1.0f;
-        }
-        static float GetPhaseToPhaseVoltage(float voltage)
-        {
-            return voltage * SQRT3;
-        }
-
-        float voltageL1{0.0f};
-        float voltageL2{0.0f};
-        float voltageL3{0.0f};
-        float currentL1{0.0f};
-        float currentL2{0.0f};
-        float currentL3{0.0f};
-        float activePowerPlus{0.0f}; // Wirkleistung
-        float activePowerMinus{0.0f};
-        float activeEnergyPlus{0.0f};
-        float activeEnergyMinus{0.0f};
-        float reactiveEnergyPlus{0.0f};
-        float reactiveEnergyMinus{0.0f};
+        RECEIVE, // read the meter link
+        FRAME, // parse mbus- or hdlc-frames and dlms-header
+        DECRYPT,
+        DECODE, // decode OBIS values
+        PUBLISH, // publish one changed sensor per step
+        NOTIFY, // notify MQTT and RegisterForMeterData
+        COUNT
     };
 
-    using OnReceiveMeterData = std::function<void(const MeterData& data)>;
+    struct StageTiming
+    {
+        uint32_t lastUs{0};
+        uint32_t maxUs{0};
+    };
+    static constexpr size_t PROCESSING_STAGE_COUNT = static_cast<size_t>(Stage::PUBLISH);
 
-    DlmsMeter(uart::UARTComponent* parent);
+    // Written by the processing stages only, the loop gets copies through a SpscQueue
+    struct ProcessingStatistics
+    {
+        LinkStatistics link;
+        uint32_t resyncCount{0}; // of the framer
+        StageTiming timings[PROCESSING_STAGE_COUNT]; // RECEIVE - DECODE
+    };
+
+    // stream: the meter link, e.g. an UartByteStream, must outlive the DlmsMeter
+    explicit DlmsMeter(ByteStream& stream);
 
     void setup() override;
+    // Runs all pending steps
     void loop() override;
+    // Runs the next step, returns true if there is more work pending
+    bool RunStep();
+#if defined(ESP32) && !defined(CONFIG_FREERTOS_UNICORE)
+    // Run the processing stages in an own task on the given core, decoded frames are handed over lock-free
+    void StartProcessingTask(BaseType_t core);
+#endif
+
+    // Time source of the publish intervals and stage timings, default: the system clock
+    void SetClock(const Clock& clock);
+
+    // Statistics of the processing stages as of the last completed frame
+    const StageTiming& GetStageTiming(Stage stage) const;
+    void ResetStageTimings();
+    const LinkStatistics& GetLinkStatistics() const;
+    uint32_t GetResyncCount() const;
 
     void set_voltage_sensors(sensor::Sensor* voltage_l1, sensor::Sensor* voltage_l2, sensor::Sensor* voltage_l3);
     void set_current_sensors(sensor::Sensor* current_l1, sensor::Sensor* current_l2, sensor::Sensor* current_l3);
@@ -106,6 +99,14 @@ public:
     void set_active_power_sensors(sensor::Sensor* active_power_plus, sensor::Sensor* active_power_minus);
     void set_active_energy_sensors(sensor::Sensor* active_energy_plus, sensor::Sensor* active_energy_minus);
     void set_reactive_energy_sensors(sensor::Sensor* reactive_energy_plus, sensor::Sensor* reactive_energy_minus);
+    // Link health, published every minute ( optional )
+    void set_link_counter_sensors(sensor::Sensor* frames_received, sensor::Sensor* frames_decoded,
+                                  sensor::Sensor* frames_aborted, sensor::Sensor* mbus_resyncs,
+                                  sensor::Sensor* frames_lost);
+    void set_link_timing_sensors(sensor::Sensor* decrypt_time, sensor::Sensor* decode_time);
+    // Age of the last meter data: local time of the clock - meter timestamp
+    void set_data_age_sensor(sensor::Sensor* data_age, time::RealTimeClock* clock);
+    void set_abort_reasons_sensor(text_sensor::TextSensor* abort_reasons);
 #if defined(USE_MQTT)
     void set_timestamp_sensor(text_sensor::TextSensor* timestamp);
 
@@ -114,10 +115,53 @@ public:
     void set_key(uint8_t key[], size_t keyLength);
 
     void RegisterForMeterData(OnReceiveMeterData onReceive);
+    // Payload of each received mbus- or hdlc-frame, e.g. for a FrameDump. Called by the processing task.
+    void RegisterForFramePayload(OnReceiveFramePayload onReceive);
+    // Records the raw bytes of the meter link, nullptr stops it. The capture is called by the processing task.
+    void SetCapture(CaptureSink* capture);
+    // Overrides the default publish policy of one of the sensors above
+    void SetPublishPolicy(sensor::Sensor* sensor, const PublishPolicy& policy);
 
 private:
-    MbusProtocol m_mbus;
-    std::vector<uint8_t> m_dlmsData;
+    struct PublishEntry
+    {
+        float (*value)(const MeterData& data); // in the unit of the sensor
+        sensor::Sensor* DlmsMeter::*sensor;
+        PublishPolicy policy; // default
+    };
+    static constexpr size_t PUBLISH_ENTRY_COUNT = 12;
+    static const PublishEntry PUBLISH_ENTRIES[PUBLISH_ENTRY_COUNT];
+    static constexpr size_t DECODED_FRAMES_CAPACITY = 4;
+    static constexpr size_t STATISTICS_CAPACITY = 2;
+
+    ByteStream& m_stream;
+    MeterLinkFramer m_framer;
+    ObisDecoder m_obisDecoder;
+    std::vector<uint8_t> m_framePayload;
+    DlmsFrame m_dlmsFrame;
+    std::vector<uint8_t> m_plaintext;
+    Stage m_stage{Stage::RECEIVE}; // processing stage
+    // Handover from processing to publishing
+    SpscQueue<MeterData, DECODED_FRAMES_CAPACITY> m_decodedFrames;
+    MeterData m_data; // data being published
+    PublishPolicy m_publishPolicies[PUBLISH_ENTRY_COUNT];
+    PublishThrottle m_publishThrottles[PUBLISH_ENTRY_COUNT];
+    uint32_t m_publishMask{0}; // bit per PUBLISH_ENTRIES, sensors to publish for m_data
+    size_t m_publishIndex{0};
+    Stage m_publishStage{Stage::PUBLISH};
+    bool m_publishing{false};
+    bool m_processingTaskRunning{false};
+    // Processing side, copied into the queue when the stages are back at RECEIVE
+    ProcessingStatistics m_processingStatistics;
+    bool m_processingStatisticsChanged{false};
+    std::atomic<bool> m_resetProcessingTimings{false}; // requested by the loop
+    SpscQueue<ProcessingStatistics, STATISTICS_CAPACITY> m_processingStatisticsQueue;
+    // Loop side
+    ProcessingStatistics m_statistics; // last copy of the processing statistics
+    StageTiming m_publishTimings[static_cast<size_t>(Stage::COUNT) - PROCESSING_STAGE_COUNT]; // PUBLISH - NOTIFY
+    int64_t m_lastMeterSeconds{0}; // meter timestamp of the last published frame, see MeterTimestamp::ToSeconds()
+    uint32_t m_linkPublishMs{0};
+    const Clock* m_clock{&SystemClock::Get()};
 
     uint8_t key[16]; // Stores the decryption key
     size_t keyLength; // Stores the decryption key length (usually 16 bytes)
@@ -143,6 +187,17 @@ private:
     sensor::Sensor* reactive_energy_plus = NULL; // Reactive energy taken from grid
     sensor::Sensor* reactive_energy_minus = NULL; // Reactive energy put into grid
 
+    sensor::Sensor* frames_received = NULL; // mbus-frames
+    sensor::Sensor* frames_decoded = NULL; // dlms-frames
+    sensor::Sensor* frames_aborted = NULL;
+    sensor::Sensor* mbus_resyncs = NULL;
+    sensor::Sensor* frames_lost = NULL; // frame counter gaps
+    sensor::Sensor* decrypt_time = NULL;
+    sensor::Sensor* decode_time = NULL;
+    sensor::Sensor* data_age = NULL;
+    time::RealTimeClock* clock = NULL;
+    text_sensor::TextSensor* abort_reasons = NULL;
+
 #if defined(USE_MQTT)
     text_sensor::TextSensor* timestamp = NULL; // Text sensor for the timestamp value
 
@@ -150,11 +205,23 @@ private:
     std::string topic; // Stores the MQTT topic
 #endif
     OnReceiveMeterData m_onReceiveMeterData{nullptr};
+    OnReceiveFramePayload m_onReceiveFramePayload{nullptr};
+    std::atomic<CaptureSink*> m_capture{nullptr};
 
-    uint16_t swap_uint16(uint16_t val);
-    uint32_t swap_uint32(uint32_t val);
-    void log_packet(std::vector<uint8_t> data);
-    void AbortDlmsParsing();
+    void RunStage(Stage stage);
+    void UpdateProcessingStatistics(Stage stage, uint32_t durationUs);
+#if defined(ESP32) && !defined(CONFIG_FREERTOS_UNICORE)
+    static void ProcessingTask(void* parameter);
+#endif
+    void ReceiveData();
+    void ParseFrame();
+    void Decrypt();
+    void Decode();
+    void SelectChangedValues();
+    void PublishNextValue();
+    void Notify();
+    void PublishLinkStatistics();
+    void AbortDlmsParsing(AbortReason reason);
 };
 } // namespace espdm
 } // namespace esphome
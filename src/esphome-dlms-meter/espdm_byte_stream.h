@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef ESPDM_HOST
+    #include "esphome/components/uart/uart.h"
+#endif
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace esphome
+{
+namespace espdm
+{
+
+// Byte source and sink of a line: the meter link of the framers and the Modbus line of the ModbusServer
+// Device: UartByteStream, gateway: Transport ( serial, pty, tcp ), tests: a buffer. Non blocking.
+class ByteStream
+{
+public:
+    virtual ~ByteStream() = default;
+    // Returns the number of bytes read, 0 if none are available
+    virtual size_t Read(uint8_t* data, size_t size) = 0;
+    // Returns false if the bytes can not be written
+    virtual bool Write(const uint8_t* data, size_t size) = 0;
+    // Waits until the written bytes are sent
+    virtual void Flush() { }
+};
+
+#ifndef ESPDM_HOST
+// ByteStream of an esphome uart
+class UartByteStream : public ByteStream
+{
+public:
+    explicit UartByteStream(uart::UARTComponent* uart)
+        : m_uart(uart)
+    { }
+
+    size_t Read(uint8_t* data, size_t size) override
+    {
+        const size_t length = std::min<size_t>(Available(), size);
+        if (length == 0 || !m_uart->read_array(data, length))
+        {
+            return 0;
+        }
+        return length;
+    }
+
+    bool Write(const uint8_t* data, size_t size) override
+    {
+        m_uart->write_array(data, size);
+        return true;
+    }
+
+    void Flush() override
+    {
+        m_uart->flush();
+    }
+
+    size_t Available()
+    {
+        return static_cast<size_t>(m_uart->available());
+    }
+
+private:
+    uart::UARTComponent* m_uart;
+};
+#endif
+
+} // namespace espdm
+} // namespace esphome
@@ -0,0 +1,354 @@
+#pragma once
+
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace esphome
+{
+namespace espdm
+{
+
+// Capture of the raw bytes of the meter link, to analyze and replay a misbehaving link
+// The capture is stored in blocks of BLOCK_SIZE: a ring of blocks on the device, a file of blocks ( oldest first ) as
+// downloaded. All values are little endian.
+// Block:
+//   header: magic ( 4 bytes ), sequence ( 4, number of the block since start ), time ( 4, ms of the first record ),
+//     used ( 2, bytes of the records ), frame count ( 1 ), reserved ( 1 ),
+//     frame index: FRAME_INDEX_SIZE offsets ( 2 each ) of the records which complete a frame
+//   records: time delta ( 2, ms since the time of the block ), length ( 2, bit 15: FRAME_END ), raw bytes
+// A record holds the bytes of one read of the uart. FRAME_END: the framer returned a frame after these bytes, so a
+// frame consists of the bytes after the previous FRAME_END record up to this record.
+namespace capture
+{
+constexpr size_t BLOCK_SIZE = 4096;
+constexpr uint32_t MAGIC = 0x31434D53; // "SMC1"
+constexpr size_t FRAME_INDEX_SIZE = 24;
+constexpr size_t HEADER_SIZE = 16 + 2 * FRAME_INDEX_SIZE;
+constexpr size_t RECORD_HEADER_SIZE = 4;
+constexpr size_t RECORDS_SIZE = BLOCK_SIZE - HEADER_SIZE;
+constexpr uint16_t FRAME_END = 0x8000;
+constexpr uint16_t LENGTH_MASK = 0x7FFF;
+constexpr uint32_t MAX_TIME_DELTA_MS = 0xFFFF;
+
+// Offsets in the block header
+constexpr size_t MAGIC_OFFSET = 0;
+constexpr size_t SEQUENCE_OFFSET = 4;
+constexpr size_t TIME_OFFSET = 8;
+constexpr size_t USED_OFFSET = 12;
+constexpr size_t FRAME_COUNT_OFFSET = 14;
+constexpr size_t FRAME_INDEX_OFFSET = 16;
+
+template <typename T>
+T Read(const uint8_t* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+template <typename T>
+void Write(uint8_t* data, T value)
+{
+    std::memcpy(data, &value, sizeof(value));
+}
+
+} // namespace capture
+
+// Receives the raw bytes of the meter link, see DlmsMeter::SetCapture()
+class CaptureSink
+{
+public:
+    virtual ~CaptureSink() = default;
+    // Bytes of one read of the uart
+    virtual void AddData(uint32_t timeMs, const uint8_t* data, size_t length) = 0;
+    // The framer returned a frame, it ends with the last added bytes
+    virtual void MarkFrameEnd() = 0;
+};
+
+// Writes the capture into a ring of blocks in memory provided by the caller ( e.g. PSRAM ), if all blocks are used,
+// the oldest one is overwritten. Adding does not allocate.
+// Note: not thread safe
+class CaptureRing : public CaptureSink
+{
+public:
+    // memory: blockCount * BLOCK_SIZE bytes, at least 2 blocks
+    CaptureRing(uint8_t* memory, size_t blockCount)
+        : m_memory(memory)
+        , m_blockCount(blockCount)
+    { }
+
+    void AddData(uint32_t timeMs, const uint8_t* data, size_t length) override
+    {
+        while (length > 0)
+        {
+            uint8_t* block = GetCurrentBlock();
+            if (block == nullptr || m_blockClosed || GetFree(block) <= capture::RECORD_HEADER_SIZE
+                || timeMs - capture::Read<uint32_t>(&block[capture::TIME_OFFSET]) > capture::MAX_TIME_DELTA_MS)
+            {
+                block = StartBlock(timeMs);
+            }
+            const size_t free = GetFree(block) - capture::RECORD_HEADER_SIZE;
+            const size_t count = length < free ? length : free;
+            const uint16_t used = capture::Read<uint16_t>(&block[capture::USED_OFFSET]);
+            uint8_t* record = &block[capture::HEADER_SIZE + used];
+            const uint32_t blockTimeMs = capture::Read<uint32_t>(&block[capture::TIME_OFFSET]);
+            capture::Write<uint16_t>(&record[0], static_cast<uint16_t>(timeMs - blockTimeMs));
+            capture::Write<uint16_t>(&record[2], static_cast<uint16_t>(count));
+            std::memcpy(&record[capture::RECORD_HEADER_SIZE], data, count);
+            capture::Write<uint16_t>(&block[capture::USED_OFFSET],
+                                     static_cast<uint16_t>(used + capture::RECORD_HEADER_SIZE + count));
+            m_lastRecord = used;
+            m_hasLastRecord = true;
+            data += count;
+            length -= count;
+        }
+    }
+
+    void MarkFrameEnd() override
+    {
+        uint8_t* block = GetCurrentBlock();
+        if (block == nullptr || !m_hasLastRecord)
+        {
+            return;
+        }
+        uint8_t* record = &block[capture::HEADER_SIZE + m_lastRecord];
+        const uint16_t length = capture::Read<uint16_t>(&record[2]);
+        if ((length & capture::FRAME_END) != 0)
+        {
+            return; // more than one frame in the bytes of the record
+        }
+        capture::Write<uint16_t>(&record[2], static_cast<uint16_t>(length | capture::FRAME_END));
+        const uint8_t frameCount = block[capture::FRAME_COUNT_OFFSET];
+        capture::Write<uint16_t>(&block[capture::FRAME_INDEX_OFFSET + 2 * frameCount], m_lastRecord);
+        block[capture::FRAME_COUNT_OFFSET] = frameCount + 1;
+        // The index is complete for each block
+        m_blockClosed = static_cast<size_t>(frameCount) + 1 >= capture::FRAME_INDEX_SIZE;
+    }
+
+    // Blocks in the ring: sequences GetFirstSequence() ... GetNextSequence() - 1, the newest one is being written
+    uint32_t GetFirstSequence() const
+    {
+        return m_nextSequence > m_blockCount ? m_nextSequence - static_cast<uint32_t>(m_blockCount) : 0;
+    }
+    uint32_t GetNextSequence() const
+    {
+        return m_nextSequence;
+    }
+    // nullptr if the block is overwritten
+    const uint8_t* GetBlock(uint32_t sequence) const
+    {
+        if (sequence < GetFirstSequence() || sequence >= m_nextSequence)
+        {
+            return nullptr;
+        }
+        return &m_memory[(sequence % m_blockCount) * capture::BLOCK_SIZE];
+    }
+
+private:
+    uint8_t* m_memory;
+    size_t m_blockCount;
+    uint32_t m_nextSequence{0};
+    uint16_t m_lastRecord{0}; // offset in the records of the current block
+    bool m_hasLastRecord{false};
+    bool m_blockClosed{false}; // frame index is full
+
+    uint8_t* GetCurrentBlock()
+    {
+        return m_nextSequence == 0 ? nullptr : &m_memory[((m_nextSequence - 1) % m_blockCount) * capture::BLOCK_SIZE];
+    }
+
+    static size_t GetFree(const uint8_t* block)
+    {
+        return capture::RECORDS_SIZE - capture::Read<uint16_t>(&block[capture::USED_OFFSET]);
+    }
+
+    uint8_t* StartBlock(uint32_t timeMs)
+    {
+        uint8_t* block = &m_memory[(m_nextSequence % m_blockCount) * capture::BLOCK_SIZE];
+        std::memset(block, 0, capture::HEADER_SIZE);
+        capture::Write<uint32_t>(&block[capture::MAGIC_OFFSET], capture::MAGIC);
+        capture::Write<uint32_t>(&block[capture::SEQUENCE_OFFSET], m_nextSequence);
+        capture::Write<uint32_t>(&block[capture::TIME_OFFSET], timeMs);
+        m_nextSequence++;
+        m_hasLastRecord = false;
+        m_blockClosed = false;
+        return block;
+    }
+};
+
+// Reads a capture file ( blocks, oldest first ) from memory, e.g. a memory mapped file. Records are not copied.
+// Stops at the first invalid block.
+class CaptureReader
+{
+public:
+    struct Record
+    {
+        uint32_t timeMs{0};
+        const uint8_t* data{nullptr};
+        uint16_t length{0};
+        bool frameEnd{false};
+    };
+
+    CaptureReader(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_blockCount(size / capture::BLOCK_SIZE)
+    { }
+
+    // Valid blocks from the begin
+    size_t GetBlockCount() const
+    {
+        size_t count = 0;
+        while (count < m_blockCount && IsValid(GetBlock(count)))
+        {
+            count++;
+        }
+        return count;
+    }
+
+    // Number of frames, from the frame index ( reads only the block headers )
+    uint32_t GetFrameCount() const
+    {
+        uint32_t count = 0;
+        for (size_t i = 0; i < m_blockCount && IsValid(GetBlock(i)); i++)
+        {
+            count += GetBlock(i)[capture::FRAME_COUNT_OFFSET];
+        }
+        return count;
+    }
+
+    bool NextRecord(Record& record)
+    {
+        for (;;)
+        {
+            if (m_block >= m_blockCount || !IsValid(GetBlock(m_block)))
+            {
+                return false;
+            }
+            const uint8_t* block = GetBlock(m_block);
+            const uint16_t used = capture::Read<uint16_t>(&block[capture::USED_OFFSET]);
+            if (m_offset + capture::RECORD_HEADER_SIZE <= used)
+            {
+                const uint8_t* header = &block[capture::HEADER_SIZE + m_offset];
+                const uint16_t length = capture::Read<uint16_t>(&header[2]);
+                record.length = length & capture::LENGTH_MASK;
+                if (m_offset + capture::RECORD_HEADER_SIZE + record.length > used)
+                {
+                    m_block = m_blockCount; // corrupt, stop
+                    return false;
+                }
+                record.timeMs
+                    = capture::Read<uint32_t>(&block[capture::TIME_OFFSET]) + capture::Read<uint16_t>(&header[0]);
+                record.data = &header[capture::RECORD_HEADER_SIZE];
+                record.frameEnd = (length & capture::FRAME_END) != 0;
+                m_offset += capture::RECORD_HEADER_SIZE + record.length;
+                return true;
+            }
+            m_block++;
+            m_offset = 0;
+        }
+    }
+
+    // Bytes of the next frame ( after the previous frame up to the record which completed the frame ) and its time,
+    // returns false at the end. Only the bytes of one frame are copied.
+    bool NextFrame(std::vector<uint8_t>& bytes, uint32_t& timeMs)
+    {
+        bytes.clear();
+        Record record;
+        while (NextRecord(record))
+        {
+            bytes.insert(bytes.end(), record.data, record.data + record.length);
+            if (record.frameEnd)
+            {
+                timeMs = record.timeMs;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // NextFrame() then returns the given frame ( 0: first frame ), uses the frame index
+    bool SeekFrame(uint32_t frame)
+    {
+        for (size_t i = 0; i < m_blockCount && IsValid(GetBlock(i)); i++)
+        {
+            const uint8_t frameCount = GetBlock(i)[capture::FRAME_COUNT_OFFSET];
+            if (frame < frameCount)
+            {
+                if (frame > 0)
+                {
+                    SetPositionAfterFrame(i, frame - 1);
+                    return true;
+                }
+                // The first frame of a block may begin in a previous block: after the last frame end before
+                m_block = 0;
+                m_offset = 0;
+                for (size_t previous = i; previous > 0; previous--)
+                {
+                    const uint8_t previousCount = GetBlock(previous - 1)[capture::FRAME_COUNT_OFFSET];
+                    if (previousCount > 0)
+                    {
+                        SetPositionAfterFrame(previous - 1, previousCount - 1);
+                        break;
+                    }
+                }
+                return true;
+            }
+            frame -= frameCount;
+        }
+        return false;
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_blockCount;
+    size_t m_block{0};
+    size_t m_offset{0}; // in the records of the block
+
+    const uint8_t* GetBlock(size_t index) const
+    {
+        return &m_data[index * capture::BLOCK_SIZE];
+    }
+
+    // After the record of the index entry of the block
+    void SetPositionAfterFrame(size_t index, size_t entry)
+    {
+        const uint8_t* block = GetBlock(index);
+        const uint16_t record = capture::Read<uint16_t>(&block[capture::FRAME_INDEX_OFFSET + 2 * entry]);
+        const uint16_t length = capture::Read<uint16_t>(&block[capture::HEADER_SIZE + record + 2]);
+        m_block = index;
+        m_offset = record + capture::RECORD_HEADER_SIZE + (length & capture::LENGTH_MASK);
+    }
+
+    // The frame index is checked as well, SeekFrame() trusts its offsets
+    static bool IsValid(const uint8_t* block)
+    {
+        const uint16_t used = capture::Read<uint16_t>(&block[capture::USED_OFFSET]);
+        const uint8_t frameCount = block[capture::FRAME_COUNT_OFFSET];
+        if (capture::Read<uint32_t>(&block[capture::MAGIC_OFFSET]) != capture::MAGIC || used > capture::RECORDS_SIZE
+            || frameCount > capture::FRAME_INDEX_SIZE)
+        {
+            return false;
+        }
+        for (size_t entry = 0; entry < frameCount; entry++)
+        {
+            // A record within the used bytes, which completes a frame
+            const size_t record = capture::Read<uint16_t>(&block[capture::FRAME_INDEX_OFFSET + 2 * entry]);
+            if (record + capture::RECORD_HEADER_SIZE > used)
+            {
+                return false;
+            }
+            const uint16_t length = capture::Read<uint16_t>(&block[capture::HEADER_SIZE + record + 2]);
+            if ((length & capture::FRAME_END) == 0
+                || record + capture::RECORD_HEADER_SIZE + (length & capture::LENGTH_MASK) > used)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace espdm
+} // namespace esphome
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef ESPDM_HOST
+    #include "esphome/core/hal.h" // millis(), micros()
+#else
+    #include "esphome_host.h"
+#endif
+
+namespace esphome
+{
+namespace espdm
+{
+
+// Time source of the time-dependent logic ( publish intervals, stale data, timing statistics, status led )
+// Injected with SetClock(), so host tests can run with a virtual clock, e.g. a month of frames in seconds.
+// Both values overflow ( ~49.7 days, ~71.6 minutes ), use unsigned differences only.
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+    virtual uint32_t Millis() const = 0;
+    virtual uint32_t Micros() const = 0;
+};
+
+// Clock of the platform, default of all users
+class SystemClock : public Clock
+{
+public:
+    uint32_t Millis() const override
+    {
+        return millis();
+    }
+    uint32_t Micros() const override
+    {
+        return micros();
+    }
+
+    static const SystemClock& Get()
+    {
+        static const SystemClock clock;
+        return clock;
+    }
+};
+
+// Milliseconds since the first Update(), continues across the overflow of Millis() if updated at least once per
+// overflow period
+class Uptime
+{
+public:
+    uint64_t Update(const Clock& clock)
+    {
+        const uint32_t now = clock.Millis();
+        if (m_started)
+        {
+            m_uptimeMs += now - m_lastMs;
+        }
+        m_started = true;
+        m_lastMs = now;
+        return m_uptimeMs;
+    }
+
+    uint64_t GetMs() const
+    {
+        return m_uptimeMs;
+    }
+
+private:
+    uint64_t m_uptimeMs{0};
+    uint32_t m_lastMs{0};
+    bool m_started{false};
+};
+
+// Switches an output ( status led ) off a fixed time after it was switched on, polled by the loop
+// Time based, the loop interval varies with the dlms processing.
+class BlinkTimer
+{
+public:
+    explicit BlinkTimer(uint32_t onMs)
+        : m_onMs(onMs)
+    { }
+
+    void Start(const Clock& clock)
+    {
+        m_startMs = clock.Millis();
+        m_running = true;
+    }
+
+    // Returns true once, when the on time has elapsed: switch the output off
+    bool Expired(const Clock& clock)
+    {
+        if (!m_running || clock.Millis() - m_startMs < m_onMs)
+        {
+            return false;
+        }
+        m_running = false;
+        return true;
+    }
+
+    bool IsRunning() const
+    {
+        return m_running;
+    }
+
+private:
+    uint32_t m_onMs;
+    uint32_t m_startMs{0};
+    bool m_running{false};
+};
+
+} // namespace espdm
+} // namespace esphome
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cstring>
+#include <vector>
+
+#ifndef ESPDM_HOST
+    #include "esphome.h" // for logging
+#else
+    #include "esphome_host.h"
+#endif
+#include "espdm_link_statistics.h"
+#include "espdm_meter_profile.h"
+
+namespace esphome
+{
+namespace espdm
+{
+
+// Assembles one encrypted dlms-frame ( general-glo-ciphering ) from the payloads of one or more mbus- or hdlc-frames and
+// validates its header, the layout is defined by the Profile ( see espdm_meter_profile.h ).
+// Note: has no dependency to the platform, so it can be used in host tests/benchmarks and the gateway
+template <typename Profile = MeterProfile>
+class BasicDlmsFrame
+{
+public:
+    // The Kaifa MA309 sends ~280 bytes in 2 mbus-frames, a longer frame is not in sync
+    static constexpr size_t MAX_LENGTH = 1024;
+    static constexpr size_t IV_LENGTH = 12;
+
+    enum class Result : uint8_t
+    {
+        INCOMPLETE, // wait for the next mbus-frame
+        COMPLETE, // ready to decrypt
+        ABORTED // data does not match the protocol, the frame is cleared
+    };
+
+    BasicDlmsFrame()
+    {
+        m_data.reserve(MAX_LENGTH);
+    }
+
+    // payload: of one mbus-frame ( C, A, CI field and the data ), reason is set if ABORTED
+    Result AddMbusPayload(const std::vector<uint8_t>& payload, AbortReason& reason)
+    {
+        return AddPayload(payload, Profile::MBUS_DLMS_OFFSET, reason);
+    }
+
+    // payload: of the framer of the meter link, the dlms-data begins at dlmsOffset ( see MeterLinkFramer )
+    Result AddPayload(const std::vector<uint8_t>& payload, size_t dlmsOffset, AbortReason& reason)
+    {
+        // Always abort parsing if the data do not match the protocol
+        if (payload.size() < dlmsOffset)
+        {
+            ESP_LOGE(LOG_TAG, "DLMS: Frame payload too short");
+            return Abort(AbortReason::PAYLOAD_TOO_SHORT, reason);
+        }
+        if (m_data.size() + payload.size() - dlmsOffset > MAX_LENGTH)
+        {
+            ESP_LOGE(LOG_TAG, "DLMS: Frame too long");
+            return Abort(AbortReason::FRAME_TOO_LONG, reason);
+        }
+        m_data.insert(m_data.end(), payload.begin() + dlmsOffset, payload.end());
+
+        ESP_LOGV(LOG_TAG, "Parsing DLMS header");
+
+        if (m_data.size() < MIN_LENGTH) // If the payload is too short we need to abort
+        {
+            ESP_LOGE(LOG_TAG, "DLMS: Payload too short");
+            return Abort(AbortReason::PAYLOAD_TOO_SHORT, reason);
+        }
+
+        if (m_data[Profile::DLMS_CIPHER_OFFSET] != Profile::DLMS_CIPHER)
+        {
+            ESP_LOGE(LOG_TAG, "DLMS: Unsupported cipher");
+            return Abort(AbortReason::UNSUPPORTED_CIPHER, reason);
+        }
+
+        if (m_data[Profile::DLMS_SYST_OFFSET] != Profile::DLMS_SYST_LENGTH)
+        {
+            ESP_LOGE(LOG_TAG, "DLMS: Unsupported system title length");
+            return Abort(AbortReason::UNSUPPORTED_SYSTEM_TITLE, reason);
+        }
+
+        int messageLength = m_data[Profile::DLMS_LENGTH_OFFSET];
+        int headerOffset = 0;
+        if (messageLength == 0x82)
+        {
+            ESP_LOGV(LOG_TAG, "DLMS: Message length > 127");
+            messageLength = (m_data[Profile::DLMS_LENGTH_OFFSET + 1] << 8) | m_data[Profile::DLMS_LENGTH_OFFSET + 2];
+            headerOffset = Profile::DLMS_HEADER_EXT_OFFSET; // Header is now longer due to length > 127
+        }
+        else
+        {
+            ESP_LOGV(LOG_TAG, "DLMS: Message length <= 127");
+        }
+
+        // Correct message length due to part of header being included in length
+        messageLength -= Profile::DLMS_LENGTH_CORRECTION;
+        const int length = static_cast<int>(m_data.size()) - Profile::DLMS_HEADER_LENGTH - headerOffset;
+        if (messageLength <= 0)
+        {
+            ESP_LOGE(LOG_TAG, "DLMS: No payload");
+            return Abort(AbortReason::PAYLOAD_TOO_SHORT, reason);
+        }
+        if (length > messageLength)
+        {
+            // Note: more data will never match, the frame is not in sync
+            ESP_LOGE(LOG_TAG, "DLMS: Frame[%d] longer than its length field, current length[%d]", messageLength,
+                     length);
+            return Abort(AbortReason::FRAME_TOO_LONG, reason);
+        }
+        if (length < messageLength)
+        {
+            // Note: Kaifa309M sends multiple(2) mbus-frames for one dlms-frame, this is normal flow.
+            ESP_LOGD(LOG_TAG, "DLMS: Frame[%d] has not enough data yet, current length[%d]", messageLength, length);
+            return Result::INCOMPLETE; // Wait for more data to come
+        }
+
+        // Now we have enough data for the dlms frame.
+        if (m_data[headerOffset + Profile::DLMS_SECBYTE_OFFSET] != Profile::DLMS_SECURITY_BYTE)
+        {
+            ESP_LOGE(LOG_TAG, "DLMS: Unsupported security control byte");
+            return Abort(AbortReason::UNSUPPORTED_SECURITY_BYTE, reason);
+        }
+
+        m_messageLength = static_cast<uint16_t>(messageLength);
+        m_headerOffset = headerOffset;
+        return Result::COMPLETE;
+    }
+
+    // Valid after COMPLETE, until Clear()
+    void GetIv(uint8_t iv[IV_LENGTH]) const
+    {
+        // System title ( after its length byte, not shifted by the header offset ) and frame counter
+        std::memcpy(&iv[0], &m_data[Profile::DLMS_SYST_OFFSET + 1], 8);
+        std::memcpy(&iv[8], &m_data[m_headerOffset + Profile::DLMS_FRAMECOUNTER_OFFSET], FRAMECOUNTER_LENGTH);
+    }
+
+    uint32_t GetFrameCounter() const
+    {
+        const uint8_t* counter = &m_data[m_headerOffset + Profile::DLMS_FRAMECOUNTER_OFFSET];
+        return (static_cast<uint32_t>(counter[0]) << 24) | (static_cast<uint32_t>(counter[1]) << 16)
+               | (static_cast<uint32_t>(counter[2]) << 8) | counter[3];
+    }
+
+    const uint8_t* GetCiphertext() const
+    {
+        return &m_data[m_headerOffset + Profile::DLMS_PAYLOAD_OFFSET];
+    }
+
+    uint16_t GetMessageLength() const
+    {
+        return m_messageLength;
+    }
+
+    // Data received so far
+    const std::vector<uint8_t>& GetData() const
+    {
+        return m_data;
+    }
+
+    void Clear()
+    {
+        m_data.clear();
+        m_messageLength = 0;
+        m_headerOffset = 0;
+    }
+
+private:
+    static constexpr const char* LOG_TAG = "espdm";
+    static constexpr size_t FRAMECOUNTER_LENGTH = 4; // Length of the frame counter (always 4)
+    static constexpr size_t MIN_LENGTH = Profile::DLMS_HEADER_LENGTH + FRAMECOUNTER_LENGTH;
+
+    std::vector<uint8_t> m_data; // capacity MAX_LENGTH, not reallocated
+    uint16_t m_messageLength{0};
+    int m_headerOffset{0};
+
+    Result Abort(AbortReason reason, AbortReason& result)
+    {
+        result = reason;
+        Clear();
+        return Result::ABORTED;
+    }
+};
+
+// Frame of the meter of the build
+using DlmsFrame = BasicDlmsFrame<>;
+
+} // namespace espdm
+} // namespace esphome
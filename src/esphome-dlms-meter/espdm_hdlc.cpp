@@ -0,0 +1,246 @@
+#include "espdm_hdlc.h"
+#ifndef ESPDM_HOST
+    #include "esphome.h" // for logging
+#else
+    #include "esphome_host.h"
+#endif
+
+namespace
+{
+
+// Format ( length counts the bytes between the flags ):
+// Pos  Meaning
+// 1    Flag(0x7E)
+// 2-3  Frame format: type(0xA) | segmentation(0x08) | length(11 bit)
+// 4-   Destination address, 1-4 bytes, bit 0 is set in the last byte
+// ..   Source address, 1-4 bytes
+// ..   Control
+// ..   HCS, only if there is an information field
+// ..   Information
+// ..   FCS
+// ..   Flag(0x7E), may be the opening flag of the next frame
+// sample data (push of a meter): 7E A0 8B CE FF 03 13 12 8B E6 E7 00 DB 08 ... 7E
+
+constexpr uint8_t FLAG_VALUE = 0x7E;
+constexpr uint8_t FORMAT_TYPE_MASK = 0xF0;
+constexpr uint8_t FORMAT_TYPE_3 = 0xA0;
+constexpr uint8_t SEGMENTATION_BIT = 0x08;
+constexpr size_t FORMAT_OFFSET = 1;
+constexpr size_t ADDRESS_OFFSET = 3;
+constexpr size_t MAX_ADDRESS_LENGTH = 4;
+constexpr size_t CHECK_LENGTH = 2; // HCS and FCS
+constexpr size_t MIN_LENGTH = 2 + 1 + 1 + 1 + CHECK_LENGTH; // format, addresses, control, FCS
+constexpr uint16_t FCS_GOOD = 0xF0B8; // FCS over the data incl. its FCS
+
+// FCS-16 lookup table, see RFC 1662
+const uint16_t FCS_TABLE[256] = {
+    0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
+    0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
+    0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
+    0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
+    0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
+    0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
+    0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
+    0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
+    0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
+    0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
+    0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
+    0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
+    0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
+    0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
+    0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
+    0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
+    0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
+    0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
+    0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
+    0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
+    0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
+    0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
+    0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
+    0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
+    0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
+    0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
+    0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
+    0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
+    0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
+    0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
+    0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
+    0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78,
+};
+
+uint16_t UpdateFcs(uint16_t fcs, uint8_t data)
+{
+    return (fcs >> 8) ^ FCS_TABLE[(fcs ^ data) & 0xFF];
+}
+
+} // namespace
+
+namespace esphome
+{
+namespace espdm
+{
+
+HdlcProtocol::HdlcProtocol()
+{
+    m_segments.reserve(MAX_PAYLOAD_LENGTH);
+}
+
+void HdlcProtocol::AddFrameData(uint8_t data)
+{
+    if (m_count == BUFFER_SIZE)
+    {
+        Remove(1); // there is no frame in the buffer, drop the oldest byte
+    }
+    m_buffer[(m_head + m_count) & BUFFER_MASK] = data;
+    m_count++;
+}
+
+bool HdlcProtocol::GetPayload(std::vector<uint8_t>& payload)
+{
+    payload.clear();
+    bool tryToSyncWithFrame = false;
+    while (m_count > 0)
+    {
+        // Closing flag followed by an opening flag
+        if (m_count >= 2 && At(0) == FLAG_VALUE && At(1) == FLAG_VALUE)
+        {
+            Remove(1);
+            continue;
+        }
+        bool segmented = false;
+        const auto removeSize = ParseFrame(segmented);
+        if (removeSize == 0)
+        {
+            // not enough data yet
+            break;
+        }
+        Remove(removeSize);
+        if (removeSize == 1)
+        {
+            if (!tryToSyncWithFrame)
+            {
+                // Frame has not the expected format, try to sync with it and log only once
+                tryToSyncWithFrame = true;
+                m_resyncCount++;
+                ESP_LOGE("hdlc", "HDLC frame is not in sync, try to sync it...");
+            }
+            continue;
+        }
+        if (!segmented && !m_segments.empty())
+        {
+            // Last ( or only ) segment
+            ESP_LOGD("hdlc", "Got valid hdlc-frame, payload size = %u", static_cast<unsigned>(m_segments.size()));
+            payload.assign(m_segments.begin(), m_segments.end());
+            m_segments.clear();
+            return true;
+        }
+    }
+    return false;
+}
+
+uint16_t HdlcProtocol::CalculateFcs(const uint8_t* data, size_t length)
+{
+    uint16_t fcs = 0xFFFF;
+    for (size_t i = 0; i < length; i++)
+    {
+        fcs = UpdateFcs(fcs, data[i]);
+    }
+    return fcs ^ 0xFFFF;
+}
+
+void HdlcProtocol::Remove(size_t count)
+{
+    m_head = (m_head + count) & BUFFER_MASK;
+    m_count -= count;
+}
+
+bool HdlcProtocol::IsFcsValid(size_t offset, size_t length) const
+{
+    uint16_t fcs = 0xFFFF;
+    for (size_t i = offset; i < offset + length; i++)
+    {
+        fcs = UpdateFcs(fcs, At(i));
+    }
+    return fcs == FCS_GOOD;
+}
+
+// Returns the number of bytes to remove: 0 if not enough data yet, 1 if not in sync
+// The information field of a valid frame is added to m_segments.
+int32_t HdlcProtocol::ParseFrame(bool& segmented)
+{
+    if (At(0) != FLAG_VALUE)
+    {
+        return 1; // wrong start
+    }
+    if (m_count < 2 + MIN_LENGTH)
+    {
+        return 0; // not enough data yet
+    }
+    const uint8_t format = At(FORMAT_OFFSET);
+    if ((format & FORMAT_TYPE_MASK) != FORMAT_TYPE_3)
+    {
+        return 1; // wrong format
+    }
+    const size_t length = ((format & 0x07) << 8) | At(FORMAT_OFFSET + 1);
+    if (length < MIN_LENGTH || length + 2 > BUFFER_SIZE)
+    {
+        return 1; // wrong length
+    }
+    if (m_count < length + 2)
+    {
+        return 0; // not enough data yet
+    }
+    if (At(length + 1) != FLAG_VALUE)
+    {
+        return 1; // wrong stop
+    }
+    if (!IsFcsValid(FORMAT_OFFSET, length))
+    {
+        return 1; // wrong FCS
+    }
+
+    // Skip the destination and source address and the control field
+    size_t offset = ADDRESS_OFFSET;
+    for (int address = 0; address < 2; address++)
+    {
+        size_t addressLength = 1;
+        while ((At(offset) & 0x01) == 0)
+        {
+            if (++addressLength > MAX_ADDRESS_LENGTH)
+            {
+                return 1; // wrong address
+            }
+            offset++;
+        }
+        offset++;
+    }
+    offset++;
+    const size_t fcsOffset = length - 1;
+    // The closing flag may be the opening flag of the next frame
+    const int32_t frameLength = static_cast<int32_t>(length + 1);
+    if (offset == fcsOffset)
+    {
+        return frameLength; // no information field ( e.g. supervisory frame )
+    }
+    if (offset + CHECK_LENGTH >= fcsOffset || !IsFcsValid(FORMAT_OFFSET, offset + CHECK_LENGTH - FORMAT_OFFSET))
+    {
+        return 1; // wrong HCS
+    }
+
+    const size_t informationOffset = offset + CHECK_LENGTH;
+    if (m_segments.size() + fcsOffset - informationOffset > MAX_PAYLOAD_LENGTH)
+    {
+        ESP_LOGE("hdlc", "HDLC payload too long, segments dropped");
+        m_segments.clear();
+        return 1;
+    }
+    for (size_t i = informationOffset; i < fcsOffset; i++)
+    {
+        m_segments.push_back(At(i));
+    }
+    segmented = (format & SEGMENTATION_BIT) != 0;
+    return frameLength;
+}
+
+} // namespace espdm
+} // namespace esphome
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace esphome
+{
+namespace espdm
+{
+
+// HDLC frames ( IEC 62056-46, frame format type 3 ) as sent by e.g. Sagemcom or Landis+Gyr meters
+// Same streaming interface as MbusProtocol. The received data is kept in a fixed ring buffer, segmented frames
+// ( S bit ) are reassembled, the payload is the information field of all segments.
+class HdlcProtocol
+{
+public:
+    // Bytes before the dlms-frame in the payload: LLC header ( E6 E7 00 )
+    static constexpr size_t DLMS_OFFSET = 3;
+    // Reassembled information fields, longer segmented frames are dropped
+    static constexpr size_t MAX_PAYLOAD_LENGTH = 1024 + DLMS_OFFSET;
+
+    HdlcProtocol();
+
+    void AddFrameData(uint8_t data);
+    bool GetPayload(std::vector<uint8_t>& payload);
+    // Number of times the data was not in sync with a frame ( bytes skipped )
+    uint32_t GetResyncCount() const
+    {
+        return m_resyncCount;
+    }
+
+    // FCS-16 ( CRC-16/X-25 ) as sent in the frame, for tests and frame builders
+    static uint16_t CalculateFcs(const uint8_t* data, size_t length);
+
+private:
+    // Power of 2, a frame incl. the flags must fit ( the length field allows 2047 bytes, meters send less )
+    static constexpr size_t BUFFER_SIZE = 2048;
+    static constexpr size_t BUFFER_MASK = BUFFER_SIZE - 1;
+
+    uint8_t m_buffer[BUFFER_SIZE];
+    size_t m_head{0}; // index of the oldest byte
+    size_t m_count{0};
+    std::vector<uint8_t> m_segments; // information fields of a segmented frame, capacity MAX_PAYLOAD_LENGTH
+    uint32_t m_resyncCount{0};
+
+    uint8_t At(size_t offset) const
+    {
+        return m_buffer[(m_head + offset) & BUFFER_MASK];
+    }
+    void Remove(size_t count);
+    int32_t ParseFrame(bool& segmented);
+    bool IsFcsValid(size_t offset, size_t length) const;
+};
+
+} // namespace espdm
+} // namespace esphome
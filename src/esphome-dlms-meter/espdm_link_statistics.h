@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace esphome
+{
+namespace espdm
+{
+
+// Why a dlms-frame was dropped, see DlmsMeter::AbortDlmsParsing()
+enum class AbortReason : uint8_t
+{
+    PAYLOAD_TOO_SHORT,
+    UNSUPPORTED_CIPHER,
+    UNSUPPORTED_SYSTEM_TITLE,
+    UNSUPPORTED_SECURITY_BYTE,
+    DECODE_FAILED,
+    FRAME_TOO_LONG, // longer than its length field or DlmsFrame::MAX_LENGTH
+    COUNT
+};
+
+// Health of the meter link, counted since boot
+// Note: not synchronized, the DlmsMeter hands copies from the processing task to the loop
+struct LinkStatistics
+{
+    static constexpr size_t ABORT_REASON_COUNT = static_cast<size_t>(AbortReason::COUNT);
+
+    // The meter increments the frame counter ( part of the IV ) with each telegram, a gap are lost telegrams
+    void AddFrameCounter(uint32_t frameCounter)
+    {
+        if (hasFrameCounter && frameCounter > lastFrameCounter + 1)
+        {
+            lostFrames += frameCounter - lastFrameCounter - 1;
+            frameCounterGaps++;
+        }
+        hasFrameCounter = true;
+        lastFrameCounter = frameCounter;
+    }
+
+    void AddAbort(AbortReason reason)
+    {
+        aborts[static_cast<size_t>(reason)]++;
+    }
+
+    uint32_t GetAbortCount() const
+    {
+        uint32_t count = 0;
+        for (const auto abort : aborts)
+        {
+            count += abort;
+        }
+        return count;
+    }
+
+    uint32_t mbusFrames{0}; // valid mbus-frames ( hdlc-frames, see MeterLinkFramer )
+    uint32_t decodedFrames{0}; // dlms-frames decoded successfully
+    uint32_t aborts[ABORT_REASON_COUNT]{};
+    uint32_t frameCounterGaps{0};
+    uint32_t lostFrames{0}; // sum of the frame counter gaps
+    uint32_t lastFrameCounter{0};
+    bool hasFrameCounter{false};
+    uint32_t decryptUs{0}; // of the last frame
+    uint32_t decodeUs{0};
+};
+
+} // namespace espdm
+} // namespace esphome
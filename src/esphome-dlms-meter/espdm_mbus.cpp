@@ -1,5 +1,9 @@
 #include "espdm_mbus.h"
-#include "esphome.h" // for logging
+#ifndef ESPDM_HOST
+    #include "esphome.h" // for logging
+#else
+    #include "esphome_host.h"
+#endif
 
 #include <algorithm>
 #include <numeric>
@@ -58,15 +62,16 @@ bool MbusProtocol::GetPayload(std::vector<uint8_t>& payload)
         }
         if (!payload.empty())
         {
+            // Note: no hex dump of the frame, see DlmsMeter::RegisterForFramePayload()
             ESP_LOGD("mbus", "Got valid mbus-frame, size = %d", removeSize);
-            ESP_LOGD("mbus", format_hex_pretty(&m_dataBuffer[0], removeSize).c_str());
         }
         // Remove processed data
         m_dataBuffer.erase(m_dataBuffer.begin(), m_dataBuffer.begin() + removeSize);
-        if (removeSize == 1 && !tryToSyncWithFrame)
+        if (payload.empty() && !tryToSyncWithFrame)
         {
             // Frame has not the expected format, try to sync with it and log only once
             tryToSyncWithFrame = true;
+            m_resyncCount++;
             ESP_LOGE("mbus", "Mbus frame is not in sync, try to sync it...");
         }
     }
@@ -81,12 +86,12 @@ int32_t MbusProtocol::ParseFrame(std::vector<uint8_t>& payload)
     }
     if (m_dataBuffer[START1_OFFSET] != START_VALUE || m_dataBuffer[START2_OFFSET] != START_VALUE)
     {
-        return 1; // wrong start
+        return GetResyncLength(); // wrong start
     }
     const auto payloadLength = m_dataBuffer[LENGTH1_OFFSET];
     if (m_dataBuffer[LENGTH2_OFFSET] != payloadLength)
     {
-        return 1; // wrong length
+        return GetResyncLength(); // wrong length
     }
     const auto frameLength = HEADER_FOOTER_LENGTH + payloadLength;
     if (m_dataBuffer.size() < frameLength)
@@ -96,12 +101,12 @@ int32_t MbusProtocol::ParseFrame(std::vector<uint8_t>& payload)
     const auto checkSum = m_dataBuffer[HEADER_LENGTH + payloadLength];
     if (m_dataBuffer[HEADER_LENGTH + payloadLength + 1] != STOP_VALUE)
     {
-        return 1; // wrong stop
+        return GetResyncLength(); // wrong stop
     }
     if (CalculateChecksum(m_dataBuffer.begin() + HEADER_LENGTH, m_dataBuffer.begin() + (HEADER_LENGTH + payloadLength))
         != checkSum)
     {
-        return 1; // wrong check sum
+        return GetResyncLength(); // wrong check sum
     }
 
     // Frame is valid, return payload
@@ -111,6 +116,13 @@ int32_t MbusProtocol::ParseFrame(std::vector<uint8_t>& payload)
     return frameLength;
 }
 
+int32_t MbusProtocol::GetResyncLength() const
+{
+    // Skip up to the next start byte at once, removing byte by byte is quadratic on noise
+    const auto next = std::find(m_dataBuffer.begin() + 1, m_dataBuffer.end(), START_VALUE);
+    return static_cast<int32_t>(next - m_dataBuffer.begin());
+}
+
 uint8_t MbusProtocol::CalculateChecksum(std::vector<uint8_t>::iterator begin, std::vector<uint8_t>::iterator end) const
 {
     // Simply the sum of all data
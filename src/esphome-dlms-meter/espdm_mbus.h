@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include <vector>
 
@@ -14,13 +15,26 @@ class MbusProtocol
 public:
     void AddFrameData(uint8_t data);
     bool GetPayload(std::vector<uint8_t>& payload);
+    // Reserves the buffer of the received data, so it is not reallocated while receiving
+    void Reserve(size_t size)
+    {
+        m_dataBuffer.reserve(size);
+    }
+    // Number of times the data was not in sync with a frame ( bytes skipped )
+    uint32_t GetResyncCount() const
+    {
+        return m_resyncCount;
+    }
 
 private:
     std::vector<uint8_t> m_dataBuffer;
+    uint32_t m_resyncCount{0};
 
+    // Returns the number of bytes to remove: 0 not enough data, the frame length if payload is set, else the bytes
+    // before the next possible frame
     int32_t ParseFrame(std::vector<uint8_t>& payload);
+    int32_t GetResyncLength() const;
     uint8_t CalculateChecksum(std::vector<uint8_t>::iterator begin, std::vector<uint8_t>::iterator end) const;
-    void Log(std::vector<uint8_t> data) const;
 };
 
 } // namespace espdm
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace esphome
+{
+namespace espdm
+{
+// Local time of the meter, when the data was sent
+struct MeterTimestamp
+{
+    bool IsValid() const
+    {
+        return year != 0;
+    }
+
+    // Seconds since 1970-01-01 as if the local time was UTC, to calculate time differences
+    int64_t ToSeconds() const
+    {
+        // Days from civil, see http://howardhinnant.github.io/date_algorithms.html
+        const int32_t y = static_cast<int32_t>(year) - (month <= 2 ? 1 : 0);
+        const int32_t era = y / 400;
+        const int32_t yearOfEra = y - era * 400;
+        const int32_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        const int32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        const int64_t days = static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+        return days * 86400 + hour * 3600 + minute * 60 + second;
+    }
+
+    // Inverse of ToSeconds()
+    static MeterTimestamp FromSeconds(int64_t seconds)
+    {
+        // Civil from days, see link above
+        const int64_t days = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+        const int32_t secondOfDay = static_cast<int32_t>(seconds - days * 86400);
+        const int64_t z = days + 719468;
+        const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const int32_t dayOfEra = static_cast<int32_t>(z - era * 146097);
+        const int32_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        const int32_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        const int32_t monthIndex = (5 * dayOfYear + 2) / 153; // March is 0
+        MeterTimestamp timestamp;
+        timestamp.day = static_cast<uint8_t>(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+        timestamp.month = static_cast<uint8_t>(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+        timestamp.year = static_cast<uint16_t>(yearOfEra + era * 400 + (timestamp.month <= 2 ? 1 : 0));
+        timestamp.hour = static_cast<uint8_t>(secondOfDay / 3600);
+        timestamp.minute = static_cast<uint8_t>(secondOfDay % 3600 / 60);
+        timestamp.second = static_cast<uint8_t>(secondOfDay % 60);
+        return timestamp;
+    }
+
+    uint16_t year{0};
+    uint8_t month{0};
+    uint8_t day{0};
+    uint8_t hour{0};
+    uint8_t minute{0};
+    uint8_t second{0};
+};
+
+// Values of one dlms-frame, fixed-point integers as sent by the meter
+// Units: voltage 0.1V, current 0.01A, power W ( VA, var ), energy Wh ( varh ), power factor 0.001. The energy
+// counters are exact over the whole range of the meter, float is only used for the outputs ( Sunspec registers,
+// sensors ), see ToVolt() etc.
+struct MeterData
+{
+    struct PhaseValues
+    {
+        int32_t total{0}; // sum or average, see usage
+        int32_t phase1{0};
+        int32_t phase2{0};
+        int32_t phase3{0};
+    };
+
+    // Values calculated from the measured ones, see UpdateDerived()
+    struct Derived
+    {
+        PhaseValues voltage; // 0.1V, total: average
+        PhaseValues voltagePhaseToPhase; // 0.1V, total: average
+        PhaseValues current; // 0.01A
+        PhaseValues apparentPower; // VA, Scheinleistung
+        PhaseValues power; // W, Wirkleistung
+        PhaseValues reactivePower; // var, Blindleistung
+        uint32_t powerFactor{1000}; // 0.001, cos-phi
+    };
+
+    static float ToVolt(int32_t value)
+    {
+        return value / 10.0f;
+    }
+    static float ToAmpere(int32_t value)
+    {
+        return value / 100.0f;
+    }
+    static float ToPowerFactor(uint32_t value)
+    {
+        return value / 1000.0f;
+    }
+
+    // 0.1V, rounded, voltage: 0 - UINT16_MAX
+    static int32_t GetPhaseToPhaseVoltage(int32_t voltage)
+    {
+        return static_cast<int32_t>((static_cast<uint32_t>(voltage) * SQRT3_Q15 + (1u << 14)) >> 15);
+    }
+
+    // Calculates the derived values once per frame, integer only
+    void UpdateDerived()
+    {
+        const int32_t count = (voltageL1 != 0 ? 1 : 0) + (voltageL2 != 0 ? 1 : 0) + (voltageL3 != 0 ? 1 : 0);
+        const int32_t averageVoltage
+            = count == 0 ? 0 : static_cast<int32_t>(DivideRounded(voltageL1 + voltageL2 + voltageL3, count));
+        derived.voltage = {averageVoltage, voltageL1, voltageL2, voltageL3};
+        derived.voltagePhaseToPhase
+            = {GetPhaseToPhaseVoltage(averageVoltage), GetPhaseToPhaseVoltage(voltageL1),
+               GetPhaseToPhaseVoltage(voltageL2), GetPhaseToPhaseVoltage(voltageL3)};
+
+        derived.current = {currentL1 + currentL2 + currentL3, currentL1, currentL2, currentL3};
+
+        // 0.1V * 0.01A = 0.001VA, the power values are calculated from the exact products
+        const int64_t apparentMilli[] = {static_cast<int64_t>(voltageL1) * currentL1,
+                                         static_cast<int64_t>(voltageL2) * currentL2,
+                                         static_cast<int64_t>(voltageL3) * currentL3};
+        const int64_t apparentTotalMilli = apparentMilli[0] + apparentMilli[1] + apparentMilli[2];
+        const int64_t activePower = static_cast<int64_t>(activePowerPlus) - activePowerMinus;
+        const int64_t absApparentTotalMilli = apparentTotalMilli < 0 ? -apparentTotalMilli : apparentTotalMilli;
+        const int64_t absActivePower = activePower < 0 ? -activePower : activePower;
+
+        // cos-phi = Wirkleistung / Scheinleistung
+        derived.powerFactor = apparentTotalMilli != 0 ? static_cast<uint32_t>(DivideRounded(
+                                  absActivePower * 1000000, absApparentTotalMilli))
+                                                      : 1000;
+
+        int32_t* apparentPower[] = {&derived.apparentPower.phase1, &derived.apparentPower.phase2,
+                                    &derived.apparentPower.phase3};
+        int32_t* power[] = {&derived.power.phase1, &derived.power.phase2, &derived.power.phase3};
+        int32_t* reactivePower[] = {&derived.reactivePower.phase1, &derived.reactivePower.phase2,
+                                    &derived.reactivePower.phase3};
+        for (size_t i = 0; i < 3; i++)
+        {
+            *apparentPower[i] = static_cast<int32_t>(DivideRounded(apparentMilli[i], 1000));
+            // Scheinleistung * cos-phi
+            *power[i] = apparentTotalMilli != 0 ? static_cast<int32_t>(
+                            DivideRounded(apparentMilli[i] * absActivePower, absApparentTotalMilli))
+                                                : *apparentPower[i];
+            *reactivePower[i] = *apparentPower[i] - *power[i];
+        }
+        UpdateTotal(derived.apparentPower);
+        UpdateTotal(derived.power);
+        UpdateTotal(derived.reactivePower);
+    }
+
+    uint16_t voltageL1{0}; // 0.1V
+    uint16_t voltageL2{0};
+    uint16_t voltageL3{0};
+    int32_t currentL1{0}; // 0.01A, negative if power is provided to grid
+    int32_t currentL2{0};
+    int32_t currentL3{0};
+    uint32_t activePowerPlus{0}; // W, Wirkleistung
+    uint32_t activePowerMinus{0};
+    uint32_t activeEnergyPlus{0}; // Wh
+    uint32_t activeEnergyMinus{0};
+    uint32_t reactiveEnergyPlus{0}; // varh
+    uint32_t reactiveEnergyMinus{0};
+    MeterTimestamp timestamp;
+
+    Derived derived;
+
+private:
+    static constexpr uint32_t SQRT3_Q15 = 56756; // sqrt(3) * 2^15, no overflow for 16 bit voltages
+
+    // Rounds half away from zero, divisor > 0
+    static int64_t DivideRounded(int64_t value, int64_t divisor)
+    {
+        return value >= 0 ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor);
+    }
+
+    static void UpdateTotal(PhaseValues& values)
+    {
+        values.total = values.phase1 + values.phase2 + values.phase3;
+    }
+};
+
+} // namespace espdm
+} // namespace esphome
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "espdm_obis.h"
+
+namespace esphome
+{
+namespace espdm
+{
+
+// Key of an OBIS code in the map of a profile: medium ( A ), C and D
+constexpr uint32_t ObisKey(uint8_t medium, uint8_t c, uint8_t d)
+{
+    return (static_cast<uint32_t>(medium) << 16) | (static_cast<uint32_t>(c) << 8) | d;
+}
+
+// Meter profiles: frame layout and OBIS map of a meter model, used as template parameter of DlmsFrame and
+// ObisDecoder. All values are compile-time constants, so another meter costs no runtime branching.
+// A profile provides:
+// - MBUS_DLMS_OFFSET: bytes before the dlms-frame in the payload of an mbus-frame
+// - DLMS_*: header of the encrypted dlms-frame ( general-glo-ciphering )
+// - PLAINTEXT_*, DECODER_START_OFFSET: header of the decrypted data-notification, start of the OBIS list
+// - GetCodeType(): the OBIS map
+
+// Kaifa MA309 ( e.g. Tinetz, EVN ), default
+struct KaifaMa309Profile
+{
+    // C, A, CI field and the 2 bytes transport header
+    static constexpr size_t MBUS_DLMS_OFFSET = 5;
+
+    static constexpr uint8_t DLMS_CIPHER = 0xDB; // Only general-glo-ciphering is supported
+    static constexpr uint8_t DLMS_SYST_LENGTH = 0x08; // Only system titles with length of 8 are supported
+    static constexpr uint8_t DLMS_SECURITY_BYTE = 0x21; // Only certain security suite is supported
+
+    static constexpr int DLMS_HEADER_LENGTH = 16; // Length of the header (total message length <= 127)
+    static constexpr int DLMS_HEADER_EXT_OFFSET = 2; // Header is 2 bytes longer if total message length > 127
+    static constexpr int DLMS_CIPHER_OFFSET = 0; // Offset at which used cipher suite is stored
+    static constexpr int DLMS_SYST_OFFSET = 1; // Offset at which length of system title is stored
+    static constexpr int DLMS_LENGTH_OFFSET = 10; // Offset at which message length is stored
+    static constexpr int DLMS_LENGTH_CORRECTION = 5; // Part of the header is included in the DLMS length field
+    // Bytes after length are shifted by DLMS_HEADER_EXT_OFFSET depending on length field
+    static constexpr int DLMS_SECBYTE_OFFSET = 11; // Offset of the security byte
+    static constexpr int DLMS_FRAMECOUNTER_OFFSET = 12; // Offset of the frame counter
+    static constexpr int DLMS_PAYLOAD_OFFSET = 16; // Offset at which the encrypted payload begins
+
+    static constexpr uint8_t PLAINTEXT_TAG = 0x0F; // data-notification
+    static constexpr int PLAINTEXT_DATETIME_OFFSET = 5; // Length of the date-time octet-string
+    static constexpr uint8_t PLAINTEXT_DATETIME_LENGTH = 0x0C;
+    static constexpr int DECODER_START_OFFSET = 20; // Skip header, timestamp and break block
+
+    static constexpr CodeType GetCodeType(uint8_t medium, uint8_t c, uint8_t d)
+    {
+        switch (ObisKey(medium, c, d))
+        {
+        case ObisKey(Medium::Abstract, 0x01, 0x00):
+            return CodeType::Timestamp;
+        case ObisKey(Medium::Abstract, 0x60, 0x01):
+            return CodeType::SerialNumber;
+        case ObisKey(Medium::Abstract, 0x2A, 0x00):
+            return CodeType::DeviceName;
+        case ObisKey(Medium::Electricity, 0x20, 0x07):
+            return CodeType::VoltageL1;
+        case ObisKey(Medium::Electricity, 0x34, 0x07):
+            return CodeType::VoltageL2;
+        case ObisKey(Medium::Electricity, 0x48, 0x07):
+            return CodeType::VoltageL3;
+        case ObisKey(Medium::Electricity, 0x1F, 0x07):
+            return CodeType::CurrentL1;
+        case ObisKey(Medium::Electricity, 0x33, 0x07):
+            return CodeType::CurrentL2;
+        case ObisKey(Medium::Electricity, 0x47, 0x07):
+            return CodeType::CurrentL3;
+        case ObisKey(Medium::Electricity, 0x01, 0x07):
+            return CodeType::ActivePowerPlus;
+        case ObisKey(Medium::Electricity, 0x02, 0x07):
+            return CodeType::ActivePowerMinus;
+        case ObisKey(Medium::Electricity, 0x01, 0x08):
+            return CodeType::ActiveEnergyPlus;
+        case ObisKey(Medium::Electricity, 0x02, 0x08):
+            return CodeType::ActiveEnergyMinus;
+        case ObisKey(Medium::Electricity, 0x03, 0x08):
+            return CodeType::ReactiveEnergyPlus;
+        case ObisKey(Medium::Electricity, 0x04, 0x08):
+            return CodeType::ReactiveEnergyMinus;
+        default:
+            return CodeType::Unknown;
+        }
+    }
+};
+
+// Profile of the build, selected with the build flag -DESPDM_METER_PROFILE=<profile>
+#if defined(ESPDM_METER_PROFILE)
+using MeterProfile = ESPDM_METER_PROFILE;
+#else
+using MeterProfile = KaifaMa309Profile;
+#endif
+
+} // namespace espdm
+} // namespace esphome
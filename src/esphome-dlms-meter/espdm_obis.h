@@ -1,3 +1,5 @@
+#pragma once
+
 /*
  * Data types as per specification
  */
@@ -70,8 +72,6 @@ enum Accuracy
  * Data structure
  */
 
-static const int DECODER_START_OFFSET = 20; // Offset for start of OBIS decoding, skip header, timestamp and break block
-
 static const int OBIS_TYPE_OFFSET = 0;
 static const int OBIS_LENGTH_OFFSET = 1;
 
@@ -84,99 +84,4 @@ static const int OBIS_D = 3;
 static const int OBIS_E = 4;
 static const int OBIS_F = 5;
 
-/*
- * Metadata
- */
-
-static uint8_t ESPDM_TIMESTAMP[]
-{
-    0x01, 0x00
-};
-
-static const uint8_t ESPDM_SERIAL_NUMBER[]
-{
-    0x60, 0x01
-};
-
-static const uint8_t ESPDM_DEVICE_NAME[]
-{
-    0x2A, 0x00
-};
-
-/*
- * Voltage
- */
-
-static uint8_t ESPDM_VOLTAGE_L1[]
-{
-    0x20, 0x07
-};
-
-static const uint8_t ESPDM_VOLTAGE_L2[]
-{
-    0x34, 0x07
-};
-
-static const uint8_t ESPDM_VOLTAGE_L3[]
-{
-    0x48, 0x07
-};
-
-/*
- * Current
- */
-
-static const uint8_t ESPDM_CURRENT_L1[]
-{
-    0x1F, 0x07
-};
-
-static const uint8_t ESPDM_CURRENT_L2[]
-{
-    0x33, 0x07
-};
-
-static const uint8_t ESPDM_CURRENT_L3[]
-{
-    0x47, 0x07
-};
-
-/*
- * Power
- */
-
-static const uint8_t ESPDM_ACTIVE_POWER_PLUS[]
-{
-    0x01, 0x07
-};
-
-static const uint8_t ESPDM_ACTIVE_POWER_MINUS[]
-{
-    0x02, 0x07
-};
-
-/*
- * Active energy
- */
-
-static const uint8_t ESPDM_ACTIVE_ENERGY_PLUS[]
-{
-    0x01, 0x08
-};
-static const uint8_t ESPDM_ACTIVE_ENERGY_MINUS[]
-{
-    0x02, 0x08
-};
-
-/*
- * Reactive energy
- */
-
-static const uint8_t ESPDM_REACTIVE_ENERGY_PLUS[]
-{
-    0x03, 0x08
-};
-static const uint8_t ESPDM_REACTIVE_ENERGY_MINUS[]
-{
-    0x04, 0x08
-};
+// The OBIS codes of the values are mapped by the meter profile, see espdm_meter_profile.h
@@ -0,0 +1,140 @@
+#include "espdm_obis_decoder.h"
+
+#include <algorithm>
+
+namespace
+{
+// In the units of MeterData
+constexpr uint32_t IMPOSSIBLE_VOLTAGE_LIMIT = 3000; // 300V
+constexpr uint32_t IMPOSSIBLE_CURRENT_LIMIT = 3200; // No more than 32Ampere for normal house
+constexpr uint32_t IMPOSSIBLE_POWER_LIMIT = 32 * 230 * 3;
+
+constexpr int8_t VOLTAGE_EXPONENT = -1; // 0.1V
+constexpr int8_t CURRENT_EXPONENT = -2; // 0.01A
+
+// value * 10^scaler in the fixed-point unit 10^exponent, rounded and saturated
+uint32_t Rescale(uint32_t value, int8_t scaler, int8_t exponent)
+{
+    int32_t shift = scaler - exponent;
+    if (shift == 0)
+    {
+        return value; // the meter sends the unit of MeterData
+    }
+    uint64_t result = value;
+    if (shift > 0)
+    {
+        for (; shift > 0 && result <= UINT32_MAX; shift--)
+        {
+            result *= 10;
+        }
+        return result > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(result);
+    }
+    if (shift < -10)
+    {
+        return 0;
+    }
+    uint64_t divisor = 1;
+    for (; shift < 0; shift++)
+    {
+        divisor *= 10;
+    }
+    return static_cast<uint32_t>((result + divisor / 2) / divisor);
+}
+
+uint16_t GetVoltage(uint32_t value, int8_t scaler)
+{
+    return static_cast<uint16_t>(std::min<uint32_t>(Rescale(value, scaler, VOLTAGE_EXPONENT), UINT16_MAX));
+}
+
+int32_t GetCurrent(uint32_t value, int8_t scaler)
+{
+    return static_cast<int32_t>(std::min<uint32_t>(Rescale(value, scaler, CURRENT_EXPONENT), INT32_MAX));
+}
+
+} // namespace
+
+namespace esphome
+{
+namespace espdm
+{
+
+template <typename T>
+void ObisDecoder::ApplyLimit(T& value, uint32_t impossibleLimit, const char* name)
+{
+    // Note: called before the sign of the current is applied, all values are positive
+    if (static_cast<uint32_t>(value) > impossibleLimit)
+    {
+        ESP_LOGE(LOG_TAG, "%s value[%u] is greater than limit[%u]. Set it to 0.", name,
+                 static_cast<unsigned>(value), static_cast<unsigned>(impossibleLimit));
+        value = 0;
+    }
+}
+
+void ObisDecoder::Complete(MeterData& data)
+{
+    ApplyLimit(data.voltageL1, IMPOSSIBLE_VOLTAGE_LIMIT, "Voltage L1");
+    ApplyLimit(data.voltageL2, IMPOSSIBLE_VOLTAGE_LIMIT, "Voltage L2");
+    ApplyLimit(data.voltageL3, IMPOSSIBLE_VOLTAGE_LIMIT, "Voltage L3");
+    ApplyLimit(data.currentL1, IMPOSSIBLE_CURRENT_LIMIT, "Current L1");
+    ApplyLimit(data.currentL2, IMPOSSIBLE_CURRENT_LIMIT, "Current L2");
+    ApplyLimit(data.currentL3, IMPOSSIBLE_CURRENT_LIMIT, "Current L3");
+    ApplyLimit(data.activePowerPlus, IMPOSSIBLE_POWER_LIMIT, "Active power plus");
+    ApplyLimit(data.activePowerMinus, IMPOSSIBLE_POWER_LIMIT, "Active power minus");
+    // Apply sign to current to show the direction of current flow
+    if (data.activePowerPlus < data.activePowerMinus)
+    {
+        // Providing power to grid ( Einspeisung ) => negative current flow
+        data.currentL1 = -data.currentL1;
+        data.currentL2 = -data.currentL2;
+        data.currentL3 = -data.currentL3;
+    }
+    data.UpdateDerived();
+}
+
+void ObisDecoder::SetValue(MeterData& data, CodeType codeType, uint32_t value, int8_t scaler) const
+{
+    switch (codeType)
+    {
+    case CodeType::VoltageL1:
+        data.voltageL1 = GetVoltage(value, scaler);
+        break;
+    case CodeType::VoltageL2:
+        data.voltageL2 = GetVoltage(value, scaler);
+        break;
+    case CodeType::VoltageL3:
+        data.voltageL3 = GetVoltage(value, scaler);
+        break;
+    case CodeType::CurrentL1:
+        data.currentL1 = GetCurrent(value, scaler);
+        break;
+    case CodeType::CurrentL2:
+        data.currentL2 = GetCurrent(value, scaler);
+        break;
+    case CodeType::CurrentL3:
+        data.currentL3 = GetCurrent(value, scaler);
+        break;
+    case CodeType::ActivePowerPlus:
+        data.activePowerPlus = Rescale(value, scaler, 0);
+        break;
+    case CodeType::ActivePowerMinus:
+        data.activePowerMinus = Rescale(value, scaler, 0);
+        break;
+    case CodeType::ActiveEnergyPlus:
+        data.activeEnergyPlus = Rescale(value, scaler, 0);
+        break;
+    case CodeType::ActiveEnergyMinus:
+        data.activeEnergyMinus = Rescale(value, scaler, 0);
+        break;
+    case CodeType::ReactiveEnergyPlus:
+        data.reactiveEnergyPlus = Rescale(value, scaler, 0);
+        break;
+    case CodeType::ReactiveEnergyMinus:
+        data.reactiveEnergyMinus = Rescale(value, scaler, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+} // namespace espdm
+} // namespace esphome
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ESPDM_HOST
+    #include "esphome.h" // for logging
+#else
+    #include "esphome_host.h"
+#endif
+#include "espdm_meter_data.h"
+#include "espdm_meter_profile.h"
+#include "espdm_obis.h"
+
+namespace esphome
+{
+namespace espdm
+{
+
+// Decodes the OBIS list of a decrypted DLMS data-notification (plaintext), the header and OBIS map are defined by
+// the Profile ( see espdm_meter_profile.h )
+// Note: has no dependency to the platform, so it can be used in host tests/benchmarks
+class ObisDecoder
+{
+public:
+    enum class Result
+    {
+        OK,
+        INVALID_DATA,
+        UNSUPPORTED_HEADER_TYPE,
+        UNSUPPORTED_HEADER_LENGTH,
+        UNSUPPORTED_MEDIUM,
+        UNSUPPORTED_DATA_TYPE
+    };
+
+    // Fills the values of data, which are available in plaintext. The values are rescaled by their scaler to the
+    // fixed-point units of MeterData ( e.g. a voltage with scaler 0 to 0.1V ).
+    template <typename Profile = MeterProfile>
+    Result Decode(const uint8_t* plaintext, size_t length, MeterData& data) const;
+    // After a successful Decode(): plausibility limits, direction of the current and the derived values
+    static void Complete(MeterData& data);
+
+private:
+    static constexpr const char* LOG_TAG = "espdm";
+
+    static uint16_t ReadUint16(const uint8_t* data)
+    {
+        return (static_cast<uint16_t>(data[0]) << 8) | data[1];
+    }
+
+    static uint32_t ReadUint32(const uint8_t* data)
+    {
+        return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16)
+               | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+    }
+
+    // count bytes from position are in the plaintext
+    static bool IsAvailable(size_t position, size_t count, size_t length)
+    {
+        return position <= length && count <= length - position;
+    }
+
+    static Result Truncated()
+    {
+        ESP_LOGE(LOG_TAG, "OBIS: Data is truncated");
+        return Result::INVALID_DATA;
+    }
+
+    // Scaler of the scaler-unit structure after the value ( 02 02 0F <scaler> 16 <unit> ), 0 if there is none
+    static int8_t ReadScaler(const uint8_t* plaintext, size_t position, size_t length)
+    {
+        return IsAvailable(position, 4, length) && plaintext[position + 2] == DataType::Integer
+                   ? static_cast<int8_t>(plaintext[position + 3])
+                   : 0;
+    }
+
+    void SetValue(MeterData& data, CodeType codeType, uint32_t value, int8_t scaler) const;
+    template <typename T>
+    static void ApplyLimit(T& value, uint32_t impossibleLimit, const char* name);
+};
+
+template <typename Profile>
+ObisDecoder::Result ObisDecoder::Decode(const uint8_t* plaintext, size_t length, MeterData& data) const
+{
+    // Note: every read is checked against length, the plaintext is not trusted ( wrong key, noise on the line )
+    if (!IsAvailable(0, Profile::DECODER_START_OFFSET + 1, length) || plaintext[0] != Profile::PLAINTEXT_TAG
+        || plaintext[Profile::PLAINTEXT_DATETIME_OFFSET] != Profile::PLAINTEXT_DATETIME_LENGTH)
+    {
+        ESP_LOGE(LOG_TAG, "OBIS: Packet was decrypted but data is invalid");
+        return Result::INVALID_DATA;
+    }
+
+    ESP_LOGV(LOG_TAG, "Decoding payload");
+
+    size_t currentPosition = Profile::DECODER_START_OFFSET;
+
+    do
+    {
+        if (!IsAvailable(currentPosition, OBIS_CODE_OFFSET, length))
+        {
+            return Truncated();
+        }
+        if (plaintext[currentPosition + OBIS_TYPE_OFFSET] != DataType::OctetString)
+        {
+            ESP_LOGE(LOG_TAG, "OBIS: Unsupported OBIS header type");
+            return Result::UNSUPPORTED_HEADER_TYPE;
+        }
+
+        const uint8_t obisCodeLength = plaintext[currentPosition + OBIS_LENGTH_OFFSET];
+
+        if (obisCodeLength != 0x06)
+        {
+            ESP_LOGE(LOG_TAG, "OBIS: Unsupported OBIS header length");
+            return Result::UNSUPPORTED_HEADER_LENGTH;
+        }
+
+        // Code and data type
+        if (!IsAvailable(currentPosition, OBIS_CODE_OFFSET + obisCodeLength + 1, length))
+        {
+            return Truncated();
+        }
+        const uint8_t* obisCode = &plaintext[currentPosition + OBIS_CODE_OFFSET];
+        if (obisCode[OBIS_A] != Medium::Electricity && obisCode[OBIS_A] != Medium::Abstract)
+        {
+            ESP_LOGE(LOG_TAG, "OBIS: Unsupported OBIS medium");
+            return Result::UNSUPPORTED_MEDIUM;
+        }
+        const CodeType codeType = Profile::GetCodeType(obisCode[OBIS_A], obisCode[OBIS_C], obisCode[OBIS_D]);
+        if (codeType == CodeType::Unknown)
+        {
+            ESP_LOGW(LOG_TAG, "OBIS: Unsupported OBIS code");
+        }
+
+        currentPosition += obisCodeLength + 2; // Advance past code, position and type
+
+        const uint8_t dataType = plaintext[currentPosition];
+        currentPosition++; // Advance past data type
+
+        uint8_t dataLength = 0x00;
+
+        switch (dataType)
+        {
+        case DataType::DoubleLongUnsigned:
+            dataLength = 4;
+            if (!IsAvailable(currentPosition, dataLength, length))
+            {
+                return Truncated();
+            }
+
+            SetValue(data, codeType, ReadUint32(&plaintext[currentPosition]),
+                     ReadScaler(plaintext, currentPosition + dataLength, length));
+
+            break;
+        case DataType::LongUnsigned:
+            dataLength = 2;
+            if (!IsAvailable(currentPosition, dataLength, length))
+            {
+                return Truncated();
+            }
+
+            SetValue(data, codeType, ReadUint16(&plaintext[currentPosition]),
+                     ReadScaler(plaintext, currentPosition + dataLength, length));
+
+            break;
+        case DataType::OctetString:
+            if (!IsAvailable(currentPosition, 1, length))
+            {
+                return Truncated();
+            }
+            dataLength = plaintext[currentPosition];
+            currentPosition++; // Advance past string length
+            if (!IsAvailable(currentPosition, dataLength, length))
+            {
+                return Truncated();
+            }
+
+            if (codeType == CodeType::Timestamp && dataLength >= 8) // Handle timestamp generation
+            {
+                MeterTimestamp& timestamp = data.timestamp;
+                timestamp.year = ReadUint16(&plaintext[currentPosition]);
+                timestamp.month = plaintext[currentPosition + 2];
+                timestamp.day = plaintext[currentPosition + 3];
+                timestamp.hour = plaintext[currentPosition + 5];
+                timestamp.minute = plaintext[currentPosition + 6];
+                timestamp.second = plaintext[currentPosition + 7];
+            }
+
+            break;
+        default:
+            ESP_LOGE(LOG_TAG, "OBIS: Unsupported OBIS data type");
+            return Result::UNSUPPORTED_DATA_TYPE;
+        }
+
+        currentPosition += dataLength; // Skip data length
+
+        currentPosition += 2; // Skip break after data
+
+        // There is still additional data for this type, skip it
+        if (currentPosition < length && plaintext[currentPosition] == 0x0F)
+            currentPosition += 6; // Skip additional data and additional break, jumps past the end on the last entry
+    } while (currentPosition < length); // Loop until arrived at end
+
+    return Result::OK;
+}
+
+} // namespace espdm
+} // namespace esphome
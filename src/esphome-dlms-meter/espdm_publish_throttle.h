@@ -0,0 +1,62 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+namespace esphome
+{
+namespace espdm
+{
+
+// When a sensor value is published
+// deadband: min. change of the value, 0 => every change
+// minIntervalMs: min. time between two publishes, 0 => no limit
+// maxIntervalMs: publish even if unchanged after this time, 0 => only on change
+struct PublishPolicy
+{
+    float deadband{0.0f};
+    uint32_t minIntervalMs{0};
+    uint32_t maxIntervalMs{0};
+};
+
+// Decides per sensor if a new value has to be published
+class PublishThrottle
+{
+public:
+    // Returns true if value has to be published, it is then taken as last published value
+    bool ShouldPublish(const PublishPolicy& policy, float value, uint32_t nowMs)
+    {
+        if (m_published)
+        {
+            const uint32_t elapsedMs = nowMs - m_lastMs;
+            if (elapsedMs < policy.minIntervalMs)
+            {
+                return false;
+            }
+            const float change = fabsf(value - m_lastValue);
+            const bool changed = value != m_lastValue && change >= policy.deadband;
+            const bool expired = policy.maxIntervalMs != 0 && elapsedMs >= policy.maxIntervalMs;
+            if (!changed && !expired)
+            {
+                return false;
+            }
+        }
+        m_published = true;
+        m_lastValue = value;
+        m_lastMs = nowMs;
+        return true;
+    }
+
+    void Reset()
+    {
+        m_published = false;
+    }
+
+private:
+    bool m_published{false};
+    float m_lastValue{0.0f};
+    uint32_t m_lastMs{0};
+};
+
+} // namespace espdm
+} // namespace esphome
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+namespace esphome
+{
+namespace espdm
+{
+
+// Lock-free single-producer/single-consumer queue with fixed capacity
+// Push must only be called by one thread(task) and Pop only by one other thread(task).
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    // Returns false if the queue is full
+    bool Push(const T& item)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        m_items[head & (Capacity - 1)] = item;
+        // publish the item after it is completely written
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Returns false if the queue is empty
+    bool Pop(T& item)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (m_head.load(std::memory_order_acquire) == tail)
+        {
+            return false;
+        }
+        item = m_items[tail & (Capacity - 1)];
+        // release the slot after it is completely read
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T m_items[Capacity];
+    std::atomic<size_t> m_head{0}; // written by producer
+    std::atomic<size_t> m_tail{0}; // written by consumer
+};
+
+} // namespace espdm
+} // namespace esphome
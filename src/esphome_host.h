@@ -0,0 +1,157 @@
+#pragma once
+
+// Host port of the esphome functions used by the sources shared with the host builds ( ESPDM_HOST ):
+// logging, millis(), micros(), crc16() and format_hex_pretty(). Used by the gateway, the tools and the tests.
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace esphome
+{
+namespace host
+{
+
+enum class LogLevel : uint8_t
+{
+    NONE,
+    ERROR,
+    WARN,
+    INFO,
+    DEBUG,
+    VERBOSE
+};
+
+// Messages up to this level are written to stderr, default: none ( tests, benchmarks )
+inline LogLevel& GetLogLevel()
+{
+    static LogLevel level{LogLevel::NONE};
+    return level;
+}
+
+inline void SetLogLevel(LogLevel level)
+{
+    GetLogLevel() = level;
+}
+
+inline bool IsLogEnabled(LogLevel level)
+{
+    return level <= GetLogLevel();
+}
+
+// Receives the formatted messages instead of stderr ( tests ), nullptr: stderr
+using LogSink = void (*)(char level, const char* tag, const char* message);
+
+inline LogSink& GetLogSink()
+{
+    static LogSink sink{nullptr};
+    return sink;
+}
+
+inline void SetLogSink(LogSink sink)
+{
+    GetLogSink() = sink;
+}
+
+// Writes one line to stderr or the sink, the format is checked like the one of esphome
+inline void Log(char level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+inline void Log(char level, const char* tag, const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    if (GetLogSink() != nullptr)
+    {
+        char message[256];
+        vsnprintf(message, sizeof(message), format, arguments);
+        GetLogSink()(level, tag, message);
+    }
+    else
+    {
+        fprintf(stderr, "[%c][%s] ", level, tag);
+        vfprintf(stderr, format, arguments);
+        fputc('\n', stderr);
+    }
+    va_end(arguments);
+}
+
+} // namespace host
+
+inline uint32_t micros()
+{
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+inline uint32_t millis()
+{
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+inline uint16_t crc16(const uint8_t* data, uint8_t len)
+{
+    uint16_t crc = 0xFFFF;
+    while (len--)
+    {
+        crc ^= *data++;
+        for (uint8_t i = 0; i < 8; i++)
+        {
+            if ((crc & 0x01) != 0)
+            {
+                crc >>= 1;
+                crc ^= 0xA001;
+            }
+            else
+            {
+                crc >>= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+inline std::string format_hex_pretty(const uint8_t* data, size_t length)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string result;
+    for (size_t i = 0; i < length; i++)
+    {
+        result += hex[data[i] >> 4];
+        result += hex[data[i] & 0x0F];
+        result += '.';
+    }
+    if (!result.empty())
+    {
+        result.pop_back();
+    }
+    return result;
+}
+
+inline std::string format_hex_pretty(const std::vector<uint8_t>& data)
+{
+    return format_hex_pretty(data.data(), data.size());
+}
+
+} // namespace esphome
+
+// The arguments are only evaluated if the level is enabled, like the compiled out levels of esphome
+#define ESPDM_HOST_LOG(level, letter, tag, ...)                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (::esphome::host::IsLogEnabled(::esphome::host::LogLevel::level))                                           \
+        {                                                                                                              \
+            ::esphome::host::Log(letter, tag, __VA_ARGS__);                                                            \
+        }                                                                                                              \
+    } while (false)
+
+#define ESP_LOGV(tag, ...) ESPDM_HOST_LOG(VERBOSE, 'V', tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESPDM_HOST_LOG(DEBUG, 'D', tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESPDM_HOST_LOG(INFO, 'I', tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESPDM_HOST_LOG(WARN, 'W', tag, __VA_ARGS__)
+#define ESP_LOGE(tag, ...) ESPDM_HOST_LOG(ERROR, 'E', tag, __VA_ARGS__)
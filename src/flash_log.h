@@ -0,0 +1,404 @@
+#pragma once
+
+#ifndef ESPDM_HOST
+    #include "esphome/core/helpers.h"
+#else
+    #include "esphome_host.h"
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Raw access to a flash region, see FlashLog
+// Note: NOR flash semantic, a write can only clear bits, an erase sets the whole sector to 0xFF
+class FlashDevice
+{
+public:
+    static constexpr size_t SECTOR_SIZE = 4096;
+
+    virtual ~FlashDevice() = default;
+    virtual size_t GetSectorCount() const = 0;
+    virtual bool Read(size_t offset, void* data, size_t size) = 0;
+    virtual bool Write(size_t offset, const void* data, size_t size) = 0;
+    virtual bool EraseSector(size_t sector) = 0;
+};
+
+// Append-only log of fixed size records in a ring of flash sectors
+//   Sector: header ( magic, sequence ) followed by slots ( record + crc ), free slots are 0xFF.
+//   Append() writes the next free slot, if the head sector is full the next sector ( the oldest one if the ring is
+//   full ) becomes the new head. So each sector is erased once per round trip of the ring ( wear levelling ), a
+//   power loss only loses the slot written at that moment ( crc ).
+//   Mount() finds the head by the sequence numbers of the sector headers and the first free slot by binary search.
+//   It does not erase, on an empty region the sectors are erased one by one when they are used.
+// Erase-ahead: a sector erase blocks for ~50ms, see FlashPartition. EraseAhead() erases the next sector before the
+// head is full, so Append() only writes. Without it Append() erases when the head moves.
+// Record: trivially copyable, first member "uint32_t time", must increase with each Append(). The time is the key
+// of Seek(), a range query reads O(log n) slots to find the start, then one slot per record.
+// Note: not thread safe
+template <typename Record>
+class FlashLog
+{
+public:
+    static_assert(std::is_trivially_copyable<Record>::value, "Record is stored binary");
+    static_assert(sizeof(Record) <= 250, "crc16 length");
+
+    // Position of a range query, see Seek() and Next()
+    struct Cursor
+    {
+        uint32_t sequence{0}; // of the sector, if it was erased meanwhile the query restarts at the oldest sector
+        uint32_t slot{0};
+    };
+
+    FlashLog(FlashDevice& device, size_t firstSector, size_t sectorCount)
+        : m_device(device)
+        , m_firstSector(firstSector)
+        , m_sectorCount(sectorCount)
+    { }
+
+    static constexpr size_t GetSlotsPerSector()
+    {
+        return SLOTS_PER_SECTOR;
+    }
+
+    size_t GetCapacity() const
+    {
+        return m_sectorCount * SLOTS_PER_SECTOR;
+    }
+
+    // Number of slots in use ( including the ones with broken crc )
+    size_t GetSize() const
+    {
+        return m_usedSectors == 0 ? 0 : (m_usedSectors - 1) * SLOTS_PER_SECTOR + m_headSlot;
+    }
+
+    bool IsMounted() const
+    {
+        return m_mounted;
+    }
+
+    // Reads the sector headers, no valid sector is an empty log
+    bool Mount()
+    {
+        m_mounted = false;
+        if (m_sectorCount < 2)
+        {
+            return false;
+        }
+        SetEmpty();
+        m_mounted = true;
+        bool found = false;
+        uint32_t headSequence = 0;
+        uint32_t oldestSequence = 0;
+        for (size_t sector = 0; sector < m_sectorCount; sector++)
+        {
+            SectorHeader header;
+            if (!ReadHeader(sector, header))
+            {
+                continue;
+            }
+            if (!found || static_cast<int32_t>(header.sequence - headSequence) > 0)
+            {
+                headSequence = header.sequence;
+                m_headSector = sector;
+            }
+            if (!found || static_cast<int32_t>(header.sequence - oldestSequence) < 0)
+            {
+                oldestSequence = header.sequence;
+            }
+            found = true;
+        }
+        if (!found)
+        {
+            return true;
+        }
+        m_headSequence = headSequence;
+        m_usedSectors = headSequence - oldestSequence + 1;
+        if (m_usedSectors > m_sectorCount)
+        {
+            // Sequence gap of a damaged header, use only the sectors in order before the head
+            m_usedSectors = m_sectorCount;
+        }
+        m_headSlot = FindFirstFreeSlot(m_headSector);
+        return true;
+    }
+
+    // Erases the whole region, the log is empty afterwards
+    // Note: blocks for ~50ms per sector, not for the boot path
+    bool Format()
+    {
+        m_mounted = false;
+        for (size_t sector = 0; sector < m_sectorCount; sector++)
+        {
+            if (!m_device.EraseSector(m_firstSector + sector))
+            {
+                return false;
+            }
+        }
+        SetEmpty();
+        m_erasedSector = GetNextSector();
+        m_mounted = true;
+        return true;
+    }
+
+    // True if the sector the head moves to next is not erased yet, see EraseAhead()
+    bool IsEraseAheadPending() const
+    {
+        return IsMounted() && m_erasedSector != GetNextSector();
+    }
+
+    // Erases the sector the head moves to next, if needed. Returns true if a sector was erased.
+    // The oldest sector is dropped before, if the ring is full ( a reader continues at the new oldest one ).
+    bool EraseAhead()
+    {
+        if (!IsEraseAheadPending())
+        {
+            return false;
+        }
+        const size_t next = GetNextSector();
+        if (m_usedSectors == m_sectorCount)
+        {
+            m_usedSectors--;
+        }
+        if (!m_device.EraseSector(m_firstSector + next))
+        {
+            return false;
+        }
+        m_erasedSector = next;
+        return true;
+    }
+
+    bool Append(const Record& record)
+    {
+        if (!IsMounted())
+        {
+            return false;
+        }
+        if (m_headSlot == SLOTS_PER_SECTOR)
+        {
+            if (IsEraseAheadPending() && !EraseAhead())
+            {
+                return false;
+            }
+            // Set the new state first, a failed header write leaves the sector erased and unused at next Mount()
+            m_headSector = m_erasedSector;
+            m_erasedSector = NO_SECTOR;
+            m_headSequence++;
+            m_headSlot = 0;
+            m_usedSectors = m_usedSectors < m_sectorCount ? m_usedSectors + 1 : m_sectorCount;
+            if (!WriteHeader(m_headSector, m_headSequence))
+            {
+                return false;
+            }
+        }
+        Slot slot;
+        slot.record = record;
+        slot.crc = crc16(reinterpret_cast<const uint8_t*>(&slot.record), sizeof(Record));
+        const bool success = m_device.Write(GetSlotOffset(m_headSector, m_headSlot), &slot, sizeof(slot));
+        m_headSlot++; // a failed write occupies the slot anyway
+        return success;
+    }
+
+    // Cursor to the first record with time >= from
+    Cursor Seek(uint32_t from)
+    {
+        Cursor cursor;
+        if (m_usedSectors == 0)
+        {
+            return cursor;
+        }
+        // Last sector with first time <= from, the sectors are in time order
+        size_t low = 0;
+        size_t high = m_usedSectors;
+        while (high - low > 1)
+        {
+            const size_t middle = (low + high) / 2;
+            uint32_t time;
+            if (ReadTime(GetSector(middle), 0, time) && time > from)
+            {
+                high = middle;
+            }
+            else
+            {
+                low = middle;
+            }
+        }
+        // First slot with time >= from in this sector, may be the end of the sector
+        const size_t sector = GetSector(low);
+        uint32_t first = 0;
+        uint32_t last = GetSlotCount(low);
+        while (first < last)
+        {
+            const uint32_t middle = (first + last) / 2;
+            uint32_t time;
+            if (ReadTime(sector, middle, time) && time < from)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+        cursor.sequence = GetSequence(low);
+        cursor.slot = first;
+        return cursor;
+    }
+
+    // Next valid record of the cursor, false at the end of the log
+    bool Next(Cursor& cursor, Record& record)
+    {
+        if (m_usedSectors == 0)
+        {
+            return false;
+        }
+        const uint32_t oldestSequence = GetSequence(0);
+        if (static_cast<int32_t>(cursor.sequence - oldestSequence) < 0)
+        {
+            // Overwritten while reading, continue with the oldest record
+            cursor.sequence = oldestSequence;
+            cursor.slot = 0;
+        }
+        while (true)
+        {
+            const size_t index = cursor.sequence - oldestSequence;
+            if (index >= m_usedSectors)
+            {
+                return false;
+            }
+            if (cursor.slot >= GetSlotCount(index))
+            {
+                if (index + 1 == m_usedSectors)
+                {
+                    return false;
+                }
+                cursor.sequence++;
+                cursor.slot = 0;
+                continue;
+            }
+            Slot slot;
+            const size_t offset = GetSlotOffset(GetSector(index), cursor.slot);
+            cursor.slot++;
+            if (m_device.Read(offset, &slot, sizeof(slot))
+                && slot.crc == crc16(reinterpret_cast<const uint8_t*>(&slot.record), sizeof(Record)))
+            {
+                record = slot.record;
+                return true;
+            }
+        }
+    }
+
+private:
+    static constexpr uint32_t MAGIC = 0x474F4C46; // "FLOG"
+    static constexpr uint32_t FREE_TIME = 0xFFFFFFFF;
+    static constexpr size_t NO_SECTOR = SIZE_MAX;
+
+    struct SectorHeader
+    {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t slotSize; // detects a changed record layout
+        uint32_t check; // ~sequence, detects a torn header write
+    };
+
+    struct Slot
+    {
+        Record record;
+        uint16_t crc;
+    };
+
+    static constexpr size_t SLOTS_PER_SECTOR = (FlashDevice::SECTOR_SIZE - sizeof(SectorHeader)) / sizeof(Slot);
+
+    FlashDevice& m_device;
+    const size_t m_firstSector;
+    const size_t m_sectorCount;
+    bool m_mounted{false};
+    size_t m_usedSectors{0}; // 0: empty
+    size_t m_headSector{0};
+    uint32_t m_headSequence{0};
+    uint32_t m_headSlot{0}; // first free slot of the head sector
+    size_t m_erasedSector{NO_SECTOR}; // erased ahead, the next head sector
+
+    // No sector in use, the first Append() starts at sector 0 with sequence 1
+    void SetEmpty()
+    {
+        m_usedSectors = 0;
+        m_headSector = m_sectorCount - 1;
+        m_headSequence = 0;
+        m_headSlot = SLOTS_PER_SECTOR;
+        m_erasedSector = NO_SECTOR;
+    }
+
+    size_t GetNextSector() const
+    {
+        return (m_headSector + 1) % m_sectorCount;
+    }
+
+    // Physical sector of the index, 0 is the oldest used sector
+    size_t GetSector(size_t index) const
+    {
+        return (m_headSector + m_sectorCount - (m_usedSectors - 1) + index) % m_sectorCount;
+    }
+
+    uint32_t GetSequence(size_t index) const
+    {
+        return m_headSequence - (m_usedSectors - 1) + index;
+    }
+
+    uint32_t GetSlotCount(size_t index) const
+    {
+        return index + 1 == m_usedSectors ? m_headSlot : SLOTS_PER_SECTOR;
+    }
+
+    size_t GetSlotOffset(size_t sector, size_t slot) const
+    {
+        return (m_firstSector + sector) * FlashDevice::SECTOR_SIZE + sizeof(SectorHeader) + slot * sizeof(Slot);
+    }
+
+    bool ReadHeader(size_t sector, SectorHeader& header)
+    {
+        return m_device.Read((m_firstSector + sector) * FlashDevice::SECTOR_SIZE, &header, sizeof(header))
+               && header.magic == MAGIC && header.slotSize == sizeof(Slot) && header.check == ~header.sequence;
+    }
+
+    bool WriteHeader(size_t sector, uint32_t sequence)
+    {
+        const SectorHeader header = {MAGIC, sequence, sizeof(Slot), ~sequence};
+        return m_device.Write((m_firstSector + sector) * FlashDevice::SECTOR_SIZE, &header, sizeof(header));
+    }
+
+    bool ReadTime(size_t sector, size_t slot, uint32_t& time)
+    {
+        // Note: time is the first member of Record
+        return m_device.Read(GetSlotOffset(sector, slot), &time, sizeof(time));
+    }
+
+    uint32_t FindFirstFreeSlot(size_t sector)
+    {
+        // Slots are written in order, a torn write has a time != FREE_TIME
+        uint32_t first = 0;
+        uint32_t last = SLOTS_PER_SECTOR;
+        while (first < last)
+        {
+            const uint32_t middle = (first + last) / 2;
+            uint32_t time;
+            if (ReadTime(sector, middle, time) && time != FREE_TIME)
+            {
+                first = middle + 1;
+            }
+            else
+            {
+                last = middle;
+            }
+        }
+        return first;
+    }
+};
+
+} // namespace sm
+} // namespace esphome
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "flash_log.h"
+
+#if defined(ESP32)
+    #include "esp_partition.h"
+#endif
+
+namespace esphome
+{
+namespace sm
+{
+
+// FlashDevice on a data partition of the ESP32 flash, see partitions.csv
+// Note: the cpu caches are disabled while writing/erasing, a sector erase blocks for ~50ms
+class FlashPartition : public FlashDevice
+{
+public:
+    bool Open(const char* label)
+    {
+#if defined(ESP32)
+        m_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+#endif
+        return m_partition != nullptr;
+    }
+
+    size_t GetSectorCount() const override
+    {
+#if defined(ESP32)
+        return m_partition == nullptr ? 0 : m_partition->size / SECTOR_SIZE;
+#else
+        return 0;
+#endif
+    }
+
+    bool Read(size_t offset, void* data, size_t size) override
+    {
+#if defined(ESP32)
+        return m_partition != nullptr && esp_partition_read(m_partition, offset, data, size) == ESP_OK;
+#else
+        return false;
+#endif
+    }
+
+    bool Write(size_t offset, const void* data, size_t size) override
+    {
+#if defined(ESP32)
+        return m_partition != nullptr && esp_partition_write(m_partition, offset, data, size) == ESP_OK;
+#else
+        return false;
+#endif
+    }
+
+    bool EraseSector(size_t sector) override
+    {
+#if defined(ESP32)
+        return m_partition != nullptr
+               && esp_partition_erase_range(m_partition, sector * SECTOR_SIZE, SECTOR_SIZE) == ESP_OK;
+#else
+        return false;
+#endif
+    }
+
+private:
+#if defined(ESP32)
+    const esp_partition_t* m_partition{nullptr};
+#else
+    const void* m_partition{nullptr};
+#endif
+};
+
+} // namespace sm
+} // namespace esphome
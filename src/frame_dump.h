@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Ring buffer of raw frames ( e.g. the mbus-frame payloads ) with fixed memory, instead of hex logging per frame
+// The frames are stored binary, they are only formatted when the dump is read ( see FrameDumpWebHandler ).
+// Record: sequence ( 4 bytes ), time ( 4 ), length ( 2 ), data. If the buffer is full, the oldest frames are dropped.
+// Note: not thread safe, see Reader
+class FrameDump
+{
+public:
+    static constexpr size_t MAX_FRAME_LENGTH = 512; // longer frames are truncated
+    // Formatted line of a frame of MAX_FRAME_LENGTH, see Format()
+    static constexpr size_t MAX_LINE_LENGTH = 28 + 3 * MAX_FRAME_LENGTH;
+
+    struct Frame
+    {
+        uint32_t sequence{0}; // number of the frame since start
+        uint32_t timeMs{0};
+        uint16_t length{0};
+    };
+
+    explicit FrameDump(size_t capacity)
+        : m_buffer(std::max(capacity, RECORD_HEADER_SIZE + MAX_FRAME_LENGTH))
+    { }
+
+    void Add(uint32_t timeMs, const uint8_t* data, size_t length)
+    {
+        if (length > MAX_FRAME_LENGTH)
+        {
+            length = MAX_FRAME_LENGTH;
+        }
+        const size_t recordSize = RECORD_HEADER_SIZE + length;
+        while (m_buffer.size() - m_used < recordSize)
+        {
+            DropOldest();
+        }
+        uint8_t header[RECORD_HEADER_SIZE];
+        const uint16_t length16 = static_cast<uint16_t>(length);
+        std::memcpy(&header[0], &m_nextSequence, sizeof(m_nextSequence));
+        std::memcpy(&header[4], &timeMs, sizeof(timeMs));
+        std::memcpy(&header[8], &length16, sizeof(length16));
+        const size_t position = Wrap(m_head + m_used);
+        Write(position, header, RECORD_HEADER_SIZE);
+        Write(Wrap(position + RECORD_HEADER_SIZE), data, length);
+        m_used += recordSize;
+        m_nextSequence++;
+    }
+
+    // Frames in the buffer
+    uint32_t GetFrameCount() const
+    {
+        return m_nextSequence - m_firstSequence;
+    }
+    // Frames overwritten by newer ones
+    uint32_t GetDroppedCount() const
+    {
+        return m_firstSequence;
+    }
+    // Bytes of the buffer, at least one frame of MAX_FRAME_LENGTH
+    size_t GetCapacity() const
+    {
+        return m_buffer.size();
+    }
+
+    // Reads the frames, oldest first. Frames added while reading are also read.
+    // The reader is valid as long as the FrameDump, calls of Next() and Add() must not overlap.
+    class Reader
+    {
+    public:
+        explicit Reader(const FrameDump& dump)
+            : m_dump(dump)
+            , m_sequence(dump.m_firstSequence)
+            , m_position(dump.m_head)
+        { }
+
+        // data: MAX_FRAME_LENGTH bytes, returns false if there is no more frame
+        bool Next(Frame& frame, uint8_t* data)
+        {
+            if (m_sequence < m_dump.m_firstSequence)
+            {
+                // frame was dropped meanwhile, continue with the oldest one
+                m_sequence = m_dump.m_firstSequence;
+                m_position = m_dump.m_head;
+            }
+            if (m_sequence >= m_dump.m_nextSequence)
+            {
+                return false;
+            }
+            m_position = m_dump.ReadRecord(m_position, frame, data);
+            m_sequence++;
+            return true;
+        }
+
+    private:
+        const FrameDump& m_dump;
+        uint32_t m_sequence;
+        size_t m_position;
+    };
+
+    // One line: "<sequence> <time in ms> <length>: <hex bytes>\n", returns the length without the terminating 0
+    // buffer: MAX_LINE_LENGTH is always enough
+    static size_t Format(const Frame& frame, const uint8_t* data, char* buffer, size_t size)
+    {
+        static const char hex[] = "0123456789ABCDEF";
+        int length = snprintf(buffer, size, "%u %u %u:", static_cast<unsigned>(frame.sequence),
+                              static_cast<unsigned>(frame.timeMs), static_cast<unsigned>(frame.length));
+        if (length < 0 || static_cast<size_t>(length) >= size)
+        {
+            return 0;
+        }
+        size_t position = static_cast<size_t>(length);
+        for (size_t i = 0; i < frame.length && position + 4 < size; i++)
+        {
+            buffer[position++] = ' ';
+            buffer[position++] = hex[data[i] >> 4];
+            buffer[position++] = hex[data[i] & 0x0F];
+        }
+        buffer[position++] = '\n';
+        buffer[position] = 0;
+        return position;
+    }
+
+private:
+    static constexpr size_t RECORD_HEADER_SIZE = 10;
+
+    std::vector<uint8_t> m_buffer; // not reallocated
+    size_t m_head{0}; // position of the oldest record
+    size_t m_used{0};
+    uint32_t m_firstSequence{0};
+    uint32_t m_nextSequence{0};
+
+    size_t Wrap(size_t position) const
+    {
+        return position % m_buffer.size();
+    }
+
+    void Write(size_t position, const uint8_t* data, size_t length)
+    {
+        const size_t first = std::min(length, m_buffer.size() - position);
+        std::memcpy(&m_buffer[position], data, first);
+        std::memcpy(&m_buffer[0], data + first, length - first);
+    }
+
+    void Read(size_t position, uint8_t* data, size_t length) const
+    {
+        const size_t first = std::min(length, m_buffer.size() - position);
+        std::memcpy(data, &m_buffer[position], first);
+        std::memcpy(data + first, &m_buffer[0], length - first);
+    }
+
+    // Returns the position of the next record
+    size_t ReadRecord(size_t position, Frame& frame, uint8_t* data) const
+    {
+        uint8_t header[RECORD_HEADER_SIZE];
+        Read(position, header, RECORD_HEADER_SIZE);
+        std::memcpy(&frame.sequence, &header[0], sizeof(frame.sequence));
+        std::memcpy(&frame.timeMs, &header[4], sizeof(frame.timeMs));
+        std::memcpy(&frame.length, &header[8], sizeof(frame.length));
+        if (data != nullptr)
+        {
+            Read(Wrap(position + RECORD_HEADER_SIZE), data, frame.length);
+        }
+        return Wrap(position + RECORD_HEADER_SIZE + frame.length);
+    }
+
+    void DropOldest()
+    {
+        Frame frame;
+        const size_t next = ReadRecord(m_head, frame, nullptr);
+        m_used -= RECORD_HEADER_SIZE + frame.length;
+        m_head = m_used == 0 ? 0 : next;
+        m_firstSequence++;
+    }
+};
+
+} // namespace sm
+} // namespace esphome
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "esphome.h"
+#include "frame_dump.h"
+
+#include <memory>
+#include <mutex>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Serves the FrameDump as text file on "http://<device>/frames.txt", oldest frame first, one line per frame
+// The frames are formatted while the response is sent, adding a frame only copies its bytes.
+// Note: the frames are added by the processing task, the web server runs in an other task, the dump is protected by
+// a mutex
+class FrameDumpWebHandler : public AsyncWebHandler
+{
+public:
+    static constexpr const char* URL = "/frames.txt";
+
+    // Called once at setup, capacity 0: no frame dump. Returns the bytes allocated.
+    size_t Allocate(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_dump && capacity > 0)
+        {
+            m_dump.reset(new FrameDump(capacity));
+        }
+        const size_t bytes = m_dump ? m_dump->GetCapacity() : 0;
+        ESP_LOGI("sm", "Frame dump: %u bytes", static_cast<unsigned>(bytes));
+        return bytes;
+    }
+
+    void Register()
+    {
+        web_server_base::global_web_server_base->add_handler(this);
+    }
+
+    void Add(uint32_t timeMs, const uint8_t* data, size_t length)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_dump)
+        {
+            m_dump->Add(timeMs, data, length);
+        }
+    }
+
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        return request->method() == HTTP_GET && request->url() == URL;
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        std::shared_ptr<Download> download;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_dump)
+            {
+                request->send(404, "text/plain", "No frame dump, not enough RAM");
+                return;
+            }
+            download = std::make_shared<Download>(*m_dump);
+        }
+        auto response = request->beginChunkedResponse(
+            "text/plain", [this, download](uint8_t* buffer, size_t maxLength, size_t index) -> size_t {
+                return FillChunk(*download, reinterpret_cast<char*>(buffer), maxLength);
+            });
+        request->send(response);
+    }
+
+private:
+    // A line may be longer than a chunk, the rest is sent with the next one
+    struct Download
+    {
+        explicit Download(const FrameDump& dump)
+            : reader(dump)
+        { }
+
+        FrameDump::Reader reader;
+        uint8_t data[FrameDump::MAX_FRAME_LENGTH];
+        char line[FrameDump::MAX_LINE_LENGTH];
+        size_t lineLength{0};
+        size_t lineOffset{0};
+    };
+
+    std::unique_ptr<FrameDump> m_dump; // sized from the free heap, see Allocate()
+    std::mutex m_mutex;
+
+    size_t FillChunk(Download& download, char* buffer, size_t maxLength)
+    {
+        size_t length = 0;
+        // returns 0 at the end, this finishes the response
+        while (length < maxLength)
+        {
+            if (download.lineOffset == download.lineLength)
+            {
+                FrameDump::Frame frame;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (!download.reader.Next(frame, download.data))
+                    {
+                        break;
+                    }
+                }
+                download.lineLength = FrameDump::Format(frame, download.data, download.line, sizeof(download.line));
+                download.lineOffset = 0;
+            }
+            const size_t count = std::min(maxLength - length, download.lineLength - download.lineOffset);
+            std::memcpy(&buffer[length], &download.line[download.lineOffset], count);
+            length += count;
+            download.lineOffset += count;
+        }
+        return length;
+    }
+};
+
+} // namespace sm
+} // namespace esphome
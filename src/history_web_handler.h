@@ -0,0 +1,89 @@
+#pragma once
+
+#include "esphome.h"
+#include "meter_history.h"
+
+#include <memory>
+#include <mutex>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Serves the MeterHistory as csv file on "http://<device>/history.csv", oldest sample first
+// The response is sent in chunks while the samples are decoded, so no copy of the history is needed.
+// Note: the web server runs in an other task, the history is protected by a mutex
+class HistoryWebHandler : public AsyncWebHandler
+{
+public:
+    static constexpr const char* URL = "/history.csv";
+
+    // Called once at setup, blockCount 0: no history. Returns the number of blocks allocated.
+    size_t Allocate(size_t blockCount)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_history && blockCount > 0)
+        {
+            m_history.reset(new MeterHistory(blockCount));
+        }
+        const size_t bytes = m_history ? m_history->GetCapacityBytes() : 0;
+        ESP_LOGI("sm", "History: %u bytes ( %u blocks )", static_cast<unsigned>(bytes),
+                 static_cast<unsigned>(bytes / MeterHistory::BLOCK_SIZE));
+        return bytes / MeterHistory::BLOCK_SIZE;
+    }
+
+    void Register()
+    {
+        web_server_base::global_web_server_base->add_handler(this);
+    }
+
+    void Append(const HistorySample& sample)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_history)
+        {
+            m_history->Append(sample);
+        }
+    }
+
+    size_t GetSampleCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_history ? m_history->GetSampleCount() : 0;
+    }
+
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        return request->method() == HTTP_GET && request->url() == URL;
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        std::shared_ptr<HistoryCsvReader> reader;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_history)
+            {
+                request->send(404, "text/plain", "No history, not enough RAM");
+                return;
+            }
+            reader = std::make_shared<HistoryCsvReader>(*m_history);
+        }
+        // The chunk size is the free window of the connection, it may be smaller than a line
+        auto response = request->beginChunkedResponse(
+            "text/csv", [this, reader](uint8_t* buffer, size_t maxLength, size_t) -> size_t {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                // returns 0 at the end, this finishes the response
+                return reader->Read(reinterpret_cast<char*>(buffer), maxLength);
+            });
+        request->send(response);
+    }
+
+private:
+    std::unique_ptr<MeterHistory> m_history; // sized from the free heap, see Allocate()
+    std::mutex m_mutex;
+};
+
+} // namespace sm
+} // namespace esphome
@@ -0,0 +1,348 @@
+#pragma once
+
+#include "flash_log.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+enum class LoadProfileTier : uint8_t
+{
+    Minute,
+    QuarterHour,
+    Day,
+    Count
+};
+
+// Aggregate of the meter frames of one period, see LoadProfileAggregator
+struct LoadProfileRecord
+{
+    uint32_t time{0}; // unix time in s of the period start ( UTC )
+    uint16_t sampleCount{0};
+    uint16_t reserved{0};
+    int32_t minPower{0}; // W, active power plus - minus
+    int32_t avgPower{0};
+    int32_t maxPower{0};
+    uint32_t energyPlus{0}; // Wh imported during the period
+    uint32_t energyMinus{0}; // Wh exported during the period
+};
+
+constexpr uint32_t GetLoadProfilePeriod(LoadProfileTier tier)
+{
+    return tier == LoadProfileTier::Minute ? 60 : tier == LoadProfileTier::QuarterHour ? 15 * 60 : 24 * 60 * 60;
+}
+
+// Streaming aggregation of the meter frames into 1 min, 15 min and 1 day records
+// A record is emitted with the first frame of the next period, the energy of a period is the difference of the
+// meter readings of the first frame in the period and the first frame of the next one. So the energy of
+// consecutive records sums up exactly to the meter reading, frames in a gap are counted for the period before.
+// Note: periods are aligned to UTC, tariff periods in local time can be summed up from 15 min records.
+class LoadProfileAggregator
+{
+public:
+    using OnRecord = std::function<void(LoadProfileTier tier, const LoadProfileRecord& record)>;
+    static constexpr size_t TIER_COUNT = static_cast<size_t>(LoadProfileTier::Count);
+
+    explicit LoadProfileAggregator(OnRecord onRecord)
+        : m_onRecord(onRecord)
+    { }
+
+    // power in W, energy in Wh ( meter readings ), time: unix time in s
+    void Add(uint32_t time, int32_t powerW, uint32_t energyPlusWh, uint32_t energyMinusWh)
+    {
+        for (size_t i = 0; i < TIER_COUNT; i++)
+        {
+            Period& period = m_periods[i];
+            const uint32_t start = time - time % GetLoadProfilePeriod(static_cast<LoadProfileTier>(i));
+            if (period.sampleCount > 0 && start != period.start)
+            {
+                if (start > period.start)
+                {
+                    Emit(static_cast<LoadProfileTier>(i), period, energyPlusWh, energyMinusWh);
+                }
+                period.sampleCount = 0; // a time step backwards drops the period
+            }
+            if (period.sampleCount == 0)
+            {
+                period.start = start;
+                period.powerSum = 0;
+                period.minPower = powerW;
+                period.maxPower = powerW;
+                period.energyPlus = energyPlusWh;
+                period.energyMinus = energyMinusWh;
+            }
+            period.sampleCount++;
+            period.powerSum += powerW;
+            period.minPower = std::min(period.minPower, powerW);
+            period.maxPower = std::max(period.maxPower, powerW);
+        }
+    }
+
+    void Reset()
+    {
+        for (auto& period : m_periods)
+        {
+            period.sampleCount = 0;
+        }
+    }
+
+private:
+    struct Period
+    {
+        uint32_t start{0};
+        uint32_t sampleCount{0};
+        int64_t powerSum{0};
+        int32_t minPower{0};
+        int32_t maxPower{0};
+        uint32_t energyPlus{0}; // meter reading of the first frame
+        uint32_t energyMinus{0};
+    };
+
+    OnRecord m_onRecord;
+    Period m_periods[TIER_COUNT];
+
+    void Emit(LoadProfileTier tier, const Period& period, uint32_t energyPlus, uint32_t energyMinus)
+    {
+        LoadProfileRecord record;
+        record.time = period.start;
+        record.sampleCount = static_cast<uint16_t>(std::min<uint32_t>(period.sampleCount, UINT16_MAX));
+        record.minPower = period.minPower;
+        record.avgPower = static_cast<int32_t>(period.powerSum / static_cast<int64_t>(period.sampleCount));
+        record.maxPower = period.maxPower;
+        // A meter reading going backwards ( meter exchanged ) gives no energy
+        record.energyPlus = energyPlus >= period.energyPlus ? energyPlus - period.energyPlus : 0;
+        record.energyMinus = energyMinus >= period.energyMinus ? energyMinus - period.energyMinus : 0;
+        m_onRecord(tier, record);
+    }
+};
+
+// Persistent load profile: one FlashLog per tier in a shared flash region
+// The region is split 50% / 30% / 20% for minute / quarter hour / day records, with the 700KB "loadprofile"
+// partition: ~7 days of minute, ~2 months of quarter hour and ~12 years of day records.
+// Each minute the minute log writes one slot, so one sector is erased every ~2 hours ( ~50 erases per sector and year ).
+// The sectors are erased ahead with EraseAhead(), outside of the frame processing.
+class LoadProfile
+{
+public:
+    using Log = FlashLog<LoadProfileRecord>;
+    static constexpr size_t TIER_COUNT = LoadProfileAggregator::TIER_COUNT;
+
+    explicit LoadProfile(FlashDevice& device)
+        : m_aggregator([this](LoadProfileTier tier, const LoadProfileRecord& record) { Append(tier, record); })
+        , m_logs{Log(device, 0, GetSectorCount(device, 0)),
+                 Log(device, GetSectorCount(device, 0), GetSectorCount(device, 1)),
+                 Log(device, GetSectorCount(device, 0) + GetSectorCount(device, 1), GetSectorCount(device, 2))}
+    { }
+
+    bool Mount()
+    {
+        bool success = true;
+        for (auto& log : m_logs)
+        {
+            success = log.Mount() && success;
+        }
+        return success;
+    }
+
+    void Add(uint32_t time, int32_t power, uint32_t energyPlus, uint32_t energyMinus)
+    {
+        m_aggregator.Add(time, power, energyPlus, energyMinus);
+    }
+
+    // Erases at most one sector, see FlashLog::EraseAhead(). Returns true if a sector was erased.
+    bool EraseAhead()
+    {
+        for (auto& log : m_logs)
+        {
+            if (log.EraseAhead())
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Log& GetLog(LoadProfileTier tier)
+    {
+        return m_logs[static_cast<size_t>(tier)];
+    }
+
+    // Calls onRecord for the records with from <= time < to, stops after maxRecords ( bounded time )
+    // Returns the number of records
+    size_t Query(LoadProfileTier tier, uint32_t from, uint32_t to, size_t maxRecords,
+                 const std::function<void(const LoadProfileRecord& record)>& onRecord)
+    {
+        Log& log = GetLog(tier);
+        auto cursor = log.Seek(from);
+        LoadProfileRecord record;
+        size_t count = 0;
+        while (count < maxRecords && log.Next(cursor, record) && record.time < to)
+        {
+            onRecord(record);
+            count++;
+        }
+        return count;
+    }
+
+private:
+    LoadProfileAggregator m_aggregator;
+    Log m_logs[TIER_COUNT];
+
+    static size_t GetSectorCount(const FlashDevice& device, size_t tier)
+    {
+        const size_t count = device.GetSectorCount();
+        if (tier + 1 == TIER_COUNT)
+        {
+            return count - GetSectorCount(device, 0) - GetSectorCount(device, 1);
+        }
+        return count * (tier == 0 ? 50 : 30) / 100;
+    }
+
+    void Append(LoadProfileTier tier, const LoadProfileRecord& record)
+    {
+        GetLog(tier).Append(record);
+    }
+};
+
+// Records of one tier as csv text in chunks of any size, from a cursor up to a time
+// A line ( or the header ) that does not fit into a chunk is continued in the next one.
+class LoadProfileCsvReader
+{
+public:
+    static constexpr size_t MAX_LINE_LENGTH = 96;
+    static constexpr const char* HEADER = "time,samples,min_power,avg_power,max_power,energy_plus,energy_minus\n";
+
+    LoadProfileCsvReader(LoadProfileTier tier, LoadProfile::Log::Cursor cursor, uint32_t to)
+        : m_tier(tier)
+        , m_cursor(cursor)
+        , m_to(to)
+        , m_pending(HEADER)
+        , m_pendingLength(strlen(HEADER))
+    { }
+
+    // Returns the length written to buffer, 0 at the end. loadProfile: nullptr gives the header only
+    size_t Read(LoadProfile* loadProfile, char* buffer, size_t maxLength)
+    {
+        size_t length = 0;
+        while (length < maxLength)
+        {
+            if (m_pendingLength == 0)
+            {
+                LoadProfileRecord record;
+                if (loadProfile == nullptr || !loadProfile->GetLog(m_tier).Next(m_cursor, record)
+                    || record.time >= m_to)
+                {
+                    m_to = 0; // end, also for the next chunk
+                    break;
+                }
+                m_pending = m_line;
+                m_pendingLength = FormatLine(record, m_line);
+            }
+            const size_t count = std::min(maxLength - length, m_pendingLength);
+            memcpy(&buffer[length], m_pending, count);
+            m_pending += count;
+            m_pendingLength -= count;
+            length += count;
+        }
+        return length;
+    }
+
+private:
+    const LoadProfileTier m_tier;
+    LoadProfile::Log::Cursor m_cursor;
+    uint32_t m_to;
+    char m_line[MAX_LINE_LENGTH];
+    const char* m_pending;
+    size_t m_pendingLength;
+
+    static size_t FormatLine(const LoadProfileRecord& record, char* line)
+    {
+        const int length = snprintf(line, MAX_LINE_LENGTH, "%u,%u,%d,%d,%d,%u,%u\n",
+                                    static_cast<unsigned int>(record.time), record.sampleCount,
+                                    static_cast<int>(record.minPower), static_cast<int>(record.avgPower),
+                                    static_cast<int>(record.maxPower), static_cast<unsigned int>(record.energyPlus),
+                                    static_cast<unsigned int>(record.energyMinus));
+        return length < 0 ? 0 : std::min(static_cast<size_t>(length), MAX_LINE_LENGTH - 1);
+    }
+};
+
+// The LoadProfile shared by the loop ( Add(), EraseAhead() ) and the web server task ( csv readers )
+// All calls are protected by a mutex. Without a mounted load profile they do nothing, a csv has the header only.
+class SharedLoadProfile
+{
+public:
+    // Returns false if the mount failed, the load profile stays disabled then
+    bool Mount(FlashDevice& device)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_loadProfile.reset(new LoadProfile(device));
+        if (!m_loadProfile->Mount())
+        {
+            m_loadProfile.reset();
+            return false;
+        }
+        return true;
+    }
+
+    // power in W, energy in Wh ( meter readings ), time: unix time in s, see LoadProfileAggregator::Add()
+    void Add(uint32_t time, int32_t power, uint32_t energyPlus, uint32_t energyMinus)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_loadProfile)
+        {
+            m_loadProfile->Add(time, power, energyPlus, energyMinus);
+        }
+    }
+
+    // Erases at most one sector ahead ( ~50ms ), returns true if a sector was erased, see LoadProfile::EraseAhead()
+    bool EraseAhead()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_loadProfile && m_loadProfile->EraseAhead();
+    }
+
+    // Number of records of a tier, 0 if not mounted
+    size_t GetSize(LoadProfileTier tier)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_loadProfile ? m_loadProfile->GetLog(tier).GetSize() : 0;
+    }
+
+    // A reader of the records with from <= time < to, read it with ReadCsv()
+    std::shared_ptr<LoadProfileCsvReader> CreateCsvReader(LoadProfileTier tier, uint32_t from, uint32_t to)
+    {
+        LoadProfile::Log::Cursor cursor;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_loadProfile)
+            {
+                cursor = m_loadProfile->GetLog(tier).Seek(from);
+            }
+        }
+        return std::make_shared<LoadProfileCsvReader>(tier, cursor, to);
+    }
+
+    // Returns the length written to buffer, 0 at the end, see LoadProfileCsvReader::Read()
+    size_t ReadCsv(LoadProfileCsvReader& reader, char* buffer, size_t maxLength)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return reader.Read(m_loadProfile.get(), buffer, maxLength);
+    }
+
+private:
+    std::unique_ptr<LoadProfile> m_loadProfile; // created in Mount(), the size of the flash device is needed
+    std::mutex m_mutex;
+};
+
+} // namespace sm
+} // namespace esphome
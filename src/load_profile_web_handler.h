@@ -0,0 +1,92 @@
+#pragma once
+
+#include "esphome.h"
+#include "flash_partition.h"
+#include "load_profile.h"
+
+#include <stdint.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Owns the LoadProfile on the "loadprofile" flash partition and serves it as csv file:
+//   "http://<device>/load_profile.csv?tier=quarter&from=<unix time>&to=<unix time>"
+//   tier: minute, quarter ( default ) or day. from/to default to the whole log.
+// Note: the web server runs in an other task, see SharedLoadProfile
+class LoadProfileWebHandler : public AsyncWebHandler
+{
+public:
+    static constexpr const char* URL = "/load_profile.csv";
+    static constexpr const char* PARTITION_LABEL = "loadprofile";
+
+    // Returns false if the partition is missing ( old partition table, needs a serial flash )
+    bool Setup()
+    {
+        if (!m_partition.Open(PARTITION_LABEL))
+        {
+            ESP_LOGW("sm", "No flash partition '%s', load profile disabled", PARTITION_LABEL);
+            return false;
+        }
+        if (!m_loadProfile.Mount(m_partition))
+        {
+            ESP_LOGW("sm", "Load profile mount failed");
+            return false;
+        }
+        web_server_base::global_web_server_base->add_handler(this);
+        ESP_LOGI("sm", "Load profile mounted, %u minute, %u quarter hour, %u day records",
+                 static_cast<unsigned>(m_loadProfile.GetSize(LoadProfileTier::Minute)),
+                 static_cast<unsigned>(m_loadProfile.GetSize(LoadProfileTier::QuarterHour)),
+                 static_cast<unsigned>(m_loadProfile.GetSize(LoadProfileTier::Day)));
+        return true;
+    }
+
+    // power in W, energy in Wh ( meter readings ), the exact integers of the meter, see SharedLoadProfile::Add()
+    void Add(uint32_t time, int32_t power, uint32_t energyPlus, uint32_t energyMinus)
+    {
+        m_loadProfile.Add(time, power, energyPlus, energyMinus);
+    }
+
+    // Erases at most one sector ahead ( ~50ms ), returns true if a sector was erased, see LoadProfile::EraseAhead()
+    bool EraseAhead()
+    {
+        return m_loadProfile.EraseAhead();
+    }
+
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        return request->method() == HTTP_GET && request->url() == URL;
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        LoadProfileTier tier = LoadProfileTier::QuarterHour;
+        if (request->hasParam("tier"))
+        {
+            const String value = request->getParam("tier")->value();
+            tier = value == "minute" ? LoadProfileTier::Minute
+                   : value == "day"  ? LoadProfileTier::Day
+                                     : LoadProfileTier::QuarterHour;
+        }
+        const uint32_t to
+            = request->hasParam("to") ? static_cast<uint32_t>(request->getParam("to")->value().toInt()) : UINT32_MAX;
+        const uint32_t from
+            = request->hasParam("from") ? static_cast<uint32_t>(request->getParam("from")->value().toInt()) : 0;
+        auto reader = m_loadProfile.CreateCsvReader(tier, from, to);
+        // The chunk size is the free window of the connection, it may be smaller than a line
+        auto response = request->beginChunkedResponse(
+            "text/csv", [this, reader](uint8_t* buffer, size_t maxLength, size_t) -> size_t {
+                // returns 0 at the end, this finishes the response
+                return m_loadProfile.ReadCsv(*reader, reinterpret_cast<char*>(buffer), maxLength);
+            });
+        request->send(response);
+    }
+
+private:
+    FlashPartition m_partition;
+    SharedLoadProfile m_loadProfile;
+};
+
+} // namespace sm
+} // namespace esphome
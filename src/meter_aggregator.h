@@ -0,0 +1,214 @@
+#pragma once
+
+#include "./esphome-dlms-meter/espdm_meter_data.h"
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Merges the frames of several meters ( e.g. house and heat pump, each on an own M-Bus ) into one MeterData
+// Updated incrementally: a frame replaces only the contribution of its meter in running sums, so the cost per
+// frame does not depend on the number of meters.
+// - phases: a meter phase is assigned to a phase of the aggregate ( e.g. rotated wiring of the heat pump )
+// - voltage: average of the meters per phase, current, power and energy: sum ( plus and minus separately, so the
+//   energy counters stay monotonic )
+// - a meter without frame for the max. age only keeps its energy counters, its voltage, current and power are
+//   removed
+// - timestamp: clock of the first meter ( reference ), advanced by the time since its last frame. So all frames of
+//   the aggregate use one clock, even if the meter clocks differ.
+// With one meter the aggregate is equal to its data.
+class MeterAggregator
+{
+public:
+    static constexpr size_t MAX_METERS = 3;
+    static constexpr uint32_t DEFAULT_MAX_AGE_MS = 30 * 1000; // Kaifa sends every ~5s
+    // Phase of the aggregate ( 0: L1 ... 2: L3 ) for L1, L2, L3 of the meter
+    using PhaseMap = std::array<uint8_t, 3>;
+
+    // Returns the index of the meter, -1 if MAX_METERS are added or the phases are invalid
+    int AddMeter(const PhaseMap& phases = PhaseMap{{0, 1, 2}})
+    {
+        for (const auto phase : phases)
+        {
+            if (phase > 2)
+            {
+                return -1;
+            }
+        }
+        if (m_meterCount >= MAX_METERS)
+        {
+            return -1;
+        }
+        m_meters[m_meterCount].phases = phases;
+        return static_cast<int>(m_meterCount++);
+    }
+
+    size_t GetMeterCount() const
+    {
+        return m_meterCount;
+    }
+
+    void SetMaxAge(uint32_t maxAgeMs)
+    {
+        m_maxAgeMs = maxAgeMs;
+    }
+
+    // Meters whose voltage, current and power are part of the aggregate
+    size_t GetLiveCount() const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < m_meterCount; i++)
+        {
+            count += m_meters[i].live ? 1 : 0;
+        }
+        return count;
+    }
+
+    // Replaces the values of the meter with the frame, returns the aggregate ( derived values updated )
+    const espdm::MeterData& Update(size_t meter, const espdm::MeterData& data, uint32_t nowMs)
+    {
+        if (meter >= m_meterCount)
+        {
+            return m_aggregate;
+        }
+        ExpireMeters(nowMs);
+        Meter& entry = m_meters[meter];
+        if (entry.hasData)
+        {
+            AddCounters(entry, -1);
+            if (entry.live)
+            {
+                AddInstant(entry, -1);
+            }
+        }
+        entry.data = data;
+        entry.receivedMs = nowMs;
+        entry.hasData = true;
+        entry.live = true;
+        AddCounters(entry, 1);
+        AddInstant(entry, 1);
+        if ((meter == 0 || !m_meters[0].hasData) && data.timestamp.IsValid())
+        {
+            m_referenceSeconds = data.timestamp.ToSeconds();
+            m_referenceMs = nowMs;
+        }
+        UpdateAggregate(nowMs);
+        return m_aggregate;
+    }
+
+    const espdm::MeterData& Get() const
+    {
+        return m_aggregate;
+    }
+
+private:
+    struct Meter
+    {
+        PhaseMap phases{{0, 1, 2}};
+        espdm::MeterData data; // last frame
+        uint32_t receivedMs{0};
+        bool hasData{false};
+        bool live{false}; // voltage, current and power are part of the sums
+    };
+
+    // Note: integer, so adding and removing the contributions is exact
+    struct Sums
+    {
+        int64_t voltage[3]{}; // 0.1V
+        int32_t voltageCount[3]{}; // meters with a voltage on the phase
+        int64_t current[3]{}; // 0.01A
+        int64_t activePowerPlus{0};
+        int64_t activePowerMinus{0};
+        int64_t activeEnergyPlus{0};
+        int64_t activeEnergyMinus{0};
+        int64_t reactiveEnergyPlus{0};
+        int64_t reactiveEnergyMinus{0};
+    };
+
+    Meter m_meters[MAX_METERS];
+    size_t m_meterCount{0};
+    uint32_t m_maxAgeMs{DEFAULT_MAX_AGE_MS};
+    Sums m_sums;
+    int64_t m_referenceSeconds{0};
+    uint32_t m_referenceMs{0};
+    espdm::MeterData m_aggregate;
+
+    void ExpireMeters(uint32_t nowMs)
+    {
+        for (size_t i = 0; i < m_meterCount; i++)
+        {
+            Meter& entry = m_meters[i];
+            if (entry.live && nowMs - entry.receivedMs > m_maxAgeMs)
+            {
+                AddInstant(entry, -1);
+                entry.live = false;
+            }
+        }
+    }
+
+    // sign: 1 adds, -1 removes the contribution
+    void AddInstant(const Meter& entry, int32_t sign)
+    {
+        const espdm::MeterData& data = entry.data;
+        const int32_t voltage[] = {data.voltageL1, data.voltageL2, data.voltageL3};
+        const int32_t current[] = {data.currentL1, data.currentL2, data.currentL3};
+        for (size_t i = 0; i < 3; i++)
+        {
+            const uint8_t phase = entry.phases[i];
+            if (voltage[i] != 0)
+            {
+                m_sums.voltage[phase] += sign * voltage[i];
+                m_sums.voltageCount[phase] += sign;
+            }
+            m_sums.current[phase] += sign * current[i];
+        }
+        m_sums.activePowerPlus += sign * static_cast<int64_t>(data.activePowerPlus);
+        m_sums.activePowerMinus += sign * static_cast<int64_t>(data.activePowerMinus);
+    }
+
+    void AddCounters(const Meter& entry, int32_t sign)
+    {
+        const espdm::MeterData& data = entry.data;
+        m_sums.activeEnergyPlus += sign * static_cast<int64_t>(data.activeEnergyPlus);
+        m_sums.activeEnergyMinus += sign * static_cast<int64_t>(data.activeEnergyMinus);
+        m_sums.reactiveEnergyPlus += sign * static_cast<int64_t>(data.reactiveEnergyPlus);
+        m_sums.reactiveEnergyMinus += sign * static_cast<int64_t>(data.reactiveEnergyMinus);
+    }
+
+    // The sum of the meters, saturated to the range of MeterData
+    static uint32_t ToUint32(int64_t sum)
+    {
+        return sum < 0 ? 0 : (sum > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(sum));
+    }
+
+    void UpdateAggregate(uint32_t nowMs)
+    {
+        espdm::MeterData& data = m_aggregate;
+        uint16_t* voltage[] = {&data.voltageL1, &data.voltageL2, &data.voltageL3};
+        int32_t* current[] = {&data.currentL1, &data.currentL2, &data.currentL3};
+        for (size_t i = 0; i < 3; i++)
+        {
+            const int64_t count = m_sums.voltageCount[i];
+            *voltage[i] = count > 0 ? static_cast<uint16_t>((m_sums.voltage[i] + count / 2) / count) : 0;
+            *current[i] = static_cast<int32_t>(m_sums.current[i]);
+        }
+        data.activePowerPlus = ToUint32(m_sums.activePowerPlus);
+        data.activePowerMinus = ToUint32(m_sums.activePowerMinus);
+        data.activeEnergyPlus = ToUint32(m_sums.activeEnergyPlus);
+        data.activeEnergyMinus = ToUint32(m_sums.activeEnergyMinus);
+        data.reactiveEnergyPlus = ToUint32(m_sums.reactiveEnergyPlus);
+        data.reactiveEnergyMinus = ToUint32(m_sums.reactiveEnergyMinus);
+        data.timestamp = m_referenceSeconds != 0
+                             ? espdm::MeterTimestamp::FromSeconds(m_referenceSeconds + (nowMs - m_referenceMs) / 1000)
+                             : espdm::MeterTimestamp();
+        data.UpdateDerived();
+    }
+};
+
+} // namespace sm
+} // namespace esphome
@@ -0,0 +1,505 @@
+#pragma once
+
+#include "./esphome-dlms-meter/espdm_meter_data.h"
+
+#include <algorithm>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Fixed-point values of one meter frame, see MeterHistory
+struct HistorySample
+{
+    enum Channel
+    {
+        VoltageL1, // 0.1V
+        VoltageL2,
+        VoltageL3,
+        CurrentL1, // 0.01A, negative if power is provided to grid
+        CurrentL2,
+        CurrentL3,
+        ActivePowerPlus, // W
+        ActivePowerMinus,
+        ActiveEnergyPlus, // Wh
+        ActiveEnergyMinus,
+        ChannelCount
+    };
+
+    static HistorySample FromMeterData(const espdm::MeterData& data, uint32_t time)
+    {
+        HistorySample sample;
+        sample.time = time;
+        sample.values[VoltageL1] = data.voltageL1;
+        sample.values[VoltageL2] = data.voltageL2;
+        sample.values[VoltageL3] = data.voltageL3;
+        sample.values[CurrentL1] = data.currentL1;
+        sample.values[CurrentL2] = data.currentL2;
+        sample.values[CurrentL3] = data.currentL3;
+        sample.values[ActivePowerPlus] = static_cast<int32_t>(data.activePowerPlus);
+        sample.values[ActivePowerMinus] = static_cast<int32_t>(data.activePowerMinus);
+        sample.values[ActiveEnergyPlus] = static_cast<int32_t>(data.activeEnergyPlus);
+        sample.values[ActiveEnergyMinus] = static_cast<int32_t>(data.activeEnergyMinus);
+        return sample;
+    }
+
+    uint32_t time{0}; // unix time in s
+    int32_t values[ChannelCount]{};
+};
+
+// Ring buffer of HistorySample with fixed memory, ~5 bytes per sample for household data ( raw: 44 bytes )
+// Each field ( time and channels ) is stored as delta to the previous sample:
+//   zigzag of the delta, then Rice code ( unary quotient, k remainder bits ) with k adapted per field to the
+//   average of the last values. Unchanged fields cost 1 bit.
+//   The time is stored as delta of the time delta, so a steady frame interval costs 1 bit.
+// The buffer is split in blocks, each block starts with an uncompressed sample.
+// If the buffer is full, the oldest block is dropped.
+// Note: not thread safe, see Reader
+class MeterHistory
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 2048;
+
+private:
+    static constexpr size_t FIELD_COUNT = 1 + HistorySample::ChannelCount; // time and channels
+    static constexpr uint32_t ESCAPE_QUOTIENT = 16; // larger values are stored uncompressed
+    static constexpr uint32_t MAX_RICE_K = 24;
+
+    struct Block
+    {
+        uint16_t usedBits{0};
+        uint16_t sampleCount{0};
+        uint8_t data[BLOCK_SIZE];
+    };
+
+    // Last sample and adaption, encoder and decoder state
+    struct State
+    {
+        uint32_t time{0};
+        int32_t timeDelta{0};
+        int32_t values[HistorySample::ChannelCount]{};
+        uint32_t averages[FIELD_COUNT]{}; // ~16 * average of the last zigzag values per field
+        bool first{true};
+    };
+
+    class BitWriter
+    {
+    public:
+        BitWriter(uint8_t* data, size_t positionBits, size_t capacityBits)
+            : m_data(data)
+            , m_position(positionBits)
+            , m_capacity(capacityBits)
+        { }
+
+        void Write(uint32_t value, uint32_t bitCount)
+        {
+            while (bitCount > 0)
+            {
+                bitCount--;
+                WriteBit((value >> bitCount) & 1);
+            }
+        }
+
+        void WriteBit(uint32_t bit)
+        {
+            if (m_position >= m_capacity)
+            {
+                m_overflow = true;
+                return;
+            }
+            const uint8_t mask = 0x80 >> (m_position & 7);
+            uint8_t& byte = m_data[m_position >> 3];
+            byte = bit ? (byte | mask) : (byte & ~mask);
+            m_position++;
+        }
+
+        size_t GetPosition() const
+        {
+            return m_position;
+        }
+
+        bool IsOverflow() const
+        {
+            return m_overflow;
+        }
+
+    private:
+        uint8_t* m_data;
+        size_t m_position;
+        size_t m_capacity;
+        bool m_overflow{false};
+    };
+
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t* data, size_t positionBits)
+            : m_data(data)
+            , m_position(positionBits)
+        { }
+
+        uint32_t Read(uint32_t bitCount)
+        {
+            uint32_t value = 0;
+            while (bitCount > 0)
+            {
+                bitCount--;
+                value = (value << 1) | ReadBit();
+            }
+            return value;
+        }
+
+        uint32_t ReadBit()
+        {
+            const uint32_t bit = (m_data[m_position >> 3] >> (7 - (m_position & 7))) & 1;
+            m_position++;
+            return bit;
+        }
+
+        size_t GetPosition() const
+        {
+            return m_position;
+        }
+
+    private:
+        const uint8_t* m_data;
+        size_t m_position;
+    };
+
+public:
+    // Memory is allocated once, in blocks to cope with a fragmented heap
+    explicit MeterHistory(size_t blockCount)
+    {
+        m_blocks.reserve(blockCount);
+        for (size_t i = 0; i < blockCount; i++)
+        {
+            m_blocks.emplace_back(new Block());
+        }
+    }
+
+    void Append(const HistorySample& sample)
+    {
+        if (m_blocks.empty())
+        {
+            return;
+        }
+        if (m_blockCount == 0 || !Encode(sample, GetBlock(m_blockCount - 1), m_writeState))
+        {
+            // Note: a sample does always fit into an empty block
+            StartBlock();
+            Encode(sample, GetBlock(m_blockCount - 1), m_writeState);
+        }
+        GetBlock(m_blockCount - 1).sampleCount++;
+        m_sampleCount++;
+    }
+
+    void Clear()
+    {
+        m_firstBlock = 0;
+        m_blockCount = 0;
+        m_sampleCount = 0;
+        m_droppedBlocks = 0;
+    }
+
+    size_t GetSampleCount() const
+    {
+        return m_sampleCount;
+    }
+
+    // Bytes used by the stored samples
+    size_t GetUsedBytes() const
+    {
+        size_t used = 0;
+        for (size_t i = 0; i < m_blockCount; i++)
+        {
+            used += (GetBlock(i).usedBits + 7) / 8;
+        }
+        return used;
+    }
+
+    size_t GetCapacityBytes() const
+    {
+        return m_blocks.size() * BLOCK_SIZE;
+    }
+
+    // Streaming decoder from the oldest to the newest sample
+    // Blocks dropped while reading are skipped. Appending while reading must be synchronized by the caller.
+    class Reader
+    {
+    public:
+        explicit Reader(const MeterHistory& history)
+            : m_history(history)
+            , m_blockSequence(history.m_droppedBlocks)
+        { }
+
+        // Returns false if there is no more sample
+        bool Next(HistorySample& sample)
+        {
+            for (;;)
+            {
+                if (m_blockSequence < m_history.m_droppedBlocks)
+                {
+                    // block was dropped meanwhile, continue with the oldest one
+                    m_blockSequence = m_history.m_droppedBlocks;
+                    m_positionBits = 0;
+                }
+                const size_t index = static_cast<size_t>(m_blockSequence - m_history.m_droppedBlocks);
+                if (index >= m_history.m_blockCount)
+                {
+                    return false;
+                }
+                const Block& block = m_history.GetBlock(index);
+                if (m_positionBits == 0)
+                {
+                    m_state = State();
+                }
+                if (m_positionBits < block.usedBits)
+                {
+                    m_positionBits = Decode(block, m_positionBits, m_state, sample);
+                    return true;
+                }
+                if (index + 1 >= m_history.m_blockCount)
+                {
+                    return false; // wait at the end of the newest block
+                }
+                m_blockSequence++;
+                m_positionBits = 0;
+            }
+        }
+
+    private:
+        const MeterHistory& m_history;
+        uint64_t m_blockSequence; // absolute number of the block
+        size_t m_positionBits{0};
+        State m_state;
+    };
+
+private:
+    std::vector<std::unique_ptr<Block>> m_blocks;
+    size_t m_firstBlock{0};
+    size_t m_blockCount{0};
+    size_t m_sampleCount{0};
+    uint64_t m_droppedBlocks{0};
+    State m_writeState;
+
+    Block& GetBlock(size_t index)
+    {
+        return *m_blocks[(m_firstBlock + index) % m_blocks.size()];
+    }
+    const Block& GetBlock(size_t index) const
+    {
+        return *m_blocks[(m_firstBlock + index) % m_blocks.size()];
+    }
+
+    void StartBlock()
+    {
+        if (m_blockCount == m_blocks.size())
+        {
+            m_sampleCount -= GetBlock(0).sampleCount;
+            m_firstBlock = (m_firstBlock + 1) % m_blocks.size();
+            m_blockCount--;
+            m_droppedBlocks++;
+        }
+        Block& block = GetBlock(m_blockCount);
+        block.usedBits = 0;
+        block.sampleCount = 0;
+        m_blockCount++;
+        m_writeState = State();
+    }
+
+    // Returns false if the sample does not fit into the block, then block and state are unchanged
+    static bool Encode(const HistorySample& sample, Block& block, State& state)
+    {
+        uint32_t fields[FIELD_COUNT];
+        // difference to the expected time
+        fields[0] = sample.time - (state.time + static_cast<uint32_t>(state.timeDelta));
+        for (size_t i = 0; i < HistorySample::ChannelCount; i++)
+        {
+            fields[i + 1] = static_cast<uint32_t>(sample.values[i]) - static_cast<uint32_t>(state.values[i]);
+        }
+
+        State newState = state;
+        BitWriter writer(block.data, block.usedBits, BLOCK_SIZE * 8);
+        for (size_t i = 0; i < FIELD_COUNT; i++)
+        {
+            if (newState.first)
+            {
+                writer.Write(fields[i], 32);
+            }
+            else
+            {
+                WriteRice(writer, ZigZag(static_cast<int32_t>(fields[i])), newState.averages[i]);
+            }
+        }
+        if (writer.IsOverflow())
+        {
+            return false;
+        }
+        Update(newState, sample);
+        state = newState;
+        block.usedBits = static_cast<uint16_t>(writer.GetPosition());
+        return true;
+    }
+
+    // Returns the position after the sample
+    static size_t Decode(const Block& block, size_t positionBits, State& state, HistorySample& sample)
+    {
+        uint32_t fields[FIELD_COUNT];
+        BitReader reader(block.data, positionBits);
+        for (size_t i = 0; i < FIELD_COUNT; i++)
+        {
+            fields[i] = state.first ? reader.Read(32)
+                                    : static_cast<uint32_t>(UnZigZag(ReadRice(reader, state.averages[i])));
+        }
+        sample.time = state.time + static_cast<uint32_t>(state.timeDelta) + fields[0];
+        for (size_t i = 0; i < HistorySample::ChannelCount; i++)
+        {
+            sample.values[i] = static_cast<int32_t>(static_cast<uint32_t>(state.values[i]) + fields[i + 1]);
+        }
+        Update(state, sample);
+        return reader.GetPosition();
+    }
+
+    static void Update(State& state, const HistorySample& sample)
+    {
+        state.timeDelta = state.first ? 0 : static_cast<int32_t>(sample.time - state.time);
+        state.time = sample.time;
+        std::copy(sample.values, sample.values + HistorySample::ChannelCount, state.values);
+        state.first = false;
+    }
+
+    static uint32_t GetRiceK(uint32_t average)
+    {
+        uint32_t k = 0;
+        while (k < MAX_RICE_K && (16UL << k) < average)
+        {
+            k++;
+        }
+        return k;
+    }
+
+    static void UpdateAverage(uint32_t& average, uint32_t value)
+    {
+        average += std::min<uint32_t>(value, 1UL << MAX_RICE_K) - (average >> 4);
+    }
+
+    static void WriteRice(BitWriter& writer, uint32_t value, uint32_t& average)
+    {
+        const uint32_t k = GetRiceK(average);
+        const uint32_t quotient = value >> k;
+        if (quotient < ESCAPE_QUOTIENT)
+        {
+            for (uint32_t i = 0; i < quotient; i++)
+            {
+                writer.WriteBit(1);
+            }
+            writer.WriteBit(0);
+            writer.Write(value, k); // remainder, Write takes the low k bits
+        }
+        else
+        {
+            for (uint32_t i = 0; i < ESCAPE_QUOTIENT; i++)
+            {
+                writer.WriteBit(1);
+            }
+            writer.Write(value, 32);
+        }
+        UpdateAverage(average, value);
+    }
+
+    static uint32_t ReadRice(BitReader& reader, uint32_t& average)
+    {
+        const uint32_t k = GetRiceK(average);
+        uint32_t quotient = 0;
+        while (quotient < ESCAPE_QUOTIENT && reader.ReadBit() == 1)
+        {
+            quotient++;
+        }
+        const uint32_t value = quotient < ESCAPE_QUOTIENT ? (quotient << k) | reader.Read(k) : reader.Read(32);
+        UpdateAverage(average, value);
+        return value;
+    }
+
+    static uint32_t ZigZag(int32_t value)
+    {
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    static int32_t UnZigZag(uint32_t value)
+    {
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+};
+
+// The history as csv text in chunks of any size, oldest sample first
+// A line ( or the header ) that does not fit into a chunk is continued in the next one.
+// Note: appending while reading must be synchronized by the caller, see MeterHistory::Reader
+class HistoryCsvReader
+{
+public:
+    static constexpr size_t MAX_LINE_LENGTH = 128;
+    static constexpr const char* HEADER = "time,voltage_l1,voltage_l2,voltage_l3,current_l1,current_l2,current_l3,"
+                                          "active_power_plus,active_power_minus,active_energy_plus,"
+                                          "active_energy_minus\n";
+
+    explicit HistoryCsvReader(const MeterHistory& history)
+        : m_reader(history)
+        , m_pending(HEADER)
+        , m_pendingLength(strlen(HEADER))
+    { }
+
+    // Returns the length written to buffer, 0 at the end
+    size_t Read(char* buffer, size_t maxLength)
+    {
+        size_t length = 0;
+        while (length < maxLength)
+        {
+            if (m_pendingLength == 0)
+            {
+                HistorySample sample;
+                if (!m_reader.Next(sample))
+                {
+                    break;
+                }
+                m_pending = m_line;
+                m_pendingLength = FormatLine(sample, m_line);
+            }
+            const size_t count = std::min(maxLength - length, m_pendingLength);
+            memcpy(&buffer[length], m_pending, count);
+            m_pending += count;
+            m_pendingLength -= count;
+            length += count;
+        }
+        return length;
+    }
+
+private:
+    MeterHistory::Reader m_reader;
+    char m_line[MAX_LINE_LENGTH];
+    const char* m_pending;
+    size_t m_pendingLength;
+
+    static size_t FormatLine(const HistorySample& sample, char* line)
+    {
+        const int32_t* values = sample.values;
+        const int length = snprintf(line, MAX_LINE_LENGTH, "%u,%.1f,%.1f,%.1f,%.2f,%.2f,%.2f,%d,%d,%d,%d\n",
+                                    static_cast<unsigned int>(sample.time), values[HistorySample::VoltageL1] / 10.0f,
+                                    values[HistorySample::VoltageL2] / 10.0f, values[HistorySample::VoltageL3] / 10.0f,
+                                    values[HistorySample::CurrentL1] / 100.0f, values[HistorySample::CurrentL2] / 100.0f,
+                                    values[HistorySample::CurrentL3] / 100.0f, values[HistorySample::ActivePowerPlus],
+                                    values[HistorySample::ActivePowerMinus], values[HistorySample::ActiveEnergyPlus],
+                                    values[HistorySample::ActiveEnergyMinus]);
+        // a truncated line is sent as far as written
+        return length < 0 ? 0 : std::min(static_cast<size_t>(length), MAX_LINE_LENGTH - 1);
+    }
+};
+
+} // namespace sm
+} // namespace esphome
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "modbus_server.h"
+#include "sunspec_meter_model.h"
+#include "./esphome-dlms-meter/espdm_meter_data.h"
+
+#include <limits>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Glue between the decoded meter data, the Sunspec MeterModel and the Modbus server
+// Shared by the SmartMeter component and the Linux gateway.
+
+// Note: the fixed-point values of MeterData are converted to float only here, the Sunspec float registers
+// ( model 211/213 ) are the only place where the energy counters lose resolution ( above ~16.7MWh ).
+
+using SetPhaseFloats = void (sunspec::MeterModel::*)(float total, float phaseA, float phaseB, float phaseC);
+
+// Sets the values divided by the fixed-point factor ( e.g. 10 for 0.1V )
+inline void SetPhaseValues(sunspec::MeterModel& model, SetPhaseFloats set, const espdm::MeterData::PhaseValues& values,
+                           float divisor = 1.0f)
+{
+    (model.*set)(values.total / divisor, values.phase1 / divisor, values.phase2 / divisor, values.phase3 / divisor);
+}
+
+// Sets the Sunspec meter values of one frame
+inline void SetMeterData(sunspec::MeterModel& model, const espdm::MeterData& data)
+{
+    using sunspec::MeterModel;
+    // Note: not all phase related values are available, provide some narrowed values
+    const auto& derived = data.derived;
+    SetPhaseValues(model, &MeterModel::SetVoltageToNeutral, derived.voltage, 10.0f);
+    SetPhaseValues(model, &MeterModel::SetAcCurrent, derived.current, 100.0f);
+    SetPhaseValues(model, &MeterModel::SetVoltagePhaseToPhase, derived.voltagePhaseToPhase, 10.0f);
+
+    model.SetFrequency(50.0f);
+
+    // No idea why Fronius inverter shows it as negative number
+    const float powerFactor = espdm::MeterData::ToPowerFactor(derived.powerFactor);
+    model.SetPowerFactor(powerFactor, powerFactor, powerFactor, powerFactor);
+
+    const float activeEnergyPerPhase = static_cast<float>(data.activeEnergyPlus / 3.0);
+    model.SetTotalWattHoursImported(static_cast<float>(data.activeEnergyPlus), activeEnergyPerPhase,
+                                    activeEnergyPerPhase, activeEnergyPerPhase);
+
+    const float reactiveEnergyPerPhase = static_cast<float>(data.reactiveEnergyPlus / 3.0);
+    model.SetTotalVaHoursImported(static_cast<float>(data.reactiveEnergyPlus), reactiveEnergyPerPhase,
+                                  reactiveEnergyPerPhase, reactiveEnergyPerPhase);
+
+    SetPhaseValues(model, &MeterModel::SetPower, derived.power);
+    SetPhaseValues(model, &MeterModel::SetApparentPower, derived.apparentPower);
+    SetPhaseValues(model, &MeterModel::SetReactivePower, derived.reactivePower);
+}
+
+// Value of one phase ( 0: L1 )
+inline int32_t GetPhaseValue(const espdm::MeterData::PhaseValues& values, size_t phase)
+{
+    return phase == 0 ? values.phase1 : (phase == 1 ? values.phase2 : values.phase3);
+}
+
+// Power in W and current in A of a single-phase model, e.g. estimated between the frames
+inline void SetPhaseMeterPower(sunspec::MeterModel& model, float power, float current)
+{
+    const float none = std::numeric_limits<float>::quiet_NaN();
+    model.SetPower(power, power, none, none);
+    model.SetAcCurrent(current, current, none, none);
+}
+
+// Sets the Sunspec 211 ( single-phase ) values of one phase ( 0: L1 ) of a frame, as if a meter measured only this
+// phase. Values of phase B and C are "not implemented" ( NaN ).
+// The energy counters are synthetic: the Kaifa meter counts energy only in total, each phase meter serves a third of
+// it. They are not the energy of the phase and must not be used for billing or per-phase balances.
+inline void SetPhaseMeterData(sunspec::MeterModel& model, const espdm::MeterData& data, size_t phase)
+{
+    using espdm::MeterData;
+    const float none = std::numeric_limits<float>::quiet_NaN();
+    const auto& derived = data.derived;
+    const float voltage = MeterData::ToVolt(GetPhaseValue(derived.voltage, phase));
+    model.SetVoltageToNeutral(voltage, voltage, none, none);
+    model.SetVoltagePhaseToPhase(none, none, none, none);
+
+    model.SetFrequency(50.0f);
+
+    const float powerFactor = MeterData::ToPowerFactor(derived.powerFactor);
+    model.SetPowerFactor(powerFactor, powerFactor, none, none);
+
+    // Synthetic counter: a third of the total energy, see above
+    const float activeEnergy = static_cast<float>(data.activeEnergyPlus / 3.0);
+    model.SetTotalWattHoursImported(activeEnergy, activeEnergy, none, none);
+    const float reactiveEnergy = static_cast<float>(data.reactiveEnergyPlus / 3.0);
+    model.SetTotalVaHoursImported(reactiveEnergy, reactiveEnergy, none, none);
+
+    SetPhaseMeterPower(model, static_cast<float>(GetPhaseValue(derived.power, phase)),
+                       MeterData::ToAmpere(GetPhaseValue(derived.current, phase)));
+    const float apparentPower = static_cast<float>(GetPhaseValue(derived.apparentPower, phase));
+    model.SetApparentPower(apparentPower, apparentPower, none, none);
+    const float reactivePower = static_cast<float>(GetPhaseValue(derived.reactivePower, phase));
+    model.SetReactivePower(reactivePower, reactivePower, none, none);
+}
+
+// Answers a Modbus read request from the registers of the model, applies its stale policy to the measured values
+inline modbus::ModbusServer::ResponseRead ReadMeterModel(const sunspec::MeterModel& model, uint8_t functionCode,
+                                                         const modbus::ModbusServer::RequestRead& request,
+                                                         uint32_t now)
+{
+    using ResponseRead = modbus::ModbusServer::ResponseRead;
+    using sunspec::StaleAction;
+    ResponseRead response;
+    if (functionCode != 0x03)
+    {
+        response.SetError(ResponseRead::ErrorCode::ILLEGAL_FUNCTION);
+        ESP_LOGW("sm", "Modbus received wrong functionCode %d", functionCode);
+        return response;
+    }
+    ESP_LOGD("sm", "Modbus request received: address = %d, count = %d", request.startAddress, request.addressCount);
+    // The static blocks are always served, also before the first frame ( discovery of the meter by the inverter )
+    const StaleAction staleAction = model.HasMeasuredValues(request.startAddress, request.addressCount)
+                                        ? model.GetStaleAction(now)
+                                        : StaleAction::SERVE;
+    if (model.IsValidAddressRange(request.startAddress, request.addressCount) == false)
+    {
+        response.SetError(ResponseRead::ErrorCode::ILLEGAL_ADDRESS);
+    }
+    else if (staleAction == StaleAction::DEVICE_FAILURE)
+    {
+        response.SetError(ResponseRead::ErrorCode::DEVICE_FAILURE);
+    }
+    else if (staleAction == StaleAction::DEVICE_BUSY)
+    {
+        response.SetError(ResponseRead::ErrorCode::DEVICE_BUSY);
+    }
+    else
+    {
+        response.SetData(
+            model.GetRegisterRaw(request.startAddress, request.addressCount, staleAction == StaleAction::ZERO_POWER));
+    }
+    return response;
+}
+
+} // namespace sm
+} // namespace esphome
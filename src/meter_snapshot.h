@@ -0,0 +1,147 @@
+#pragma once
+
+#include "energy_interval.h"
+#include "./esphome-dlms-meter/espdm_meter_data.h"
+
+#include <algorithm>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+// All values of the last meter frame as one JSON object, formatted once per frame into a fixed buffer
+// The web handler serves the buffer as is, so a client request costs no formatting. The fixed-point values of
+// MeterData are formatted exactly, without float.
+// Example ( shortened ):
+//   {"sequence":12,"timestamp":"2024-03-17T12:34:56","voltage":{"l1":230.1,"l2":231.2,"l3":232.3,"avg":231.2},
+//    ...,"energy_interval":{"plus":1.234,"minus":0.000,"sum":1.234},"energy_day":{"plus":...},...}
+class MeterSnapshot
+{
+public:
+    static constexpr size_t MAX_SIZE = 2048;
+
+    // Formats the snapshot, the interval values in kWh are null if not valid ( e.g. no begin set )
+    void Update(const espdm::MeterData& data, const EnergyInterval& energyInterval,
+                const CalendarEnergy& calendarEnergy)
+    {
+        m_length = 0;
+        m_sequence++;
+        const auto& ts = data.timestamp;
+        Append("{\"sequence\":%u,\"timestamp\":\"%04u-%02u-%02uT%02u:%02u:%02u\"", m_sequence, ts.year, ts.month,
+               ts.day, ts.hour, ts.minute, ts.second);
+        const auto& derived = data.derived;
+        AppendPhases("voltage", derived.voltage, "avg", 1);
+        AppendPhases("voltage_phase_to_phase", derived.voltagePhaseToPhase, "avg", 1);
+        AppendPhases("current", derived.current, "sum", 2);
+        AppendPhases("power", derived.power, "sum", 0);
+        AppendPhases("apparent_power", derived.apparentPower, "sum", 0);
+        AppendPhases("reactive_power", derived.reactivePower, "sum", 0);
+        AppendValue("power_factor", derived.powerFactor, 3);
+        AppendValue("active_power_plus", data.activePowerPlus, 0);
+        AppendValue("active_power_minus", data.activePowerMinus, 0);
+        AppendValue("active_energy_plus", data.activeEnergyPlus, 0);
+        AppendValue("active_energy_minus", data.activeEnergyMinus, 0);
+        AppendValue("reactive_energy_plus", data.reactiveEnergyPlus, 0);
+        AppendValue("reactive_energy_minus", data.reactiveEnergyMinus, 0);
+        AppendInterval("energy_interval", energyInterval, true);
+        AppendInterval("energy_day", calendarEnergy.Get(CalendarEnergy::Day), false);
+        AppendInterval("energy_month", calendarEnergy.Get(CalendarEnergy::Month), false);
+        AppendInterval("energy_year", calendarEnergy.Get(CalendarEnergy::Year), false);
+        Append("}");
+    }
+
+    // Empty until the first Update()
+    const char* GetJson() const
+    {
+        return m_json;
+    }
+
+    size_t GetLength() const
+    {
+        return m_length;
+    }
+
+    // +1 per Update(), used as SSE event id
+    uint32_t GetSequence() const
+    {
+        return m_sequence;
+    }
+
+private:
+    char m_json[MAX_SIZE]{};
+    size_t m_length{0};
+    uint32_t m_sequence{0};
+
+    void Append(const char* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+        const int written = vsnprintf(&m_json[m_length], MAX_SIZE - m_length, format, args);
+        va_end(args);
+        // On overflow the json is truncated ( and invalid ), MAX_SIZE covers the longest values
+        if (written > 0)
+        {
+            m_length = std::min(m_length + static_cast<size_t>(written), MAX_SIZE - 1);
+        }
+    }
+
+    // value in units of 10^-decimals, e.g. 2301 with 1 decimal: 230.1
+    void AppendNumber(int64_t value, int decimals)
+    {
+        uint64_t factor = 1;
+        for (int i = 0; i < decimals; i++)
+        {
+            factor *= 10;
+        }
+        const uint64_t absValue = value < 0 ? -static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        Append("%s%llu", value < 0 ? "-" : "", static_cast<unsigned long long>(absValue / factor));
+        if (decimals > 0)
+        {
+            Append(".%0*llu", decimals, static_cast<unsigned long long>(absValue % factor));
+        }
+    }
+
+    void AppendValue(const char* name, int64_t value, int decimals)
+    {
+        Append(",\"%s\":", name);
+        AppendNumber(value, decimals);
+    }
+
+    void AppendPhases(const char* name, const espdm::MeterData::PhaseValues& values, const char* totalName,
+                      int decimals)
+    {
+        Append(",\"%s\":{\"l1\":", name);
+        AppendNumber(values.phase1, decimals);
+        Append(",\"l2\":");
+        AppendNumber(values.phase2, decimals);
+        Append(",\"l3\":");
+        AppendNumber(values.phase3, decimals);
+        Append(",\"%s\":", totalName);
+        AppendNumber(values.total, decimals);
+        Append("}");
+    }
+
+    void AppendInterval(const char* name, const EnergyInterval& interval, bool withSum)
+    {
+        if (!interval.IsValid())
+        {
+            Append(",\"%s\":null", name);
+            return;
+        }
+        // Wh are exact, kWh with 3 decimals
+        Append(",\"%s\":{\"plus\":%.3f,\"minus\":%.3f", name, interval.GetPlus() * 0.001,
+               interval.GetMinus() * 0.001);
+        if (withSum)
+        {
+            Append(",\"sum\":%.3f", interval.GetSum() * 0.001);
+        }
+        Append("}");
+    }
+};
+
+} // namespace sm
+} // namespace esphome
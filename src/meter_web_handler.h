@@ -0,0 +1,75 @@
+#pragma once
+
+#include "esphome.h"
+#include "meter_snapshot.h"
+
+#include <mutex>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Serves the MeterSnapshot of the last frame for dashboards, instead of polling each entity:
+//   "http://<device>/meter": one JSON object with all values
+//   "http://<device>/meter/events": Server-Sent-Events stream, event "meter" with the same JSON per frame
+// The JSON is formatted once per frame, a request or event only copies it.
+// Note: the web server runs in an other task, the snapshot is protected by a mutex
+class MeterWebHandler : public AsyncWebHandler
+{
+public:
+    static constexpr const char* URL = "/meter";
+    static constexpr const char* EVENTS_URL = "/meter/events";
+
+    MeterWebHandler()
+        : m_events(EVENTS_URL)
+    { }
+
+    void Register()
+    {
+        web_server_base::global_web_server_base->add_handler(this);
+        web_server_base::global_web_server_base->add_handler(&m_events);
+    }
+
+    // Called per frame
+    void Update(const espdm::MeterData& data, const EnergyInterval& energyInterval,
+                const CalendarEnergy& calendarEnergy)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_snapshot.Update(data, energyInterval, calendarEnergy);
+        if (m_events.count() > 0)
+        {
+            m_events.send(m_snapshot.GetJson(), "meter", m_snapshot.GetSequence());
+        }
+    }
+
+    bool canHandle(AsyncWebServerRequest* request) override
+    {
+        return request->method() == HTTP_GET && request->url() == URL;
+    }
+
+    void handleRequest(AsyncWebServerRequest* request) override
+    {
+        char json[MeterSnapshot::MAX_SIZE];
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_snapshot.GetLength() == 0)
+            {
+                request->send(503, "text/plain", "No meter data yet");
+                return;
+            }
+            std::memcpy(json, m_snapshot.GetJson(), m_snapshot.GetLength() + 1);
+        }
+        auto response = request->beginResponse(200, "application/json", json);
+        response->addHeader("Access-Control-Allow-Origin", "*");
+        request->send(response);
+    }
+
+private:
+    MeterSnapshot m_snapshot;
+    AsyncEventSource m_events;
+    std::mutex m_mutex;
+};
+
+} // namespace sm
+} // namespace esphome
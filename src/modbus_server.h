@@ -1,10 +1,15 @@
 #pragma once
 
-#ifndef GTEST
-    #include "esphome/components/uart/uart.h"
+#ifndef ESPDM_HOST
+    #include "esphome/core/hal.h"
     #include "esphome/core/helpers.h"
+#else
+    #include "esphome_host.h"
 #endif
+#include "./esphome-dlms-meter/espdm_byte_stream.h"
+#include "./esphome-dlms-meter/espdm_clock.h"
 
+#include <algorithm>
 #include <cstring>
 #include <functional>
 #include <vector>
@@ -14,14 +19,17 @@ namespace esphome
 namespace modbus
 {
 /** Modbus server(slave) class.
- *   Handles the modbus commuinication for one modbus server(slave) address.
+ *   Handles the modbus commuinication for one modbus server(slave) address, more can be added with AddAddress().
  *   This class is needed, cause modbus::Modbus is tailored for Modbus-client(master).
  *   A received modbus-frame is not the same for client and server.
  *   Note: it handles only function-code 0x03
  */
-class ModbusServer : public uart::UARTDevice
+class ModbusServer
 {
 public:
+    // Bytes read from the stream at once
+    static constexpr size_t READ_CHUNK_SIZE = 64;
+
     struct RequestRead
     {
         uint16_t startAddress{0};
@@ -36,7 +44,8 @@ public:
             ILLEGAL_FUNCTION = 0X01,
             ILLEGAL_ADDRESS = 0X02,
             ILLEGAL_VALUE = 0X03,
-            DEVICE_FAILURE = 0X04
+            DEVICE_FAILURE = 0X04,
+            DEVICE_BUSY = 0X06
         };
 
         void SetError(ErrorCode error)
@@ -86,35 +95,71 @@ public:
     using OnReceiveRequest = std::function<ResponseRead(uint8_t functionCode, const RequestRead& request)>;
 
     ModbusServer(uint8_t address, OnReceiveRequest onReceive)
-        : m_address(address)
-        , m_onReceiveRequest(onReceive)
-    { }
+    {
+        AddAddress(address, onReceive);
+    }
+
+    // An other server(slave) address on the same line, e.g. a virtual meter. Add all at setup, not while requests
+    // are processed.
+    void AddAddress(uint8_t address, OnReceiveRequest onReceive)
+    {
+        m_units.push_back({address, onReceive});
+    }
+
+    // Line of the requests and responses, e.g. an UartByteStream, set it before ProcessRequest() is called
+    void SetStream(espdm::ByteStream& stream)
+    {
+        m_stream = &stream;
+    }
+
+    // Reserves the buffer of the received bytes, it holds at most one read chunk and an incomplete frame
+    void ReserveRxBuffer(size_t size)
+    {
+        m_rxBuffer.reserve(size);
+    }
+
+    // Received bytes which are not processed yet, an incomplete frame
+    const std::vector<uint8_t>& GetRxBuffer() const
+    {
+        return m_rxBuffer;
+    }
+
+    // Time source of the response delay, default: the system clock
+    void SetClock(const espdm::Clock& clock)
+    {
+        m_clock = &clock;
+    }
 
     void ProcessRequest()
     {
         // this is called every ~16ms, so we can not rely on timing (3.5 chars between frames see
         // https://en.wikipedia.org/wiki/Modbus) instead parse the rx_buffer for valid frames(address, function-code,
-        // length, crc). Read all from uart
-        while (available())
+        // length, crc). Read all from the stream, chunk by chunk
+        uint8_t chunk[READ_CHUNK_SIZE];
+        size_t length;
+        while (m_stream != nullptr && (length = m_stream->Read(chunk, sizeof(chunk))) > 0)
         {
-            uint8_t byte(0);
-            if (read_byte(&byte))
+            if (m_rxBuffer.empty())
             {
-                m_rxBuffer.push_back(byte);
-                // ESP_LOGD("mbsrv", "Modbus received Byte  %d (0X%x)", byte, byte);
+                m_frameStartUs = m_clock->Micros();
             }
+            m_rxBuffer.insert(m_rxBuffer.end(), chunk, chunk + length);
+            ParseRxBuffer();
         }
+    }
 
-        while (m_rxBuffer.size() > 0)
-        {
-            auto removeSize = ParseModbusFrame();
-            if (removeSize == 0)
-            {
-                break;
-            }
-            // Remove processed data
-            m_rxBuffer.erase(m_rxBuffer.begin(), m_rxBuffer.begin() + removeSize);
-        }
+    // Time from the first received byte of a request until the response is sent
+    uint32_t GetMaxResponseDelayUs() const
+    {
+        return m_maxResponseDelayUs;
+    }
+    uint32_t GetLastResponseDelayUs() const
+    {
+        return m_lastResponseDelayUs;
+    }
+    void ResetStatistics()
+    {
+        m_maxResponseDelayUs = 0;
     }
 
     // Send command. payload contains data without CRC
@@ -126,19 +171,50 @@ public:
         }
 
         auto crc = crc16(payload.data(), payload.size());
-        write_array(payload);
-        write_byte(crc & 0xFF);
-        write_byte((crc >> 8) & 0xFF);
-        flush();
-        ESP_LOGD("mbsrv", "Modbus sending raw frame: %s, CRC: 0x%02x, 0x%02x", format_hex_pretty(payload).c_str(),
+        const uint8_t crcBytes[2] = {static_cast<uint8_t>(crc & 0xFF), static_cast<uint8_t>((crc >> 8) & 0xFF)};
+        if (m_stream != nullptr)
+        {
+            m_stream->Write(payload.data(), payload.size());
+            m_stream->Write(crcBytes, sizeof(crcBytes));
+            m_stream->Flush();
+        }
+        m_lastResponseDelayUs = m_clock->Micros() - m_frameStartUs;
+        m_maxResponseDelayUs = std::max(m_maxResponseDelayUs, m_lastResponseDelayUs);
+        // Note: the arguments are only evaluated if verbose logging is compiled in ( logger level )
+        ESP_LOGV("mbsrv", "Modbus sending raw frame: %s, CRC: 0x%02x, 0x%02x", format_hex_pretty(payload).c_str(),
                  crc & 0xFF, (crc >> 8) & 0xFF);
     }
 
+protected:
+    struct Unit
+    {
+        uint8_t address;
+        OnReceiveRequest onReceiveRequest;
+    };
+
+    std::vector<Unit> m_units; // a few, searched linear
+    espdm::ByteStream* m_stream{nullptr};
     std::vector<uint8_t> m_rxBuffer;
+    const espdm::Clock* m_clock{&espdm::SystemClock::Get()};
+    uint32_t m_frameStartUs{0};
+    uint32_t m_lastResponseDelayUs{0};
+    uint32_t m_maxResponseDelayUs{0};
 
-protected:
-    uint8_t m_address;
-    OnReceiveRequest m_onReceiveRequest;
+    void ParseRxBuffer()
+    {
+        // Remove the processed data at once, removing byte by byte is quadratic on noise
+        size_t offset = 0;
+        while (offset < m_rxBuffer.size())
+        {
+            auto removeSize = ParseModbusFrame(offset);
+            if (removeSize == 0)
+            {
+                break;
+            }
+            offset += removeSize;
+        }
+        m_rxBuffer.erase(m_rxBuffer.begin(), m_rxBuffer.begin() + offset);
+    }
 
     size_t GetFrameSize(uint8_t functionCode)
     {
@@ -147,19 +223,20 @@ protected:
         return functionCode >= 0x01 && functionCode <= 0x04 ? 8 : 0;
     }
 
-    uint32_t ParseModbusFrame()
+    // Parses the frame at offset of the rx buffer
+    uint32_t ParseModbusFrame(size_t offset)
     {
         const uint32_t needMoreData = 0;
         const uint32_t tryToFindValidFrame = 1;
 
-        size_t bufSize = m_rxBuffer.size();
+        size_t bufSize = m_rxBuffer.size() - offset;
         // at least address | functionCode
         if (bufSize < 2)
         {
             return needMoreData;
         }
 
-        const auto begin = m_rxBuffer.begin();
+        const auto begin = m_rxBuffer.begin() + offset;
         uint8_t address = *(begin + 0);
         const auto functionCode = *(begin + 1);
         const auto frameSize = GetFrameSize(functionCode);
@@ -185,7 +262,9 @@ protected:
             return tryToFindValidFrame;
         }
 
-        if (m_address == address)
+        const auto unit = std::find_if(m_units.begin(), m_units.end(),
+                                       [address](const Unit& unit) { return unit.address == address; });
+        if (unit != m_units.end())
         {
             RequestRead request;
             // Note: Received as big endian
@@ -193,13 +272,13 @@ protected:
             request.startAddress += static_cast<uint16_t>(*(begin + 3));
             request.addressCount = static_cast<uint16_t>(*(begin + 4)) << 8;
             request.addressCount += static_cast<uint16_t>(*(begin + 5));
-            ResponseRead response = m_onReceiveRequest(functionCode, request);
+            ResponseRead response = unit->onReceiveRequest(functionCode, request);
 
-            Send(response.GetPayload(m_address, functionCode));
+            Send(response.GetPayload(address, functionCode));
         }
         else
         {
-            ESP_LOGD("mbsrv", "Not our[%d] address = %d", m_address, address);
+            ESP_LOGD("mbsrv", "Not our[%d] address = %d", m_units[0].address, address);
         }
 
         // Frame can be removed
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "./esphome-dlms-meter/espdm_meter_data.h"
+
+#include <stdint.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+// The energy counters of MeterData as stored in flash
+// Note: the instantaneous values ( voltage, current, power ) are not persisted. The flash is written at most every
+// hour, restored power values could be that old and an inverter would regulate on them. They stay 0 until the first
+// frame is decoded.
+struct PersistedMeterData
+{
+    static PersistedMeterData FromMeterData(const espdm::MeterData& data)
+    {
+        PersistedMeterData persisted;
+        persisted.activeEnergyPlus = data.activeEnergyPlus;
+        persisted.activeEnergyMinus = data.activeEnergyMinus;
+        persisted.reactiveEnergyPlus = data.reactiveEnergyPlus;
+        persisted.reactiveEnergyMinus = data.reactiveEnergyMinus;
+        persisted.timestamp = data.timestamp;
+        return persisted;
+    }
+
+    espdm::MeterData ToMeterData() const
+    {
+        espdm::MeterData data;
+        data.activeEnergyPlus = activeEnergyPlus;
+        data.activeEnergyMinus = activeEnergyMinus;
+        data.reactiveEnergyPlus = reactiveEnergyPlus;
+        data.reactiveEnergyMinus = reactiveEnergyMinus;
+        data.timestamp = timestamp;
+        data.UpdateDerived();
+        return data;
+    }
+
+    // Units see MeterData
+    uint32_t activeEnergyPlus{0};
+    uint32_t activeEnergyMinus{0};
+    uint32_t reactiveEnergyPlus{0};
+    uint32_t reactiveEnergyMinus{0};
+    espdm::MeterTimestamp timestamp;
+};
+
+// When the meter data is persisted
+// deadbandWh: min. change of the active energy plus or minus, minIntervalMs: min. time between two saves
+struct PersistPolicy
+{
+    uint32_t deadbandWh{1};
+    uint32_t minIntervalMs{0};
+};
+
+// Decides on the exact energy counters ( Wh ) if the meter data has to be persisted
+class PersistThrottle
+{
+public:
+    // Returns true if the data has to be persisted, the counters are then taken as last persisted ones
+    bool ShouldPersist(const PersistPolicy& policy, uint32_t energyPlus, uint32_t energyMinus, uint32_t nowMs)
+    {
+        if (m_persisted)
+        {
+            if (nowMs - m_lastMs < policy.minIntervalMs)
+            {
+                return false;
+            }
+            // Note: the counters only increase, a reset of the meter is a change as well
+            const uint32_t changePlus = energyPlus >= m_lastPlus ? energyPlus - m_lastPlus : m_lastPlus - energyPlus;
+            const uint32_t changeMinus
+                = energyMinus >= m_lastMinus ? energyMinus - m_lastMinus : m_lastMinus - energyMinus;
+            if (changePlus < policy.deadbandWh && changeMinus < policy.deadbandWh)
+            {
+                return false;
+            }
+        }
+        m_persisted = true;
+        m_lastPlus = energyPlus;
+        m_lastMinus = energyMinus;
+        m_lastMs = nowMs;
+        return true;
+    }
+
+private:
+    bool m_persisted{false};
+    uint32_t m_lastPlus{0};
+    uint32_t m_lastMinus{0};
+    uint32_t m_lastMs{0};
+};
+
+} // namespace sm
+} // namespace esphome
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Extrapolates the power between two meter frames ( Kaifa sends every ~5s, the inverter polls every ~1s )
+// A trend is only continued if the last two changes go in the same direction ( e.g. pv ramp ), a single
+// step ( e.g. kettle switched on ) is held. The trend is continued for at most one frame interval.
+// Bounded error: the estimate never deviates more than the smaller of the last two changes from the last
+// measured value.
+class PowerEstimator
+{
+public:
+    static constexpr uint32_t MAX_FRAME_INTERVAL_MS = 15000; // older frames are not used for a trend
+    static constexpr float DAMPING = 0.5f; // part of the trend which is continued, see replay in power_estimator_test
+
+    void SetEnabled(bool enabled)
+    {
+        m_enabled = enabled;
+    }
+
+    bool IsEnabled() const
+    {
+        return m_enabled;
+    }
+
+    void AddMeasurement(float power, uint32_t timeMs)
+    {
+        for (size_t i = 0; i < FRAME_COUNT - 1; i++)
+        {
+            m_frames[i] = m_frames[i + 1];
+        }
+        m_frames[FRAME_COUNT - 1] = {power, timeMs};
+        m_count = m_count < FRAME_COUNT ? m_count + 1 : FRAME_COUNT;
+    }
+
+    // Returns the last measured power if disabled or no trend is available
+    float Estimate(uint32_t nowMs) const
+    {
+        const Frame& last = m_frames[2];
+        if (!m_enabled || m_count < FRAME_COUNT)
+        {
+            return last.power;
+        }
+        const Frame& previous = m_frames[1];
+        const Frame& first = m_frames[0];
+        const uint32_t frameIntervalMs = last.timeMs - previous.timeMs;
+        if (frameIntervalMs == 0 || frameIntervalMs > MAX_FRAME_INTERVAL_MS
+            || previous.timeMs - first.timeMs > MAX_FRAME_INTERVAL_MS)
+        {
+            return last.power;
+        }
+        const float change1 = previous.power - first.power;
+        const float change2 = last.power - previous.power;
+        if ((change1 > 0.0f) != (change2 > 0.0f) || change1 == 0.0f || change2 == 0.0f)
+        {
+            return last.power; // no trend
+        }
+        const float trend = fabsf(change1) < fabsf(change2) ? change1 : change2;
+
+        uint32_t elapsedMs = nowMs - last.timeMs;
+        if (elapsedMs > frameIntervalMs)
+        {
+            elapsedMs = frameIntervalMs; // next frame is overdue, do not run away
+        }
+        return last.power + DAMPING * trend * static_cast<float>(elapsedMs) / static_cast<float>(frameIntervalMs);
+    }
+
+    float GetLastPower() const
+    {
+        return m_frames[2].power;
+    }
+
+    void Reset()
+    {
+        m_count = 0;
+        m_frames[2].power = 0.0f;
+    }
+
+private:
+    struct Frame
+    {
+        float power;
+        uint32_t timeMs;
+    };
+    static constexpr size_t FRAME_COUNT = 3;
+
+    bool m_enabled{false};
+    size_t m_count{0};
+    Frame m_frames[FRAME_COUNT]{};
+};
+
+} // namespace sm
+} // namespace esphome
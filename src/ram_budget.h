@@ -0,0 +1,61 @@
+#pragma once
+
+#if defined(ESP32)
+    #include "esp_heap_caps.h"
+#endif
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Kept free for the web server, TLS, the processing task and the fragmentation of the heap
+constexpr size_t RAM_RESERVE = 64 * 1024;
+
+// Free bytes of the internal RAM, 0 if unknown ( no optional buffers then )
+inline size_t GetFreeHeap()
+{
+#if defined(ESP32)
+    return heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#else
+    return 0;
+#endif
+}
+
+// Shares the free heap between the optional RAM buffers ( history, frame dump, capture )
+// Each buffer gets a share of the heap above the reserve up to its max. size, a buffer below its min. size is not
+// allocated.
+class RamBudget
+{
+public:
+    RamBudget(size_t freeBytes, size_t reserveBytes)
+        : m_available(freeBytes > reserveBytes ? freeBytes - reserveBytes : 0)
+    { }
+
+    // percent: share of the bytes still available. Returns the bytes granted ( taken from the budget ), 0: none.
+    size_t Take(size_t minBytes, size_t maxBytes, uint32_t percent)
+    {
+        const size_t bytes = std::min(maxBytes, m_available / 100 * percent);
+        if (bytes < minBytes || bytes == 0)
+        {
+            return 0;
+        }
+        m_available -= bytes;
+        return bytes;
+    }
+
+    size_t GetAvailable() const
+    {
+        return m_available;
+    }
+
+private:
+    size_t m_available;
+};
+
+} // namespace sm
+} // namespace esphome
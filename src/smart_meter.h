@@ -1,9 +1,24 @@
 #pragma once
 
 #include "esphome.h"
+#include "capture_web_handler.h"
+#include "energy_interval.h"
+#include "frame_dump_web_handler.h"
+#include "history_web_handler.h"
+#include "load_profile_web_handler.h"
+#include "meter_aggregator.h"
+#include "meter_model_bridge.h"
+#include "meter_web_handler.h"
 #include "modbus_server.h"
+#include "persisted_meter_data.h"
+#include "ram_budget.h"
+#include "power_estimator.h"
 #include "sunspec_meter_model.h"
+#include "telemetry_sender.h"
 #include "./esphome-dlms-meter/espdm.h"
+#if defined(ESP32)
+    #include "esp_heap_caps.h"
+#endif
 
 #define SMART_METER_VERSION "1.0.0"
 // first release
@@ -19,21 +34,62 @@ using namespace modbus;
 using namespace sunspec;
 
 constexpr uint8_t SMART_METER_ADDRESS = 1;
-constexpr uint32_t BLINK_OFF_COUNT = 5; // 5 * 16ms => led is ~80ms on when blinking
+// Virtual single-phase meters ( Sunspec 211 ) of L1, L2, L3 on the addresses 2, 3, 4, e.g. for micro-inverters
+// Voltage, current and power are measured per phase, the energy counters are a third of the total ( synthetic )
+constexpr uint8_t PHASE_METER_ADDRESS = 2;
+constexpr size_t PHASE_COUNT = 3;
+constexpr uint32_t BLINK_ON_MS = 80; // led is on when blinking, switched off by the first loop after it
+constexpr uint32_t DLMS_TICK_BUDGET_US = 4000; // max. time per loop for dlms processing ( one step may take longer )
+constexpr uint32_t POWER_ESTIMATE_INTERVAL_MS = 200; // update of the estimated power in the MeterModel
+constexpr uint32_t ERASE_AHEAD_INTERVAL_MS = 1000; // max. one flash sector erase ( ~50ms ) of the load profile
+// RAM buffers of the diagnostics, sized from the free heap at setup, see RamBudget ( esp32dev: ~40KB history )
+// 24h of 5s frames need ~85KB, see MeterHistory. Half of the budget, at least ~1h.
+constexpr size_t HISTORY_MIN_SIZE = 2 * MeterHistory::BLOCK_SIZE;
+constexpr size_t HISTORY_MAX_SIZE = 96 * 1024;
+constexpr uint32_t HISTORY_BUDGET_PERCENT = 50;
+// Raw frames of the meter link for "/frames.txt", 16KB: ~2 minutes of Kaifa frames ( 2 mbus-frames per 5s )
+constexpr size_t FRAME_DUMP_MIN_SIZE = 2 * 1024;
+constexpr size_t FRAME_DUMP_MAX_SIZE = 16 * 1024;
+constexpr uint32_t FRAME_DUMP_BUDGET_PERCENT = 25;
+// Publish policies of the sensors calculated here, see espdm::PublishPolicy
+constexpr espdm::PublishPolicy POWER_FACTOR_POLICY = {0.01f, 0, 5 * 60 * 1000};
+constexpr espdm::PublishPolicy APPARENT_POWER_POLICY = {5.0f, 0, 5 * 60 * 1000};
+constexpr espdm::PublishPolicy TIMESPAN_POLICY = {0.0f, 60 * 1000, 60 * 1000}; // uptime, energy interval duration
+constexpr espdm::PublishPolicy SETTINGS_UPDATE_POLICY = {0.0f, 1000, 1000}; // read the Modbus and telemetry settings
+constexpr espdm::PublishPolicy DIAGNOSTIC_POLICY = {0.0f, 60 * 1000, 60 * 1000}; // heap and timing stats
+// Persisted meter data: update the pending data each minute, write it to flash at most every hour ( wear )
+// Note: change the key if PersistedMeterData changes, old data is then ignored
+constexpr char PERSISTED_METER_DATA_KEY[] = "smart_meter_data_v4";
+constexpr PersistPolicy PERSIST_SAVE_POLICY = {1, 60 * 1000};
+constexpr PersistPolicy PERSIST_SYNC_POLICY = {1, 60 * 60 * 1000};
+// Energy of the current day, month and year in kWh, persisted when a period begins
+constexpr char PERSISTED_CALENDAR_ENERGY_KEY[] = "smart_meter_calendar_energy_v1";
+constexpr espdm::PublishPolicy CALENDAR_ENERGY_POLICY = {0.001f, 30 * 1000, 5 * 60 * 1000};
 
 class SmartMeter : public Component, public sensor::Sensor
 {
 public:
     SmartMeter(uart::UARTComponent* uartModbus, uart::UARTComponent* uartMbus)
-        : m_modbusServer(SMART_METER_ADDRESS,
+        : m_modbusStream(uartModbus)
+        , m_meterStream(uartMbus)
+        , m_modbusServer(SMART_METER_ADDRESS,
                          [this](uint8_t functionCode, const ModbusServer::RequestRead& request) {
-                             return OnModbusReceiveRequest(functionCode, request);
+                             return OnModbusReceiveRequest(m_meterModel, functionCode, request);
                          })
-        , m_dlmsMeter(uartMbus)
+        , m_dlmsMeter(m_meterStream)
         , m_meterModel(SMART_METER_ADDRESS)
+        , m_phaseMeterModels{{PHASE_METER_ADDRESS, MODEL_SINGLE_PHASE},
+                             {PHASE_METER_ADDRESS + 1, MODEL_SINGLE_PHASE},
+                             {PHASE_METER_ADDRESS + 2, MODEL_SINGLE_PHASE}}
     {
-        std::memset(&m_uptimeStart, 0, sizeof(m_uptimeStart));
-        m_modbusServer.set_uart_parent(uartModbus);
+        m_modbusServer.SetStream(m_modbusStream);
+        for (size_t i = 0; i < PHASE_COUNT; i++)
+        {
+            m_modbusServer.AddAddress(static_cast<uint8_t>(PHASE_METER_ADDRESS + i),
+                                      [this, i](uint8_t functionCode, const ModbusServer::RequestRead& request) {
+                                          return OnModbusReceiveRequest(m_phaseMeterModels[i], functionCode, request);
+                                      });
+        }
         // None GUI sensor, just to get access from yaml if needed.
         set_internal(true);
 
@@ -58,21 +114,107 @@ public:
             &id(reactive_energy_plus),
             &id(reactive_energy_minus)); // Set sensors to use for reactive energy (optional)
 
-        m_dlmsMeter.RegisterForMeterData([this](const espdm::DlmsMeter::MeterData& data) { OnReceiveMeterData(data); });
+        m_dlmsMeter.set_link_counter_sensors(&id(dlms_frames_received), &id(dlms_frames_decoded),
+                                             &id(dlms_frames_aborted), &id(mbus_resyncs), &id(dlms_frames_lost));
+        m_dlmsMeter.set_link_timing_sensors(&id(dlms_decrypt_time), &id(dlms_decode_time));
+        m_dlmsMeter.set_data_age_sensor(&id(meter_data_age), &id(sntp_time));
+        m_dlmsMeter.set_abort_reasons_sensor(&id(dlms_abort_reasons));
+
+        m_dlmsMeter.RegisterForMeterData([this](const espdm::DlmsMeter::MeterData& data) { OnReceiveFrame(0, data); });
+        m_dlmsMeter.RegisterForFramePayload(
+            [this](const uint8_t* data, size_t length) { m_frameDump.Add(m_clock->Millis(), data, length); });
+        m_aggregator.AddMeter();
+    }
+
+    // Adds a meter on an own uart, its frames are merged with the ones of the first meter ( see MeterAggregator ),
+    // e.g. house and heat pump. Call before setup(). The sensors of the DlmsMeter show the first meter only.
+    // phases: phase of the aggregate for L1, L2, L3 of this meter
+    bool AddMeter(uart::UARTComponent* uartMbus, const uint8_t key[16],
+                  const MeterAggregator::PhaseMap& phases = MeterAggregator::PhaseMap{{0, 1, 2}})
+    {
+        const int index = m_aggregator.AddMeter(phases);
+        if (index < 0)
+        {
+            ESP_LOGE("sm", "Meter not added, max. %u meters with valid phases",
+                     static_cast<unsigned>(MeterAggregator::MAX_METERS));
+            return false;
+        }
+        m_additionalStreams.emplace_back(new espdm::UartByteStream(uartMbus));
+        std::unique_ptr<espdm::DlmsMeter> meter(new espdm::DlmsMeter(*m_additionalStreams.back()));
+        uint8_t meterKey[16];
+        std::memcpy(meterKey, key, sizeof(meterKey));
+        meter->set_key(meterKey, sizeof(meterKey));
+        meter->SetClock(*m_clock);
+        meter->RegisterForMeterData(
+            [this, index](const espdm::DlmsMeter::MeterData& data) { OnReceiveFrame(index, data); });
+        m_additionalMeters.push_back(std::move(meter));
+        return true;
+    }
+
+    // Time source of all time-dependent logic, default: the system clock. Call before setup(), the clock must
+    // outlive the SmartMeter.
+    void SetClock(const espdm::Clock& clock)
+    {
+        m_clock = &clock;
+        m_modbusServer.SetClock(clock);
+        m_dlmsMeter.SetClock(clock);
+        for (auto& meter : m_additionalMeters)
+        {
+            meter->SetClock(clock);
+        }
     }
 
     void setup() override
     {
         ESP_LOGI("sm", "Smart-Meter starting, version = %s", SMART_METER_VERSION);
+        RestoreMeterData();
+        RestoreCalendarEnergy();
+        AllocateRamBuffers();
+        m_history.Register();
+        m_loadProfile.Setup();
+        m_meterWeb.Register();
+        m_frameDump.Register();
+        m_capture.Register();
         m_dlmsMeter.setup();
+        for (auto& meter : m_additionalMeters)
+        {
+            meter->setup();
+        }
+#if defined(ESP32) && !defined(CONFIG_FREERTOS_UNICORE)
+        // Decrypt and decode on core 0, esphome loop ( publishing and Modbus ) runs on core 1
+        m_dlmsMeter.StartProcessingTask(0);
+        for (auto& meter : m_additionalMeters)
+        {
+            meter->StartProcessingTask(0);
+        }
+#endif
     }
 
     void loop() override
     {
         // called in ~16ms interval
-        m_dlmsMeter.loop();
+        // Modbus requests always go first, dlms-frame processing is split in steps and continued in next loop if
+        // the time budget is used up.
         m_modbusServer.ProcessRequest();
+        const uint32_t start = m_clock->Micros();
+        bool pending;
+        while ((pending = RunMeterSteps()))
+        {
+            m_modbusServer.ProcessRequest();
+            if (m_clock->Micros() - start >= DLMS_TICK_BUDGET_US)
+            {
+                break;
+            }
+        }
+        if (!pending)
+        {
+            EraseAhead();
+        }
+        UpdateEstimatedPower();
+        UpdateSettings();
+        UpdateStaleState();
         SetStatusLed(false);
+        m_uptime.Update(*m_clock);
     }
 
     std::vector<sensor::Sensor*> GetSensors()
@@ -83,93 +225,334 @@ public:
         return sensors;
     }
 
+    // A frame of one of the meters
+    void OnReceiveFrame(size_t meter, const espdm::DlmsMeter::MeterData& data)
+    {
+        if (m_aggregator.GetMeterCount() == 1)
+        {
+            OnReceiveMeterData(data);
+            return;
+        }
+        OnReceiveMeterData(m_aggregator.Update(meter, data, m_clock->Millis()));
+    }
+
+    // Data of the meter, or the aggregate of all meters
     void OnReceiveMeterData(const espdm::DlmsMeter::MeterData& data)
     {
-        // Set Sunspec meter data
-        // Note: not all phase related values are available, provide some narrowed values
-        float total(0.0f), value1(0.0f), value2(0.0f), value3(0.0f);
+        const uint32_t now = m_clock->Millis();
+        UpdateMeterModel(data);
+        SetMeterModelUpdateTime(now);
+        if (m_meterDataStale || m_firstFrameMs == 0)
+        {
+            m_meterDataStale = false;
+            id(meter_data_stale).publish_state(false);
+        }
+        if (m_firstFrameMs == 0)
+        {
+            m_firstFrameMs = now;
+            id(boot_first_frame_time).publish_state(now / 1000.0f);
+        }
+        PersistMeterData(data, now);
+        m_telemetry.Send(data);
+        auto utcNow = id(sntp_time).utcnow();
+        if (utcNow.is_valid())
+        {
+            m_history.Append(HistorySample::FromMeterData(data, utcNow.timestamp));
+            m_loadProfile.Add(utcNow.timestamp,
+                              static_cast<int32_t>(data.activePowerPlus) - static_cast<int32_t>(data.activePowerMinus),
+                              data.activeEnergyPlus, data.activeEnergyMinus);
+        }
 
-        data.GetVoltage(value1, value2, value3);
-        m_meterModel.SetVoltageToNeutral(data.GetAverageVoltage(), value1, value2, value3);
+        const auto& derived = data.derived;
+        const float powerFactor = espdm::MeterData::ToPowerFactor(derived.powerFactor);
+        if (m_powerFactorThrottle.ShouldPublish(POWER_FACTOR_POLICY, powerFactor, now))
+        {
+            id(power_factor).publish_state(powerFactor);
+        }
+        const float apparentPower = static_cast<float>(derived.apparentPower.total);
+        if (m_apparentPowerThrottle.ShouldPublish(APPARENT_POWER_POLICY, apparentPower, now))
+        {
+            id(apparent_power).publish_state(apparentPower);
+        }
+        m_lastDerived = derived;
+        m_powerEstimator.AddMeasurement(static_cast<float>(derived.power.total), now);
+        m_lastPowerEstimateMs = now;
+
+        // Text sensors are only published on change, timespans and diagnostics in a fixed interval
+        const bool publishTimespans = m_timespanThrottle.ShouldPublish(TIMESPAN_POLICY, 0.0f, now);
+        SetEnergyFlow(data, now, publishTimespans);
+        m_meterWeb.Update(data, m_energyInterval, m_calendarEnergy);
+        if (publishTimespans)
+        {
+            SetUptime();
+        }
+        if (m_diagnosticThrottle.ShouldPublish(DIAGNOSTIC_POLICY, 0.0f, now))
+        {
+            SetHeapStats();
+            SetTimingStats();
+        }
+        ESP_LOGD("sm", "MeterModel data updated");
+    }
 
-        data.GetCurrent(total, value1, value2, value3);
-        m_meterModel.SetAcCurrent(total, value1, value2, value3);
+    // The registers are updated with each frame, a request only copies them
+    ModbusServer::ResponseRead OnModbusReceiveRequest(const MeterModel& model, uint8_t functionCode,
+                                                      const ModbusServer::RequestRead& request)
+    {
+        ModbusServer::ResponseRead response = ReadMeterModel(model, functionCode, request, m_clock->Millis());
+        SetStatusLed(true, response.IsError());
+        if (m_firstValidResponseMs == 0 && m_hasMeterData && !response.IsError())
+        {
+            m_firstValidResponseMs = m_clock->Millis();
+            id(boot_first_response_time).publish_state(m_firstValidResponseMs / 1000.0f);
+            ESP_LOGI("sm", "First valid Modbus response %ums after boot, meter data %s", m_firstValidResponseMs,
+                     m_meterDataStale ? "restored" : "received");
+        }
 
-        m_meterModel.SetVoltagePhaseToPhase(
-            data.GetPhaseToPhaseVoltage(data.GetAverageVoltage()), data.GetPhaseToPhaseVoltage(data.voltageL1),
-            data.GetPhaseToPhaseVoltage(data.voltageL2), data.GetPhaseToPhaseVoltage(data.voltageL3));
+        return response;
+    }
 
-        m_meterModel.SetFrequency(50.0f);
+private:
+    espdm::UartByteStream m_modbusStream;
+    espdm::UartByteStream m_meterStream;
+    ModbusServer m_modbusServer;
+    espdm::DlmsMeter m_dlmsMeter;
+    std::vector<std::unique_ptr<espdm::UartByteStream>> m_additionalStreams;
+    std::vector<std::unique_ptr<espdm::DlmsMeter>> m_additionalMeters;
+    MeterAggregator m_aggregator;
+    MeterModel m_meterModel;
+    MeterModel m_phaseMeterModels[PHASE_COUNT]; // L1, L2, L3
+    HistoryWebHandler m_history;
+    LoadProfileWebHandler m_loadProfile;
+    MeterWebHandler m_meterWeb;
+    FrameDumpWebHandler m_frameDump; // of the first meter
+    CaptureWebHandler m_capture; // of the first meter
+    bool m_captureEnabled{false};
+    const espdm::Clock* m_clock{&espdm::SystemClock::Get()};
+    espdm::Uptime m_uptime;
+    espdm::BlinkTimer m_statusBlink{BLINK_ON_MS};
+    ESPPreferenceObject m_persistedMeterData;
+    PersistThrottle m_persistSaveThrottle;
+    PersistThrottle m_persistSyncThrottle;
+    bool m_hasMeterData{false}; // received or restored
+    bool m_meterDataStale{false}; // restored, no frame received yet
+    uint32_t m_firstFrameMs{0};
+    uint32_t m_firstValidResponseMs{0};
+    espdm::PublishThrottle m_powerFactorThrottle;
+    espdm::PublishThrottle m_apparentPowerThrottle;
+    espdm::PublishThrottle m_timespanThrottle;
+    espdm::PublishThrottle m_diagnosticThrottle;
+    espdm::PublishThrottle m_settingsThrottle;
+    TelemetrySender m_telemetry;
+    std::string m_telemetryTarget;
+    PowerEstimator m_powerEstimator;
+    espdm::MeterData::Derived m_lastDerived; // of last frame, base for the estimated values
+    uint32_t m_lastPowerEstimateMs{0};
+    uint32_t m_lastEraseAheadMs{0};
+    // Settings of the energy interval ( number entities ), to detect a change
+    struct EnergyIntervalSettings
+    {
+        float year;
+        float month;
+        float day;
+        float plusKWh;
+        float minusKWh;
+    };
+    EnergyIntervalSettings m_energyIntervalSettings{-1.0f, -1.0f, -1.0f, -1.0f, -1.0f};
+    EnergyInterval m_energyInterval;
+    CalendarEnergy m_calendarEnergy;
+    ESPPreferenceObject m_persistedCalendarEnergy;
+    espdm::PublishThrottle m_calendarEnergyThrottles[CalendarEnergy::PeriodCount][2]; // plus, minus
+
+    // The load profile sectors are erased in an idle loop, so the frame processing and Modbus are not blocked
+    // Note: not on the boot path, the first frame and Modbus response go first
+    void EraseAhead()
+    {
+        const uint32_t now = m_clock->Millis();
+        if (m_firstFrameMs == 0 || m_modbusStream.Available() > 0 || now - m_lastEraseAheadMs < ERASE_AHEAD_INTERVAL_MS)
+        {
+            return;
+        }
+        if (m_loadProfile.EraseAhead())
+        {
+            m_lastEraseAheadMs = now;
+        }
+    }
 
-        // No idea why Fronius inverter shows it as negative number
-        const auto powerFactor = data.GetPowerFactor();
-        m_meterModel.SetPowerFactor(powerFactor, powerFactor, powerFactor, powerFactor);
-        id(power_factor).publish_state(powerFactor);
+    // Runs the next step of each meter, returns true if there is more work pending
+    bool RunMeterSteps()
+    {
+        bool pending = m_dlmsMeter.RunStep();
+        for (auto& meter : m_additionalMeters)
+        {
+            pending = meter->RunStep() || pending;
+        }
+        return pending;
+    }
+
+    void UpdateSettings()
+    {
+        const uint32_t now = m_clock->Millis();
+        if (!m_settingsThrottle.ShouldPublish(SETTINGS_UPDATE_POLICY, 0.0f, now))
+        {
+            return;
+        }
+        {
+            // Stale policy of the Modbus unit
+            const auto index = id(modbus_stale_action).active_index();
+            const StaleAction actions[] = {StaleAction::SERVE, StaleAction::DEVICE_FAILURE, StaleAction::DEVICE_BUSY,
+                                           StaleAction::ZERO_POWER};
+            StalePolicy policy;
+            policy.maxAgeMs = std::isnan(id(modbus_stale_age).state)
+                                  ? 0
+                                  : static_cast<uint32_t>(id(modbus_stale_age).state * 1000.0f);
+            policy.action = index.has_value() && *index < 4 ? actions[*index] : StaleAction::SERVE;
+            m_meterModel.SetStalePolicy(policy);
+            for (auto& model : m_phaseMeterModels)
+            {
+                model.SetStalePolicy(policy);
+            }
+        }
+        const std::string& telemetryTarget = id(telemetry_target).state;
+        if (telemetryTarget != m_telemetryTarget)
+        {
+            m_telemetryTarget = telemetryTarget;
+            m_telemetry.SetTarget(telemetryTarget);
+        }
+        const bool captureEnabled = id(meter_capture).state;
+        if (captureEnabled != m_captureEnabled)
+        {
+            m_captureEnabled = captureEnabled;
+            // The memory is kept when disabled, the capture can still be downloaded
+            const bool capture = captureEnabled && m_capture.Allocate();
+            m_dlmsMeter.SetCapture(capture ? &m_capture : nullptr);
+        }
+    }
+
+    void UpdateStaleState()
+    {
+        // Cleared with the next frame
+        if (!m_meterDataStale && m_meterModel.IsStale(m_clock->Millis()))
+        {
+            m_meterDataStale = true;
+            id(meter_data_stale).publish_state(true);
+            ESP_LOGW("sm", "Meter data is stale, Modbus policy applied");
+        }
+    }
 
-        const float activeEnergyPerPhase = data.activeEnergyPlus / 3.0f;
-        m_meterModel.SetTotalWattHoursImported(data.activeEnergyPlus, activeEnergyPerPhase, activeEnergyPerPhase,
-                                               activeEnergyPerPhase);
+    void UpdateEstimatedPower()
+    {
+        // Serve extrapolated power and current between the meter frames, if enabled
+        const bool enabled = id(power_estimation).state;
+        if (enabled != m_powerEstimator.IsEnabled())
+        {
+            m_powerEstimator.SetEnabled(enabled);
+            // Note: disabling restores the measured values with the next frame
+        }
+        const uint32_t now = m_clock->Millis();
+        if (!enabled || now - m_lastPowerEstimateMs < POWER_ESTIMATE_INTERVAL_MS)
+        {
+            return;
+        }
+        m_lastPowerEstimateMs = now;
 
-        const float reactiveEnergyPerPhase = data.reactiveEnergyPlus / 3.0f;
-        m_meterModel.SetTotalVaHoursImported(data.reactiveEnergyPlus, reactiveEnergyPerPhase, reactiveEnergyPerPhase,
-                                             reactiveEnergyPerPhase);
+        // Scale the measured phase values, the direction of power flow is not changed by an estimate
+        // Note: the estimate is an output value like the Sunspec registers, so it is float
+        const int32_t measured = m_lastDerived.power.total;
+        if (measured == 0)
+        {
+            return;
+        }
+        const float ratio = std::max(m_powerEstimator.Estimate(now) / measured, 0.0f);
+        const auto& power = m_lastDerived.power;
+        m_meterModel.SetPower(power.total * ratio, power.phase1 * ratio, power.phase2 * ratio, power.phase3 * ratio);
+        const auto& current = m_lastDerived.current;
+        const float currentRatio = ratio / 100.0f; // 0.01A to A
+        m_meterModel.SetAcCurrent(current.total * currentRatio, current.phase1 * currentRatio,
+                                  current.phase2 * currentRatio, current.phase3 * currentRatio);
+        for (size_t i = 0; i < PHASE_COUNT; i++)
+        {
+            SetPhaseMeterPower(m_phaseMeterModels[i], GetPhaseValue(power, i) * ratio,
+                               GetPhaseValue(current, i) * currentRatio);
+        }
+    }
 
-        data.GetPower(total, value1, value2, value3);
-        m_meterModel.SetPower(total, value1, value2, value3);
+    static void PublishOnChange(text_sensor::TextSensor& sensor, const char* text)
+    {
+        if (!sensor.has_state() || sensor.state != text)
+        {
+            sensor.publish_state(text);
+        }
+    }
 
-        data.GetApparentPower(total, value1, value2, value3);
-        m_meterModel.SetApparentPower(total, value1, value2, value3);
-        id(apparent_power).publish_state(total);
+    void UpdateMeterModel(const espdm::DlmsMeter::MeterData& data)
+    {
+        SetMeterData(m_meterModel, data);
+        for (size_t i = 0; i < PHASE_COUNT; i++)
+        {
+            SetPhaseMeterData(m_phaseMeterModels[i], data, i);
+        }
+        m_hasMeterData = true;
+    }
 
-        data.GetReactivePower(total, value1, value2, value3);
-        m_meterModel.SetReactivePower(total, value1, value2, value3);
+    void SetMeterModelUpdateTime(uint32_t now)
+    {
+        m_meterModel.SetUpdateTime(now);
+        for (auto& model : m_phaseMeterModels)
+        {
+            model.SetUpdateTime(now);
+        }
+    }
 
-        SetEnergyFlow();
-        SetUptime();
-        ESP_LOGD("sm", "MeterModel data updated");
+    void AllocateRamBuffers()
+    {
+        // Before the web server and the api take their memory, the rest is left for the capture ( see Allocate() )
+        RamBudget budget(GetFreeHeap(), RAM_RESERVE);
+        m_history.Allocate(budget.Take(HISTORY_MIN_SIZE, HISTORY_MAX_SIZE, HISTORY_BUDGET_PERCENT)
+                           / MeterHistory::BLOCK_SIZE);
+        m_frameDump.Allocate(budget.Take(FRAME_DUMP_MIN_SIZE, FRAME_DUMP_MAX_SIZE, FRAME_DUMP_BUDGET_PERCENT));
     }
 
-    ModbusServer::ResponseRead OnModbusReceiveRequest(uint8_t functionCode, const ModbusServer::RequestRead& request)
+    void RestoreMeterData()
     {
-        ModbusServer::ResponseRead response;
-        if (functionCode != 0x03)
+        // Serve the last energy counters until the first frame is decoded ( 5-10s after boot ), power and current are 0
+        m_persistedMeterData
+            = global_preferences->make_preference<PersistedMeterData>(fnv1_hash(PERSISTED_METER_DATA_KEY), true);
+        PersistedMeterData persisted;
+        if (!m_persistedMeterData.load(&persisted) || persisted.activeEnergyPlus == 0)
         {
-            response.SetError(ModbusServer::ResponseRead::ErrorCode::ILLEGAL_FUNCTION);
-            ESP_LOGW("sm", "Modbus received wrong functionCode %d", functionCode);
+            ESP_LOGI("sm", "No persisted meter data");
+            return;
         }
-        else
+        UpdateMeterModel(persisted.ToMeterData());
+        SetMeterModelUpdateTime(m_clock->Millis()); // served until the max. age, if no frame is received
+        m_meterDataStale = true;
+        id(meter_data_stale).publish_state(true);
+        ESP_LOGI("sm", "Persisted energy counters restored, marked as stale");
+    }
+
+    void PersistMeterData(const espdm::DlmsMeter::MeterData& data, uint32_t now)
+    {
+        // Note: save() only updates the pending data in RAM, sync() writes to flash ( also done at shutdown/OTA )
+        if (m_persistSaveThrottle.ShouldPersist(PERSIST_SAVE_POLICY, data.activeEnergyPlus, data.activeEnergyMinus,
+                                                now))
         {
-            ESP_LOGD("sm", "Modbus request received: address = %d, count = %d", request.startAddress,
-                     request.addressCount);
-            if (m_meterModel.IsValidAddressRange(request.startAddress, request.addressCount) == false)
+            const PersistedMeterData persisted = PersistedMeterData::FromMeterData(data);
+            m_persistedMeterData.save(&persisted);
+            if (m_persistSyncThrottle.ShouldPersist(PERSIST_SYNC_POLICY, data.activeEnergyPlus,
+                                                    data.activeEnergyMinus, now))
             {
-                response.SetError(ModbusServer::ResponseRead::ErrorCode::ILLEGAL_ADDRESS);
-            }
-            else
-            {
-                response.SetData(m_meterModel.GetRegisterRaw(request.startAddress, request.addressCount));
+                global_preferences->sync();
             }
         }
-        SetStatusLed(true, response.IsError());
-
-        return response;
     }
 
-private:
-    ModbusServer m_modbusServer;
-    espdm::DlmsMeter m_dlmsMeter;
-    MeterModel m_meterModel;
-    ESPTime m_uptimeStart;
-    uint32_t m_statusLedBlinkCount{0};
-
     void SetStatusLed(bool on, bool error = false)
     {
         if (!on)
         {
-            if (m_statusLedBlinkCount > 0 && ++m_statusLedBlinkCount > BLINK_OFF_COUNT)
+            if (m_statusBlink.Expired(*m_clock))
             {
                 id(status_led).turn_off().perform();
-                m_statusLedBlinkCount = 0;
             }
             return;
         }
@@ -189,93 +572,143 @@ private:
             call.set_blue(0.0);
         }
         call.perform();
-        m_statusLedBlinkCount = 1;
+        m_statusBlink.Start(*m_clock);
     }
 
-    void SetEnergyFlow()
+    void SetEnergyFlow(const espdm::DlmsMeter::MeterData& data, uint32_t now, bool publishDuration)
     {
+        const int64_t plusWh = data.activeEnergyPlus;
+        const int64_t minusWh = data.activeEnergyMinus;
+        UpdateEnergyIntervalSettings();
+        if (m_energyInterval.IsValid())
+        {
+            if (m_energyInterval.Update(plusWh, minusWh))
+            {
+                id(energy_interval_plus).publish_state(m_energyInterval.GetPlusText());
+                id(energy_interval_minus).publish_state(m_energyInterval.GetMinusText());
+                id(energy_interval_sum).publish_state(m_energyInterval.GetSumText());
+            }
+            if (publishDuration && data.timestamp.IsValid())
+            {
+                char duration[TIMESPAN_TEXT_SIZE];
+                FormatTimespan(duration, sizeof(duration), m_energyInterval.GetDurationSeconds(data.timestamp));
+                id(energy_interval_duration).publish_state(duration);
+            }
+        }
+
+        if (m_calendarEnergy.Update(data.timestamp, plusWh, minusWh))
+        {
+            // once per day
+            m_persistedCalendarEnergy.save(&m_calendarEnergy.GetState());
+            global_preferences->sync();
+        }
+        using Period = CalendarEnergy::Period;
+        PublishCalendarEnergy(Period::Day, id(energy_day_plus), id(energy_day_minus), now);
+        PublishCalendarEnergy(Period::Month, id(energy_month_plus), id(energy_month_minus), now);
+        PublishCalendarEnergy(Period::Year, id(energy_year_plus), id(energy_year_minus), now);
+    }
+
+    void UpdateEnergyIntervalSettings()
+    {
+        // The begin is only recalculated if a setting was changed
+        const EnergyIntervalSettings settings
+            = {id(energy_year_begin).state, id(energy_month_begin).state, id(energy_day_begin).state,
+               id(energy_plus_begin).state, id(energy_minus_begin).state};
+        if (std::memcmp(&settings, &m_energyIntervalSettings, sizeof(settings)) == 0)
+        {
+            return;
+        }
+        m_energyIntervalSettings = settings;
+
         const float preventCastError = 0.5f;
-        ESPTime begin;
-        std::memset(&begin, 0, sizeof(begin));
-        begin.day_of_month = static_cast<uint32_t>(id(energy_day_begin).state + preventCastError);
-        begin.month = static_cast<uint32_t>(id(energy_month_begin).state + preventCastError);
-        begin.year = static_cast<uint32_t>(id(energy_year_begin).state + preventCastError);
-        auto now = id(sntp_time).now();
-        if (begin.year != 1970U && now.is_valid())
-        {
-            // make fields_in_range() happy, otherwise recalc_timestamp_utc() fails
-            const uint8_t doesNotMatter = 1;
-            begin.day_of_week = doesNotMatter;
-            begin.day_of_year = doesNotMatter;
-            begin.recalc_timestamp_utc(false);
-            now.recalc_timestamp_utc(false);
-            id(energy_interval_duration).publish_state(GetTimespanString(now.timestamp - begin.timestamp));
-
-            // Plus
-            char temp[64] = {0};
-            const auto plus = id(active_energy_plus).state - id(energy_plus_begin).state;
-            sprintf(temp, "%.3fkWh", plus);
-            id(energy_interval_plus).publish_state(temp);
-
-            // Minus
-            const auto minus = id(active_energy_minus).state - id(energy_minus_begin).state;
-            sprintf(temp, "%.3fkWh", minus);
-            id(energy_interval_minus).publish_state(temp);
-
-            // Sum
-            sprintf(temp, "%.3fkWh", plus - minus);
-            id(energy_interval_sum).publish_state(temp);
+        espdm::MeterTimestamp begin; // midnight, local time like the timestamps of the meter
+        if (!std::isnan(settings.year)) // not restored yet
+        {
+            begin.day = static_cast<uint8_t>(settings.day + preventCastError);
+            begin.month = static_cast<uint8_t>(settings.month + preventCastError);
+            begin.year = static_cast<uint16_t>(settings.year + preventCastError);
         }
-        else
+        if (begin.year == 0U || begin.year == 1970U)
         {
+            m_energyInterval.Invalidate();
             const char invalid[] = {"--"};
-            id(energy_interval_duration).publish_state(invalid);
-            id(energy_interval_plus).publish_state(invalid);
-            id(energy_interval_minus).publish_state(invalid);
-            id(energy_interval_sum).publish_state(invalid);
+            PublishOnChange(id(energy_interval_duration), invalid);
+            PublishOnChange(id(energy_interval_plus), invalid);
+            PublishOnChange(id(energy_interval_minus), invalid);
+            PublishOnChange(id(energy_interval_sum), invalid);
+            return;
         }
+        m_energyInterval.SetBeginDate(begin);
+        m_energyInterval.SetBegin(llroundf(settings.plusKWh * 1000.0f), llroundf(settings.minusKWh * 1000.0f));
     }
 
-    std::string GetTimespanString(long int timespan)
+    void PublishCalendarEnergy(CalendarEnergy::Period period, sensor::Sensor& plusSensor,
+                               sensor::Sensor& minusSensor, uint32_t now)
     {
-        const int secPerMinute = 60;
-        const int secPerHour = secPerMinute * 60;
-        const int secPerDay = secPerHour * 24;
-        const int days = timespan / secPerDay;
-        timespan -= days * secPerDay;
-        const int hours = timespan / secPerHour;
-        timespan -= hours * secPerHour;
-        const int minutes = timespan / secPerMinute;
-        timespan -= minutes * secPerMinute;
-        char temp[64] = {0};
-        sprintf(temp, "%dd %02d:%02d:%02d", days, hours, minutes, timespan);
-
-        return temp;
+        const EnergyInterval& interval = m_calendarEnergy.Get(period);
+        if (!interval.IsValid())
+        {
+            return;
+        }
+        const float plus = interval.GetPlus() * 0.001f;
+        if (m_calendarEnergyThrottles[period][0].ShouldPublish(CALENDAR_ENERGY_POLICY, plus, now))
+        {
+            plusSensor.publish_state(plus);
+        }
+        const float minus = interval.GetMinus() * 0.001f;
+        if (m_calendarEnergyThrottles[period][1].ShouldPublish(CALENDAR_ENERGY_POLICY, minus, now))
+        {
+            minusSensor.publish_state(minus);
+        }
     }
 
-    void SetUptime()
+    void RestoreCalendarEnergy()
     {
-        auto utcnow = id(sntp_time).utcnow();
-        if (utcnow.is_valid())
+        m_persistedCalendarEnergy = global_preferences->make_preference<CalendarEnergy::State>(
+            fnv1_hash(PERSISTED_CALENDAR_ENERGY_KEY), true);
+        CalendarEnergy::State state;
+        if (m_persistedCalendarEnergy.load(&state))
         {
-            utcnow.recalc_timestamp_utc(false);
-            if (m_uptimeStart.timestamp != 0)
-            {
-                const long int elapsedTime = utcnow.timestamp - m_uptimeStart.timestamp;
-                if (elapsedTime < 0)
-                {
-                    // Sometimes seen strange values...
-                    ESP_LOGI("sm", "elapsedTime is negative : %d", elapsedTime);
-                }
-                else
-                {
-                    id(device_uptime).publish_state(GetTimespanString(elapsedTime));
-                    return;
-                }
-            }
-            m_uptimeStart = utcnow;
+            m_calendarEnergy.Restore(state);
         }
-        id(device_uptime).publish_state("-");
+    }
+
+    void SetUptime()
+    {
+        // Note: of the injected clock, independent of the sntp time
+        char uptime[TIMESPAN_TEXT_SIZE];
+        FormatTimespan(uptime, sizeof(uptime), static_cast<int64_t>(m_uptime.Update(*m_clock) / 1000));
+        id(device_uptime).publish_state(uptime);
+    }
+
+    void SetTimingStats()
+    {
+        // Max. duration of one step per stage in the last minute
+        using Stage = espdm::DlmsMeter::Stage;
+        char temp[96] = {0};
+        sprintf(temp, "rx %u, frame %u, decrypt %u, decode %u, publish %u, notify %uus",
+                m_dlmsMeter.GetStageTiming(Stage::RECEIVE).maxUs, m_dlmsMeter.GetStageTiming(Stage::FRAME).maxUs,
+                m_dlmsMeter.GetStageTiming(Stage::DECRYPT).maxUs, m_dlmsMeter.GetStageTiming(Stage::DECODE).maxUs,
+                m_dlmsMeter.GetStageTiming(Stage::PUBLISH).maxUs, m_dlmsMeter.GetStageTiming(Stage::NOTIFY).maxUs);
+        id(dlms_stage_timing).publish_state(temp);
+        m_dlmsMeter.ResetStageTimings();
+
+        id(modbus_response_delay).publish_state(m_modbusServer.GetMaxResponseDelayUs() / 1000.0f);
+        m_modbusServer.ResetStatistics();
+    }
+
+    void SetHeapStats()
+    {
+#if defined(ESP32)
+        // Watch for fragmentation: largest free block shrinks while free heap stays
+        multi_heap_info_t info;
+        heap_caps_get_info(&info, MALLOC_CAP_8BIT);
+        id(heap_allocated_blocks).publish_state(info.allocated_blocks);
+        id(heap_allocated_bytes).publish_state(info.total_allocated_bytes);
+        id(heap_free_bytes).publish_state(info.total_free_bytes);
+        id(heap_min_free_bytes).publish_state(info.minimum_free_bytes); // high-water mark of heap usage
+        id(heap_largest_free_block).publish_state(info.largest_free_block);
+#endif
     }
 };
 
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
+#include <initializer_list>
 #include <stdint.h>
 #include <vector>
 
@@ -9,7 +11,7 @@
 namespace sunspec
 {
 // Infos from "Fronius Datamanager Register Map: Floating Point Meter Model (211, 212, 213)"
-// Note: Here only 213 is supported : 3-phase float model
+// Note: Here only 211 : 1-phase float model and 213 : 3-phase float model are supported, same register layout
 // The smallest data element ( called register ) is uint16 ( e.g. a float32 requires 2 registers)
 // Values are converted from little to big endian
 
@@ -19,6 +21,24 @@ constexpr auto REGISTER_METER_COUNT = 2 + 124;
 constexpr auto REGISTER_END_COUNT = 2;
 constexpr auto REGISTER_TOTAL_COUNT = REGISTER_COMMON_COUNT + REGISTER_METER_COUNT + REGISTER_END_COUNT;
 
+constexpr uint16_t MODEL_SINGLE_PHASE = 211;
+constexpr uint16_t MODEL_THREE_PHASE = 213;
+
+// What is served if the data of a MeterModel is too old, e.g. the meter line is broken
+enum class StaleAction : uint8_t
+{
+    SERVE, // serve the last values
+    DEVICE_FAILURE, // modbus exception 0x04
+    DEVICE_BUSY, // modbus exception 0x06
+    ZERO_POWER // serve with current and power set to 0
+};
+
+struct StalePolicy
+{
+    uint32_t maxAgeMs{0}; // 0: never stale
+    StaleAction action{StaleAction::SERVE};
+};
+
 template <typename T>
 T Convert2BigEndian(T n)
 {
@@ -33,7 +53,8 @@ T Convert2BigEndian(T n)
 class MeterModel
 {
 public:
-    MeterModel(uint8_t modbusAddress)
+    // model: MODEL_SINGLE_PHASE uses total and phase A only, see SetPhaseMeterData()
+    MeterModel(uint8_t modbusAddress, uint16_t model = MODEL_THREE_PHASE)
     {
         // Init static data
         std::memset(m_registers, 0, sizeof(m_registers));
@@ -57,7 +78,7 @@ public:
         SetRegisterUint16(68, modbusAddress);
 
         // Meter block
-        SetRegisterUint16(69, 213); // float, 3-phase meter.
+        SetRegisterUint16(69, model); // float meter
         SetRegisterUint16(70, REGISTER_METER_COUNT - 2); // Number of registers in this block following this entry
 
         // End block
@@ -115,7 +136,32 @@ public:
     }
     // Rest is not needed
 
-    std::vector<uint16_t> GetRegister(uint32_t registerAddress, uint8_t registerCount)
+    // Time of the last update of the measured values ( millis() ), the age is checked with each request
+    void SetUpdateTime(uint32_t nowMs)
+    {
+        m_updateTimeMs = nowMs;
+        m_updated = true;
+    }
+    void SetStalePolicy(const StalePolicy& policy)
+    {
+        m_stalePolicy = policy;
+    }
+    const StalePolicy& GetStalePolicy() const
+    {
+        return m_stalePolicy;
+    }
+    bool IsStale(uint32_t nowMs) const
+    {
+        // Note: unsigned difference, works across the millis() overflow
+        return m_stalePolicy.maxAgeMs != 0 && (!m_updated || nowMs - m_updateTimeMs > m_stalePolicy.maxAgeMs);
+    }
+    // How to answer a request at nowMs
+    StaleAction GetStaleAction(uint32_t nowMs) const
+    {
+        return IsStale(nowMs) ? m_stalePolicy.action : StaleAction::SERVE;
+    }
+
+    std::vector<uint16_t> GetRegister(uint32_t registerAddress, uint8_t registerCount) const
     {
         const int32_t registerIndex = GetRegisterIndexForRange(registerAddress, registerCount);
         if (registerIndex < 0)
@@ -128,7 +174,8 @@ public:
         return reg;
     }
 
-    std::vector<uint8_t> GetRegisterRaw(uint32_t registerAddress, uint8_t registerCount)
+    // zeroPower: current and power registers are returned as 0, see StaleAction::ZERO_POWER
+    std::vector<uint8_t> GetRegisterRaw(uint32_t registerAddress, uint8_t registerCount, bool zeroPower = false) const
     {
         const int32_t registerIndex = GetRegisterIndexForRange(registerAddress, registerCount);
         if (registerIndex < 0)
@@ -137,17 +184,56 @@ public:
         }
         std::vector<uint8_t> raw(registerCount * sizeof(m_registers[0]));
         std::memcpy(&raw[0], &m_registers[registerIndex], raw.size());
+        if (zeroPower)
+        {
+            // float 0.0 is 0 in all bytes
+            ZeroRegisters(raw, registerIndex, REGISTER_CURRENT, REGISTER_CURRENT_COUNT);
+            ZeroRegisters(raw, registerIndex, REGISTER_POWER, REGISTER_POWER_COUNT);
+        }
 
         return raw;
     }
 
-    bool IsValidAddressRange(uint32_t registerAddress, uint8_t registerCount)
+    bool IsValidAddressRange(uint32_t registerAddress, uint8_t registerCount) const
     {
         return GetRegisterIndexForRange(registerAddress, registerCount) >= 0;
     }
 
+    // Returns true if the range overlaps the measured values, false for the common block, the model header and the
+    // end block. These are static, an inverter discovers the meter with them, so the stale policy is not applied.
+    bool HasMeasuredValues(uint32_t registerAddress, uint8_t registerCount) const
+    {
+        const int32_t registerIndex = GetRegisterIndexForRange(registerAddress, registerCount);
+        return registerIndex >= 0 && registerIndex < REGISTER_VALUES_END
+               && registerIndex + registerCount > REGISTER_VALUES_BEGIN;
+    }
+
 private:
-    int32_t GetRegisterIndexForRange(uint32_t registerAddress, uint8_t registerCount)
+    static constexpr int32_t REGISTER_VALUES_BEGIN = REGISTER_COMMON_COUNT + 2; // after the model header
+    static constexpr int32_t REGISTER_VALUES_END = REGISTER_COMMON_COUNT + REGISTER_METER_COUNT;
+    static constexpr int32_t REGISTER_CURRENT = 71; // total and phases
+    static constexpr int32_t REGISTER_CURRENT_COUNT = 8;
+    static constexpr int32_t REGISTER_POWER = 97; // power, apparent power and reactive power
+    static constexpr int32_t REGISTER_POWER_COUNT = 24;
+
+    uint16_t m_registers[REGISTER_TOTAL_COUNT];
+    uint32_t m_updateTimeMs{0};
+    bool m_updated{false};
+    StalePolicy m_stalePolicy;
+
+    static void ZeroRegisters(std::vector<uint8_t>& raw, int32_t rawIndex, int32_t registerIndex, int32_t count)
+    {
+        // Overlap of the requested and the zeroed registers
+        const int32_t rawCount = static_cast<int32_t>(raw.size() / sizeof(uint16_t));
+        const int32_t first = std::max(rawIndex, registerIndex);
+        const int32_t last = std::min(rawIndex + rawCount, registerIndex + count);
+        if (first < last)
+        {
+            std::memset(&raw[(first - rawIndex) * sizeof(uint16_t)], 0, (last - first) * sizeof(uint16_t));
+        }
+    }
+
+    int32_t GetRegisterIndexForRange(uint32_t registerAddress, uint8_t registerCount) const
     {
         // registerAddress is already REGISTER_OFFSET-based! (e.g. sunspec-address: 40001 is
         // registerAddress: 40000)
@@ -160,11 +246,13 @@ private:
         return registerIndex;
     }
 
-    void SetFloats(uint32_t registerIndex, const std::vector<float>& values)
+    void SetFloats(uint32_t registerIndex, std::initializer_list<float> values)
     {
-        for (size_t i = 0; i < values.size(); i++)
+        // Note: initializer_list does not allocate on heap
+        for (const float value : values)
         {
-            SetRegisterFloat(registerIndex + (i * 2), values[i]);
+            SetRegisterFloat(registerIndex, value);
+            registerIndex += 2;
         }
     }
     void SetRegisterUint16(uint32_t registerIndex, uint16_t value)
@@ -185,8 +273,6 @@ private:
         T temp = Convert2BigEndian(value);
         std::memcpy(m_registers + registerIndex, &temp, sizeof(temp));
     }
-
-    uint16_t m_registers[REGISTER_TOTAL_COUNT];
 };
 
 } // namespace sunspec
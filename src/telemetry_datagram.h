@@ -0,0 +1,139 @@
+#pragma once
+
+#ifndef ESPDM_HOST
+    #include "esphome/core/helpers.h"
+#else
+    #include "esphome_host.h"
+#endif
+#include "./esphome-dlms-meter/espdm_meter_data.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Fixed layout binary datagram of one MeterData frame, all values little endian
+//   Offset Size
+//   0      2    magic "SM"
+//   2      1    version
+//   3      1    reserved
+//   4      4    device id
+//   8      4    sequence number, +1 per frame
+//   12     8    meter timestamp: year(2), month, day, hour, minute, second, reserved
+//   20     48   12 int32 in the order and fixed-point units of MeterData ( e.g. voltage in 0.1V, energy in Wh )
+//   68     2    crc16 ( modbus ) of bytes 0-67
+struct TelemetryDatagram
+{
+    static constexpr size_t SIZE = 70;
+    static constexpr uint8_t VERSION = 2; // 2: fixed-point values instead of float32
+
+    uint32_t deviceId{0};
+    uint32_t sequence{0};
+    espdm::MeterData data; // only the measured values and the timestamp, not derived
+
+    // buffer: at least SIZE bytes, no allocation
+    void Encode(uint8_t* buffer) const
+    {
+        buffer[0] = 'S';
+        buffer[1] = 'M';
+        buffer[2] = VERSION;
+        buffer[3] = 0;
+        WriteUint32(&buffer[4], deviceId);
+        WriteUint32(&buffer[8], sequence);
+        const espdm::MeterTimestamp& timestamp = data.timestamp;
+        WriteUint16(&buffer[12], timestamp.year);
+        buffer[14] = timestamp.month;
+        buffer[15] = timestamp.day;
+        buffer[16] = timestamp.hour;
+        buffer[17] = timestamp.minute;
+        buffer[18] = timestamp.second;
+        buffer[19] = 0;
+        const uint32_t values[VALUE_COUNT] = {data.voltageL1,
+                                              data.voltageL2,
+                                              data.voltageL3,
+                                              static_cast<uint32_t>(data.currentL1),
+                                              static_cast<uint32_t>(data.currentL2),
+                                              static_cast<uint32_t>(data.currentL3),
+                                              data.activePowerPlus,
+                                              data.activePowerMinus,
+                                              data.activeEnergyPlus,
+                                              data.activeEnergyMinus,
+                                              data.reactiveEnergyPlus,
+                                              data.reactiveEnergyMinus};
+        for (size_t i = 0; i < VALUE_COUNT; i++)
+        {
+            WriteUint32(&buffer[VALUES_OFFSET + i * sizeof(uint32_t)], values[i]);
+        }
+        WriteUint16(&buffer[CRC_OFFSET], crc16(buffer, CRC_OFFSET));
+    }
+
+    // Returns false if the datagram is invalid ( size, magic, version or crc )
+    bool Decode(const uint8_t* buffer, size_t length)
+    {
+        if (length != SIZE || buffer[0] != 'S' || buffer[1] != 'M' || buffer[2] != VERSION
+            || ReadUint16(&buffer[CRC_OFFSET]) != crc16(buffer, CRC_OFFSET))
+        {
+            return false;
+        }
+        deviceId = ReadUint32(&buffer[4]);
+        sequence = ReadUint32(&buffer[8]);
+        espdm::MeterTimestamp& timestamp = data.timestamp;
+        timestamp.year = ReadUint16(&buffer[12]);
+        timestamp.month = buffer[14];
+        timestamp.day = buffer[15];
+        timestamp.hour = buffer[16];
+        timestamp.minute = buffer[17];
+        timestamp.second = buffer[18];
+        uint32_t values[VALUE_COUNT];
+        for (size_t i = 0; i < VALUE_COUNT; i++)
+        {
+            values[i] = ReadUint32(&buffer[VALUES_OFFSET + i * sizeof(uint32_t)]);
+        }
+        data.voltageL1 = static_cast<uint16_t>(values[0]);
+        data.voltageL2 = static_cast<uint16_t>(values[1]);
+        data.voltageL3 = static_cast<uint16_t>(values[2]);
+        data.currentL1 = static_cast<int32_t>(values[3]);
+        data.currentL2 = static_cast<int32_t>(values[4]);
+        data.currentL3 = static_cast<int32_t>(values[5]);
+        data.activePowerPlus = values[6];
+        data.activePowerMinus = values[7];
+        data.activeEnergyPlus = values[8];
+        data.activeEnergyMinus = values[9];
+        data.reactiveEnergyPlus = values[10];
+        data.reactiveEnergyMinus = values[11];
+        return true;
+    }
+
+private:
+    static constexpr size_t VALUES_OFFSET = 20;
+    static constexpr size_t CRC_OFFSET = 68;
+    static constexpr size_t VALUE_COUNT = 12;
+
+    static void WriteUint16(uint8_t* buffer, uint16_t value)
+    {
+        buffer[0] = value & 0xFF;
+        buffer[1] = value >> 8;
+    }
+    static void WriteUint32(uint8_t* buffer, uint32_t value)
+    {
+        for (size_t i = 0; i < 4; i++)
+        {
+            buffer[i] = (value >> (8 * i)) & 0xFF;
+        }
+    }
+    static uint16_t ReadUint16(const uint8_t* buffer)
+    {
+        return buffer[0] | (static_cast<uint16_t>(buffer[1]) << 8);
+    }
+    static uint32_t ReadUint32(const uint8_t* buffer)
+    {
+        return buffer[0] | (static_cast<uint32_t>(buffer[1]) << 8) | (static_cast<uint32_t>(buffer[2]) << 16)
+               | (static_cast<uint32_t>(buffer[3]) << 24);
+    }
+};
+
+} // namespace sm
+} // namespace esphome
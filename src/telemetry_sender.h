@@ -0,0 +1,101 @@
+#pragma once
+
+#include "esphome.h"
+#include "telemetry_datagram.h"
+#if defined(ESP32)
+    #include "lwip/sockets.h"
+#endif
+
+#include <string>
+
+namespace esphome
+{
+namespace sm
+{
+
+// Sends each MeterData frame as TelemetryDatagram via UDP to a collector, see test/telemetry_receiver
+// The socket and the buffer are created once, sending a frame does not allocate ( except lwip internal ).
+class TelemetrySender
+{
+public:
+    ~TelemetrySender()
+    {
+        Close();
+    }
+
+    // target: "<ipv4>:<port>", an empty or invalid target stops sending
+    bool SetTarget(const std::string& target)
+    {
+        Close();
+#if defined(ESP32)
+        const size_t colon = target.find(':');
+        if (colon == std::string::npos)
+        {
+            return false;
+        }
+        const std::string host = target.substr(0, colon);
+        const int port = atoi(target.c_str() + colon + 1);
+        std::memset(&m_address, 0, sizeof(m_address));
+        m_address.sin_family = AF_INET;
+        m_address.sin_port = htons(static_cast<uint16_t>(port));
+        if (port <= 0 || port > 0xFFFF || inet_pton(AF_INET, host.c_str(), &m_address.sin_addr) != 1)
+        {
+            ESP_LOGW("sm", "Invalid telemetry target '%s'", target.c_str());
+            return false;
+        }
+        m_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (m_socket < 0)
+        {
+            ESP_LOGW("sm", "Telemetry socket failed");
+            return false;
+        }
+        // The device id is taken from the mac address
+        uint8_t mac[6];
+        get_mac_address_raw(mac);
+        m_datagram.deviceId = (static_cast<uint32_t>(mac[2]) << 24) | (static_cast<uint32_t>(mac[3]) << 16)
+                              | (static_cast<uint32_t>(mac[4]) << 8) | mac[5];
+        ESP_LOGI("sm", "Telemetry to %s, device id %08X", target.c_str(), m_datagram.deviceId);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void Send(const espdm::MeterData& data)
+    {
+        if (m_socket < 0)
+        {
+            return;
+        }
+        m_datagram.sequence++;
+        m_datagram.data = data;
+        m_datagram.Encode(m_buffer);
+#if defined(ESP32)
+        // Non blocking, a datagram is dropped if the network stack is busy
+        sendto(m_socket, m_buffer, sizeof(m_buffer), MSG_DONTWAIT, reinterpret_cast<sockaddr*>(&m_address),
+               sizeof(m_address));
+#endif
+    }
+
+private:
+    int m_socket{-1};
+#if defined(ESP32)
+    sockaddr_in m_address;
+#endif
+    TelemetryDatagram m_datagram;
+    uint8_t m_buffer[TelemetryDatagram::SIZE];
+
+    void Close()
+    {
+#if defined(ESP32)
+        if (m_socket >= 0)
+        {
+            close(m_socket);
+        }
+#endif
+        m_socket = -1;
+    }
+};
+
+} // namespace sm
+} // namespace esphome
@@ -0,0 +1,143 @@
+#include "alloc_tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+// Each block is prefixed with its size, to know the freed bytes also for unsized delete
+constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+std::atomic<size_t> s_allocations{0};
+std::atomic<size_t> s_deallocations{0};
+std::atomic<size_t> s_allocatedBytes{0};
+std::atomic<size_t> s_liveBytes{0};
+std::atomic<size_t> s_peakLiveBytes{0};
+
+void* Allocate(size_t size)
+{
+    auto block = static_cast<char*>(std::malloc(size + HEADER_SIZE));
+    if (block == nullptr)
+    {
+        return nullptr;
+    }
+    *reinterpret_cast<size_t*>(block) = size;
+
+    s_allocations++;
+    s_allocatedBytes += size;
+    const size_t live = s_liveBytes += size;
+    size_t peak = s_peakLiveBytes;
+    while (live > peak && !s_peakLiveBytes.compare_exchange_weak(peak, live))
+    {
+    }
+
+    return block + HEADER_SIZE;
+}
+
+void Deallocate(void* ptr)
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+    auto block = static_cast<char*>(ptr) - HEADER_SIZE;
+    s_deallocations++;
+    s_liveBytes -= *reinterpret_cast<size_t*>(block);
+    std::free(block);
+}
+
+void* AllocateOrThrow(size_t size)
+{
+    void* ptr = Allocate(size);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    return AllocateOrThrow(size);
+}
+void* operator new[](size_t size)
+{
+    return AllocateOrThrow(size);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+void operator delete(void* ptr) noexcept
+{
+    Deallocate(ptr);
+}
+void operator delete[](void* ptr) noexcept
+{
+    Deallocate(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept
+{
+    Deallocate(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept
+{
+    Deallocate(ptr);
+}
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    Deallocate(ptr);
+}
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    Deallocate(ptr);
+}
+
+namespace alloc_tracker
+{
+
+Counters GetCounters()
+{
+    Counters counters;
+    counters.allocations = s_allocations;
+    counters.deallocations = s_deallocations;
+    counters.allocatedBytes = s_allocatedBytes;
+    counters.liveBytes = s_liveBytes;
+    counters.peakLiveBytes = s_peakLiveBytes;
+    return counters;
+}
+
+Scope::Scope()
+{
+    s_peakLiveBytes = s_liveBytes.load();
+    m_begin = GetCounters();
+}
+
+size_t Scope::GetAllocations() const
+{
+    return s_allocations - m_begin.allocations;
+}
+
+size_t Scope::GetDeallocations() const
+{
+    return s_deallocations - m_begin.deallocations;
+}
+
+size_t Scope::GetAllocatedBytes() const
+{
+    return s_allocatedBytes - m_begin.allocatedBytes;
+}
+
+size_t Scope::GetPeakBytes() const
+{
+    return s_peakLiveBytes - m_begin.liveBytes;
+}
+
+} // namespace alloc_tracker
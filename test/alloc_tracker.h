@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts the heap allocations of the test binary ( global operator new/delete are replaced in alloc_tracker.cpp )
+namespace alloc_tracker
+{
+
+struct Counters
+{
+    size_t allocations{0};
+    size_t deallocations{0};
+    size_t allocatedBytes{0};
+    size_t liveBytes{0};
+    size_t peakLiveBytes{0}; // high-water mark
+};
+
+Counters GetCounters();
+
+// Counts the allocations done during the lifetime of the scope
+// Note: scopes must not be nested, the peak is reset by each new scope
+class Scope
+{
+public:
+    Scope();
+
+    size_t GetAllocations() const;
+    size_t GetDeallocations() const;
+    size_t GetAllocatedBytes() const;
+    // Highest heap usage above the usage at scope begin
+    size_t GetPeakBytes() const;
+
+private:
+    Counters m_begin;
+};
+
+} // namespace alloc_tracker
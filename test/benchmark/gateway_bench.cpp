@@ -0,0 +1,82 @@
+#include <benchmark/benchmark.h>
+#define ESPDM_HOST
+#include "../esphome_mock.h"
+#include "../encrypted_frame_builder.h"
+#include "../../gateway/meter_pipeline.h"
+
+// Capacity of the Linux gateway: pipelines processed by one core ( without the system calls of the links )
+namespace
+{
+// The Kaifa MA309 sends a frame every 5s, the inverter reads the meter block about once per second
+constexpr int METER_FRAME_INTERVAL_S = 5;
+const std::vector<uint8_t> MODBUS_REQUEST = {0x01, 0x03, 0x9C, 0x86, 0x00, 0x7C, 0x00, 0x00};
+
+std::vector<uint8_t> GetModbusRequest()
+{
+    auto request = MODBUS_REQUEST;
+    const auto crc = esphome::crc16(request.data(), request.size() - 2);
+    request[6] = crc & 0xFF;
+    request[7] = crc >> 8;
+    return request;
+}
+
+std::vector<std::unique_ptr<gateway::MeterPipeline>> CreatePipelines(size_t count)
+{
+    std::vector<std::unique_ptr<gateway::MeterPipeline>> pipelines;
+    for (size_t i = 0; i < count; i++)
+    {
+        pipelines.emplace_back(new gateway::MeterPipeline(encrypted_frame_builder::KEY, 1));
+    }
+    return pipelines;
+}
+
+// One frame per iteration, the pipelines round robin ( cache behavior of many meters )
+void BM_Gateway_MeterFrame(benchmark::State& state)
+{
+    auto pipelines = CreatePipelines(state.range(0));
+    const auto frame = encrypted_frame_builder::BuildMbusFrames(1);
+    size_t next = 0;
+    for (auto _ : state)
+    {
+        pipelines[next]->AddMeterData(frame.data(), frame.size());
+        next = (next + 1) % pipelines.size();
+    }
+    state.SetBytesProcessed(state.iterations() * frame.size());
+}
+BENCHMARK(BM_Gateway_MeterFrame)->Arg(1)->Arg(100)->Arg(1000);
+
+// One second of traffic of all pipelines per iteration: a Modbus request and response each,
+// a meter frame every METER_FRAME_INTERVAL_S. meters_per_core = meters served per second of CPU time.
+void BM_Gateway_MeterSecond(benchmark::State& state)
+{
+    auto pipelines = CreatePipelines(state.range(0));
+    const auto frame = encrypted_frame_builder::BuildMbusFrames(1);
+    const auto request = GetModbusRequest();
+    std::vector<esphome::MockByteStream> modbus(pipelines.size());
+    for (size_t i = 0; i < pipelines.size(); i++)
+    {
+        pipelines[i]->SetModbusStream(modbus[i]);
+    }
+    size_t second = 0;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < pipelines.size(); i++)
+        {
+            auto& pipeline = *pipelines[i];
+            if ((i + second) % METER_FRAME_INTERVAL_S == 0)
+            {
+                pipeline.AddMeterData(frame.data(), frame.size());
+            }
+            modbus[i].AddRx(request);
+            pipeline.ProcessModbus();
+            benchmark::DoNotOptimize(modbus[i].m_tx.size());
+            modbus[i].m_tx.clear();
+        }
+        second++;
+    }
+    state.counters["meters_per_core"]
+        = benchmark::Counter(static_cast<double>(state.iterations() * pipelines.size()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Gateway_MeterSecond)->Arg(1)->Arg(100)->Arg(1000);
+
+} // namespace
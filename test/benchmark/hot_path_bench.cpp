@@ -0,0 +1,470 @@
+#include <benchmark/benchmark.h>
+#define ESPDM_HOST
+#include "../esphome_mock.h"
+#include "../dlms_frame_builder.h"
+#include "../history_sample_generator.h"
+#include "../ram_flash.h"
+#include "../telemetry_receiver/telemetry_collector.h"
+#include "../../src/load_profile.h"
+#include "../../src/meter_aggregator.h"
+#include "../../src/meter_history.h"
+#include "../../src/meter_model_bridge.h"
+#include "../../src/meter_snapshot.h"
+#include "../../src/modbus_server.h"
+#include "../../src/sunspec_meter_model.h"
+#include "../../src/esphome-dlms-meter/espdm_dlms_frame.h"
+#include "../../src/esphome-dlms-meter/espdm_hdlc.h"
+#include "../../src/esphome-dlms-meter/espdm_mbus.h"
+#include "../../src/esphome-dlms-meter/espdm_obis_decoder.h"
+
+#include <random>
+
+using namespace esphome;
+using namespace esphome::modbus;
+
+namespace
+{
+// Request as sent by the Fronius inverter: read 124 registers of the meter block
+const std::vector<uint8_t> MODBUS_REQUEST = {0x01, 0x03, 0x9C, 0x86, 0x00, 0x7C, 0x00, 0x00};
+
+std::vector<uint8_t> GetModbusRequest()
+{
+    auto request = MODBUS_REQUEST;
+    const auto crc = crc16(request.data(), request.size() - 2);
+    request[6] = crc & 0xFF;
+    request[7] = crc >> 8;
+    return request;
+}
+
+std::vector<uint8_t> GetNoise(size_t size)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::vector<uint8_t> noise(size);
+    for (auto& n : noise)
+    {
+        n = distribution(generator);
+    }
+    return noise;
+}
+
+void BM_Crc16(benchmark::State& state)
+{
+    const auto data = GetNoise(state.range(0));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(crc16(data.data(), data.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_Crc16)->Arg(6)->Arg(255);
+
+void ModbusProcessRequest(benchmark::State& state, const std::vector<uint8_t>& rx)
+{
+    sunspec::MeterModel meterModel(1);
+    ModbusServer server(1, [&meterModel](uint8_t, const ModbusServer::RequestRead& request) {
+        ModbusServer::ResponseRead response;
+        response.SetData(meterModel.GetRegisterRaw(request.startAddress, request.addressCount));
+        return response;
+    });
+    MockByteStream stream;
+    server.SetStream(stream);
+    for (auto _ : state)
+    {
+        stream.AddRx(rx);
+        server.ProcessRequest();
+        stream.m_tx.clear();
+    }
+    state.SetBytesProcessed(state.iterations() * rx.size());
+}
+
+void BM_ModbusParseFrame_Clean(benchmark::State& state)
+{
+    ModbusProcessRequest(state, GetModbusRequest());
+}
+BENCHMARK(BM_ModbusParseFrame_Clean);
+
+void BM_ModbusParseFrame_Noisy(benchmark::State& state)
+{
+    auto rx = GetNoise(state.range(0));
+    const auto request = GetModbusRequest();
+    rx.insert(rx.end(), request.begin(), request.end());
+    ModbusProcessRequest(state, rx);
+}
+BENCHMARK(BM_ModbusParseFrame_Noisy)->Arg(16)->Arg(256);
+
+void BM_MeterModel_SetAll(benchmark::State& state)
+{
+    sunspec::MeterModel meterModel(1);
+    float value = 1.0f;
+    for (auto _ : state)
+    {
+        meterModel.SetAcCurrent(value, value, value, value);
+        meterModel.SetVoltageToNeutral(value, value, value, value);
+        meterModel.SetVoltagePhaseToPhase(value, value, value, value);
+        meterModel.SetFrequency(value);
+        meterModel.SetPower(value, value, value, value);
+        meterModel.SetApparentPower(value, value, value, value);
+        meterModel.SetReactivePower(value, value, value, value);
+        meterModel.SetPowerFactor(value, value, value, value);
+        meterModel.SetTotalWattHoursImported(value, value, value, value);
+        meterModel.SetTotalVaHoursImported(value, value, value, value);
+        value += 1.0f;
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_MeterModel_SetAll);
+
+void BM_MeterModel_GetRegisterRaw(benchmark::State& state)
+{
+    sunspec::MeterModel meterModel(1);
+    const uint8_t count = state.range(0);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(meterModel.GetRegisterRaw(40071, count));
+    }
+}
+BENCHMARK(BM_MeterModel_GetRegisterRaw)->Arg(2)->Arg(124);
+
+template <typename T>
+void BM_Convert2BigEndian(benchmark::State& state)
+{
+    T value = 1;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(value = sunspec::Convert2BigEndian(value));
+    }
+}
+BENCHMARK_TEMPLATE(BM_Convert2BigEndian, uint16_t);
+BENCHMARK_TEMPLATE(BM_Convert2BigEndian, uint32_t);
+BENCHMARK_TEMPLATE(BM_Convert2BigEndian, float);
+
+void MbusGetPayload(benchmark::State& state, const std::vector<uint8_t>& rx)
+{
+    espdm::MbusProtocol mbus;
+    std::vector<uint8_t> payload;
+    for (auto _ : state)
+    {
+        for (const auto byte : rx)
+        {
+            mbus.AddFrameData(byte);
+        }
+        while (mbus.GetPayload(payload))
+        {
+            benchmark::DoNotOptimize(payload.data());
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * rx.size());
+}
+
+void BM_MbusGetPayload_Clean(benchmark::State& state)
+{
+    // Kaifa sends one dlms-frame split in two mbus-frames
+    auto rx = dlms_frame_builder::BuildMbusFrame(GetNoise(245));
+    const auto second = dlms_frame_builder::BuildMbusFrame(GetNoise(100));
+    rx.insert(rx.end(), second.begin(), second.end());
+    MbusGetPayload(state, rx);
+}
+BENCHMARK(BM_MbusGetPayload_Clean);
+
+void BM_MbusGetPayload_Resync(benchmark::State& state)
+{
+    auto rx = GetNoise(state.range(0));
+    const auto frame = dlms_frame_builder::BuildMbusFrame(GetNoise(245));
+    rx.insert(rx.end(), frame.begin(), frame.end());
+    MbusGetPayload(state, rx);
+}
+BENCHMARK(BM_MbusGetPayload_Resync)->Arg(16)->Arg(256);
+
+// Recorded link traffic of 100 dlms-frames ( 16 noise bytes after every 10th frame ), in the framing of Framer
+template <typename Framer> std::vector<uint8_t> BuildReplay();
+
+template <> std::vector<uint8_t> BuildReplay<espdm::MbusProtocol>()
+{
+    std::vector<uint8_t> rx;
+    const auto noise = GetNoise(16);
+    for (uint8_t i = 0; i < 100; i++)
+    {
+        const uint8_t iv[12] = {1, 2, 3, 4, 5, 6, 7, 8, 0, 0, 0, i};
+        const auto frames = dlms_frame_builder::BuildMbusFrames(
+            dlms_frame_builder::BuildDlmsFrame(dlms_frame_builder::BuildPlaintext(), iv));
+        rx.insert(rx.end(), frames.begin(), frames.end());
+        if (i % 10 == 9)
+        {
+            rx.insert(rx.end(), noise.begin(), noise.end());
+        }
+    }
+    return rx;
+}
+
+template <> std::vector<uint8_t> BuildReplay<espdm::HdlcProtocol>()
+{
+    std::vector<uint8_t> rx;
+    const auto noise = GetNoise(16);
+    for (uint8_t i = 0; i < 100; i++)
+    {
+        const uint8_t iv[12] = {1, 2, 3, 4, 5, 6, 7, 8, 0, 0, 0, i};
+        const auto frames = dlms_frame_builder::BuildHdlcFrames(
+            dlms_frame_builder::BuildDlmsFrame(dlms_frame_builder::BuildPlaintext(), iv));
+        rx.insert(rx.end(), frames.begin(), frames.end());
+        if (i % 10 == 9)
+        {
+            rx.insert(rx.end(), noise.begin(), noise.end());
+        }
+    }
+    return rx;
+}
+
+// Framer and DlmsFrame assembly, as the FRAME stage of DlmsMeter ( chunks of 64 bytes as read from the uart )
+template <typename Framer, size_t DlmsOffset> void BM_FramerReplay(benchmark::State& state)
+{
+    const auto rx = BuildReplay<Framer>();
+    Framer framer;
+    espdm::DlmsFrame dlmsFrame;
+    std::vector<uint8_t> payload;
+    payload.reserve(1100);
+    size_t completeFrames = 0;
+    for (auto _ : state)
+    {
+        for (size_t offset = 0; offset < rx.size(); offset += 64)
+        {
+            const size_t end = std::min(offset + 64, rx.size());
+            for (size_t i = offset; i < end; i++)
+            {
+                framer.AddFrameData(rx[i]);
+            }
+            while (framer.GetPayload(payload))
+            {
+                espdm::AbortReason reason;
+                if (dlmsFrame.AddPayload(payload, DlmsOffset, reason) == espdm::DlmsFrame::Result::COMPLETE)
+                {
+                    completeFrames++;
+                    dlmsFrame.Clear();
+                }
+            }
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * rx.size());
+    state.counters["frames"] = benchmark::Counter(static_cast<double>(completeFrames), benchmark::Counter::kIsRate);
+}
+BENCHMARK_TEMPLATE2(BM_FramerReplay, espdm::MbusProtocol, espdm::MeterProfile::MBUS_DLMS_OFFSET);
+BENCHMARK_TEMPLATE2(BM_FramerReplay, espdm::HdlcProtocol, espdm::HdlcProtocol::DLMS_OFFSET);
+
+void BM_ObisDecode(benchmark::State& state)
+{
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+    espdm::ObisDecoder decoder;
+    for (auto _ : state)
+    {
+        espdm::MeterData data;
+        benchmark::DoNotOptimize(decoder.Decode(plaintext.data(), plaintext.size(), data));
+        benchmark::DoNotOptimize(data);
+    }
+    state.SetBytesProcessed(state.iterations() * plaintext.size());
+}
+BENCHMARK(BM_ObisDecode);
+
+void BM_MeterData_UpdateDerived(benchmark::State& state)
+{
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+    espdm::MeterData data;
+    espdm::ObisDecoder().Decode(plaintext.data(), plaintext.size(), data);
+    for (auto _ : state)
+    {
+        data.UpdateDerived();
+        benchmark::DoNotOptimize(data);
+    }
+}
+BENCHMARK(BM_MeterData_UpdateDerived);
+
+// Fixed-point from the plaintext to the Sunspec registers, float only for the register encoding
+void BM_ObisDecode_ToMeterModel(benchmark::State& state)
+{
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+    espdm::ObisDecoder decoder;
+    sunspec::MeterModel meterModel(1);
+    for (auto _ : state)
+    {
+        espdm::MeterData data;
+        decoder.Decode(plaintext.data(), plaintext.size(), data);
+        espdm::ObisDecoder::Complete(data);
+        sm::SetMeterData(meterModel, data);
+        benchmark::DoNotOptimize(meterModel);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ObisDecode_ToMeterModel);
+
+// One day of samples, reports the compressed size
+void BM_MeterHistory_Append(benchmark::State& state)
+{
+    constexpr size_t SAMPLES_PER_DAY = 24 * 3600 / history_sample_generator::FRAME_INTERVAL_S;
+    history_sample_generator::SampleGenerator generator;
+    std::vector<sm::HistorySample> samples;
+    for (size_t i = 0; i < SAMPLES_PER_DAY; i++)
+    {
+        samples.push_back(generator.Next());
+    }
+    sm::MeterHistory history(96 * 1024 / sm::MeterHistory::BLOCK_SIZE);
+    for (auto _ : state)
+    {
+        history.Clear();
+        for (const auto& sample : samples)
+        {
+            history.Append(sample);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * samples.size());
+    state.counters["bytes_per_sample"] = static_cast<double>(history.GetUsedBytes()) / history.GetSampleCount();
+}
+BENCHMARK(BM_MeterHistory_Append)->Unit(benchmark::kMillisecond);
+
+void BM_MeterHistory_Read(benchmark::State& state)
+{
+    constexpr size_t SAMPLES_PER_DAY = 24 * 3600 / history_sample_generator::FRAME_INTERVAL_S;
+    history_sample_generator::SampleGenerator generator;
+    sm::MeterHistory history(96 * 1024 / sm::MeterHistory::BLOCK_SIZE);
+    for (size_t i = 0; i < SAMPLES_PER_DAY; i++)
+    {
+        history.Append(generator.Next());
+    }
+    for (auto _ : state)
+    {
+        sm::MeterHistory::Reader reader(history);
+        sm::HistorySample sample;
+        while (reader.Next(sample))
+        {
+            benchmark::DoNotOptimize(sample);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * history.GetSampleCount());
+}
+BENCHMARK(BM_MeterHistory_Read)->Unit(benchmark::kMillisecond);
+
+void BM_LoadProfile_Add(benchmark::State& state)
+{
+    // Full size partition, one frame per iteration, records are written to the ram flash
+    RamFlash flash(0xAF000 / RamFlash::SECTOR_SIZE);
+    sm::LoadProfile loadProfile(flash);
+    loadProfile.Mount();
+    uint32_t time = history_sample_generator::START_TIME;
+    uint32_t energy = 1000000;
+    for (auto _ : state)
+    {
+        loadProfile.Add(time, 500, energy, 0);
+        time += history_sample_generator::FRAME_INTERVAL_S;
+        energy++;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LoadProfile_Add);
+
+void BM_LoadProfile_Query(benchmark::State& state)
+{
+    // Seek in a full minute log and read one tariff period of quarter hours
+    RamFlash flash(0xAF000 / RamFlash::SECTOR_SIZE);
+    sm::LoadProfile loadProfile(flash);
+    loadProfile.Mount();
+    const uint32_t start = history_sample_generator::START_TIME;
+    const uint32_t days = 10;
+    for (uint32_t time = start; time < start + days * 24 * 3600; time += history_sample_generator::FRAME_INTERVAL_S)
+    {
+        loadProfile.Add(time, 500.0f, 0.0f, 0.0f);
+    }
+    const uint32_t from = start + (days - 1) * 24 * 3600;
+    for (auto _ : state)
+    {
+        uint32_t energy = 0;
+        loadProfile.Query(sm::LoadProfileTier::Minute, from, from + 4 * 3600, 1000,
+                          [&energy](const sm::LoadProfileRecord& record) { energy += record.energyPlus; });
+        benchmark::DoNotOptimize(energy);
+    }
+}
+BENCHMARK(BM_LoadProfile_Query);
+
+void BM_TelemetryEncode(benchmark::State& state)
+{
+    sm::TelemetryDatagram datagram;
+    datagram.data.activeEnergyPlus = 1000000;
+    uint8_t buffer[sm::TelemetryDatagram::SIZE];
+    for (auto _ : state)
+    {
+        datagram.sequence++;
+        datagram.Encode(buffer);
+        benchmark::DoNotOptimize(buffer);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelemetryEncode);
+
+void BM_MeterSnapshot_Update(benchmark::State& state)
+{
+    // Once per frame, independent of the number of /meter clients
+    espdm::MeterData data;
+    data.voltageL1 = 2301;
+    data.currentL1 = 123;
+    data.activePowerPlus = 283;
+    data.activeEnergyPlus = 12345678;
+    data.UpdateDerived();
+    sm::EnergyInterval interval;
+    interval.SetBegin(12000000, 0);
+    interval.Update(12345678, 0);
+    const sm::CalendarEnergy calendar;
+    sm::MeterSnapshot snapshot;
+    for (auto _ : state)
+    {
+        snapshot.Update(data, interval, calendar);
+        benchmark::DoNotOptimize(snapshot.GetLength());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * snapshot.GetLength());
+}
+BENCHMARK(BM_MeterSnapshot_Update);
+
+void BM_TelemetryCollect(benchmark::State& state)
+{
+    // Datagrams of Arg(0) devices interleaved, as received by the collector
+    const uint32_t deviceCount = static_cast<uint32_t>(state.range(0));
+    std::vector<uint8_t> datagrams(deviceCount * sm::TelemetryDatagram::SIZE);
+    sm::TelemetryDatagram datagram;
+    for (uint32_t i = 0; i < deviceCount; i++)
+    {
+        datagram.deviceId = i;
+        datagram.Encode(&datagrams[i * sm::TelemetryDatagram::SIZE]);
+    }
+    TelemetryCollector collector;
+    uint32_t device = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(collector.Add(&datagrams[device * sm::TelemetryDatagram::SIZE], sm::TelemetryDatagram::SIZE));
+        device = device + 1 < deviceCount ? device + 1 : 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sm::TelemetryDatagram::SIZE);
+}
+BENCHMARK(BM_TelemetryCollect)->Arg(1)->Arg(100)->Arg(10000);
+
+// One frame of one of three meters, incremental merge
+void BM_MeterAggregator_Update(benchmark::State& state)
+{
+    sm::MeterAggregator aggregator;
+    espdm::MeterData data[sm::MeterAggregator::MAX_METERS];
+    espdm::ObisDecoder decoder;
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+    for (size_t i = 0; i < sm::MeterAggregator::MAX_METERS; i++)
+    {
+        aggregator.AddMeter();
+        decoder.Decode(plaintext.data(), plaintext.size(), data[i]);
+    }
+    uint32_t now = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(aggregator.Update(now % sm::MeterAggregator::MAX_METERS, data[now % sm::MeterAggregator::MAX_METERS], now));
+        now++;
+    }
+}
+BENCHMARK(BM_MeterAggregator_Update);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "capture_replay.h"
+#include "encrypted_frame_builder.h"
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace gateway;
+using namespace esphome::espdm;
+
+namespace
+{
+constexpr uint32_t FRAME_INTERVAL_MS = 5000; // Kaifa MA309
+constexpr uint32_t DLMS_FRAME_COUNT = 50;
+
+// Capture of encrypted frames, as downloaded from the device, in a temporary file
+class CaptureFile
+{
+public:
+    CaptureFile()
+    {
+        char name[] = "/tmp/capture_replay_test_XXXXXX";
+        const int fd = mkstemp(name);
+        close(fd);
+        m_name = name;
+
+        std::vector<uint8_t> memory(64 * capture::BLOCK_SIZE);
+        CaptureRing ring(memory.data(), 64);
+        MbusProtocol mbus;
+        std::vector<uint8_t> payload;
+        for (uint32_t i = 0; i < DLMS_FRAME_COUNT; i++)
+        {
+            const auto bytes = encrypted_frame_builder::BuildMbusFrames(i + 1);
+            for (size_t offset = 0; offset < bytes.size(); offset += 64)
+            {
+                const size_t length = std::min<size_t>(64, bytes.size() - offset);
+                ring.AddData(i * FRAME_INTERVAL_MS, &bytes[offset], length);
+                for (size_t j = 0; j < length; j++)
+                {
+                    mbus.AddFrameData(bytes[offset + j]);
+                }
+                while (mbus.GetPayload(payload))
+                {
+                    ring.MarkFrameEnd();
+                }
+            }
+        }
+        FILE* file = fopen(m_name.c_str(), "wb");
+        for (uint32_t sequence = ring.GetFirstSequence(); sequence < ring.GetNextSequence(); sequence++)
+        {
+            fwrite(ring.GetBlock(sequence), 1, capture::BLOCK_SIZE, file);
+        }
+        fclose(file);
+    }
+
+    ~CaptureFile()
+    {
+        remove(m_name.c_str());
+    }
+
+    const char* GetName() const
+    {
+        return m_name.c_str();
+    }
+
+private:
+    std::string m_name;
+};
+
+} // namespace
+
+TEST(CaptureReplayTest, Run_MappedCapture_AllFramesDecoded)
+{
+    CaptureFile capture;
+    MappedFile file;
+    ASSERT_TRUE(file.Open(capture.GetName()));
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, 1);
+    CaptureReplay replay(file.GetData(), file.GetSize());
+
+    replay.Run(pipeline);
+
+    // 2 mbus-frames per dlms-frame
+    ASSERT_EQ(replay.GetReader().GetFrameCount(), 2 * DLMS_FRAME_COUNT);
+    ASSERT_EQ(pipeline.GetLinkStatistics().decodedFrames, DLMS_FRAME_COUNT);
+    ASSERT_EQ(pipeline.GetLinkStatistics().GetAbortCount(), 0);
+    ASSERT_EQ(pipeline.GetLinkStatistics().lostFrames, 0);
+    // Clock of the pipeline: time of the capture
+    ASSERT_EQ(replay.Millis(), (DLMS_FRAME_COUNT - 1) * FRAME_INTERVAL_MS);
+    ASSERT_FALSE(pipeline.GetMeterModel().IsStale(replay.Millis()));
+}
+
+TEST(CaptureReplayTest, SeekFrame_SecondHalf_OnlyTheseDecoded)
+{
+    CaptureFile capture;
+    MappedFile file;
+    ASSERT_TRUE(file.Open(capture.GetName()));
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, 1);
+    CaptureReplay replay(file.GetData(), file.GetSize());
+
+    ASSERT_TRUE(replay.SeekFrame(DLMS_FRAME_COUNT)); // mbus-frame of the dlms-frame DLMS_FRAME_COUNT / 2
+    replay.Run(pipeline);
+
+    ASSERT_EQ(pipeline.GetLinkStatistics().decodedFrames, DLMS_FRAME_COUNT / 2);
+    ASSERT_EQ(pipeline.GetLinkStatistics().GetAbortCount(), 0);
+}
+
+TEST(CaptureReplayTest, Open_MissingFile_False)
+{
+    MappedFile file;
+
+    ASSERT_FALSE(file.Open("/tmp/capture_replay_test_missing"));
+    ASSERT_EQ(file.GetData(), nullptr);
+}
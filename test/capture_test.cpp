@@ -0,0 +1,280 @@
+#include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "alloc_tracker.h"
+#include "dlms_frame_builder.h"
+#include "../src/esphome-dlms-meter/espdm_capture.h"
+#include "../src/esphome-dlms-meter/espdm_mbus.h"
+
+using namespace esphome::espdm;
+
+namespace
+{
+const uint8_t IV[12] = {1, 2, 3, 4, 5, 6, 7, 8, 0x00, 0x01, 0x02, 0x03};
+
+std::vector<uint8_t> GetData(uint8_t first, size_t length)
+{
+    std::vector<uint8_t> data(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        data[i] = static_cast<uint8_t>(first + i);
+    }
+    return data;
+}
+
+// The downloaded file: the blocks of the ring, oldest first
+std::vector<uint8_t> GetFile(const CaptureRing& ring)
+{
+    std::vector<uint8_t> file;
+    for (uint32_t sequence = ring.GetFirstSequence(); sequence < ring.GetNextSequence(); sequence++)
+    {
+        const uint8_t* block = ring.GetBlock(sequence);
+        file.insert(file.end(), block, block + capture::BLOCK_SIZE);
+    }
+    return file;
+}
+
+std::vector<std::vector<uint8_t>> ReadFrames(CaptureReader& reader)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> bytes;
+    uint32_t timeMs;
+    while (reader.NextFrame(bytes, timeMs))
+    {
+        frames.push_back(bytes);
+    }
+    return frames;
+}
+
+} // namespace
+
+TEST(CaptureTest, NextRecord_Added_SameTimeAndBytes)
+{
+    std::vector<uint8_t> memory(2 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 2);
+    const auto first = GetData(0x68, 64);
+    const auto second = GetData(0x10, 3);
+    ring.AddData(1000, first.data(), first.size());
+    ring.AddData(1020, second.data(), second.size());
+    ring.MarkFrameEnd();
+    const auto file = GetFile(ring);
+    CaptureReader reader(file.data(), file.size());
+    CaptureReader::Record record;
+
+    ASSERT_TRUE(reader.NextRecord(record));
+    ASSERT_EQ(record.timeMs, 1000);
+    ASSERT_EQ(std::vector<uint8_t>(record.data, record.data + record.length), first);
+    ASSERT_FALSE(record.frameEnd);
+    ASSERT_TRUE(reader.NextRecord(record));
+    ASSERT_EQ(record.timeMs, 1020);
+    ASSERT_EQ(std::vector<uint8_t>(record.data, record.data + record.length), second);
+    ASSERT_TRUE(record.frameEnd);
+    ASSERT_FALSE(reader.NextRecord(record));
+    ASSERT_EQ(reader.GetBlockCount(), 1);
+    ASSERT_EQ(reader.GetFrameCount(), 1);
+}
+
+TEST(CaptureTest, NextFrame_FrameSpansBlocks_Complete)
+{
+    std::vector<uint8_t> memory(4 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 4);
+    const auto frame = GetData(0, 3 * capture::BLOCK_SIZE);
+    ring.AddData(0, frame.data(), frame.size());
+    ring.MarkFrameEnd();
+    const auto file = GetFile(ring);
+    CaptureReader reader(file.data(), file.size());
+
+    ASSERT_EQ(reader.GetBlockCount(), 4);
+    ASSERT_EQ(ReadFrames(reader), (std::vector<std::vector<uint8_t>>{frame}));
+}
+
+TEST(CaptureTest, SeekFrame_Index_ReturnsGivenFrame)
+{
+    std::vector<uint8_t> memory(8 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 8);
+    // 300 bytes per frame in 2 reads, frames span blocks
+    for (uint8_t i = 0; i < 40; i++)
+    {
+        const auto frame = GetData(i, 300);
+        ring.AddData(i * 1000, frame.data(), 100);
+        ring.AddData(i * 1000 + 50, frame.data() + 100, 200);
+        ring.MarkFrameEnd();
+    }
+    const auto file = GetFile(ring);
+    CaptureReader reader(file.data(), file.size());
+    std::vector<uint8_t> bytes;
+    uint32_t timeMs;
+
+    ASSERT_EQ(reader.GetFrameCount(), 40);
+    for (const uint8_t frame : {0, 1, 13, 14, 26, 39})
+    {
+        ASSERT_TRUE(reader.SeekFrame(frame));
+        ASSERT_TRUE(reader.NextFrame(bytes, timeMs));
+        ASSERT_EQ(timeMs, frame * 1000 + 50);
+        ASSERT_EQ(bytes, GetData(frame, 300));
+    }
+    ASSERT_FALSE(reader.SeekFrame(40));
+}
+
+TEST(CaptureTest, AddData_RingFull_OldestBlockOverwritten)
+{
+    std::vector<uint8_t> memory(2 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 2);
+    const auto data = GetData(0, 1000);
+    for (int i = 0; i < 20; i++)
+    {
+        ring.AddData(i, data.data(), data.size());
+    }
+
+    ASSERT_GT(ring.GetNextSequence(), 2);
+    ASSERT_EQ(ring.GetFirstSequence(), ring.GetNextSequence() - 2);
+    ASSERT_EQ(ring.GetBlock(ring.GetFirstSequence() - 1), nullptr);
+    const auto file = GetFile(ring);
+    CaptureReader reader(file.data(), file.size());
+    ASSERT_EQ(reader.GetBlockCount(), 2);
+}
+
+TEST(CaptureTest, AddData_TimeDeltaTooLarge_NewBlock)
+{
+    std::vector<uint8_t> memory(2 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 2);
+    const auto data = GetData(0, 10);
+    // close to the overflow of millis()
+    ring.AddData(0xFFFFFF00, data.data(), data.size());
+    ring.AddData(0xFFFFFF00 + 0xFFFF, data.data(), data.size());
+    ring.AddData(0xFFFFFF00 + 0x10000, data.data(), data.size());
+    const auto file = GetFile(ring);
+    CaptureReader reader(file.data(), file.size());
+    CaptureReader::Record record;
+
+    ASSERT_EQ(ring.GetNextSequence(), 2);
+    ASSERT_TRUE(reader.NextRecord(record));
+    ASSERT_TRUE(reader.NextRecord(record));
+    ASSERT_EQ(record.timeMs, 0xFFFFFF00 + 0xFFFF);
+    ASSERT_TRUE(reader.NextRecord(record));
+    ASSERT_EQ(record.timeMs, 0xFFFFFF00 + 0x10000);
+}
+
+TEST(CaptureTest, MarkFrameEnd_IndexFull_NewBlock)
+{
+    std::vector<uint8_t> memory(2 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 2);
+    const auto data = GetData(0, 8);
+    const size_t indexSize = capture::FRAME_INDEX_SIZE;
+    for (size_t i = 0; i <= indexSize; i++)
+    {
+        ring.AddData(0, data.data(), data.size());
+        ring.MarkFrameEnd();
+    }
+    const auto file = GetFile(ring);
+    CaptureReader reader(file.data(), file.size());
+
+    ASSERT_EQ(ring.GetNextSequence(), 2);
+    ASSERT_EQ(reader.GetFrameCount(), indexSize + 1);
+    ASSERT_EQ(ReadFrames(reader).size(), indexSize + 1);
+}
+
+TEST(CaptureTest, NextRecord_CorruptBlock_Stops)
+{
+    std::vector<uint8_t> memory(3 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 3);
+    const auto data = GetData(0, 3000);
+    for (int i = 0; i < 3; i++)
+    {
+        ring.AddData(0, data.data(), data.size());
+        ring.MarkFrameEnd();
+    }
+    auto file = GetFile(ring);
+    file[capture::BLOCK_SIZE + capture::MAGIC_OFFSET] ^= 0xFF;
+    CaptureReader reader(file.data(), file.size());
+
+    ASSERT_EQ(reader.GetBlockCount(), 1);
+    ASSERT_EQ(ReadFrames(reader).size(), 1);
+}
+
+TEST(CaptureTest, SeekFrame_CorruptFrameIndex_BlockInvalid)
+{
+    std::vector<uint8_t> memory(2 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 2);
+    const auto data = GetData(0, 100);
+    for (int i = 0; i < 3; i++)
+    {
+        ring.AddData(0, data.data(), data.size());
+        ring.MarkFrameEnd();
+    }
+    const auto file = GetFile(ring);
+    std::vector<uint8_t> beyondUsed = file;
+    capture::Write<uint16_t>(&beyondUsed[capture::FRAME_INDEX_OFFSET + 2], 0xFFF0);
+    std::vector<uint8_t> noFrameEnd = file;
+    capture::Write<uint16_t>(&noFrameEnd[capture::FRAME_INDEX_OFFSET + 2], 1);
+
+    for (const auto* corrupt : {&beyondUsed, &noFrameEnd})
+    {
+        CaptureReader reader(corrupt->data(), corrupt->size());
+        ASSERT_EQ(reader.GetBlockCount(), 0);
+        ASSERT_EQ(reader.GetFrameCount(), 0);
+        ASSERT_FALSE(reader.SeekFrame(1));
+    }
+    CaptureReader reader(file.data(), file.size());
+    ASSERT_TRUE(reader.SeekFrame(2));
+}
+
+TEST(CaptureTest, AddData_AfterConstruction_NoHeapAllocations)
+{
+    std::vector<uint8_t> memory(2 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 2);
+    const auto data = GetData(0, 64);
+
+    alloc_tracker::Scope scope;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        ring.AddData(i * 10, data.data(), data.size());
+        ring.MarkFrameEnd();
+    }
+
+    ASSERT_EQ(scope.GetAllocations(), 0);
+}
+
+TEST(CaptureTest, NextFrame_CapturedMbusFrames_SamePayloads)
+{
+    // Captured as DlmsMeter does: reads of the uart, the frame end when the framer returns a payload
+    const auto bytes = dlms_frame_builder::BuildMbusFrames(
+        dlms_frame_builder::BuildDlmsFrame(dlms_frame_builder::BuildPlaintext(), IV));
+    std::vector<uint8_t> memory(4 * capture::BLOCK_SIZE);
+    CaptureRing ring(memory.data(), 4);
+    MbusProtocol mbus;
+    std::vector<uint8_t> payload;
+    std::vector<std::vector<uint8_t>> payloads;
+    for (size_t offset = 0; offset < bytes.size(); offset += 64)
+    {
+        const size_t length = std::min<size_t>(64, bytes.size() - offset);
+        ring.AddData(static_cast<uint32_t>(offset), &bytes[offset], length);
+        for (size_t i = 0; i < length; i++)
+        {
+            mbus.AddFrameData(bytes[offset + i]);
+        }
+        while (mbus.GetPayload(payload))
+        {
+            payloads.push_back(payload);
+            ring.MarkFrameEnd();
+        }
+    }
+    const auto file = GetFile(ring);
+    CaptureReader reader(file.data(), file.size());
+
+    MbusProtocol replay;
+    std::vector<std::vector<uint8_t>> replayed;
+    for (const auto& frame : ReadFrames(reader))
+    {
+        for (const auto byte : frame)
+        {
+            replay.AddFrameData(byte);
+        }
+        while (replay.GetPayload(payload))
+        {
+            replayed.push_back(payload);
+        }
+    }
+
+    ASSERT_EQ(payloads.size(), 2);
+    ASSERT_EQ(replayed, payloads);
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "virtual_clock.h"
+
+using namespace esphome::espdm;
+
+namespace
+{
+constexpr uint64_t MS_PER_DAY = 24ULL * 60 * 60 * 1000;
+// millis() overflows after 2^32 ms
+constexpr uint64_t MILLIS_OVERFLOW_US = (1ULL << 32) * 1000;
+} // namespace
+
+TEST(ClockTest, VirtualClock_Advance_MillisAndMicros)
+{
+    VirtualClock clock;
+
+    clock.Advance(5);
+    clock.AdvanceUs(250);
+
+    ASSERT_EQ(clock.Millis(), 5);
+    ASSERT_EQ(clock.Micros(), 5250);
+}
+
+TEST(ClockTest, Uptime_FirstUpdate_Zero)
+{
+    VirtualClock clock(123456789);
+    Uptime uptime;
+
+    ASSERT_EQ(uptime.Update(clock), 0);
+    clock.Advance(1500);
+    ASSERT_EQ(uptime.Update(clock), 1500);
+    ASSERT_EQ(uptime.GetMs(), 1500);
+}
+
+TEST(ClockTest, Uptime_AcrossMillisOverflow_Continues)
+{
+    VirtualClock clock(MILLIS_OVERFLOW_US - MS_PER_DAY * 1000);
+    Uptime uptime;
+    uptime.Update(clock);
+
+    // 60 days, updated hourly
+    for (int hour = 0; hour < 60 * 24; hour++)
+    {
+        clock.Advance(60 * 60 * 1000);
+        uptime.Update(clock);
+    }
+
+    ASSERT_LT(clock.Millis(), MS_PER_DAY * 60); // overflowed
+    ASSERT_EQ(uptime.GetMs(), MS_PER_DAY * 60);
+}
+
+TEST(ClockTest, BlinkTimer_OnTimeElapsed_ExpiredOnce)
+{
+    VirtualClock clock;
+    BlinkTimer blink(80);
+
+    ASSERT_FALSE(blink.Expired(clock)); // not started
+    blink.Start(clock);
+    clock.Advance(79);
+    ASSERT_FALSE(blink.Expired(clock));
+    clock.Advance(1);
+    ASSERT_TRUE(blink.Expired(clock));
+    ASSERT_FALSE(blink.IsRunning());
+    clock.Advance(100);
+    ASSERT_FALSE(blink.Expired(clock));
+}
+
+TEST(ClockTest, BlinkTimer_RestartedWhileOn_OnTimeFromRestart)
+{
+    VirtualClock clock(MILLIS_OVERFLOW_US - 50 * 1000);
+    BlinkTimer blink(80);
+    blink.Start(clock);
+
+    clock.Advance(60);
+    blink.Start(clock); // next response, across the millis() overflow
+    clock.Advance(60);
+    ASSERT_FALSE(blink.Expired(clock));
+    clock.Advance(20);
+    ASSERT_TRUE(blink.Expired(clock));
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Builds synthetic Kaifa MA309 frames for tests and benchmarks
+namespace dlms_frame_builder
+{
+
+struct MeterValues
+{
+    uint16_t voltageL1{2301}; // 0.1V
+    uint16_t voltageL2{2312};
+    uint16_t voltageL3{2323};
+    uint16_t currentL1{123}; // 0.01A
+    uint16_t currentL2{234};
+    uint16_t currentL3{345};
+    uint32_t activePowerPlus{1234}; // W
+    uint32_t activePowerMinus{0};
+    uint32_t activeEnergyPlus{12345678}; // Wh
+    uint32_t activeEnergyMinus{2345678};
+    uint32_t reactiveEnergyPlus{345678}; // varh
+    uint32_t reactiveEnergyMinus{45678};
+    uint8_t voltageScaler{0xFF}; // 10^scaler V
+    uint8_t energyScaler{0x00}; // 10^scaler Wh, varh
+};
+
+inline void AddUint16(std::vector<uint8_t>& data, uint16_t value)
+{
+    data.push_back(value >> 8);
+    data.push_back(value & 0xFF);
+}
+
+inline void AddUint32(std::vector<uint8_t>& data, uint32_t value)
+{
+    AddUint16(data, value >> 16);
+    AddUint16(data, value & 0xFFFF);
+}
+
+inline void AddObisCode(std::vector<uint8_t>& data, uint8_t a, uint8_t c, uint8_t d)
+{
+    data.insert(data.end(), {0x09, 0x06, a, 0x00, c, d, 0x00, 0xFF});
+}
+
+inline void AddScalerUnit(std::vector<uint8_t>& data, uint8_t scaler, uint8_t unit, bool last)
+{
+    data.insert(data.end(), {0x02, 0x02, 0x0F, scaler, 0x16, unit});
+    if (!last)
+    {
+        data.insert(data.end(), {0x02, 0x03}); // structure of next entry
+    }
+}
+
+inline void AddLongUnsigned(std::vector<uint8_t>& data, uint8_t c, uint8_t d, uint16_t value, uint8_t scaler,
+                            uint8_t unit)
+{
+    AddObisCode(data, 0x01, c, d);
+    data.push_back(0x12);
+    AddUint16(data, value);
+    AddScalerUnit(data, scaler, unit, false);
+}
+
+inline void AddDoubleLongUnsigned(std::vector<uint8_t>& data, uint8_t c, uint8_t d, uint32_t value, uint8_t unit,
+                                  bool last = false, uint8_t scaler = 0x00)
+{
+    AddObisCode(data, 0x01, c, d);
+    data.push_back(0x06);
+    AddUint32(data, value);
+    AddScalerUnit(data, scaler, unit, last);
+}
+
+inline void AddDateTime(std::vector<uint8_t>& data)
+{
+    // 2024-03-17 (Sunday) 12:34:56
+    AddUint16(data, 2024);
+    data.insert(data.end(), {0x03, 0x11, 0x07, 0x0C, 0x22, 0x38, 0xFF, 0x80, 0x00, 0x00});
+}
+
+// Decrypted DLMS data-notification as sent by the Kaifa MA309
+inline std::vector<uint8_t> BuildPlaintext(const MeterValues& values = MeterValues())
+{
+    std::vector<uint8_t> data = {0x0F, 0x00, 0x01, 0x23, 0x45, 0x0C};
+    AddDateTime(data);
+    data.insert(data.end(), {0x02, 0x0D}); // structure of 13 entries, decoder starts after it
+
+    AddObisCode(data, 0x00, 0x01, 0x00); // timestamp
+    data.insert(data.end(), {0x09, 0x0C});
+    AddDateTime(data);
+    data.insert(data.end(), {0x02, 0x03});
+
+    AddLongUnsigned(data, 0x20, 0x07, values.voltageL1, values.voltageScaler, 0x23);
+    AddLongUnsigned(data, 0x34, 0x07, values.voltageL2, values.voltageScaler, 0x23);
+    AddLongUnsigned(data, 0x48, 0x07, values.voltageL3, values.voltageScaler, 0x23);
+    AddLongUnsigned(data, 0x1F, 0x07, values.currentL1, 0xFE, 0x21);
+    AddLongUnsigned(data, 0x33, 0x07, values.currentL2, 0xFE, 0x21);
+    AddLongUnsigned(data, 0x47, 0x07, values.currentL3, 0xFE, 0x21);
+    AddDoubleLongUnsigned(data, 0x01, 0x07, values.activePowerPlus, 0x1B);
+    AddDoubleLongUnsigned(data, 0x02, 0x07, values.activePowerMinus, 0x1B);
+    AddDoubleLongUnsigned(data, 0x01, 0x08, values.activeEnergyPlus, 0x1E, false, values.energyScaler);
+    AddDoubleLongUnsigned(data, 0x02, 0x08, values.activeEnergyMinus, 0x1E, false, values.energyScaler);
+    AddDoubleLongUnsigned(data, 0x03, 0x08, values.reactiveEnergyPlus, 0x20, false, values.energyScaler);
+    AddDoubleLongUnsigned(data, 0x04, 0x08, values.reactiveEnergyMinus, 0x20, true, values.energyScaler);
+
+    return data;
+}
+
+// M-Bus long frame: 68 L L 68 C A CI <data> CS 16
+inline std::vector<uint8_t> BuildMbusFrame(const std::vector<uint8_t>& data)
+{
+    const uint8_t length = static_cast<uint8_t>(data.size() + 3);
+    std::vector<uint8_t> frame = {0x68, length, length, 0x68, 0x53, 0xFF, 0x00};
+    for (const auto d : data)
+    {
+        frame.push_back(d);
+    }
+    uint8_t checkSum = 0;
+    for (size_t i = 4; i < frame.size(); i++)
+    {
+        checkSum += frame[i];
+    }
+    frame.push_back(checkSum);
+    frame.push_back(0x16);
+
+    return frame;
+}
+
+// Encrypted dlms-frame ( general-glo-ciphering, security 0x21 ), see KaifaMa309Profile
+// iv: system title ( 8 bytes ) and frame counter ( 4 bytes ), the ciphertext is encrypted with it
+inline std::vector<uint8_t> BuildDlmsFrame(const std::vector<uint8_t>& ciphertext, const uint8_t iv[12])
+{
+    std::vector<uint8_t> frame = {0xDB, 0x08};
+    frame.insert(frame.end(), iv, iv + 8);
+    const size_t length = ciphertext.size() + 5; // security byte and frame counter are included
+    if (length > 127)
+    {
+        frame.push_back(0x82);
+        AddUint16(frame, static_cast<uint16_t>(length));
+    }
+    else
+    {
+        frame.push_back(static_cast<uint8_t>(length));
+    }
+    frame.push_back(0x21);
+    frame.insert(frame.end(), iv + 8, iv + 12);
+    frame.insert(frame.end(), ciphertext.begin(), ciphertext.end());
+    return frame;
+}
+
+// Splits a dlms-frame into mbus-frames, as the Kaifa MA309 does ( at most maxData dlms bytes per mbus-frame )
+// Each mbus payload starts with the 2 bytes transport header, which are skipped by DlmsFrame
+inline std::vector<uint8_t> BuildMbusFrames(const std::vector<uint8_t>& dlmsFrame, size_t maxData = 227)
+{
+    std::vector<uint8_t> frames;
+    for (size_t offset = 0; offset < dlmsFrame.size(); offset += maxData)
+    {
+        const size_t end = std::min(offset + maxData, dlmsFrame.size());
+        std::vector<uint8_t> data = {0x01, 0x67};
+        data.insert(data.end(), dlmsFrame.begin() + offset, dlmsFrame.begin() + end);
+        const auto frame = BuildMbusFrame(data);
+        frames.insert(frames.end(), frame.begin(), frame.end());
+    }
+    return frames;
+}
+
+// FCS-16 ( CRC-16/X-25 ) bitwise, as reference for the table of HdlcProtocol
+inline uint16_t CalculateHdlcFcs(const std::vector<uint8_t>& data, size_t begin, size_t end)
+{
+    uint16_t fcs = 0xFFFF;
+    for (size_t i = begin; i < end; i++)
+    {
+        fcs ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            fcs = (fcs & 1) != 0 ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+        }
+    }
+    return fcs ^ 0xFFFF;
+}
+
+// HDLC frame type 3: 7E A0|S|L L <dest 41> <src 03> <control 13> HCS <information> FCS 7E
+inline std::vector<uint8_t> BuildHdlcFrame(const std::vector<uint8_t>& information, bool segmented)
+{
+    const size_t length = 2 + 3 + 2 + information.size() + 2;
+    std::vector<uint8_t> frame = {0x7E, static_cast<uint8_t>(0xA0 | (segmented ? 0x08 : 0x00) | (length >> 8)),
+                                  static_cast<uint8_t>(length & 0xFF), 0x41, 0x03, 0x13};
+    const uint16_t hcs = CalculateHdlcFcs(frame, 1, frame.size());
+    frame.push_back(hcs & 0xFF);
+    frame.push_back(hcs >> 8);
+    frame.insert(frame.end(), information.begin(), information.end());
+    const uint16_t fcs = CalculateHdlcFcs(frame, 1, frame.size());
+    frame.push_back(fcs & 0xFF);
+    frame.push_back(fcs >> 8);
+    frame.push_back(0x7E);
+    return frame;
+}
+
+// Splits a dlms-frame into hdlc-frames ( segments of at most maxInformation bytes ), the first one starts with
+// the LLC header E6 E7 00
+inline std::vector<uint8_t> BuildHdlcFrames(const std::vector<uint8_t>& dlmsFrame, size_t maxInformation = 128)
+{
+    std::vector<uint8_t> information = {0xE6, 0xE7, 0x00};
+    information.insert(information.end(), dlmsFrame.begin(), dlmsFrame.end());
+    std::vector<uint8_t> frames;
+    for (size_t offset = 0; offset < information.size(); offset += maxInformation)
+    {
+        const size_t end = std::min(offset + maxInformation, information.size());
+        const auto frame = BuildHdlcFrame(std::vector<uint8_t>(information.begin() + offset, information.begin() + end),
+                                          end < information.size());
+        frames.insert(frames.end(), frame.begin(), frame.end());
+    }
+    return frames;
+}
+
+} // namespace dlms_frame_builder
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "dlms_frame_builder.h"
+#include "../src/esphome-dlms-meter/espdm_dlms_frame.h"
+#include "../src/esphome-dlms-meter/espdm_mbus.h"
+
+#include <cstring>
+
+using namespace esphome::espdm;
+
+namespace
+{
+const uint8_t IV[DlmsFrame::IV_LENGTH] = {1, 2, 3, 4, 5, 6, 7, 8, 0x00, 0x01, 0x02, 0x03};
+
+// Adds the mbus-frames to frame, returns the result of the last one
+DlmsFrame::Result AddMbusFrames(DlmsFrame& frame, const std::vector<uint8_t>& mbusFrames, AbortReason& reason,
+                                size_t& count)
+{
+    MbusProtocol mbus;
+    for (const auto byte : mbusFrames)
+    {
+        mbus.AddFrameData(byte);
+    }
+    std::vector<uint8_t> payload;
+    DlmsFrame::Result result = DlmsFrame::Result::INCOMPLETE;
+    count = 0;
+    while (mbus.GetPayload(payload))
+    {
+        result = frame.AddMbusPayload(payload, reason);
+        count++;
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(DlmsFrameTest, AddMbusPayload_TwoMbusFrames_Complete)
+{
+    const auto ciphertext = dlms_frame_builder::BuildPlaintext(); // content does not matter here
+    const auto mbusFrames = dlms_frame_builder::BuildMbusFrames(dlms_frame_builder::BuildDlmsFrame(ciphertext, IV));
+    DlmsFrame frame;
+    AbortReason reason;
+    size_t count;
+
+    ASSERT_EQ(AddMbusFrames(frame, mbusFrames, reason, count), DlmsFrame::Result::COMPLETE);
+
+    ASSERT_EQ(count, 2);
+    ASSERT_EQ(frame.GetMessageLength(), ciphertext.size());
+    ASSERT_EQ(std::memcmp(frame.GetCiphertext(), ciphertext.data(), ciphertext.size()), 0);
+    ASSERT_EQ(frame.GetFrameCounter(), 0x00010203);
+    uint8_t iv[DlmsFrame::IV_LENGTH];
+    frame.GetIv(iv);
+    ASSERT_EQ(std::memcmp(iv, IV, sizeof(iv)), 0);
+}
+
+TEST(DlmsFrameTest, AddMbusPayload_ShortLength_Complete)
+{
+    const std::vector<uint8_t> ciphertext(100, 0x55); // length <= 127, header is not extended
+    const auto mbusFrames = dlms_frame_builder::BuildMbusFrames(dlms_frame_builder::BuildDlmsFrame(ciphertext, IV));
+    DlmsFrame frame;
+    AbortReason reason;
+    size_t count;
+
+    ASSERT_EQ(AddMbusFrames(frame, mbusFrames, reason, count), DlmsFrame::Result::COMPLETE);
+
+    ASSERT_EQ(frame.GetMessageLength(), 100);
+    ASSERT_EQ(frame.GetCiphertext()[99], 0x55);
+    ASSERT_EQ(frame.GetFrameCounter(), 0x00010203);
+}
+
+TEST(DlmsFrameTest, AddMbusPayload_UnsupportedCipher_Aborted)
+{
+    auto dlmsFrame = dlms_frame_builder::BuildDlmsFrame(std::vector<uint8_t>(100, 0x55), IV);
+    dlmsFrame[0] = 0xDA;
+    DlmsFrame frame;
+    AbortReason reason;
+    size_t count;
+
+    ASSERT_EQ(AddMbusFrames(frame, dlms_frame_builder::BuildMbusFrames(dlmsFrame), reason, count),
+              DlmsFrame::Result::ABORTED);
+
+    ASSERT_EQ(reason, AbortReason::UNSUPPORTED_CIPHER);
+    ASSERT_TRUE(frame.GetData().empty());
+}
+
+TEST(DlmsFrameTest, AddMbusPayload_LongerThanLengthField_Aborted)
+{
+    // Before, such a frame was never completed and all following frames were appended to it
+    auto dlmsFrame = dlms_frame_builder::BuildDlmsFrame(std::vector<uint8_t>(100, 0x55), IV);
+    dlmsFrame.push_back(0x00);
+    DlmsFrame frame;
+    AbortReason reason;
+    size_t count;
+
+    ASSERT_EQ(AddMbusFrames(frame, dlms_frame_builder::BuildMbusFrames(dlmsFrame), reason, count),
+              DlmsFrame::Result::ABORTED);
+
+    ASSERT_EQ(reason, AbortReason::FRAME_TOO_LONG);
+}
+
+TEST(DlmsFrameTest, AddMbusPayload_ShortMbusPayload_Aborted)
+{
+    DlmsFrame frame;
+    AbortReason reason;
+
+    ASSERT_EQ(frame.AddMbusPayload({0x53, 0xFF, 0x00}, reason), DlmsFrame::Result::ABORTED);
+
+    ASSERT_EQ(reason, AbortReason::PAYLOAD_TOO_SHORT);
+}
+
+TEST(DlmsFrameTest, AddMbusPayload_AfterAbort_NextFrameComplete)
+{
+    const auto ciphertext = dlms_frame_builder::BuildPlaintext();
+    const auto dlmsFrame = dlms_frame_builder::BuildDlmsFrame(ciphertext, IV);
+    // Second half of a frame ( e.g. after boot ), followed by a complete frame
+    const auto mbusFrames = dlms_frame_builder::BuildMbusFrames(dlmsFrame);
+    const auto firstLength = dlms_frame_builder::BuildMbusFrames(std::vector<uint8_t>(dlmsFrame.begin(),
+                                                                                      dlmsFrame.begin() + 227))
+                                 .size();
+    std::vector<uint8_t> data(mbusFrames.begin() + firstLength, mbusFrames.end());
+    data.insert(data.end(), mbusFrames.begin(), mbusFrames.end());
+    DlmsFrame frame;
+    AbortReason reason;
+    size_t count;
+
+    ASSERT_EQ(AddMbusFrames(frame, data, reason, count), DlmsFrame::Result::COMPLETE);
+
+    ASSERT_EQ(count, 3);
+    ASSERT_EQ(frame.GetMessageLength(), ciphertext.size());
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "aes_gcm.h"
+#include "dlms_frame_builder.h"
+
+// Builds encrypted Kaifa MA309 frames ( as received on the M-Bus ) for the gateway tests and benchmarks
+namespace encrypted_frame_builder
+{
+
+const uint8_t KEY[gateway::AesGcm::KEY_LENGTH]
+    = {0x38, 0x68, 0x68, 0x69, 0x71, 0x7A, 0x32, 0x45, 0x6B, 0x75, 0x53, 0x48, 0x53, 0x4B, 0x51, 0x37};
+
+inline std::vector<uint8_t> BuildMbusFrames(uint32_t frameCounter,
+                                            const dlms_frame_builder::MeterValues& values
+                                            = dlms_frame_builder::MeterValues(),
+                                            const uint8_t* key = KEY)
+{
+    const uint8_t iv[gateway::AesGcm::IV_LENGTH]
+        = {0x4B, 0x46, 0x4D, 0x10, 0x20, 0x00, 0x00, 0x01, static_cast<uint8_t>(frameCounter >> 24),
+           static_cast<uint8_t>(frameCounter >> 16), static_cast<uint8_t>(frameCounter >> 8),
+           static_cast<uint8_t>(frameCounter)};
+    const auto plaintext = dlms_frame_builder::BuildPlaintext(values);
+    std::vector<uint8_t> ciphertext(plaintext.size());
+    gateway::AesGcm aes(key);
+    aes.Encrypt(iv, plaintext.data(), plaintext.size(), ciphertext.data());
+    return dlms_frame_builder::BuildMbusFrames(dlms_frame_builder::BuildDlmsFrame(ciphertext, iv));
+}
+
+} // namespace encrypted_frame_builder
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include "../src/energy_interval.h"
+
+using namespace esphome::sm;
+using esphome::espdm::MeterTimestamp;
+
+namespace
+{
+MeterTimestamp CreateTimestamp(uint16_t year, uint8_t month, uint8_t day)
+{
+    MeterTimestamp timestamp;
+    timestamp.year = year;
+    timestamp.month = month;
+    timestamp.day = day;
+    timestamp.hour = 12;
+    return timestamp;
+}
+
+} // namespace
+
+TEST(EnergyIntervalTest, Update_NotValid_NoChange)
+{
+    EnergyInterval interval;
+
+    ASSERT_FALSE(interval.IsValid());
+    ASSERT_FALSE(interval.Update(1000, 500));
+}
+
+TEST(EnergyIntervalTest, Update_ChangedOnlyIfWhChanged)
+{
+    EnergyInterval interval;
+    interval.SetBegin(1000000, 500000);
+
+    ASSERT_TRUE(interval.Update(1012345, 500100)); // first update formats the texts
+    ASSERT_STREQ(interval.GetPlusText(), "12.345kWh");
+    ASSERT_STREQ(interval.GetMinusText(), "0.100kWh");
+    ASSERT_STREQ(interval.GetSumText(), "12.245kWh");
+    ASSERT_FALSE(interval.Update(1012345, 500100));
+
+    ASSERT_TRUE(interval.Update(1012345, 513000));
+    ASSERT_EQ(interval.GetMinus(), 13000);
+    ASSERT_STREQ(interval.GetSumText(), "-0.655kWh");
+}
+
+TEST(EnergyIntervalTest, SetBegin_Changed_TextsUpdated)
+{
+    EnergyInterval interval;
+    interval.SetBegin(1000000, 500000);
+    interval.Update(1002000, 500000);
+
+    interval.SetBegin(1001000, 500000);
+
+    ASSERT_TRUE(interval.Update(1002000, 500000));
+    ASSERT_STREQ(interval.GetPlusText(), "1.000kWh");
+}
+
+TEST(EnergyIntervalTest, GetDurationSeconds_FromBeginDate)
+{
+    EnergyInterval interval;
+    MeterTimestamp begin = CreateTimestamp(2024, 2, 28);
+    begin.hour = 0;
+    interval.SetBeginDate(begin);
+
+    MeterTimestamp now = CreateTimestamp(2024, 3, 1); // leap year
+    now.minute = 30;
+    ASSERT_EQ(interval.GetDurationSeconds(now), 2 * 24 * 3600 + 12 * 3600 + 30 * 60);
+}
+
+TEST(EnergyIntervalTest, FormatTimespan_DaysAndTime)
+{
+    char text[TIMESPAN_TEXT_SIZE];
+
+    FormatTimespan(text, sizeof(text), 0);
+    ASSERT_STREQ(text, "0d 00:00:00");
+    FormatTimespan(text, sizeof(text), 400 * 24 * 3600 + 2 * 3600 + 3 * 60 + 4);
+    ASSERT_STREQ(text, "400d 02:03:04");
+    FormatTimespan(text, sizeof(text), -5); // begin date in the future
+    ASSERT_STREQ(text, "0d 00:00:00");
+}
+
+TEST(CalendarEnergyTest, Update_FirstFrame_AllPeriodsBegin)
+{
+    CalendarEnergy energy;
+
+    ASSERT_TRUE(energy.Update(CreateTimestamp(2024, 3, 17), 1000000, 500000));
+    ASSERT_FALSE(energy.Update(CreateTimestamp(2024, 3, 17), 1001000, 500000));
+
+    for (auto period : {CalendarEnergy::Day, CalendarEnergy::Month, CalendarEnergy::Year})
+    {
+        ASSERT_TRUE(energy.Get(period).IsValid());
+        ASSERT_EQ(energy.Get(period).GetPlus(), 1000);
+    }
+}
+
+TEST(CalendarEnergyTest, Update_NewDayMonthYear_PeriodsBegin)
+{
+    CalendarEnergy energy;
+    energy.Update(CreateTimestamp(2024, 12, 30), 1000000, 0);
+
+    ASSERT_TRUE(energy.Update(CreateTimestamp(2024, 12, 31), 1001000, 0)); // new day
+    energy.Update(CreateTimestamp(2024, 12, 31), 1001500, 0);
+    ASSERT_EQ(energy.Get(CalendarEnergy::Day).GetPlus(), 500);
+    ASSERT_EQ(energy.Get(CalendarEnergy::Month).GetPlus(), 1500);
+    ASSERT_EQ(energy.Get(CalendarEnergy::Year).GetPlus(), 1500);
+
+    ASSERT_TRUE(energy.Update(CreateTimestamp(2025, 1, 1), 1002000, 0)); // new year
+    energy.Update(CreateTimestamp(2025, 1, 1), 1002100, 0);
+    ASSERT_EQ(energy.Get(CalendarEnergy::Day).GetPlus(), 100);
+    ASSERT_EQ(energy.Get(CalendarEnergy::Month).GetPlus(), 100);
+    ASSERT_EQ(energy.Get(CalendarEnergy::Year).GetPlus(), 100);
+}
+
+TEST(CalendarEnergyTest, Restore_SameDay_Continued)
+{
+    CalendarEnergy energy;
+    energy.Update(CreateTimestamp(2024, 3, 1), 1000000, 0);
+    energy.Update(CreateTimestamp(2024, 3, 17), 1100000, 0);
+    const CalendarEnergy::State state = energy.GetState();
+
+    CalendarEnergy restored;
+    restored.Restore(state);
+
+    ASSERT_FALSE(restored.Update(CreateTimestamp(2024, 3, 17), 1100500, 0));
+    ASSERT_EQ(restored.Get(CalendarEnergy::Day).GetPlus(), 500);
+    ASSERT_EQ(restored.Get(CalendarEnergy::Month).GetPlus(), 100500);
+}
+
+TEST(CalendarEnergyTest, Update_InvalidTimestamp_NoPeriodBegins)
+{
+    CalendarEnergy energy;
+
+    ASSERT_FALSE(energy.Update(MeterTimestamp(), 1000000, 0));
+    ASSERT_FALSE(energy.Get(CalendarEnergy::Day).IsValid());
+}
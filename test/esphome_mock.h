@@ -1,81 +1,43 @@
+#pragma once
+
+#include "esphome_host.h"
+#include "./esphome-dlms-meter/espdm_byte_stream.h"
+
 #include <algorithm>
+#include <cstdint>
 #include <deque>
-#include <functional>
-#include <memory>
 #include <vector>
 
-#define ESP_LOGV(tag, ...)
-#define ESP_LOGD(tag, ...)
-#define ESP_LOGW(tag, ...)
-#define TAG
-
 namespace esphome
 {
-namespace uart
-{
-class UARTDevice
+
+// ByteStream of the tests: reads m_rx, writes to m_tx
+class MockByteStream : public espdm::ByteStream
 {
 public:
-    std::deque<uint8_t> m_uartRx;
-    std::deque<uint8_t> m_uartTx;
+    std::deque<uint8_t> m_rx;
+    std::deque<uint8_t> m_tx;
 
-    void AddRx(const std::vector<uint8_t> data)
+    void AddRx(const std::vector<uint8_t>& data)
     {
-        for (const uint8_t& d : data)
-        {
-            m_uartRx.push_back(d);
-        }
+        m_rx.insert(m_rx.end(), data.begin(), data.end());
     }
-    bool available()
+
+    size_t Read(uint8_t* data, size_t size) override
     {
-        return m_uartRx.size() > 0;
+        const size_t length = std::min(size, m_rx.size());
+        std::copy(m_rx.begin(), m_rx.begin() + length, data);
+        m_rx.erase(m_rx.begin(), m_rx.begin() + length);
+        return length;
     }
-    bool read_byte(uint8_t* byte)
+
+    bool Write(const uint8_t* data, size_t size) override
     {
-        if (!available())
-            return false;
-        *byte = m_uartRx.front();
-        m_uartRx.pop_front();
+        m_tx.insert(m_tx.end(), data, data + size);
         return true;
     }
-    void write_byte(uint8_t data)
-    {
-        m_uartTx.push_back(data);
-    }
-    void write_array(const std::vector<uint8_t>& data)
-    {
-        for (const uint8_t& d : data)
-        {
-            m_uartTx.push_back(d);
-        }
-    }
-    void flush() { }
 };
 
-} // namespace uart
-
-uint16_t crc16(const uint8_t* data, uint8_t len)
-{
-    uint16_t crc = 0xFFFF;
-    while (len--)
-    {
-        crc ^= *data++;
-        for (uint8_t i = 0; i < 8; i++)
-        {
-            if ((crc & 0x01) != 0)
-            {
-                crc >>= 1;
-                crc ^= 0xA001;
-            }
-            else
-            {
-                crc >>= 1;
-            }
-        }
-    }
-    return crc;
-}
-
 template <typename T>
 T Convert2BigEndian(T n)
 {
@@ -0,0 +1,278 @@
+#include <gtest/gtest.h>
+#include "ram_flash.h"
+
+#include <algorithm>
+#include <numeric>
+
+using namespace esphome::sm;
+
+namespace
+{
+struct TestRecord
+{
+    uint32_t time;
+    uint32_t value;
+};
+
+using TestLog = FlashLog<TestRecord>;
+constexpr size_t SECTOR_COUNT = 8;
+constexpr uint32_t SLOTS = TestLog::GetSlotsPerSector();
+
+std::vector<TestRecord> ReadAll(TestLog& log, uint32_t from = 0)
+{
+    std::vector<TestRecord> records;
+    auto cursor = log.Seek(from);
+    TestRecord record;
+    while (log.Next(cursor, record))
+    {
+        records.push_back(record);
+    }
+    return records;
+}
+
+void AppendRange(TestLog& log, uint32_t first, uint32_t count)
+{
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        ASSERT_TRUE(log.Append({i * 10, i}));
+    }
+}
+
+uint32_t GetEraseCount(const RamFlash& flash)
+{
+    const auto& eraseCounts = flash.GetEraseCounts();
+    return std::accumulate(eraseCounts.begin(), eraseCounts.end(), 0u);
+}
+
+} // namespace
+
+TEST(FlashLogTest, Mount_EmptyFlash_EmptyWithoutErase)
+{
+    RamFlash flash(SECTOR_COUNT);
+    TestLog log(flash, 0, SECTOR_COUNT);
+
+    ASSERT_TRUE(log.Mount());
+    ASSERT_EQ(log.GetSize(), 0);
+    ASSERT_EQ(log.GetCapacity(), SECTOR_COUNT * SLOTS);
+    ASSERT_TRUE(ReadAll(log).empty());
+    ASSERT_EQ(GetEraseCount(flash), 0);
+
+    AppendRange(log, 1, 1); // erases the first sector
+    ASSERT_EQ(GetEraseCount(flash), 1);
+    ASSERT_EQ(ReadAll(log).size(), 1);
+}
+
+TEST(FlashLogTest, AppendAndRemount_RecordsRestored)
+{
+    RamFlash flash(SECTOR_COUNT);
+    const uint32_t count = SLOTS * 2 + 5;
+    {
+        TestLog log(flash, 0, SECTOR_COUNT);
+        ASSERT_TRUE(log.Mount());
+        AppendRange(log, 1, count);
+    }
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+
+    ASSERT_EQ(log.GetSize(), count);
+    const auto records = ReadAll(log);
+    ASSERT_EQ(records.size(), count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ASSERT_EQ(records[i].value, i + 1);
+    }
+    AppendRange(log, count + 1, 1); // continues after the last one
+    ASSERT_EQ(ReadAll(log).back().value, count + 1);
+}
+
+TEST(FlashLogTest, Append_Full_OldestSectorDroppedAndWearLevelled)
+{
+    RamFlash flash(SECTOR_COUNT);
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+    const uint32_t rounds = 10;
+    const uint32_t count = SECTOR_COUNT * SLOTS * rounds;
+
+    AppendRange(log, 1, count);
+
+    const auto records = ReadAll(log);
+    ASSERT_GT(records.size(), (SECTOR_COUNT - 1) * SLOTS);
+    ASSERT_EQ(records.back().value, count);
+    for (size_t i = 1; i < records.size(); i++)
+    {
+        ASSERT_EQ(records[i].value, records[i - 1].value + 1);
+    }
+    // each sector is erased once per round
+    const auto& eraseCounts = flash.GetEraseCounts();
+    const auto minMax = std::minmax_element(eraseCounts.begin(), eraseCounts.end());
+    ASSERT_LE(*minMax.second - *minMax.first, 1);
+    ASSERT_LE(*minMax.second, rounds + 1);
+}
+
+TEST(FlashLogTest, Seek_FirstRecordAtOrAfterTime)
+{
+    RamFlash flash(SECTOR_COUNT);
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+    const uint32_t count = SECTOR_COUNT * SLOTS * 3 / 2; // wrapped
+    AppendRange(log, 1, count);
+    const uint32_t oldest = ReadAll(log).front().value;
+
+    for (uint32_t value : {oldest, oldest + 1, oldest + SLOTS, (oldest + count) / 2, count})
+    {
+        ASSERT_EQ(ReadAll(log, value * 10).front().value, value);
+        ASSERT_EQ(ReadAll(log, value * 10 - 5).front().value, value); // between two records
+    }
+    ASSERT_EQ(ReadAll(log, 0).front().value, oldest);
+    ASSERT_TRUE(ReadAll(log, count * 10 + 1).empty());
+}
+
+TEST(FlashLogTest, Next_SectorOverwrittenWhileReading_ContinuesAtOldest)
+{
+    RamFlash flash(SECTOR_COUNT);
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+    AppendRange(log, 1, SECTOR_COUNT * SLOTS);
+    auto cursor = log.Seek(0);
+    TestRecord record;
+    ASSERT_TRUE(log.Next(cursor, record));
+
+    AppendRange(log, SECTOR_COUNT * SLOTS + 1, SLOTS * 2); // drops the sector of the cursor
+
+    ASSERT_TRUE(log.Next(cursor, record));
+    ASSERT_EQ(record.value, ReadAll(log).front().value);
+}
+
+TEST(FlashLogTest, PowerLoss_TornRecord_SkippedAndSlotNotReused)
+{
+    RamFlash flash(SECTOR_COUNT);
+    {
+        TestLog log(flash, 0, SECTOR_COUNT);
+        ASSERT_TRUE(log.Mount());
+        AppendRange(log, 1, 3);
+        flash.LimitNextWrite(5); // time and one byte of the value
+        log.Append({40, 4});
+    }
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+    AppendRange(log, 5, 1);
+
+    const auto records = ReadAll(log);
+    ASSERT_EQ(records.size(), 4);
+    ASSERT_EQ(records[2].value, 3);
+    ASSERT_EQ(records[3].value, 5);
+}
+
+TEST(FlashLogTest, PowerLoss_TornSectorHeader_SectorIgnored)
+{
+    RamFlash flash(SECTOR_COUNT);
+    {
+        TestLog log(flash, 0, SECTOR_COUNT);
+        ASSERT_TRUE(log.Mount());
+        AppendRange(log, 1, SLOTS);
+        flash.LimitNextWrite(6); // header of the next sector
+        log.Append({(SLOTS + 1) * 10, SLOTS + 1});
+    }
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+    AppendRange(log, SLOTS + 2, 1);
+
+    const auto records = ReadAll(log);
+    ASSERT_EQ(records.size(), SLOTS + 1);
+    ASSERT_EQ(records.back().value, SLOTS + 2);
+}
+
+TEST(FlashLogTest, Regions_Independent)
+{
+    RamFlash flash(SECTOR_COUNT);
+    TestLog first(flash, 0, SECTOR_COUNT / 2);
+    TestLog second(flash, SECTOR_COUNT / 2, SECTOR_COUNT / 2);
+    ASSERT_TRUE(first.Mount());
+    ASSERT_TRUE(second.Mount());
+
+    AppendRange(first, 1, SLOTS * 5);
+    AppendRange(second, 1000, 3);
+
+    ASSERT_EQ(ReadAll(second).size(), 3);
+    ASSERT_EQ(ReadAll(second).front().value, 1000);
+    ASSERT_EQ(ReadAll(first).back().value, SLOTS * 5);
+}
+
+TEST(FlashLogTest, EraseAhead_AppendDoesNotErase)
+{
+    RamFlash flash(SECTOR_COUNT);
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+    ASSERT_TRUE(log.IsEraseAheadPending());
+    ASSERT_TRUE(log.EraseAhead());
+    ASSERT_FALSE(log.IsEraseAheadPending());
+    ASSERT_FALSE(log.EraseAhead()); // nothing to do
+
+    // Several round trips of the ring, erased ahead once per sector
+    for (uint32_t i = 1; i <= SECTOR_COUNT * SLOTS * 3; i++)
+    {
+        const uint32_t erases = GetEraseCount(flash);
+        ASSERT_TRUE(log.Append({i * 10, i}));
+        ASSERT_EQ(GetEraseCount(flash), erases) << "record " << i;
+        log.EraseAhead();
+    }
+    const auto records = ReadAll(log);
+    ASSERT_GE(records.size(), (SECTOR_COUNT - 2) * SLOTS);
+    ASSERT_EQ(records.back().value, SECTOR_COUNT * SLOTS * 3);
+}
+
+TEST(FlashLogTest, EraseAhead_FullRing_OldestSectorDroppedFirst)
+{
+    RamFlash flash(SECTOR_COUNT);
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+    AppendRange(log, 1, SECTOR_COUNT * SLOTS + 1); // full ring, head has one record
+    const uint32_t oldest = ReadAll(log).front().value;
+    auto cursor = log.Seek(0);
+    TestRecord record;
+    ASSERT_TRUE(log.Next(cursor, record));
+    ASSERT_EQ(record.value, oldest);
+
+    ASSERT_TRUE(log.EraseAhead());
+
+    ASSERT_EQ(ReadAll(log).front().value, oldest + SLOTS);
+    ASSERT_TRUE(log.Next(cursor, record));
+    ASSERT_EQ(record.value, oldest + SLOTS); // continues at the new oldest one
+    ASSERT_EQ(log.GetSize(), (SECTOR_COUNT - 2) * SLOTS + 1);
+}
+
+TEST(FlashLogTest, EraseAhead_Remount_RecordsRestored)
+{
+    RamFlash flash(SECTOR_COUNT);
+    const uint32_t count = SECTOR_COUNT * SLOTS + 5;
+    {
+        TestLog log(flash, 0, SECTOR_COUNT);
+        ASSERT_TRUE(log.Mount());
+        AppendRange(log, 1, count);
+        ASSERT_TRUE(log.EraseAhead());
+    }
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+
+    const auto records = ReadAll(log);
+    ASSERT_EQ(records.size(), (SECTOR_COUNT - 2) * SLOTS + 5);
+    ASSERT_EQ(records.back().value, count);
+    AppendRange(log, count + 1, SLOTS);
+    ASSERT_EQ(ReadAll(log).back().value, count + SLOTS);
+}
+
+TEST(FlashLogTest, Format_AllErased_FirstSectorReady)
+{
+    RamFlash flash(SECTOR_COUNT);
+    TestLog log(flash, 0, SECTOR_COUNT);
+    ASSERT_TRUE(log.Mount());
+    AppendRange(log, 1, SLOTS * 2);
+
+    ASSERT_TRUE(log.Format());
+
+    ASSERT_EQ(log.GetSize(), 0);
+    ASSERT_FALSE(log.IsEraseAheadPending());
+    const uint32_t erases = GetEraseCount(flash);
+    AppendRange(log, 1, 1);
+    ASSERT_EQ(GetEraseCount(flash), erases);
+}
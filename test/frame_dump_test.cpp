@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include "alloc_tracker.h"
+#include "../src/frame_dump.h"
+
+#include <string>
+
+using namespace esphome::sm;
+
+namespace
+{
+// Header of a record: sequence, time, length
+constexpr size_t RECORD_HEADER_SIZE = 10;
+
+std::vector<uint8_t> GetFrame(uint8_t first, size_t length)
+{
+    std::vector<uint8_t> frame(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        frame[i] = static_cast<uint8_t>(first + i);
+    }
+    return frame;
+}
+
+// Reads all frames, returns their sequences
+std::vector<uint32_t> ReadSequences(FrameDump::Reader& reader)
+{
+    std::vector<uint32_t> sequences;
+    FrameDump::Frame frame;
+    uint8_t data[FrameDump::MAX_FRAME_LENGTH];
+    while (reader.Next(frame, data))
+    {
+        sequences.push_back(frame.sequence);
+    }
+    return sequences;
+}
+
+} // namespace
+
+TEST(FrameDumpTest, Next_Empty_False)
+{
+    FrameDump dump(1024);
+    FrameDump::Reader reader(dump);
+    FrameDump::Frame frame;
+    uint8_t data[FrameDump::MAX_FRAME_LENGTH];
+
+    ASSERT_FALSE(reader.Next(frame, data));
+    ASSERT_EQ(dump.GetFrameCount(), 0);
+}
+
+TEST(FrameDumpTest, Add_TwoFrames_ReadOldestFirst)
+{
+    FrameDump dump(1024);
+    const auto first = GetFrame(0x68, 20);
+    const auto second = GetFrame(0x10, 3);
+    dump.Add(1000, first.data(), first.size());
+    dump.Add(6000, second.data(), second.size());
+    FrameDump::Reader reader(dump);
+    FrameDump::Frame frame;
+    uint8_t data[FrameDump::MAX_FRAME_LENGTH];
+
+    ASSERT_TRUE(reader.Next(frame, data));
+    ASSERT_EQ(frame.sequence, 0);
+    ASSERT_EQ(frame.timeMs, 1000);
+    ASSERT_EQ(std::vector<uint8_t>(data, data + frame.length), first);
+    ASSERT_TRUE(reader.Next(frame, data));
+    ASSERT_EQ(frame.sequence, 1);
+    ASSERT_EQ(frame.timeMs, 6000);
+    ASSERT_EQ(std::vector<uint8_t>(data, data + frame.length), second);
+    ASSERT_FALSE(reader.Next(frame, data));
+}
+
+TEST(FrameDumpTest, Add_Full_OldestDroppedAndWrappedFrameIntact)
+{
+    // 3 records fit, the 4th wraps around the end of the buffer
+    const size_t frameLength = 290;
+    FrameDump dump(3 * (RECORD_HEADER_SIZE + frameLength) + 100);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        const auto frame = GetFrame(i, frameLength);
+        dump.Add(i, frame.data(), frame.size());
+    }
+    FrameDump::Reader reader(dump);
+    FrameDump::Frame frame;
+    uint8_t data[FrameDump::MAX_FRAME_LENGTH];
+
+    ASSERT_EQ(dump.GetFrameCount(), 3);
+    ASSERT_EQ(dump.GetDroppedCount(), 1);
+    for (uint8_t i = 1; i < 4; i++)
+    {
+        ASSERT_TRUE(reader.Next(frame, data));
+        ASSERT_EQ(frame.sequence, i);
+        ASSERT_EQ(std::vector<uint8_t>(data, data + frame.length), GetFrame(i, frameLength));
+    }
+    ASSERT_FALSE(reader.Next(frame, data));
+}
+
+TEST(FrameDumpTest, Next_OvertakenByAdd_ContinuesWithOldest)
+{
+    const size_t frameLength = 100;
+    FrameDump dump(4 * (RECORD_HEADER_SIZE + frameLength));
+    const auto frame = GetFrame(0, frameLength);
+    for (int i = 0; i < 4; i++)
+    {
+        dump.Add(i, frame.data(), frame.size());
+    }
+    FrameDump::Reader reader(dump);
+    FrameDump::Frame read;
+    uint8_t data[FrameDump::MAX_FRAME_LENGTH];
+    ASSERT_TRUE(reader.Next(read, data));
+
+    // frames 0 - 5 are dropped
+    for (int i = 0; i < 6; i++)
+    {
+        dump.Add(i, frame.data(), frame.size());
+    }
+
+    ASSERT_EQ(ReadSequences(reader), (std::vector<uint32_t>{6, 7, 8, 9}));
+}
+
+TEST(FrameDumpTest, Add_TooLong_Truncated)
+{
+    FrameDump dump(4096);
+    const auto frame = GetFrame(0, FrameDump::MAX_FRAME_LENGTH + 10);
+    dump.Add(0, frame.data(), frame.size());
+    FrameDump::Reader reader(dump);
+    FrameDump::Frame read;
+    uint8_t data[FrameDump::MAX_FRAME_LENGTH];
+
+    const size_t maxLength = FrameDump::MAX_FRAME_LENGTH;
+    ASSERT_TRUE(reader.Next(read, data));
+    ASSERT_EQ(read.length, maxLength);
+}
+
+TEST(FrameDumpTest, Add_AfterConstruction_NoHeapAllocations)
+{
+    FrameDump dump(1024);
+    const auto frame = GetFrame(0, 300);
+
+    alloc_tracker::Scope scope;
+    for (int i = 0; i < 100; i++)
+    {
+        dump.Add(i, frame.data(), frame.size());
+    }
+
+    ASSERT_EQ(scope.GetAllocations(), 0);
+}
+
+TEST(FrameDumpTest, GetCapacity_BelowOneFrame_OneMaxFrame)
+{
+    ASSERT_EQ(FrameDump(16 * 1024).GetCapacity(), 16 * 1024);
+    ASSERT_EQ(FrameDump(0).GetCapacity(), RECORD_HEADER_SIZE + FrameDump::MAX_FRAME_LENGTH);
+}
+
+TEST(FrameDumpTest, Format_Frame_HexLine)
+{
+    const uint8_t data[] = {0x68, 0xFA, 0x0F};
+    FrameDump::Frame frame;
+    frame.sequence = 7;
+    frame.timeMs = 12345;
+    frame.length = sizeof(data);
+    char line[FrameDump::MAX_LINE_LENGTH];
+
+    const size_t length = FrameDump::Format(frame, data, line, sizeof(line));
+
+    ASSERT_EQ(std::string(line), "7 12345 3: 68 FA 0F\n");
+    ASSERT_EQ(length, 20);
+}
+
+TEST(FrameDumpTest, Format_MaxLength_FitsMaxLine)
+{
+    const auto data = GetFrame(0, FrameDump::MAX_FRAME_LENGTH);
+    FrameDump::Frame frame;
+    frame.sequence = 0xFFFFFFFF;
+    frame.timeMs = 0xFFFFFFFF;
+    frame.length = FrameDump::MAX_FRAME_LENGTH;
+    char line[FrameDump::MAX_LINE_LENGTH];
+
+    const size_t length = FrameDump::Format(frame, data.data(), line, sizeof(line));
+
+    ASSERT_EQ(line[length - 1], '\n');
+    ASSERT_EQ(length, 27 + 3 * FrameDump::MAX_FRAME_LENGTH);
+}
@@ -0,0 +1,20 @@
+// Fuzz target: OBIS decoder of the decrypted dlms-frame, as the DECODE stage of DlmsMeter
+#include "esphome_mock.h"
+#include "fuzz_timing.h"
+#include "../src/esphome-dlms-meter/espdm_obis_decoder.h"
+
+using namespace esphome::espdm;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static fuzz::TimePerByte timePerByte("dlms");
+    timePerByte.Measure(size, [&]() {
+        const ObisDecoder decoder;
+        MeterData meterData;
+        if (decoder.Decode(data, size, meterData) == ObisDecoder::Result::OK)
+        {
+            ObisDecoder::Complete(meterData);
+        }
+    });
+    return 0;
+}
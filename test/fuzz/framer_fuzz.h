@@ -0,0 +1,46 @@
+#pragma once
+
+#include "fuzz_timing.h"
+#include "../src/esphome-dlms-meter/espdm_dlms_frame.h"
+
+#include <vector>
+
+namespace fuzz
+{
+
+// The FRAME stage of DlmsMeter: the framer ( HdlcProtocol, MbusProtocol ) is fed chunk by chunk, its payloads are
+// assembled into dlms-frames. addPayload(dlmsFrame, payload, reason) adds one payload of the framer.
+template <typename Framer, typename AddPayload>
+void RunFrameStage(const uint8_t* data, size_t size, AddPayload addPayload)
+{
+    using esphome::espdm::AbortReason;
+    using esphome::espdm::DlmsFrame;
+
+    Framer framer;
+    DlmsFrame dlmsFrame;
+    std::vector<uint8_t> payload;
+    ForEachChunk(data, size, [&](const uint8_t* chunk, size_t chunkSize) {
+        for (size_t i = 0; i < chunkSize; i++)
+        {
+            framer.AddFrameData(chunk[i]);
+        }
+        while (framer.GetPayload(payload))
+        {
+            AbortReason reason;
+            if (addPayload(dlmsFrame, payload, reason) == DlmsFrame::Result::COMPLETE)
+            {
+                uint8_t iv[DlmsFrame::IV_LENGTH];
+                dlmsFrame.GetIv(iv);
+                // The ciphertext must be part of the received data ( capacity of the buffer is not checked by ASan )
+                const auto& received = dlmsFrame.GetData();
+                if (dlmsFrame.GetCiphertext() + dlmsFrame.GetMessageLength() > received.data() + received.size())
+                {
+                    std::abort();
+                }
+                dlmsFrame.Clear();
+            }
+        }
+    });
+}
+
+} // namespace fuzz
@@ -0,0 +1,178 @@
+// Standalone driver of the fuzz targets for compilers without libFuzzer ( e.g. gcc ), built with the sanitizers
+// Usage: <target>_fuzz [-runs=N] [-seed=N] [files or directories ...]
+// Runs each input file once, then N random mutations of them ( or of random data without inputs ).
+// An input which crashes or aborts the target is written to crash-<seed>-<run>.
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sanitizer/common_interface_defs.h>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace
+{
+constexpr size_t MAX_INPUT_SIZE = 4096;
+
+using Input = std::vector<uint8_t>;
+
+const Input* g_input = nullptr;
+char g_crashFileName[64] = "crash-input";
+
+void SaveInput()
+{
+    if (g_input == nullptr)
+    {
+        return;
+    }
+    FILE* file = fopen(g_crashFileName, "wb");
+    if (file != nullptr)
+    {
+        fwrite(g_input->data(), 1, g_input->size(), file);
+        fclose(file);
+        fprintf(stderr, "Input of %zu bytes written to %s\n", g_input->size(), g_crashFileName);
+    }
+    g_input = nullptr;
+}
+
+void OnAbort(int)
+{
+    SaveInput();
+    std::signal(SIGABRT, SIG_DFL);
+    std::abort();
+}
+
+void Load(const std::string& path, std::vector<Input>& inputs)
+{
+    DIR* directory = opendir(path.c_str());
+    if (directory != nullptr)
+    {
+        while (dirent* entry = readdir(directory))
+        {
+            if (entry->d_name[0] != '.')
+            {
+                Load(path + "/" + entry->d_name, inputs);
+            }
+        }
+        closedir(directory);
+        return;
+    }
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        fprintf(stderr, "Can not open %s\n", path.c_str());
+        return;
+    }
+    inputs.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Runs the input from an own allocation of its exact size, so the sanitizer detects reads past the end
+void Run(const Input& input)
+{
+    g_input = &input;
+    std::unique_ptr<uint8_t[]> data(new uint8_t[input.size()]);
+    std::copy(input.begin(), input.end(), data.get());
+    LLVMFuzzerTestOneInput(data.get(), input.size());
+    g_input = nullptr;
+}
+
+void Mutate(Input& input, std::mt19937& random)
+{
+    const int count = 1 + static_cast<int>(random() % 8);
+    for (int i = 0; i < count; i++)
+    {
+        const size_t position = input.empty() ? 0 : random() % input.size();
+        switch (random() % 5)
+        {
+        case 0: // change a byte
+            if (!input.empty())
+            {
+                input[position] = static_cast<uint8_t>(random());
+            }
+            break;
+        case 1: // insert a byte
+            input.insert(input.begin() + position, static_cast<uint8_t>(random()));
+            break;
+        case 2: // remove a byte
+            if (!input.empty())
+            {
+                input.erase(input.begin() + position);
+            }
+            break;
+        case 3: // repeat a part ( e.g. a frame )
+        {
+            const size_t length = std::min<size_t>(input.size() - position, 1 + random() % 300);
+            const Input part(input.begin() + position, input.begin() + position + length);
+            input.insert(input.begin() + random() % (input.size() + 1), part.begin(), part.end());
+            break;
+        }
+        default: // truncate
+            input.resize(position);
+            break;
+        }
+    }
+    if (input.size() > MAX_INPUT_SIZE)
+    {
+        input.resize(MAX_INPUT_SIZE);
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    unsigned long runs = 100000;
+    unsigned long seed = std::random_device()();
+    std::vector<Input> inputs;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strncmp(argv[i], "-runs=", 6) == 0)
+        {
+            runs = std::strtoul(argv[i] + 6, nullptr, 10);
+        }
+        else if (std::strncmp(argv[i], "-seed=", 6) == 0)
+        {
+            seed = std::strtoul(argv[i] + 6, nullptr, 10);
+        }
+        else
+        {
+            Load(argv[i], inputs);
+        }
+    }
+    __sanitizer_set_death_callback(SaveInput);
+    std::signal(SIGABRT, OnAbort);
+    for (const auto& input : inputs)
+    {
+        Run(input);
+    }
+    std::mt19937 random(static_cast<std::mt19937::result_type>(seed));
+    fprintf(stderr, "%zu inputs, %lu runs, seed %lu\n", inputs.size(), runs, seed);
+    for (unsigned long run = 0; run < runs; run++)
+    {
+        Input input;
+        if (inputs.empty())
+        {
+            input.resize(random() % MAX_INPUT_SIZE);
+            for (auto& data : input)
+            {
+                data = static_cast<uint8_t>(random());
+            }
+        }
+        else
+        {
+            input = inputs[random() % inputs.size()];
+        }
+        Mutate(input, random);
+        snprintf(g_crashFileName, sizeof(g_crashFileName), "crash-%lu-%lu", seed, run);
+        Run(input);
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Writes a seed corpus of valid frames for the fuzz targets: <dir>/mbus, hdlc, dlms and modbus
+// Usage: fuzz_seed_corpus <dir>, then e.g. "mbus_fuzz <dir>/mbus"
+#include "esphome_mock.h"
+#include "dlms_frame_builder.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+
+namespace
+{
+
+bool Write(const std::string& dir, const std::string& name, const std::vector<uint8_t>& data)
+{
+    mkdir(dir.c_str(), 0755);
+    std::ofstream file(dir + "/" + name, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(file);
+}
+
+std::vector<uint8_t> BuildModbusRequest(uint8_t address, uint8_t functionCode, uint16_t start, uint16_t count)
+{
+    std::vector<uint8_t> request = {address, functionCode};
+    dlms_frame_builder::AddUint16(request, start);
+    dlms_frame_builder::AddUint16(request, count);
+    const uint16_t crc = esphome::crc16(request.data(), static_cast<uint8_t>(request.size()));
+    request.push_back(crc & 0xFF);
+    request.push_back(crc >> 8);
+    return request;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s <dir>\n", argv[0]);
+        return 1;
+    }
+    const std::string dir = argv[1];
+    mkdir(dir.c_str(), 0755);
+    const uint8_t iv[12] = {0x4B, 0x46, 0x4D, 0x10, 0x20, 0x01, 0x23, 0x45, 0x00, 0x00, 0x00, 0x01};
+    // Content of the ciphertext is not checked by the framers, the plaintext is used
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+    const auto dlmsFrame = dlms_frame_builder::BuildDlmsFrame(plaintext, iv);
+    auto mbusFrames = dlms_frame_builder::BuildMbusFrames(dlmsFrame);
+    auto hdlcFrames = dlms_frame_builder::BuildHdlcFrames(dlmsFrame);
+
+    bool ok = Write(dir + "/dlms", "plaintext", plaintext);
+    ok = Write(dir + "/mbus", "frame", mbusFrames) && ok;
+    ok = Write(dir + "/hdlc", "frame", hdlcFrames) && ok;
+    // Two frames, as received by the uart
+    const auto mbusFrame = mbusFrames;
+    const auto hdlcFrame = hdlcFrames;
+    mbusFrames.insert(mbusFrames.end(), mbusFrame.begin(), mbusFrame.end());
+    hdlcFrames.insert(hdlcFrames.end(), hdlcFrame.begin(), hdlcFrame.end());
+    ok = Write(dir + "/mbus", "frames", mbusFrames) && ok;
+    ok = Write(dir + "/hdlc", "frames", hdlcFrames) && ok;
+    ok = Write(dir + "/modbus", "read_header", BuildModbusRequest(1, 0x03, 40000, 2)) && ok;
+    ok = Write(dir + "/modbus", "read_model", BuildModbusRequest(1, 0x03, 40069, 105)) && ok;
+    ok = Write(dir + "/modbus", "other_address", BuildModbusRequest(2, 0x03, 40000, 2)) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stddef.h>
+#include <stdint.h>
+
+// Max. processing time per input byte of a fuzz target, finds algorithmic blowups ( e.g. quadratic resync )
+// A new maximum is printed to stderr. If the environment variable FUZZ_MAX_NS_PER_BYTE is set, a slower input aborts,
+// so the fuzzer stores it as crash input.
+namespace fuzz
+{
+
+constexpr size_t CHUNK_SIZE = 64; // bytes read from the uart per loop
+
+// Calls function(chunk, chunkSize) for each CHUNK_SIZE part of the input, as the loop reads the uart
+template <typename Function> void ForEachChunk(const uint8_t* data, size_t size, Function function)
+{
+    for (size_t offset = 0; offset < size; offset += CHUNK_SIZE)
+    {
+        function(data + offset, std::min(CHUNK_SIZE, size - offset));
+    }
+}
+
+class TimePerByte
+{
+public:
+    // Short inputs are dominated by the fixed cost of a call, they are measured as MIN_SIZE bytes
+    static constexpr size_t MIN_SIZE = 64;
+    static constexpr int REPEAT_COUNT = 4;
+
+    explicit TimePerByte(const char* name)
+        : m_name(name)
+    {
+        const char* limit = std::getenv("FUZZ_MAX_NS_PER_BYTE");
+        m_limitNs = limit != nullptr ? std::strtod(limit, nullptr) : 0.0;
+    }
+
+    ~TimePerByte()
+    {
+        fprintf(stderr, "%s: max %.1f ns per byte ( input of %zu bytes )\n", m_name, m_maxNs, m_maxSize);
+    }
+
+    template <typename Function> void Measure(size_t size, Function function)
+    {
+        double ns = GetNsPerByte(size, function);
+        if (ns <= m_maxNs && (m_limitNs <= 0.0 || ns <= m_limitNs))
+        {
+            return;
+        }
+        // Repeat a slow input, so a preemption or cold cache is not reported
+        for (int i = 0; i < REPEAT_COUNT; i++)
+        {
+            ns = std::min(ns, GetNsPerByte(size, function));
+        }
+        if (ns > m_maxNs)
+        {
+            m_maxNs = ns;
+            m_maxSize = size;
+            fprintf(stderr, "%s: new max %.1f ns per byte ( input of %zu bytes )\n", m_name, ns, size);
+        }
+        if (m_limitNs > 0.0 && ns > m_limitNs)
+        {
+            fprintf(stderr, "%s: %.1f ns per byte exceeds FUZZ_MAX_NS_PER_BYTE\n", m_name, ns);
+            std::abort();
+        }
+    }
+
+private:
+    const char* m_name;
+    double m_limitNs{0.0};
+    double m_maxNs{0.0};
+    size_t m_maxSize{0};
+
+    template <typename Function> static double GetNsPerByte(size_t size, Function function)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto duration = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration<double, std::nano>(duration).count() / (size > MIN_SIZE ? size : MIN_SIZE);
+    }
+};
+
+} // namespace fuzz
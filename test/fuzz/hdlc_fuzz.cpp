@@ -0,0 +1,18 @@
+// Fuzz target: HDLC framer and dlms-frame assembly, as the FRAME stage of DlmsMeter
+#include "esphome_mock.h"
+#include "framer_fuzz.h"
+#include "../src/esphome-dlms-meter/espdm_hdlc.h"
+
+using namespace esphome::espdm;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static fuzz::TimePerByte timePerByte("hdlc");
+    timePerByte.Measure(size, [&]() {
+        fuzz::RunFrameStage<HdlcProtocol>(
+            data, size, [](DlmsFrame& dlmsFrame, const std::vector<uint8_t>& payload, AbortReason& reason) {
+                return dlmsFrame.AddPayload(payload, HdlcProtocol::DLMS_OFFSET, reason);
+            });
+    });
+    return 0;
+}
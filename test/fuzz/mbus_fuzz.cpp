@@ -0,0 +1,18 @@
+// Fuzz target: M-Bus framer and dlms-frame assembly, as the FRAME stage of DlmsMeter
+#include "esphome_mock.h"
+#include "framer_fuzz.h"
+#include "../src/esphome-dlms-meter/espdm_mbus.h"
+
+using namespace esphome::espdm;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static fuzz::TimePerByte timePerByte("mbus");
+    timePerByte.Measure(size, [&]() {
+        fuzz::RunFrameStage<MbusProtocol>(
+            data, size, [](DlmsFrame& dlmsFrame, const std::vector<uint8_t>& payload, AbortReason& reason) {
+                return dlmsFrame.AddMbusPayload(payload, reason);
+            });
+    });
+    return 0;
+}
@@ -0,0 +1,36 @@
+// Fuzz target: Modbus RTU server with the Sunspec MeterModel, as the SmartMeter serves it
+#include "esphome_mock.h"
+#include "fuzz_timing.h"
+#include "meter_model_bridge.h"
+
+using namespace esphome;
+
+namespace
+{
+constexpr uint8_t MODBUS_ADDRESS = 1;
+
+void Run(const uint8_t* data, size_t size)
+{
+    static sunspec::MeterModel model(MODBUS_ADDRESS);
+    model.SetUpdateTime(millis());
+    modbus::ModbusServer server(MODBUS_ADDRESS,
+                                [](uint8_t functionCode, const modbus::ModbusServer::RequestRead& request) {
+                                    return sm::ReadMeterModel(model, functionCode, request, millis());
+                                });
+    MockByteStream stream;
+    server.SetStream(stream);
+    fuzz::ForEachChunk(data, size, [&](const uint8_t* chunk, size_t chunkSize) {
+        stream.m_rx.insert(stream.m_rx.end(), chunk, chunk + chunkSize);
+        server.ProcessRequest();
+        stream.m_tx.clear();
+    });
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static fuzz::TimePerByte timePerByte("modbus");
+    timePerByte.Measure(size, [&]() { Run(data, size); });
+    return 0;
+}
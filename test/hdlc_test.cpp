@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "dlms_frame_builder.h"
+#include "../src/esphome-dlms-meter/espdm_dlms_frame.h"
+#include "../src/esphome-dlms-meter/espdm_hdlc.h"
+
+using namespace esphome::espdm;
+
+namespace
+{
+const uint8_t IV[DlmsFrame::IV_LENGTH] = {1, 2, 3, 4, 5, 6, 7, 8, 0x00, 0x01, 0x02, 0x03};
+
+std::vector<uint8_t> GetDlmsFrame()
+{
+    return dlms_frame_builder::BuildDlmsFrame(dlms_frame_builder::BuildPlaintext(), IV);
+}
+
+// Returns all payloads of data
+std::vector<std::vector<uint8_t>> AddData(HdlcProtocol& hdlc, const std::vector<uint8_t>& data)
+{
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<uint8_t> payload;
+    for (const auto byte : data)
+    {
+        hdlc.AddFrameData(byte);
+        // Byte by byte, as in the RECEIVE/FRAME stages
+        while (hdlc.GetPayload(payload))
+        {
+            payloads.push_back(payload);
+        }
+    }
+    return payloads;
+}
+
+std::vector<uint8_t> GetInformation(const std::vector<uint8_t>& dlmsFrame)
+{
+    // LLC header and the dlms-frame
+    std::vector<uint8_t> information(3 + dlmsFrame.size());
+    information[0] = 0xE6;
+    information[1] = 0xE7;
+    information[2] = 0x00;
+    std::copy(dlmsFrame.begin(), dlmsFrame.end(), information.begin() + 3);
+    return information;
+}
+
+} // namespace
+
+TEST(HdlcTest, CalculateFcs_Table_EqualToBitwise)
+{
+    std::vector<uint8_t> data(256);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    ASSERT_EQ(HdlcProtocol::CalculateFcs(data.data(), data.size()),
+              dlms_frame_builder::CalculateHdlcFcs(data, 0, data.size()));
+    // Check value of CRC-16/X-25
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    ASSERT_EQ(HdlcProtocol::CalculateFcs(check, sizeof(check)), 0x906E);
+}
+
+TEST(HdlcTest, GetPayload_SingleFrame_InformationField)
+{
+    HdlcProtocol hdlc;
+    const auto dlmsFrame = GetDlmsFrame();
+
+    const auto payloads = AddData(hdlc, dlms_frame_builder::BuildHdlcFrames(dlmsFrame, 1024));
+
+    ASSERT_EQ(payloads.size(), 1);
+    ASSERT_EQ(payloads[0], GetInformation(dlmsFrame));
+    ASSERT_EQ(hdlc.GetResyncCount(), 0);
+}
+
+TEST(HdlcTest, GetPayload_SegmentedFrame_Reassembled)
+{
+    HdlcProtocol hdlc;
+    const auto dlmsFrame = GetDlmsFrame();
+    const auto frames = dlms_frame_builder::BuildHdlcFrames(dlmsFrame, 100);
+
+    const auto payloads = AddData(hdlc, frames);
+
+    ASSERT_EQ(payloads.size(), 1);
+    ASSERT_EQ(payloads[0], GetInformation(dlmsFrame));
+    ASSERT_EQ(hdlc.GetResyncCount(), 0);
+}
+
+TEST(HdlcTest, GetPayload_SharedFlags_AllFrames)
+{
+    HdlcProtocol hdlc;
+    const auto frame = dlms_frame_builder::BuildHdlcFrames(GetDlmsFrame(), 1024);
+    // Closing flag of a frame is the opening flag of the next one
+    auto data = frame;
+    data.insert(data.end(), frame.begin() + 1, frame.end());
+    data.insert(data.end(), frame.begin(), frame.end());
+
+    ASSERT_EQ(AddData(hdlc, data).size(), 3);
+    ASSERT_EQ(hdlc.GetResyncCount(), 0);
+}
+
+TEST(HdlcTest, GetPayload_InvalidFcs_FrameSkippedNextFrameOk)
+{
+    HdlcProtocol hdlc;
+    const auto frame = dlms_frame_builder::BuildHdlcFrames(GetDlmsFrame(), 1024);
+    auto data = frame;
+    data[20] ^= 0x01;
+    data.insert(data.end(), frame.begin(), frame.end());
+
+    const auto payloads = AddData(hdlc, data);
+
+    ASSERT_EQ(payloads.size(), 1);
+    ASSERT_GE(hdlc.GetResyncCount(), 1);
+}
+
+TEST(HdlcTest, GetPayload_InvalidHcs_FrameSkipped)
+{
+    HdlcProtocol hdlc;
+    auto frame = dlms_frame_builder::BuildHdlcFrames(GetDlmsFrame(), 1024);
+    // Invalid HCS with a valid FCS
+    frame[6] ^= 0xFF;
+    const auto fcs = dlms_frame_builder::CalculateHdlcFcs(frame, 1, frame.size() - 3);
+    frame[frame.size() - 3] = fcs & 0xFF;
+    frame[frame.size() - 2] = fcs >> 8;
+
+    ASSERT_EQ(AddData(hdlc, frame).size(), 0);
+    ASSERT_GE(hdlc.GetResyncCount(), 1);
+}
+
+TEST(HdlcTest, GetPayload_NoiseBeforeFrame_Synced)
+{
+    HdlcProtocol hdlc;
+    std::vector<uint8_t> data = {0x00, 0x7E, 0x12, 0x7E, 0xA0, 0x05, 0x7E, 0xFF};
+    const auto frame = dlms_frame_builder::BuildHdlcFrames(GetDlmsFrame(), 1024);
+    data.insert(data.end(), frame.begin(), frame.end());
+
+    ASSERT_EQ(AddData(hdlc, data).size(), 1);
+}
+
+TEST(HdlcTest, GetPayload_FrameWithoutInformation_NoPayload)
+{
+    HdlcProtocol hdlc;
+    std::vector<uint8_t> frame = {0x7E, 0xA0, 0x07, 0x41, 0x03, 0x53};
+    const auto fcs = dlms_frame_builder::CalculateHdlcFcs(frame, 1, frame.size());
+    frame.push_back(fcs & 0xFF);
+    frame.push_back(fcs >> 8);
+    frame.push_back(0x7E);
+    const auto next = dlms_frame_builder::BuildHdlcFrames(GetDlmsFrame(), 1024);
+    frame.insert(frame.end(), next.begin(), next.end());
+
+    ASSERT_EQ(AddData(hdlc, frame).size(), 1);
+    ASSERT_EQ(hdlc.GetResyncCount(), 0);
+}
+
+TEST(HdlcTest, GetPayload_NoiseLongerThanBuffer_NextFrameOk)
+{
+    HdlcProtocol hdlc;
+    std::vector<uint8_t> data(5000, 0x55);
+    const auto frame = dlms_frame_builder::BuildHdlcFrames(GetDlmsFrame(), 1024);
+    data.insert(data.end(), frame.begin(), frame.end());
+    std::vector<uint8_t> payload;
+    // All at once, the buffer overflows
+    for (const auto byte : data)
+    {
+        hdlc.AddFrameData(byte);
+    }
+
+    ASSERT_TRUE(hdlc.GetPayload(payload));
+}
+
+TEST(HdlcTest, DlmsFrame_HdlcPayload_Complete)
+{
+    HdlcProtocol hdlc;
+    const auto payloads = AddData(hdlc, dlms_frame_builder::BuildHdlcFrames(GetDlmsFrame(), 100));
+    DlmsFrame frame;
+    AbortReason reason;
+    const size_t dlmsOffset = HdlcProtocol::DLMS_OFFSET;
+
+    ASSERT_EQ(frame.AddPayload(payloads[0], dlmsOffset, reason), DlmsFrame::Result::COMPLETE);
+    ASSERT_EQ(frame.GetFrameCounter(), 0x00010203);
+    ASSERT_EQ(frame.GetMessageLength(), dlms_frame_builder::BuildPlaintext().size());
+}
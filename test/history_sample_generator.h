@@ -0,0 +1,62 @@
+#pragma once
+
+#include "../src/meter_history.h"
+
+#include <algorithm>
+
+// Creates HistorySamples for tests and benchmarks
+namespace history_sample_generator
+{
+using esphome::sm::HistorySample;
+
+constexpr uint32_t START_TIME = 1710678896; // 2024-03-17 12:34:56
+constexpr uint32_t FRAME_INTERVAL_S = 5;
+
+// Household like data: random walk of voltages and power, appliance switched on/off, energy counted up
+class SampleGenerator
+{
+public:
+    HistorySample Next()
+    {
+        HistorySample sample;
+        sample.time = m_time;
+        m_time += FRAME_INTERVAL_S;
+        m_power += static_cast<int32_t>(Random() % 61) - 30;
+        m_power = std::max(m_power, -3000);
+        m_power = std::min(m_power, 6000);
+        const int32_t appliance = (m_time / 600) % 3 == 0 ? 2000 : 0;
+        const int32_t power = m_power + appliance;
+        for (int i = 0; i < 3; i++)
+        {
+            auto& voltage = m_voltages[i];
+            voltage += static_cast<int32_t>(Random() % 7) - 3;
+            voltage = std::max(voltage, 2250);
+            voltage = std::min(voltage, 2350);
+            sample.values[HistorySample::VoltageL1 + i] = voltage;
+            sample.values[HistorySample::CurrentL1 + i] = (power * (i + 1) / 6) * 1000 / voltage;
+        }
+        sample.values[HistorySample::ActivePowerPlus] = std::max(power, 0);
+        sample.values[HistorySample::ActivePowerMinus] = std::max(-power, 0);
+        m_energyPlus += std::max(power, 0) * static_cast<int32_t>(FRAME_INTERVAL_S);
+        m_energyMinus += std::max(-power, 0) * static_cast<int32_t>(FRAME_INTERVAL_S);
+        sample.values[HistorySample::ActiveEnergyPlus] = 12345678 + m_energyPlus / 3600;
+        sample.values[HistorySample::ActiveEnergyMinus] = 2345678 + m_energyMinus / 3600;
+        return sample;
+    }
+
+private:
+    uint32_t m_random{1};
+    uint32_t m_time{START_TIME};
+    int32_t m_power{500};
+    int32_t m_voltages[3]{2300, 2310, 2290};
+    int32_t m_energyPlus{0}; // Ws
+    int32_t m_energyMinus{0};
+
+    uint32_t Random()
+    {
+        m_random = m_random * 1664525u + 1013904223u;
+        return m_random >> 8;
+    }
+};
+
+} // namespace history_sample_generator
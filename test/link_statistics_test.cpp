@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include "dlms_frame_builder.h"
+#include "../src/esphome-dlms-meter/espdm_link_statistics.h"
+#include "../src/esphome-dlms-meter/espdm_mbus.h"
+#include "../src/esphome-dlms-meter/espdm_meter_data.h"
+
+using namespace esphome::espdm;
+
+TEST(LinkStatisticsTest, AddFrameCounter_Consecutive_NoGap)
+{
+    LinkStatistics statistics;
+
+    for (uint32_t counter = 100; counter < 110; counter++)
+    {
+        statistics.AddFrameCounter(counter);
+    }
+
+    ASSERT_EQ(statistics.frameCounterGaps, 0);
+    ASSERT_EQ(statistics.lostFrames, 0);
+    ASSERT_EQ(statistics.lastFrameCounter, 109);
+}
+
+TEST(LinkStatisticsTest, AddFrameCounter_Gaps_LostFramesCounted)
+{
+    LinkStatistics statistics;
+
+    statistics.AddFrameCounter(100);
+    statistics.AddFrameCounter(103); // 2 lost
+    statistics.AddFrameCounter(104);
+    statistics.AddFrameCounter(110); // 5 lost
+    statistics.AddFrameCounter(5); // meter restarted, no gap
+
+    ASSERT_EQ(statistics.frameCounterGaps, 2);
+    ASSERT_EQ(statistics.lostFrames, 7);
+}
+
+TEST(LinkStatisticsTest, AddAbort_CountedPerReason)
+{
+    LinkStatistics statistics;
+
+    statistics.AddAbort(AbortReason::UNSUPPORTED_CIPHER);
+    statistics.AddAbort(AbortReason::DECODE_FAILED);
+    statistics.AddAbort(AbortReason::DECODE_FAILED);
+
+    ASSERT_EQ(statistics.aborts[static_cast<size_t>(AbortReason::UNSUPPORTED_CIPHER)], 1);
+    ASSERT_EQ(statistics.aborts[static_cast<size_t>(AbortReason::DECODE_FAILED)], 2);
+    ASSERT_EQ(statistics.GetAbortCount(), 3);
+}
+
+TEST(LinkStatisticsTest, MbusGetPayload_NoiseBeforeFrame_ResyncCounted)
+{
+    MbusProtocol mbus;
+    std::vector<uint8_t> payload;
+    const auto frame = dlms_frame_builder::BuildMbusFrame({1, 2, 3});
+
+    for (const auto d : frame)
+    {
+        mbus.AddFrameData(d);
+    }
+    ASSERT_TRUE(mbus.GetPayload(payload));
+    ASSERT_EQ(mbus.GetResyncCount(), 0);
+
+    for (const auto d : {0x00, 0x16, 0x68})
+    {
+        mbus.AddFrameData(d);
+    }
+    for (const auto d : frame)
+    {
+        mbus.AddFrameData(d);
+    }
+    ASSERT_TRUE(mbus.GetPayload(payload));
+    ASSERT_EQ(mbus.GetResyncCount(), 1);
+}
+
+TEST(LinkStatisticsTest, MeterTimestampToSeconds_DataAge)
+{
+    MeterTimestamp timestamp;
+    timestamp.year = 2024;
+    timestamp.month = 3;
+    timestamp.day = 17;
+    timestamp.hour = 12;
+    timestamp.minute = 34;
+    timestamp.second = 56;
+
+    ASSERT_EQ(timestamp.ToSeconds(), 1710678896);
+
+    MeterTimestamp nextYear = timestamp;
+    nextYear.year = 2025;
+    nextYear.month = 1;
+    nextYear.day = 1;
+    nextYear.hour = 0;
+    nextYear.minute = 0;
+    nextYear.second = 5;
+    MeterTimestamp lastYear = nextYear;
+    lastYear.year = 2024;
+    lastYear.month = 12;
+    lastYear.day = 31;
+    lastYear.hour = 23;
+    lastYear.minute = 59;
+    lastYear.second = 55;
+    ASSERT_EQ(nextYear.ToSeconds() - lastYear.ToSeconds(), 10);
+}
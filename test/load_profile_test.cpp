@@ -0,0 +1,282 @@
+#include <gtest/gtest.h>
+#include "ram_flash.h"
+#include "../src/load_profile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+using namespace esphome::sm;
+
+namespace
+{
+constexpr uint32_t START_TIME = 1710633600; // 2024-03-17 00:00:00 UTC
+constexpr uint32_t FRAME_INTERVAL_S = 5;
+
+struct TierRecord
+{
+    LoadProfileTier tier;
+    LoadProfileRecord record;
+};
+
+// Constant power, energy counted up
+class FrameGenerator
+{
+public:
+    template <typename Target>
+    void Run(Target& target, uint32_t durationS, int32_t power)
+    {
+        for (uint32_t i = 0; i < durationS / FRAME_INTERVAL_S; i++)
+        {
+            // The meter sends whole Wh
+            target.Add(m_time, power, static_cast<uint32_t>(llround(m_energyPlus)),
+                       static_cast<uint32_t>(llround(m_energyMinus)));
+            m_time += FRAME_INTERVAL_S;
+            const double energy = power * static_cast<double>(FRAME_INTERVAL_S) / 3600.0;
+            (power >= 0 ? m_energyPlus : m_energyMinus) += std::fabs(energy);
+        }
+    }
+
+    uint32_t GetTime() const
+    {
+        return m_time;
+    }
+
+private:
+    uint32_t m_time{START_TIME};
+    double m_energyPlus{1000000.0}; // Wh
+    double m_energyMinus{500000.0};
+};
+
+} // namespace
+
+TEST(LoadProfileAggregatorTest, Add_MinutePeriod_MinAvgMaxAndEnergy)
+{
+    std::vector<TierRecord> records;
+    LoadProfileAggregator aggregator(
+        [&records](LoadProfileTier tier, const LoadProfileRecord& record) { records.push_back({tier, record}); });
+
+    aggregator.Add(START_TIME, 100, 1000, 50);
+    aggregator.Add(START_TIME + 20, 400, 1002, 50);
+    aggregator.Add(START_TIME + 40, -200, 1004, 50);
+    ASSERT_TRUE(records.empty());
+    aggregator.Add(START_TIME + 60, 0, 1004, 51); // next minute
+
+    ASSERT_EQ(records.size(), 1);
+    const auto& record = records[0].record;
+    ASSERT_EQ(records[0].tier, LoadProfileTier::Minute);
+    ASSERT_EQ(record.time, START_TIME);
+    ASSERT_EQ(record.sampleCount, 3);
+    ASSERT_EQ(record.minPower, -200);
+    ASSERT_EQ(record.avgPower, 100);
+    ASSERT_EQ(record.maxPower, 400);
+    ASSERT_EQ(record.energyPlus, 4);
+    ASSERT_EQ(record.energyMinus, 1);
+}
+
+TEST(LoadProfileAggregatorTest, Add_OneDay_AllTiersAndEnergySumsUp)
+{
+    std::vector<TierRecord> records;
+    LoadProfileAggregator aggregator(
+        [&records](LoadProfileTier tier, const LoadProfileRecord& record) { records.push_back({tier, record}); });
+    FrameGenerator generator;
+
+    generator.Run(aggregator, 12 * 3600, 1200);
+    generator.Run(aggregator, 12 * 3600, -600);
+    generator.Run(aggregator, FRAME_INTERVAL_S, 0); // closes the day
+
+    uint32_t counts[3] = {0, 0, 0};
+    uint64_t energyPlus[3] = {0, 0, 0};
+    uint64_t energyMinus[3] = {0, 0, 0};
+    for (const auto& tierRecord : records)
+    {
+        const size_t tier = static_cast<size_t>(tierRecord.tier);
+        counts[tier]++;
+        energyPlus[tier] += tierRecord.record.energyPlus;
+        energyMinus[tier] += tierRecord.record.energyMinus;
+    }
+    ASSERT_EQ(counts[0], 24 * 60);
+    ASSERT_EQ(counts[1], 24 * 4);
+    ASSERT_EQ(counts[2], 1);
+    for (size_t tier = 0; tier < 3; tier++)
+    {
+        ASSERT_EQ(energyPlus[tier], 12 * 1200) << "tier " << tier;
+        ASSERT_EQ(energyMinus[tier], 12 * 600) << "tier " << tier;
+    }
+    const auto& day = records.back().record;
+    ASSERT_EQ(day.time, START_TIME);
+    ASSERT_EQ(day.sampleCount, 24 * 3600 / FRAME_INTERVAL_S);
+    ASSERT_EQ(day.minPower, -600);
+    ASSERT_EQ(day.avgPower, 300);
+    ASSERT_EQ(day.maxPower, 1200);
+}
+
+TEST(LoadProfileAggregatorTest, Add_GapAndTimeStepBack_NoRecordForMissingPeriods)
+{
+    std::vector<TierRecord> records;
+    LoadProfileAggregator aggregator(
+        [&records](LoadProfileTier tier, const LoadProfileRecord& record) { records.push_back({tier, record}); });
+
+    aggregator.Add(START_TIME, 100, 1000, 0);
+    aggregator.Add(START_TIME + 300, 100, 1010, 0); // 5 minutes later
+    ASSERT_EQ(records.size(), 1);
+    ASSERT_EQ(records[0].record.time, START_TIME);
+    ASSERT_EQ(records[0].record.energyPlus, 10);
+
+    aggregator.Add(START_TIME + 100, 100, 1011, 0); // time step back, period dropped
+    aggregator.Add(START_TIME + 400, 100, 1012, 0);
+    ASSERT_EQ(records.size(), 2);
+    ASSERT_EQ(records[1].record.time, START_TIME + 60);
+    ASSERT_EQ(records[1].record.energyPlus, 1);
+}
+
+TEST(LoadProfileTest, Query_TariffPeriodFromQuarterHours)
+{
+    RamFlash flash(40);
+    LoadProfile loadProfile(flash);
+    ASSERT_TRUE(loadProfile.Mount());
+    FrameGenerator generator;
+    generator.Run(loadProfile, 6 * 3600, 400);
+    generator.Run(loadProfile, 4 * 3600, 2000); // peak tariff 06:00-10:00
+    generator.Run(loadProfile, 2 * 3600, 400);
+
+    uint32_t energy = 0;
+    const size_t count = loadProfile.Query(LoadProfileTier::QuarterHour, START_TIME + 6 * 3600,
+                                           START_TIME + 10 * 3600, 1000,
+                                           [&energy](const LoadProfileRecord& record) { energy += record.energyPlus; });
+
+    ASSERT_EQ(count, 16);
+    ASSERT_EQ(energy, 4 * 2000);
+}
+
+TEST(LoadProfileTest, Query_MaxRecords_Bounded)
+{
+    RamFlash flash(40);
+    LoadProfile loadProfile(flash);
+    ASSERT_TRUE(loadProfile.Mount());
+    FrameGenerator generator;
+    generator.Run(loadProfile, 3600, 400);
+
+    const size_t count = loadProfile.Query(LoadProfileTier::Minute, 0, UINT32_MAX, 10,
+                                           [](const LoadProfileRecord&) {});
+
+    ASSERT_EQ(count, 10);
+}
+
+TEST(LoadProfileTest, Remount_RecordsPersisted)
+{
+    RamFlash flash(40);
+    FrameGenerator generator;
+    {
+        LoadProfile loadProfile(flash);
+        ASSERT_TRUE(loadProfile.Mount());
+        generator.Run(loadProfile, 2 * 24 * 3600 + FRAME_INTERVAL_S, 100);
+    }
+    LoadProfile loadProfile(flash);
+    ASSERT_TRUE(loadProfile.Mount());
+
+    // 20 sectors of minute records, the oldest are dropped
+    const size_t slots = LoadProfile::Log::GetSlotsPerSector();
+    ASSERT_GE(loadProfile.GetLog(LoadProfileTier::Minute).GetSize(), 19 * slots);
+    ASSERT_LE(loadProfile.GetLog(LoadProfileTier::Minute).GetSize(), 20 * slots);
+    size_t minutes = loadProfile.Query(LoadProfileTier::Minute, START_TIME + 2 * 24 * 3600 - 60, UINT32_MAX, 10,
+                                       [](const LoadProfileRecord& record) { ASSERT_EQ(record.energyPlus, 2); });
+    ASSERT_EQ(minutes, 1);
+    ASSERT_EQ(loadProfile.GetLog(LoadProfileTier::QuarterHour).GetSize(), 2 * 24 * 4);
+    ASSERT_EQ(loadProfile.GetLog(LoadProfileTier::Day).GetSize(), 2);
+    size_t days = loadProfile.Query(LoadProfileTier::Day, 0, UINT32_MAX, 10, [](const LoadProfileRecord& record) {
+        ASSERT_EQ(record.energyPlus, 24 * 100);
+    });
+    ASSERT_EQ(days, 2);
+}
+
+TEST(LoadProfileTest, CsvReader_ChunksSmallerThanHeaderAndLine_SameText)
+{
+    RamFlash flash(40);
+    LoadProfile loadProfile(flash);
+    ASSERT_TRUE(loadProfile.Mount());
+    FrameGenerator generator;
+    generator.Run(loadProfile, 3 * 3600, 400);
+    const auto cursor = loadProfile.GetLog(LoadProfileTier::QuarterHour).Seek(START_TIME + 3600);
+    std::string expected;
+    {
+        LoadProfileCsvReader reader(LoadProfileTier::QuarterHour, cursor, START_TIME + 2 * 3600);
+        char buffer[4096];
+        for (size_t length = reader.Read(&loadProfile, buffer, sizeof(buffer)); length != 0;
+             length = reader.Read(&loadProfile, buffer, sizeof(buffer)))
+        {
+            expected.append(buffer, length);
+        }
+    }
+    const std::string header = LoadProfileCsvReader::HEADER;
+    ASSERT_EQ(expected.substr(0, header.size()), header);
+    ASSERT_EQ(std::count(expected.begin(), expected.end(), '\n'), 1 + 4);
+
+    for (size_t chunkSize : {1, 5, 40, 100})
+    {
+        LoadProfileCsvReader reader(LoadProfileTier::QuarterHour, cursor, START_TIME + 2 * 3600);
+        std::string text;
+        // guard bytes behind the chunk must stay untouched
+        std::vector<char> buffer(chunkSize + 16, '#');
+        for (size_t length = reader.Read(&loadProfile, buffer.data(), chunkSize); length != 0;
+             length = reader.Read(&loadProfile, buffer.data(), chunkSize))
+        {
+            ASSERT_LE(length, chunkSize);
+            ASSERT_EQ(std::string(&buffer[chunkSize], 16), std::string(16, '#'));
+            text.append(buffer.data(), length);
+        }
+        ASSERT_EQ(text, expected) << "chunk size " << chunkSize;
+    }
+}
+
+TEST(LoadProfileTest, CsvReader_NoLoadProfile_HeaderOnly)
+{
+    LoadProfileCsvReader reader(LoadProfileTier::Day, LoadProfile::Log::Cursor(), UINT32_MAX);
+    char buffer[256];
+
+    const size_t length = reader.Read(nullptr, buffer, sizeof(buffer));
+
+    ASSERT_EQ(std::string(buffer, length), std::string(LoadProfileCsvReader::HEADER));
+    ASSERT_EQ(reader.Read(nullptr, buffer, sizeof(buffer)), 0);
+}
+
+TEST(SharedLoadProfileTest, Add_LargeMeterReadingsAndExport_ExactEnergyAndPowerInCsv)
+{
+    RamFlash flash(40);
+    SharedLoadProfile loadProfile;
+    ASSERT_TRUE(loadProfile.Mount(flash));
+    // Above 2^24 Wh a float has steps of 8 Wh, the 1 Wh per minute would be lost
+    const uint32_t energyPlus = 100000000;
+    const uint32_t energyMinus = 20000001;
+    for (uint32_t minute = 0; minute <= 15; minute++)
+    {
+        loadProfile.Add(START_TIME + minute * 60, -1234567, energyPlus + minute, energyMinus + 3 * minute);
+    }
+
+    ASSERT_EQ(loadProfile.GetSize(LoadProfileTier::Minute), 15);
+    ASSERT_EQ(loadProfile.GetSize(LoadProfileTier::QuarterHour), 1);
+    auto reader = loadProfile.CreateCsvReader(LoadProfileTier::QuarterHour, START_TIME, UINT32_MAX);
+    std::string text;
+    char buffer[32];
+    for (size_t length = loadProfile.ReadCsv(*reader, buffer, sizeof(buffer)); length != 0;
+         length = loadProfile.ReadCsv(*reader, buffer, sizeof(buffer)))
+    {
+        text.append(buffer, length);
+    }
+    ASSERT_EQ(text, std::string(LoadProfileCsvReader::HEADER) + "1710633600,15,-1234567,-1234567,-1234567,15,45\n");
+}
+
+TEST(SharedLoadProfileTest, NotMounted_AddIgnoredAndCsvHeaderOnly)
+{
+    SharedLoadProfile loadProfile;
+    loadProfile.Add(START_TIME, 100, 1000, 0);
+    ASSERT_FALSE(loadProfile.EraseAhead());
+    ASSERT_EQ(loadProfile.GetSize(LoadProfileTier::Minute), 0);
+
+    auto reader = loadProfile.CreateCsvReader(LoadProfileTier::Day, 0, UINT32_MAX);
+    char buffer[256];
+    const size_t length = loadProfile.ReadCsv(*reader, buffer, sizeof(buffer));
+
+    ASSERT_EQ(std::string(buffer, length), std::string(LoadProfileCsvReader::HEADER));
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include "sample_meter_data.h"
+#include "../src/meter_aggregator.h"
+
+using namespace esphome::sm;
+using namespace esphome::espdm;
+
+namespace
+{
+// The sample frame with other power, energy plus and time
+MeterData CreateMeterData(int32_t power, uint32_t energyPlus, const MeterTimestamp& timestamp = {2024, 3, 17, 12, 0, 0})
+{
+    MeterData data = sample_meter_data::Create();
+    data.activePowerPlus = power > 0 ? power : 0;
+    data.activePowerMinus = power < 0 ? -power : 0;
+    data.activeEnergyPlus = energyPlus;
+    data.timestamp = timestamp;
+    data.UpdateDerived();
+    return data;
+}
+
+} // namespace
+
+TEST(MeterAggregatorTest, Update_OneMeter_EqualToMeterData)
+{
+    MeterAggregator aggregator;
+    aggregator.AddMeter();
+    const auto data = CreateMeterData(1234, 12345678);
+
+    const auto& result = aggregator.Update(0, data, 1000);
+
+    ASSERT_EQ(result.voltageL2, data.voltageL2);
+    ASSERT_EQ(result.currentL3, data.currentL3);
+    ASSERT_EQ(result.activePowerPlus, data.activePowerPlus);
+    ASSERT_EQ(result.activeEnergyPlus, data.activeEnergyPlus);
+    ASSERT_EQ(result.reactiveEnergyMinus, data.reactiveEnergyMinus);
+    ASSERT_EQ(result.timestamp.ToSeconds(), data.timestamp.ToSeconds());
+    ASSERT_EQ(result.derived.power.total, data.derived.power.total);
+    ASSERT_EQ(result.derived.powerFactor, data.derived.powerFactor);
+}
+
+TEST(MeterAggregatorTest, Update_TwoMeters_Summed)
+{
+    MeterAggregator aggregator;
+    aggregator.AddMeter();
+    aggregator.AddMeter();
+    aggregator.Update(0, CreateMeterData(-3000, 1000000), 1000);
+
+    const auto& result = aggregator.Update(1, CreateMeterData(1000, 2000), 2000);
+
+    ASSERT_EQ(aggregator.GetLiveCount(), 2);
+    ASSERT_EQ(result.voltageL1, 2301); // average
+    ASSERT_EQ(result.currentL3, 2 * 345);
+    ASSERT_EQ(result.activePowerPlus, 1000);
+    ASSERT_EQ(result.activePowerMinus, 3000); // net export of both
+    ASSERT_EQ(result.activeEnergyPlus, 1002000);
+    ASSERT_EQ(result.activeEnergyMinus, 2 * 2345678);
+    ASSERT_EQ(result.reactiveEnergyMinus, 2 * 45678);
+}
+
+TEST(MeterAggregatorTest, Update_NewFrame_ReplacesContributionOfMeter)
+{
+    MeterAggregator aggregator;
+    aggregator.AddMeter();
+    aggregator.AddMeter();
+    aggregator.Update(0, CreateMeterData(500, 1000000), 1000);
+    aggregator.Update(1, CreateMeterData(1000, 2000), 2000);
+
+    // Many frames, the running sums must not drift
+    const MeterData* result = nullptr;
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        result = &aggregator.Update(i % 2, CreateMeterData(100 + (i % 2), 1000000 + i * 7), 3000 + i);
+    }
+
+    ASSERT_EQ(result->activePowerPlus, 201);
+    ASSERT_EQ(result->activeEnergyPlus, 2000000 + 99998 * 7 + 99999 * 7);
+}
+
+TEST(MeterAggregatorTest, Update_EnergyAboveFloatResolution_ExactSum)
+{
+    MeterAggregator aggregator;
+    aggregator.AddMeter();
+    aggregator.AddMeter();
+    aggregator.Update(0, CreateMeterData(0, 16777217), 0); // 2^24 + 1
+
+    ASSERT_EQ(aggregator.Update(1, CreateMeterData(0, 1), 0).activeEnergyPlus, 16777218u);
+    ASSERT_EQ(aggregator.Update(1, CreateMeterData(0, 2), 0).activeEnergyPlus, 16777219u);
+    // Saturated, the sum of the meters exceeds the counter range
+    ASSERT_EQ(aggregator.Update(1, CreateMeterData(0, UINT32_MAX), 0).activeEnergyPlus, UINT32_MAX);
+}
+
+TEST(MeterAggregatorTest, Update_RotatedPhases_Aligned)
+{
+    MeterAggregator aggregator;
+    aggregator.AddMeter();
+    aggregator.AddMeter({{1, 2, 0}}); // L1 of the heat pump is L2 of the house
+    aggregator.Update(0, CreateMeterData(0, 0), 0);
+    auto heatPump = CreateMeterData(0, 0);
+    heatPump.voltageL1 = 2400;
+    heatPump.currentL1 = 1000;
+    heatPump.voltageL3 = 0; // not measured
+
+    const auto& result = aggregator.Update(1, heatPump, 0);
+
+    ASSERT_EQ(result.currentL1, 123 + 345);
+    ASSERT_EQ(result.currentL2, 234 + 1000);
+    ASSERT_EQ(result.currentL3, 345 + 234);
+    ASSERT_EQ(result.voltageL1, 2301); // only the house
+    ASSERT_EQ(result.voltageL2, (2312 + 2400) / 2);
+    ASSERT_EQ(result.voltageL3, 2318); // 231.75V rounded
+}
+
+TEST(MeterAggregatorTest, Update_MeterWithoutFrames_OnlyEnergyKept)
+{
+    MeterAggregator aggregator;
+    aggregator.AddMeter();
+    aggregator.AddMeter();
+    aggregator.Update(0, CreateMeterData(500, 1000), 0);
+    aggregator.Update(1, CreateMeterData(1000, 2000), 0);
+
+    const auto& result = aggregator.Update(0, CreateMeterData(600, 1001), MeterAggregator::DEFAULT_MAX_AGE_MS + 1);
+
+    ASSERT_EQ(aggregator.GetLiveCount(), 1);
+    ASSERT_EQ(result.activePowerPlus, 600);
+    ASSERT_EQ(result.currentL1, 123);
+    ASSERT_EQ(result.activeEnergyPlus, 3001);
+
+    // Back again
+    ASSERT_EQ(aggregator.Update(1, CreateMeterData(1000, 2001), 40000).activePowerPlus, 1600);
+    ASSERT_EQ(aggregator.GetLiveCount(), 2);
+}
+
+TEST(MeterAggregatorTest, Update_DifferentMeterClocks_TimestampOfFirstMeter)
+{
+    MeterAggregator aggregator;
+    aggregator.AddMeter();
+    aggregator.AddMeter();
+    // Clock of the second meter is 1 minute ahead
+    aggregator.Update(1, CreateMeterData(0, 0, {2024, 3, 17, 12, 1, 0}), 0);
+    aggregator.Update(0, CreateMeterData(0, 0, {2024, 3, 17, 12, 0, 0}), 1000);
+
+    const auto& result = aggregator.Update(1, CreateMeterData(0, 0, {2024, 3, 17, 12, 1, 3}), 3500);
+
+    ASSERT_EQ(result.timestamp.minute, 0);
+    ASSERT_EQ(result.timestamp.second, 2); // 2.5s after the frame of the first meter
+}
+
+TEST(MeterAggregatorTest, AddMeter_TooManyOrInvalidPhase_Rejected)
+{
+    MeterAggregator aggregator;
+
+    ASSERT_EQ(aggregator.AddMeter({{0, 1, 3}}), -1);
+    for (size_t i = 0; i < MeterAggregator::MAX_METERS; i++)
+    {
+        ASSERT_EQ(aggregator.AddMeter(), static_cast<int>(i));
+    }
+    ASSERT_EQ(aggregator.AddMeter(), -1);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include "sample_meter_data.h"
+
+using namespace esphome::espdm;
+
+TEST(MeterDataTest, UpdateDerived_AllPhases_ValuesOk)
+{
+    // 230.1V 1.23A, 231.2V 2.34A, 232.3V 3.45A, 1234W
+    const auto data = sample_meter_data::Create();
+    const auto& derived = data.derived;
+
+    ASSERT_EQ(derived.voltage.total, 2312);
+    ASSERT_EQ(derived.voltage.phase2, 2312);
+    ASSERT_EQ(derived.voltagePhaseToPhase.total, 4005); // 231.2V * sqrt(3) in Q15 = 400.45V
+    ASSERT_EQ(derived.voltagePhaseToPhase.phase1, 3985); // 230.1V * sqrt(3) = 398.545V
+    ASSERT_EQ(derived.current.total, 702);
+    ASSERT_EQ(derived.apparentPower.phase3, 801); // 801.435VA
+    ASSERT_EQ(derived.apparentPower.total, 283 + 541 + 801);
+    ASSERT_EQ(derived.powerFactor, 759); // 1234 / 1625.466 = 0.75917
+    ASSERT_EQ(derived.power.total, 1234);
+    ASSERT_EQ(derived.power.phase1, 215); // 283.023 * 1234 / 1625.466 = 214.86
+    ASSERT_EQ(derived.reactivePower.total, 391);
+}
+
+TEST(MeterDataTest, UpdateDerived_MissingPhaseVoltage_AverageOfAvailablePhases)
+{
+    auto data = sample_meter_data::Create();
+    data.voltageL3 = 0;
+    data.UpdateDerived();
+
+    ASSERT_EQ(data.derived.voltage.total, 2307); // 230.65V
+}
+
+TEST(MeterDataTest, UpdateDerived_NoCurrent_PowerFactorIsOne)
+{
+    MeterData data;
+    data.voltageL1 = 2300;
+    data.UpdateDerived();
+
+    ASSERT_EQ(data.derived.powerFactor, 1000);
+    ASSERT_EQ(data.derived.power.total, 0);
+    ASSERT_EQ(data.derived.reactivePower.total, 0);
+}
+
+TEST(MeterDataTest, UpdateDerived_PowerToGrid_PowerFactorPositive)
+{
+    auto data = sample_meter_data::Create();
+    data.activePowerPlus = 0;
+    data.activePowerMinus = 1234;
+    data.currentL1 = -data.currentL1;
+    data.currentL2 = -data.currentL2;
+    data.currentL3 = -data.currentL3;
+    data.UpdateDerived();
+
+    ASSERT_EQ(data.derived.powerFactor, 759);
+    ASSERT_EQ(data.derived.apparentPower.total, -1625);
+    ASSERT_EQ(data.derived.power.phase1, -215);
+}
+
+TEST(MeterDataTest, UpdateDerived_SmallCurrents_PowerFactorFromExactProduct)
+{
+    // 230.1V * 0.04A = 9.204VA per phase, the power factor of the rounded 27VA would be 1
+    MeterData data;
+    data.voltageL1 = 2301;
+    data.voltageL2 = 2301;
+    data.voltageL3 = 2301;
+    data.currentL1 = 4;
+    data.currentL2 = 4;
+    data.currentL3 = 4;
+    data.activePowerPlus = 27;
+    data.UpdateDerived();
+
+    ASSERT_EQ(data.derived.apparentPower.phase1, 9);
+    ASSERT_EQ(data.derived.powerFactor, 978); // 27 / 27.612
+    ASSERT_EQ(data.derived.power.phase1, 9);
+}
+
+TEST(MeterDataTest, ToFloat_FixedPoint_NearestFloat)
+{
+    ASSERT_EQ(MeterData::ToVolt(2301), 230.1f);
+    ASSERT_EQ(MeterData::ToAmpere(-123), -1.23f);
+    ASSERT_EQ(MeterData::ToPowerFactor(716), 0.716f);
+}
+
+TEST(MeterDataTest, MeterTimestamp_FromSeconds_InverseOfToSeconds)
+{
+    // Leap day, end of year and begin of the epoch
+    const MeterTimestamp timestamps[] = {{2024, 2, 29, 23, 59, 59}, {2023, 12, 31, 12, 0, 1}, {1970, 1, 1, 0, 0, 0}};
+    for (const auto& timestamp : timestamps)
+    {
+        const auto result = MeterTimestamp::FromSeconds(timestamp.ToSeconds());
+
+        ASSERT_EQ(result.year, timestamp.year);
+        ASSERT_EQ(result.month, timestamp.month);
+        ASSERT_EQ(result.day, timestamp.day);
+        ASSERT_EQ(result.hour, timestamp.hour);
+        ASSERT_EQ(result.minute, timestamp.minute);
+        ASSERT_EQ(result.second, timestamp.second);
+    }
+    ASSERT_EQ(MeterTimestamp::FromSeconds(MeterTimestamp{2024, 2, 28, 23, 59, 59}.ToSeconds() + 1).day, 29);
+}
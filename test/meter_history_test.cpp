@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+#include "alloc_tracker.h"
+#include "history_sample_generator.h"
+#include "../src/meter_history.h"
+
+using namespace esphome::sm;
+
+namespace
+{
+using history_sample_generator::FRAME_INTERVAL_S;
+using history_sample_generator::SampleGenerator;
+using history_sample_generator::START_TIME;
+
+void ExpectEqual(const HistorySample& actual, const HistorySample& expected)
+{
+    ASSERT_EQ(actual.time, expected.time);
+    for (size_t i = 0; i < HistorySample::ChannelCount; i++)
+    {
+        ASSERT_EQ(actual.values[i], expected.values[i]) << "channel " << i;
+    }
+}
+
+} // namespace
+
+TEST(MeterHistoryTest, FromMeterData_FixedPointValues)
+{
+    esphome::espdm::MeterData data;
+    data.voltageL1 = 2301;
+    data.currentL2 = -234;
+    data.activePowerPlus = 1234;
+    data.activeEnergyMinus = 2345678;
+
+    const auto sample = HistorySample::FromMeterData(data, START_TIME);
+
+    ASSERT_EQ(sample.time, START_TIME);
+    ASSERT_EQ(sample.values[HistorySample::VoltageL1], 2301);
+    ASSERT_EQ(sample.values[HistorySample::CurrentL2], -234);
+    ASSERT_EQ(sample.values[HistorySample::ActivePowerPlus], 1234);
+    ASSERT_EQ(sample.values[HistorySample::ActiveEnergyMinus], 2345678);
+}
+
+TEST(MeterHistoryTest, Append_Read_SameSamples)
+{
+    MeterHistory history(8);
+    SampleGenerator generator;
+    std::vector<HistorySample> expected;
+    for (int i = 0; i < 500; i++)
+    {
+        expected.push_back(generator.Next());
+        history.Append(expected.back());
+    }
+    ASSERT_EQ(history.GetSampleCount(), 500);
+
+    MeterHistory::Reader reader(history);
+    HistorySample sample;
+    for (const auto& expectedSample : expected)
+    {
+        ASSERT_TRUE(reader.Next(sample));
+        ExpectEqual(sample, expectedSample);
+    }
+    ASSERT_FALSE(reader.Next(sample));
+}
+
+TEST(MeterHistoryTest, Append_IrregularTimeAndLargeSteps_SameSamples)
+{
+    MeterHistory history(2);
+    std::vector<HistorySample> expected(4);
+    expected[0].time = START_TIME;
+    expected[0].values[HistorySample::CurrentL1] = -3200;
+    expected[1].time = START_TIME + 5;
+    expected[1].values[HistorySample::CurrentL1] = 3200;
+    expected[1].values[HistorySample::ActiveEnergyPlus] = INT32_MAX;
+    expected[2].time = START_TIME + 17; // frames lost
+    expected[2].values[HistorySample::ActiveEnergyPlus] = INT32_MIN;
+    expected[3].time = START_TIME + 16; // time set back
+    for (const auto& sample : expected)
+    {
+        history.Append(sample);
+    }
+
+    MeterHistory::Reader reader(history);
+    HistorySample sample;
+    for (const auto& expectedSample : expected)
+    {
+        ASSERT_TRUE(reader.Next(sample));
+        ExpectEqual(sample, expectedSample);
+    }
+}
+
+TEST(MeterHistoryTest, Append_Full_OldestBlockDropped)
+{
+    MeterHistory history(4);
+    SampleGenerator generator;
+    std::vector<HistorySample> expected;
+    for (int i = 0; i < 5000; i++)
+    {
+        expected.push_back(generator.Next());
+        history.Append(expected.back());
+    }
+    ASSERT_LT(history.GetSampleCount(), 5000);
+    ASSERT_LE(history.GetUsedBytes(), history.GetCapacityBytes());
+
+    // newest samples are kept
+    MeterHistory::Reader reader(history);
+    HistorySample sample;
+    for (size_t i = expected.size() - history.GetSampleCount(); i < expected.size(); i++)
+    {
+        ASSERT_TRUE(reader.Next(sample));
+        ExpectEqual(sample, expected[i]);
+    }
+    ASSERT_FALSE(reader.Next(sample));
+}
+
+TEST(MeterHistoryTest, Reader_AppendWhileReading_ContinuesWithOldestOrNewSamples)
+{
+    MeterHistory history(2);
+    SampleGenerator generator;
+    for (int i = 0; i < 10; i++)
+    {
+        history.Append(generator.Next());
+    }
+    MeterHistory::Reader reader(history);
+    HistorySample sample;
+    ASSERT_TRUE(reader.Next(sample));
+    ASSERT_EQ(sample.time, START_TIME);
+
+    // both blocks are refilled, the block of the reader is dropped
+    uint32_t lastTime(0);
+    for (int i = 0; i < 1000; i++)
+    {
+        const auto newSample = generator.Next();
+        lastTime = newSample.time;
+        history.Append(newSample);
+    }
+    uint32_t previousTime = 0;
+    size_t count = 0;
+    while (reader.Next(sample))
+    {
+        ASSERT_GT(sample.time, previousTime);
+        previousTime = sample.time;
+        count++;
+    }
+    ASSERT_EQ(count, history.GetSampleCount());
+    ASSERT_EQ(previousTime, lastTime);
+
+    // new samples are read by the same reader
+    history.Append(generator.Next());
+    ASSERT_TRUE(reader.Next(sample));
+    ASSERT_EQ(sample.time, lastTime + FRAME_INTERVAL_S);
+}
+
+TEST(MeterHistoryTest, Append_NoHeapAllocation)
+{
+    MeterHistory history(4);
+    SampleGenerator generator;
+
+    alloc_tracker::Scope scope;
+    for (int i = 0; i < 5000; i++)
+    {
+        history.Append(generator.Next());
+    }
+    ASSERT_EQ(scope.GetAllocations(), 0);
+}
+
+TEST(MeterHistoryTest, Append_HouseholdData_24hFitIn96KByte)
+{
+    constexpr size_t SAMPLES_PER_DAY = 24 * 3600 / FRAME_INTERVAL_S;
+    MeterHistory history(96 * 1024 / MeterHistory::BLOCK_SIZE);
+    SampleGenerator generator;
+    for (size_t i = 0; i < SAMPLES_PER_DAY; i++)
+    {
+        history.Append(generator.Next());
+    }
+    RecordProperty("bytes_per_sample", std::to_string(static_cast<double>(history.GetUsedBytes()) / SAMPLES_PER_DAY));
+    ASSERT_EQ(history.GetSampleCount(), SAMPLES_PER_DAY);
+}
+
+TEST(MeterHistoryTest, CsvReader_HeaderAndLines)
+{
+    MeterHistory history(4);
+    HistorySample sample;
+    sample.time = 1700000000;
+    sample.values[HistorySample::VoltageL1] = 2301;
+    sample.values[HistorySample::CurrentL2] = -125;
+    sample.values[HistorySample::ActivePowerPlus] = 1150;
+    sample.values[HistorySample::ActiveEnergyPlus] = 123456;
+    history.Append(sample);
+
+    HistoryCsvReader reader(history);
+    char buffer[1024];
+    const size_t length = reader.Read(buffer, sizeof(buffer));
+
+    ASSERT_EQ(std::string(buffer, length),
+              std::string(HistoryCsvReader::HEADER) + "1700000000,230.1,0.0,0.0,0.00,-1.25,0.00,1150,0,123456,0\n");
+    ASSERT_EQ(reader.Read(buffer, sizeof(buffer)), 0);
+}
+
+TEST(MeterHistoryTest, CsvReader_ChunksSmallerThanHeaderAndLine_SameText)
+{
+    MeterHistory history(8);
+    SampleGenerator generator;
+    for (int i = 0; i < 200; i++)
+    {
+        history.Append(generator.Next());
+    }
+    std::string expected;
+    {
+        HistoryCsvReader reader(history);
+        char buffer[4096];
+        for (size_t length = reader.Read(buffer, sizeof(buffer)); length != 0;
+             length = reader.Read(buffer, sizeof(buffer)))
+        {
+            expected.append(buffer, length);
+        }
+    }
+
+    for (size_t chunkSize : {1, 7, 64, 150})
+    {
+        HistoryCsvReader reader(history);
+        std::string text;
+        // guard bytes behind the chunk must stay untouched
+        std::vector<char> buffer(chunkSize + 16, '#');
+        for (size_t length = reader.Read(buffer.data(), chunkSize); length != 0;
+             length = reader.Read(buffer.data(), chunkSize))
+        {
+            ASSERT_LE(length, chunkSize);
+            ASSERT_EQ(std::string(&buffer[chunkSize], 16), std::string(16, '#'));
+            text.append(buffer.data(), length);
+        }
+        ASSERT_EQ(text, expected) << "chunk size " << chunkSize;
+    }
+}
@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "alloc_tracker.h"
+#include "encrypted_frame_builder.h"
+#include "meter_pipeline.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+
+using namespace gateway;
+
+namespace
+{
+constexpr uint8_t MODBUS_ADDRESS = 1;
+
+// Read the 124 registers of the meter block, as sent by the Fronius inverter
+std::vector<uint8_t> GetModbusRequest(uint16_t startAddress = 40070, uint16_t count = 124)
+{
+    std::vector<uint8_t> request = {MODBUS_ADDRESS,
+                                    0x03,
+                                    static_cast<uint8_t>(startAddress >> 8),
+                                    static_cast<uint8_t>(startAddress),
+                                    static_cast<uint8_t>(count >> 8),
+                                    static_cast<uint8_t>(count),
+                                    0x00,
+                                    0x00};
+    const auto crc = esphome::crc16(request.data(), request.size() - 2);
+    request[6] = crc & 0xFF;
+    request[7] = crc >> 8;
+    return request;
+}
+
+float GetFloatRegister(const sunspec::MeterModel& model, uint32_t registerAddress)
+{
+    // Registers are big endian
+    const auto bytes = model.GetRegisterRaw(registerAddress, 2);
+    const uint32_t raw = (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16)
+                         | (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3];
+    float value;
+    std::memcpy(&value, &raw, sizeof(value));
+    return value;
+}
+
+} // namespace
+
+TEST(MeterPipelineTest, AddMeterData_EncryptedFrame_MeterModelUpdated)
+{
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, MODBUS_ADDRESS);
+    const auto frames = encrypted_frame_builder::BuildMbusFrames(1);
+
+    pipeline.AddMeterData(frames.data(), frames.size());
+
+    ASSERT_EQ(pipeline.GetLinkStatistics().decodedFrames, 1);
+    ASSERT_EQ(pipeline.GetLinkStatistics().GetAbortCount(), 0);
+    ASSERT_EQ(pipeline.GetMeterData().voltageL1, 2301);
+    ASSERT_EQ(pipeline.GetMeterData().activeEnergyPlus, 12345678);
+    // Voltage phase A of the Sunspec 213 model
+    ASSERT_FLOAT_EQ(GetFloatRegister(pipeline.GetMeterModel(), 40000 + 81), 230.1f);
+}
+
+TEST(MeterPipelineTest, AddMeterData_ByteByByte_Decoded)
+{
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, MODBUS_ADDRESS);
+    const auto frames = encrypted_frame_builder::BuildMbusFrames(1);
+
+    for (const auto byte : frames)
+    {
+        pipeline.AddMeterData(&byte, 1);
+    }
+
+    ASSERT_EQ(pipeline.GetLinkStatistics().decodedFrames, 1);
+}
+
+TEST(MeterPipelineTest, AddMeterData_WrongKey_DecodeFailed)
+{
+    uint8_t key[AesGcm::KEY_LENGTH] = {};
+    MeterPipeline pipeline(key, MODBUS_ADDRESS);
+    const auto frames = encrypted_frame_builder::BuildMbusFrames(1);
+
+    pipeline.AddMeterData(frames.data(), frames.size());
+
+    ASSERT_EQ(pipeline.GetLinkStatistics().decodedFrames, 0);
+    ASSERT_EQ(pipeline.GetLinkStatistics().aborts[static_cast<size_t>(esphome::espdm::AbortReason::DECODE_FAILED)], 1);
+}
+
+TEST(MeterPipelineTest, ProcessModbus_NoMeterData_DeviceFailure)
+{
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, MODBUS_ADDRESS);
+    esphome::MockByteStream modbus;
+    pipeline.SetModbusStream(modbus);
+
+    modbus.AddRx(GetModbusRequest());
+    pipeline.ProcessModbus();
+
+    // Exception response: address, function code | 0x80, exception code, crc
+    ASSERT_EQ(modbus.m_tx.size(), 5);
+    ASSERT_EQ(modbus.m_tx[1], 0x83);
+    ASSERT_EQ(modbus.m_tx[2], 0x04);
+}
+
+TEST(MeterPipelineTest, ProcessModbus_NoMeterData_CommonBlockAndModelHeaderServed)
+{
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, MODBUS_ADDRESS);
+    esphome::MockByteStream modbus;
+    pipeline.SetModbusStream(modbus);
+
+    // Discovery by the inverter: "SunS", common block and the id of the meter model
+    modbus.AddRx(GetModbusRequest(40000, 71));
+    pipeline.ProcessModbus();
+
+    ASSERT_EQ(modbus.m_tx.size(), 3 + 2 * 71 + 2);
+    ASSERT_EQ(modbus.m_tx[1], 0x03);
+    ASSERT_EQ(modbus.m_tx[3], 'S');
+    ASSERT_EQ(modbus.m_tx[3 + 2 * 69 + 1], sunspec::MODEL_THREE_PHASE & 0xFF);
+}
+
+TEST(MeterPipelineTest, ProcessModbus_AfterMeterFrame_MeterBlockServed)
+{
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, MODBUS_ADDRESS);
+    esphome::MockByteStream modbus;
+    pipeline.SetModbusStream(modbus);
+    const auto frames = encrypted_frame_builder::BuildMbusFrames(1);
+    pipeline.AddMeterData(frames.data(), frames.size());
+
+    modbus.AddRx(GetModbusRequest());
+    pipeline.ProcessModbus();
+
+    // address, function code, byte count, 124 registers, crc
+    ASSERT_EQ(modbus.m_tx.size(), 3 + 2 * 124 + 2);
+    ASSERT_EQ(modbus.m_tx[1], 0x03);
+    ASSERT_EQ(modbus.m_tx[2], 2 * 124);
+    ASSERT_TRUE(modbus.m_rx.empty());
+}
+
+TEST(MeterPipelineTest, AddMeterData_AfterWarmUp_NoHeapAllocations)
+{
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, MODBUS_ADDRESS);
+    std::vector<std::vector<uint8_t>> frames;
+    for (uint32_t i = 1; i <= 11; i++)
+    {
+        frames.push_back(encrypted_frame_builder::BuildMbusFrames(i));
+    }
+    pipeline.AddMeterData(frames[0].data(), frames[0].size());
+
+    const size_t chunkSize = MeterPipeline::READ_CHUNK_SIZE;
+    alloc_tracker::Scope scope;
+    for (size_t i = 1; i < frames.size(); i++)
+    {
+        // In chunks as read from the link
+        for (size_t offset = 0; offset < frames[i].size(); offset += chunkSize)
+        {
+            pipeline.AddMeterData(&frames[i][offset], std::min(chunkSize, frames[i].size() - offset));
+        }
+    }
+
+    ASSERT_EQ(pipeline.GetLinkStatistics().decodedFrames, 11);
+    ASSERT_EQ(scope.GetAllocations(), 0);
+}
+
+TEST(MeterPipelineTest, Create_InvalidSpec_Nullptr)
+{
+    ASSERT_EQ(Transport::Create(""), nullptr);
+    ASSERT_EQ(Transport::Create("serial:/dev/ttyUSB0"), nullptr);
+    ASSERT_EQ(Transport::Create("serial:/dev/ttyUSB0:2400:7E1"), nullptr);
+    ASSERT_EQ(Transport::Create("tcp:localhost"), nullptr);
+    ASSERT_EQ(Transport::Create("udp:localhost:502"), nullptr);
+    ASSERT_NE(Transport::Create("serial:/dev/ttyUSB0:2400:8N1"), nullptr);
+    ASSERT_NE(Transport::Create("serial:/dev/ttyUSB0:2400:8E1"), nullptr);
+    ASSERT_NE(Transport::Create("tcp:localhost:502"), nullptr);
+}
+
+TEST(MeterPipelineTest, PtyTransport_WriteToLink_ReadByTransport)
+{
+    const std::string link = "/tmp/meter_pipeline_test_pty_" + std::to_string(getpid());
+    auto transport = Transport::Create("pty:" + link);
+    ASSERT_TRUE(transport->Open());
+    const int peer = open(link.c_str(), O_RDWR | O_NOCTTY);
+    ASSERT_GE(peer, 0);
+    const uint8_t data[] = {0x68, 0xFA, 0xFA, 0x68};
+    uint8_t buffer[16];
+
+    ASSERT_EQ(transport->Read(buffer, sizeof(buffer)), 0); // nothing available
+    ASSERT_FALSE(transport->IsFailed());
+    ASSERT_EQ(write(peer, data, sizeof(data)), static_cast<ssize_t>(sizeof(data)));
+    pollfd readable = {transport->GetFd(), POLLIN, 0};
+    ASSERT_EQ(poll(&readable, 1, 1000), 1);
+
+    ASSERT_EQ(transport->Read(buffer, sizeof(buffer)), sizeof(data));
+    ASSERT_EQ(std::memcmp(buffer, data, sizeof(data)), 0);
+    close(peer);
+    transport.reset();
+    ASSERT_NE(access(link.c_str(), F_OK), 0); // link is removed
+}
+
+TEST(MeterPipelineTest, OnModbusReadable_PtyLinks_ResponseWrittenToLink)
+{
+    const std::string link = "/tmp/meter_pipeline_test_pty_" + std::to_string(getpid());
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, MODBUS_ADDRESS);
+    pipeline.SetLinks(Transport::Create("pty:" + link + "_meter"), Transport::Create("pty:" + link + "_modbus"));
+    ASSERT_TRUE(pipeline.GetMeterLink()->Open());
+    ASSERT_TRUE(pipeline.GetModbusLink()->Open());
+    const int peer = open((link + "_modbus").c_str(), O_RDWR | O_NOCTTY);
+    ASSERT_GE(peer, 0);
+    const auto request = GetModbusRequest();
+
+    ASSERT_EQ(write(peer, request.data(), request.size()), static_cast<ssize_t>(request.size()));
+    pollfd readable = {pipeline.GetModbusLink()->GetFd(), POLLIN, 0};
+    ASSERT_EQ(poll(&readable, 1, 1000), 1);
+    ASSERT_TRUE(pipeline.OnModbusReadable());
+
+    // Exception response, no meter data yet
+    uint8_t response[16];
+    readable = {peer, POLLIN, 0};
+    ASSERT_EQ(poll(&readable, 1, 1000), 1);
+    ASSERT_EQ(read(peer, response, sizeof(response)), 5);
+    ASSERT_EQ(response[1], 0x83);
+    close(peer);
+}
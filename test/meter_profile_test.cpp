@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#define ESPDM_HOST
+#include "esphome_mock.h"
+#include "dlms_frame_builder.h"
+#include "../src/esphome-dlms-meter/espdm_dlms_frame.h"
+#include "../src/esphome-dlms-meter/espdm_mbus.h"
+#include "../src/esphome-dlms-meter/espdm_obis_decoder.h"
+
+#include <cstring>
+#include <type_traits>
+
+using namespace esphome::espdm;
+
+namespace
+{
+
+// Meter with another layout than the Kaifa MA309: no transport header in the mbus-frame, security byte 0x30,
+// no structure before the OBIS list and the active power as sum 1-0:16.7.0
+struct TestProfile : KaifaMa309Profile
+{
+    static constexpr size_t MBUS_DLMS_OFFSET = 3;
+    static constexpr uint8_t DLMS_SECURITY_BYTE = 0x30;
+    static constexpr int DECODER_START_OFFSET = 18;
+
+    static constexpr CodeType GetCodeType(uint8_t medium, uint8_t c, uint8_t d)
+    {
+        return ObisKey(medium, c, d) == ObisKey(Medium::Electricity, 0x10, 0x07)
+                   ? CodeType::ActivePowerPlus
+                   : KaifaMa309Profile::GetCodeType(medium, c, d);
+    }
+};
+
+static_assert(KaifaMa309Profile::GetCodeType(Medium::Electricity, 0x20, 0x07) == CodeType::VoltageL1,
+              "OBIS map is evaluated at compile time");
+static_assert(KaifaMa309Profile::GetCodeType(Medium::Electricity, 0x10, 0x07) == CodeType::Unknown, "");
+static_assert(TestProfile::GetCodeType(Medium::Electricity, 0x10, 0x07) == CodeType::ActivePowerPlus, "");
+
+// Captured layout of the Kaifa MA309: mbus-frame with a short dlms-frame ( frame counter 42, 8 bytes ciphertext )
+const std::vector<uint8_t> MA309_MBUS_FRAME = {
+    0x68, 0x1D, 0x1D, 0x68, 0x53, 0xFF, 0x00, 0x01, 0x67, 0xDB, 0x08, 0x4B, 0x46, 0x4D, 0x10, 0x20,
+    0x01, 0x23, 0x45, 0x0D, 0x21, 0x00, 0x00, 0x00, 0x2A, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0xD0, 0x16};
+
+// Decrypted data-notification of the Kaifa MA309, 2024-03-17 12:34:56
+const std::vector<uint8_t> MA309_PLAINTEXT = {
+    0x0F, 0x00, 0x01, 0x23, 0x45, 0x0C, 0x07, 0xE8, 0x03, 0x11, 0x07, 0x0C, 0x22, 0x38, 0xFF, 0x80,
+    0x00, 0x00, 0x02, 0x0D, 0x09, 0x06, 0x00, 0x00, 0x01, 0x00, 0x00, 0xFF, 0x09, 0x0C, 0x07, 0xE8,
+    0x03, 0x11, 0x07, 0x0C, 0x22, 0x38, 0xFF, 0x80, 0x00, 0x00, 0x02, 0x03, 0x09, 0x06, 0x01, 0x00,
+    0x20, 0x07, 0x00, 0xFF, 0x12, 0x08, 0xFD, 0x02, 0x02, 0x0F, 0xFF, 0x16, 0x23, 0x02, 0x03, 0x09,
+    0x06, 0x01, 0x00, 0x34, 0x07, 0x00, 0xFF, 0x12, 0x09, 0x08, 0x02, 0x02, 0x0F, 0xFF, 0x16, 0x23,
+    0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x48, 0x07, 0x00, 0xFF, 0x12, 0x09, 0x13, 0x02, 0x02, 0x0F,
+    0xFF, 0x16, 0x23, 0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x1F, 0x07, 0x00, 0xFF, 0x12, 0x00, 0x7B,
+    0x02, 0x02, 0x0F, 0xFE, 0x16, 0x21, 0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x33, 0x07, 0x00, 0xFF,
+    0x12, 0x00, 0xEA, 0x02, 0x02, 0x0F, 0xFE, 0x16, 0x21, 0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x47,
+    0x07, 0x00, 0xFF, 0x12, 0x01, 0x59, 0x02, 0x02, 0x0F, 0xFE, 0x16, 0x21, 0x02, 0x03, 0x09, 0x06,
+    0x01, 0x00, 0x01, 0x07, 0x00, 0xFF, 0x06, 0x00, 0x00, 0x04, 0xD2, 0x02, 0x02, 0x0F, 0x00, 0x16,
+    0x1B, 0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x02, 0x07, 0x00, 0xFF, 0x06, 0x00, 0x00, 0x00, 0x00,
+    0x02, 0x02, 0x0F, 0x00, 0x16, 0x1B, 0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x01, 0x08, 0x00, 0xFF,
+    0x06, 0x00, 0xBC, 0x61, 0x4E, 0x02, 0x02, 0x0F, 0x00, 0x16, 0x1E, 0x02, 0x03, 0x09, 0x06, 0x01,
+    0x00, 0x02, 0x08, 0x00, 0xFF, 0x06, 0x00, 0x23, 0xCA, 0xCE, 0x02, 0x02, 0x0F, 0x00, 0x16, 0x1E,
+    0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x03, 0x08, 0x00, 0xFF, 0x06, 0x00, 0x05, 0x46, 0x4E, 0x02,
+    0x02, 0x0F, 0x00, 0x16, 0x20, 0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x04, 0x08, 0x00, 0xFF, 0x06,
+    0x00, 0x00, 0xB2, 0x6E, 0x02, 0x02, 0x0F, 0x00, 0x16, 0x20};
+
+// Same dlms-frame in the layout of the TestProfile
+const std::vector<uint8_t> TEST_PROFILE_MBUS_FRAME = {
+    0x68, 0x1B, 0x1B, 0x68, 0x53, 0xFF, 0x00, 0xDB, 0x08, 0x4B, 0x46, 0x4D, 0x10, 0x20, 0x01, 0x23,
+    0x45, 0x0D, 0x30, 0x00, 0x00, 0x00, 0x2A, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x77,
+    0x16};
+
+// Voltage L1 230.9V and active power 1-0:16.7.0 1234W
+const std::vector<uint8_t> TEST_PROFILE_PLAINTEXT = {
+    0x0F, 0x00, 0x00, 0x00, 0x01, 0x0C, 0x07, 0xE8, 0x03, 0x11, 0x07, 0x0C, 0x22, 0x38, 0xFF, 0x80,
+    0x00, 0x00, 0x09, 0x06, 0x01, 0x00, 0x20, 0x07, 0x00, 0xFF, 0x12, 0x09, 0x05, 0x02, 0x02, 0x0F,
+    0xFF, 0x16, 0x23, 0x02, 0x03, 0x09, 0x06, 0x01, 0x00, 0x10, 0x07, 0x00, 0xFF, 0x06, 0x00, 0x00,
+    0x04, 0xD2, 0x02, 0x02, 0x0F, 0x00, 0x16, 0x1B};
+
+const uint8_t GOLDEN_IV[] = {0x4B, 0x46, 0x4D, 0x10, 0x20, 0x01, 0x23, 0x45, 0x00, 0x00, 0x00, 0x2A};
+const uint8_t GOLDEN_CIPHERTEXT[] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+
+template <typename Profile>
+typename BasicDlmsFrame<Profile>::Result AddMbusFrame(BasicDlmsFrame<Profile>& frame,
+                                                      const std::vector<uint8_t>& mbusFrame, AbortReason& reason)
+{
+    MbusProtocol mbus;
+    for (const auto data : mbusFrame)
+    {
+        mbus.AddFrameData(data);
+    }
+    std::vector<uint8_t> payload;
+    EXPECT_TRUE(mbus.GetPayload(payload));
+    return frame.AddMbusPayload(payload, reason);
+}
+
+template <typename Profile> void ExpectGoldenHeader(const BasicDlmsFrame<Profile>& frame)
+{
+    uint8_t iv[DlmsFrame::IV_LENGTH];
+    frame.GetIv(iv);
+    EXPECT_EQ(std::memcmp(iv, GOLDEN_IV, sizeof(iv)), 0);
+    EXPECT_EQ(frame.GetFrameCounter(), 42u);
+    ASSERT_EQ(frame.GetMessageLength(), sizeof(GOLDEN_CIPHERTEXT));
+    EXPECT_EQ(std::memcmp(frame.GetCiphertext(), GOLDEN_CIPHERTEXT, sizeof(GOLDEN_CIPHERTEXT)), 0);
+}
+
+} // namespace
+
+TEST(MeterProfileTest, DefaultProfile_IsKaifaMa309)
+{
+    ASSERT_TRUE((std::is_same<MeterProfile, KaifaMa309Profile>::value));
+    ASSERT_TRUE((std::is_same<DlmsFrame, BasicDlmsFrame<KaifaMa309Profile>>::value));
+}
+
+TEST(MeterProfileTest, Ma309_GoldenFrame_HeaderOk)
+{
+    DlmsFrame frame;
+    AbortReason reason;
+
+    ASSERT_EQ(AddMbusFrame(frame, MA309_MBUS_FRAME, reason), DlmsFrame::Result::COMPLETE);
+    ExpectGoldenHeader(frame);
+}
+
+TEST(MeterProfileTest, Ma309_GoldenPlaintext_AllValuesOk)
+{
+    const ObisDecoder decoder;
+    MeterData data;
+
+    ASSERT_EQ(decoder.Decode(MA309_PLAINTEXT.data(), MA309_PLAINTEXT.size(), data), ObisDecoder::Result::OK);
+    ASSERT_EQ(data.voltageL1, 2301);
+    ASSERT_EQ(data.voltageL3, 2323);
+    ASSERT_EQ(data.currentL2, 234);
+    ASSERT_EQ(data.activePowerPlus, 1234);
+    ASSERT_EQ(data.activeEnergyPlus, 12345678);
+    ASSERT_EQ(data.reactiveEnergyMinus, 45678);
+    ASSERT_EQ(data.timestamp.year, 2024);
+    ASSERT_EQ(data.timestamp.second, 56);
+}
+
+TEST(MeterProfileTest, Ma309_FrameBuilder_MatchesGolden)
+{
+    // The synthetic frames of the other tests and the benchmarks have the golden layout
+    ASSERT_EQ(dlms_frame_builder::BuildPlaintext(), MA309_PLAINTEXT);
+}
+
+TEST(MeterProfileTest, TestProfile_GoldenFrame_HeaderOk)
+{
+    BasicDlmsFrame<TestProfile> frame;
+    AbortReason reason;
+
+    ASSERT_EQ(AddMbusFrame(frame, TEST_PROFILE_MBUS_FRAME, reason), BasicDlmsFrame<TestProfile>::Result::COMPLETE);
+    ExpectGoldenHeader(frame);
+}
+
+TEST(MeterProfileTest, TestProfile_GoldenPlaintext_ValuesOk)
+{
+    const ObisDecoder decoder;
+    MeterData data;
+
+    ASSERT_EQ(decoder.Decode<TestProfile>(TEST_PROFILE_PLAINTEXT.data(), TEST_PROFILE_PLAINTEXT.size(), data),
+              ObisDecoder::Result::OK);
+    ASSERT_EQ(data.voltageL1, 2309);
+    ASSERT_EQ(data.activePowerPlus, 1234);
+}
+
+TEST(MeterProfileTest, Ma309_TestProfileFrame_Aborted)
+{
+    DlmsFrame frame;
+    AbortReason reason;
+
+    // The transport header is missing, the 2 skipped bytes are part of the dlms header
+    ASSERT_EQ(AddMbusFrame(frame, TEST_PROFILE_MBUS_FRAME, reason), DlmsFrame::Result::ABORTED);
+    ASSERT_EQ(reason, AbortReason::UNSUPPORTED_CIPHER);
+}
+
+TEST(MeterProfileTest, TestProfile_Ma309Frame_Aborted)
+{
+    BasicDlmsFrame<TestProfile> frame;
+    AbortReason reason;
+
+    ASSERT_EQ(AddMbusFrame(frame, MA309_MBUS_FRAME, reason), BasicDlmsFrame<TestProfile>::Result::ABORTED);
+    ASSERT_EQ(reason, AbortReason::UNSUPPORTED_CIPHER);
+}
+
+TEST(MeterProfileTest, Ma309_TestProfilePlaintext_PowerNotMapped)
+{
+    // 1-0:16.7.0 is not in the map of the MA309, the OBIS list starts 2 bytes later
+    auto plaintext = TEST_PROFILE_PLAINTEXT;
+    plaintext.insert(plaintext.begin() + 18, 2, 0x00);
+    const ObisDecoder decoder;
+    MeterData data;
+
+    ASSERT_EQ(decoder.Decode(plaintext.data(), plaintext.size(), data), ObisDecoder::Result::OK);
+    ASSERT_EQ(data.voltageL1, 2309);
+    ASSERT_EQ(data.activePowerPlus, 0);
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "alloc_tracker.h"
+#include "sample_meter_data.h"
+#include "../src/meter_snapshot.h"
+
+#include <string>
+
+using namespace esphome::sm;
+using esphome::espdm::MeterData;
+
+namespace
+{
+bool Contains(const MeterSnapshot& snapshot, const std::string& text)
+{
+    return std::string(snapshot.GetJson()).find(text) != std::string::npos;
+}
+
+} // namespace
+
+TEST(MeterSnapshotTest, Update_AllValuesFormatted)
+{
+    MeterSnapshot snapshot;
+    ASSERT_EQ(snapshot.GetLength(), 0);
+
+    snapshot.Update(sample_meter_data::Create(), EnergyInterval(), CalendarEnergy());
+
+    ASSERT_EQ(snapshot.GetSequence(), 1);
+    ASSERT_EQ(snapshot.GetLength(), std::string(snapshot.GetJson()).size());
+    ASSERT_EQ(snapshot.GetJson()[0], '{');
+    ASSERT_EQ(snapshot.GetJson()[snapshot.GetLength() - 1], '}');
+    ASSERT_TRUE(Contains(snapshot, "\"sequence\":1,\"timestamp\":\"2024-03-17T12:34:56\""));
+    ASSERT_TRUE(Contains(snapshot, "\"voltage\":{\"l1\":230.1,\"l2\":231.2,\"l3\":232.3,\"avg\":231.2}"));
+    ASSERT_TRUE(Contains(snapshot, "\"current\":{\"l1\":1.23,\"l2\":2.34,\"l3\":3.45,\"sum\":7.02}"));
+    ASSERT_TRUE(Contains(snapshot, "\"active_power_plus\":1234,"));
+    ASSERT_TRUE(Contains(snapshot, "\"active_energy_plus\":12345678,"));
+    ASSERT_TRUE(Contains(snapshot, "\"energy_interval\":null"));
+    ASSERT_TRUE(Contains(snapshot, "\"energy_year\":null}"));
+}
+
+TEST(MeterSnapshotTest, Update_ValidIntervals_KWh)
+{
+    const MeterData data = sample_meter_data::Create();
+    EnergyInterval interval;
+    interval.SetBegin(12000000, 2345000);
+    interval.Update(12345678, 2345678);
+    CalendarEnergy calendar;
+    calendar.Update(data.timestamp, 12345000, 2345678);
+    calendar.Update(data.timestamp, 12345678, 2345678);
+    MeterSnapshot snapshot;
+
+    snapshot.Update(data, interval, calendar);
+
+    ASSERT_TRUE(Contains(snapshot, "\"energy_interval\":{\"plus\":345.678,\"minus\":0.678,\"sum\":345.000}"));
+    ASSERT_TRUE(Contains(snapshot, "\"energy_day\":{\"plus\":0.678,\"minus\":0.000}"));
+}
+
+TEST(MeterSnapshotTest, Update_FixedPoint_ExactDecimals)
+{
+    MeterData data = sample_meter_data::Create();
+    data.currentL1 = -5;
+    data.currentL2 = -100;
+    data.currentL3 = -1234;
+    data.activeEnergyPlus = UINT32_MAX;
+    data.activeEnergyMinus = 16777217; // not exact as float
+    data.UpdateDerived();
+    MeterSnapshot snapshot;
+
+    snapshot.Update(data, EnergyInterval(), CalendarEnergy());
+
+    ASSERT_TRUE(Contains(snapshot, "\"current\":{\"l1\":-0.05,\"l2\":-1.00,\"l3\":-12.34,\"sum\":-13.39}"));
+    ASSERT_TRUE(Contains(snapshot, "\"active_energy_plus\":4294967295,"));
+    ASSERT_TRUE(Contains(snapshot, "\"active_energy_minus\":16777217,"));
+}
+
+TEST(MeterSnapshotTest, Update_LongestValues_FitIntoBuffer)
+{
+    MeterData data = sample_meter_data::Create();
+    data.voltageL1 = data.voltageL2 = data.voltageL3 = UINT16_MAX;
+    data.currentL1 = data.currentL2 = data.currentL3 = INT32_MIN;
+    for (uint32_t* value : {&data.activePowerPlus, &data.activePowerMinus, &data.activeEnergyPlus,
+                            &data.activeEnergyMinus, &data.reactiveEnergyPlus, &data.reactiveEnergyMinus})
+    {
+        *value = UINT32_MAX;
+    }
+    data.derived.voltage = {INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN};
+    data.derived.voltagePhaseToPhase = data.derived.voltage;
+    data.derived.current = data.derived.voltage;
+    data.derived.power = data.derived.voltage;
+    data.derived.apparentPower = data.derived.voltage;
+    data.derived.reactivePower = data.derived.voltage;
+    data.derived.powerFactor = UINT32_MAX;
+    data.timestamp.year = 65535;
+    EnergyInterval interval;
+    interval.SetBegin(INT64_MAX / 2, INT64_MAX / 2);
+    interval.Update(-INT64_MAX / 2, -INT64_MAX / 2);
+    MeterSnapshot snapshot;
+
+    snapshot.Update(data, interval, CalendarEnergy());
+
+    ASSERT_LT(snapshot.GetLength(), MeterSnapshot::MAX_SIZE - 1);
+    ASSERT_EQ(snapshot.GetJson()[snapshot.GetLength() - 1], '}');
+}
+
+TEST(MeterSnapshotTest, Update_NoHeapAllocation)
+{
+    const MeterData data = sample_meter_data::Create();
+    const EnergyInterval interval;
+    const CalendarEnergy calendar;
+    MeterSnapshot snapshot;
+
+    alloc_tracker::Scope scope;
+    snapshot.Update(data, interval, calendar);
+    snapshot.Update(data, interval, calendar);
+
+    ASSERT_EQ(scope.GetAllocations(), 0);
+    ASSERT_EQ(snapshot.GetSequence(), 2);
+}
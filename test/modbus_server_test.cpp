@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
-#define GTEST
+#define ESPDM_HOST
 #include "esphome_mock.h"
+#include "alloc_tracker.h"
+#include "virtual_clock.h"
 #include "../src/modbus_server.h"
 
 #include <cstring>
@@ -14,12 +16,14 @@ protected:
     std::vector<ModbusServer::RequestRead> m_requests;
     float m_responseValue{0.0f};
     std::unique_ptr<ModbusServer> m_server;
+    MockByteStream m_stream;
 
     void SetUp() override
     {
         m_server.reset(new ModbusServer(0x01U, [this](uint8_t functionCode, const ModbusServer::RequestRead& request) {
             return OnModbusReceiveRequest(functionCode, request);
         }));
+        m_server->SetStream(m_stream);
     }
     void TearDown() override { }
 
@@ -56,14 +60,14 @@ TEST_F(ModbusServerTest, OnReceive_IncompleteRequest_RxBufferOk)
 {
     const std::vector<uint8_t> testData = {0x01, 0x03, 0x00, 0x02, 0x00, 0x01, 0x25};
 
-    m_server->AddRx(testData);
-    ASSERT_EQ(m_server->m_uartRx.size(), 7);
+    m_stream.AddRx(testData);
+    ASSERT_EQ(m_stream.m_rx.size(), 7);
     m_server->ProcessRequest();
 
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 7);
-    ASSERT_EQ(m_server->m_rxBuffer, testData);
-    ASSERT_EQ(m_server->m_uartTx.size(), 0);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 7);
+    ASSERT_EQ(m_server->GetRxBuffer(), testData);
+    ASSERT_EQ(m_stream.m_tx.size(), 0);
     ASSERT_EQ(m_requests.size(), 0);
 }
 
@@ -72,34 +76,54 @@ TEST_F(ModbusServerTest, OnReceive_IncompleteFollowedByValidRequest_ResponseOk)
     std::vector<uint8_t> testData = {0x01, 0x03, 0x00, 0x02, 0x00, 0x01, 0x25};
     m_responseValue = 42.3f;
 
-    m_server->AddRx(testData);
+    m_stream.AddRx(testData);
     testData.push_back(0xca);
-    m_server->AddRx(testData);
-    ASSERT_EQ(m_server->m_uartRx.size(), 15);
+    m_stream.AddRx(testData);
+    ASSERT_EQ(m_stream.m_rx.size(), 15);
     m_server->ProcessRequest();
 
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 0);
-    ASSERT_EQ(m_server->m_uartTx.size(), 9);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 0);
+    ASSERT_EQ(m_stream.m_tx.size(), 9);
     ASSERT_EQ(m_requests.size(), 1);
 }
 
+TEST_F(ModbusServerTest, OnReceive_SplitRequest_ResponseDelayFromFirstByte)
+{
+    const std::vector<uint8_t> first = {0x01, 0x03, 0x00, 0x02};
+    const std::vector<uint8_t> second = {0x00, 0x01, 0x25, 0xca};
+    m_responseValue = 42.3f;
+    // micros() overflows between the parts
+    VirtualClock clock(0xFFFFFFFFULL - 1000);
+    m_server->SetClock(clock);
+
+    m_stream.AddRx(first);
+    m_server->ProcessRequest();
+    clock.AdvanceUs(3000);
+    m_stream.AddRx(second);
+    m_server->ProcessRequest();
+
+    ASSERT_EQ(m_requests.size(), 1);
+    ASSERT_EQ(m_server->GetLastResponseDelayUs(), 3000);
+    ASSERT_EQ(m_server->GetMaxResponseDelayUs(), 3000);
+}
+
 TEST_F(ModbusServerTest, OnReceive_InvalidCrcFollowedByValidRequest_ResponseOk)
 {
     const std::vector<uint8_t> invalidTestData = {0x01, 0x03, 0x15, 0x12, 0x00, 0x01, 0x25, 0xff};
     const std::vector<uint8_t> testData = {0x01, 0x03, 0x00, 0x02, 0x00, 0x01, 0x25, 0xca};
     m_responseValue = 42.3f;
 
-    m_server->AddRx(invalidTestData);
-    m_server->AddRx(testData);
-    m_server->AddRx(invalidTestData);
-    m_server->AddRx(testData);
-    ASSERT_EQ(m_server->m_uartRx.size(), 32);
+    m_stream.AddRx(invalidTestData);
+    m_stream.AddRx(testData);
+    m_stream.AddRx(invalidTestData);
+    m_stream.AddRx(testData);
+    ASSERT_EQ(m_stream.m_rx.size(), 32);
     m_server->ProcessRequest();
 
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 0);
-    ASSERT_EQ(m_server->m_uartTx.size(), 18);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 0);
+    ASSERT_EQ(m_stream.m_tx.size(), 18);
     ASSERT_EQ(m_requests.size(), 2);
     ASSERT_EQ(::memcmp(&m_requests[0], &m_requests[1], sizeof(m_requests[0])), 0);
 }
@@ -108,17 +132,17 @@ TEST_F(ModbusServerTest, OnReceive_ValidRequest_InvalidFunctionCode_Response_IsE
 {
     std::vector<uint8_t> testData = {0x01, 0x04, 0x00, 0x02, 0x00, 0x01, 0x90, 0x0a};
 
-    m_server->AddRx(testData);
-    ASSERT_EQ(m_server->m_uartRx.size(), 8);
+    m_stream.AddRx(testData);
+    ASSERT_EQ(m_stream.m_rx.size(), 8);
     m_server->ProcessRequest();
 
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 0);
-    ASSERT_EQ(m_server->m_uartTx.size(), 5);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 0);
+    ASSERT_EQ(m_stream.m_tx.size(), 5);
     ASSERT_EQ(m_requests.size(), 1);
-    ASSERT_EQ(m_server->m_uartTx[0], testData[0]);
-    ASSERT_EQ(m_server->m_uartTx[1], testData[1] | 0x80);
-    ASSERT_EQ(m_server->m_uartTx[2], ModbusServer::ResponseRead::ErrorCode::ILLEGAL_FUNCTION);
+    ASSERT_EQ(m_stream.m_tx[0], testData[0]);
+    ASSERT_EQ(m_stream.m_tx[1], testData[1] | 0x80);
+    ASSERT_EQ(m_stream.m_tx[2], ModbusServer::ResponseRead::ErrorCode::ILLEGAL_FUNCTION);
 }
 
 TEST_F(ModbusServerTest, OnReceive_InvalidFunctionCodeFollowedByValidRequest_ResponseOk)
@@ -127,14 +151,14 @@ TEST_F(ModbusServerTest, OnReceive_InvalidFunctionCodeFollowedByValidRequest_Res
     const std::vector<uint8_t> testData = {0x01, 0x03, 0x00, 0x00, 0x00, 0x02, 0xc4, 0x0b};
     m_responseValue = 42.3f;
 
-    m_server->AddRx(invalidFunctionCodeTestData);
-    m_server->AddRx(testData);
-    ASSERT_EQ(m_server->m_uartRx.size(), 16);
+    m_stream.AddRx(invalidFunctionCodeTestData);
+    m_stream.AddRx(testData);
+    ASSERT_EQ(m_stream.m_rx.size(), 16);
     m_server->ProcessRequest();
 
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 0);
-    ASSERT_EQ(m_server->m_uartTx.size(), 9);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 0);
+    ASSERT_EQ(m_stream.m_tx.size(), 9);
     ASSERT_EQ(m_requests.size(), 1);
 
     // verify request
@@ -147,16 +171,37 @@ TEST_F(ModbusServerTest, OnReceive_ValidRequestButWrongAddress_ResponseNone)
 {
     const std::vector<uint8_t> testData = {0x02, 0x03, 0x00, 0x02, 0x00, 0x01, 0x25, 0xf9};
 
-    m_server->AddRx(testData);
-    ASSERT_EQ(m_server->m_uartRx.size(), 8);
+    m_stream.AddRx(testData);
+    ASSERT_EQ(m_stream.m_rx.size(), 8);
     m_server->ProcessRequest();
 
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 0);
-    ASSERT_EQ(m_server->m_uartTx.size(), 0);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 0);
+    ASSERT_EQ(m_stream.m_tx.size(), 0);
     ASSERT_EQ(m_requests.size(), 0);
 }
 
+TEST_F(ModbusServerTest, OnReceive_RequestForAddedAddress_AnsweredByItsHandler)
+{
+    const std::vector<uint8_t> testData = {0x02, 0x03, 0x00, 0x02, 0x00, 0x01, 0x25, 0xf9};
+    size_t addedRequests = 0;
+    m_server->AddAddress(0x02, [&addedRequests](uint8_t, const ModbusServer::RequestRead&) {
+        addedRequests++;
+        ModbusServer::ResponseRead response;
+        response.SetData({0x12, 0x34});
+        return response;
+    });
+
+    m_stream.AddRx(testData);
+    m_server->ProcessRequest();
+
+    ASSERT_EQ(addedRequests, 1);
+    ASSERT_EQ(m_requests.size(), 0);
+    ASSERT_EQ(m_stream.m_tx.size(), 7);
+    ASSERT_EQ(m_stream.m_tx[0], 0x02);
+    ASSERT_EQ(m_stream.m_tx[3], 0x12);
+}
+
 TEST_F(ModbusServerTest, OnReceive_ValidRequest_ResponseOk)
 {
     const std::vector<uint8_t> testData = {0x01, 0x03, 0x00, 0x02, 0x00, 0x01, 0x25, 0xca};
@@ -165,50 +210,50 @@ TEST_F(ModbusServerTest, OnReceive_ValidRequest_ResponseOk)
     // Receive in small peaces and always try to parse
     uint8_t pos = 0;
     // Byte 1
-    m_server->m_uartRx.push_back(testData[pos++]);
+    m_stream.m_rx.push_back(testData[pos++]);
     m_server->ProcessRequest();
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 1);
-    ASSERT_EQ(m_server->m_rxBuffer[0], 1);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 1);
+    ASSERT_EQ(m_server->GetRxBuffer()[0], 1);
 
     // Byte 2
-    m_server->m_uartRx.push_back(testData[pos++]);
+    m_stream.m_rx.push_back(testData[pos++]);
     m_server->ProcessRequest();
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 2);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 2);
 
     // Byte 3 - 6
-    m_server->m_uartRx.push_back(testData[pos++]);
-    m_server->m_uartRx.push_back(testData[pos++]);
-    m_server->m_uartRx.push_back(testData[pos++]);
-    m_server->m_uartRx.push_back(testData[pos++]);
+    m_stream.m_rx.push_back(testData[pos++]);
+    m_stream.m_rx.push_back(testData[pos++]);
+    m_stream.m_rx.push_back(testData[pos++]);
+    m_stream.m_rx.push_back(testData[pos++]);
     m_server->ProcessRequest();
-    ASSERT_EQ(m_server->m_uartRx.size(), 0);
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 6);
+    ASSERT_EQ(m_stream.m_rx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 6);
 
     // Byte 7
-    m_server->m_uartRx.push_back(testData[pos++]);
+    m_stream.m_rx.push_back(testData[pos++]);
     m_server->ProcessRequest();
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 7);
-    ASSERT_EQ(m_server->m_uartTx.size(), 0);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 7);
+    ASSERT_EQ(m_stream.m_tx.size(), 0);
 
     // Byte 8: frame is complete => response received
-    m_server->m_uartRx.push_back(testData[pos++]);
+    m_stream.m_rx.push_back(testData[pos++]);
     m_server->ProcessRequest();
-    ASSERT_EQ(m_server->m_rxBuffer.size(), 0);
-    ASSERT_EQ(m_server->m_uartTx.size(), 9);
+    ASSERT_EQ(m_server->GetRxBuffer().size(), 0);
+    ASSERT_EQ(m_stream.m_tx.size(), 9);
 
-    ASSERT_EQ(m_server->m_uartTx[0], testData[0]);
-    ASSERT_EQ(m_server->m_uartTx[1], testData[1]);
-    ASSERT_EQ(m_server->m_uartTx[2], 4);
+    ASSERT_EQ(m_stream.m_tx[0], testData[0]);
+    ASSERT_EQ(m_stream.m_tx[1], testData[1]);
+    ASSERT_EQ(m_stream.m_tx[2], 4);
     uint8_t* val = (uint8_t*)(&m_responseValue);
-    ASSERT_EQ(m_server->m_uartTx[3], val[3]);
-    ASSERT_EQ(m_server->m_uartTx[4], val[2]);
-    ASSERT_EQ(m_server->m_uartTx[5], val[1]);
-    ASSERT_EQ(m_server->m_uartTx[6], val[0]);
-    auto expectedCrc = crc16(&m_server->m_uartTx[0], m_server->m_uartTx.size() - 2);
-    ASSERT_EQ(m_server->m_uartTx[7], expectedCrc & 0xFF);
-    ASSERT_EQ(m_server->m_uartTx[8], expectedCrc >> 8);
+    ASSERT_EQ(m_stream.m_tx[3], val[3]);
+    ASSERT_EQ(m_stream.m_tx[4], val[2]);
+    ASSERT_EQ(m_stream.m_tx[5], val[1]);
+    ASSERT_EQ(m_stream.m_tx[6], val[0]);
+    auto expectedCrc = crc16(&m_stream.m_tx[0], m_stream.m_tx.size() - 2);
+    ASSERT_EQ(m_stream.m_tx[7], expectedCrc & 0xFF);
+    ASSERT_EQ(m_stream.m_tx[8], expectedCrc >> 8);
     ASSERT_EQ(m_requests.size(), 1);
 
     // verify request
@@ -217,6 +262,25 @@ TEST_F(ModbusServerTest, OnReceive_ValidRequest_ResponseOk)
     ASSERT_EQ(request.addressCount, 1);
 }
 
+TEST_F(ModbusServerTest, OnReceive_ValidRequest_HeapAllocationsPerRequest)
+{
+    const std::vector<uint8_t> testData = {0x01, 0x03, 0x00, 0x02, 0x00, 0x01, 0x25, 0xca};
+    m_responseValue = 42.3f;
+    m_requests.reserve(3);
+    // first request grows the rx-buffer
+    m_stream.AddRx(testData);
+    m_server->ProcessRequest();
+
+    m_stream.AddRx(testData);
+    alloc_tracker::Scope scope;
+    m_server->ProcessRequest();
+
+    ASSERT_EQ(m_requests.size(), 2);
+    // response-data and payload
+    ASSERT_EQ(scope.GetAllocations(), 2);
+    ASSERT_EQ(scope.GetDeallocations(), 2);
+}
+
 TEST_F(ModbusServerTest, Send_Response4Bytes_CrcOk)
 {
     const uint8_t address = 0xF0;
@@ -231,13 +295,13 @@ TEST_F(ModbusServerTest, Send_Response4Bytes_CrcOk)
 
     m_server->Send(response.GetPayload(address, functionCode));
 
-    ASSERT_EQ(m_server->m_uartTx.size(), 9);
-    ASSERT_EQ(m_server->m_uartTx[0], address);
-    ASSERT_EQ(m_server->m_uartTx[1], functionCode);
-    ASSERT_EQ(m_server->m_uartTx[2], data.size());
-    ASSERT_EQ(std::memcmp(&m_server->m_uartTx[3], &data[0], data.size()), 0);
-    ASSERT_EQ(m_server->m_uartTx[7], expectedCrcLo);
-    ASSERT_EQ(m_server->m_uartTx[8], expectedCrcHi);
+    ASSERT_EQ(m_stream.m_tx.size(), 9);
+    ASSERT_EQ(m_stream.m_tx[0], address);
+    ASSERT_EQ(m_stream.m_tx[1], functionCode);
+    ASSERT_EQ(m_stream.m_tx[2], data.size());
+    ASSERT_EQ(std::memcmp(&m_stream.m_tx[3], &data[0], data.size()), 0);
+    ASSERT_EQ(m_stream.m_tx[7], expectedCrcLo);
+    ASSERT_EQ(m_stream.m_tx[8], expectedCrcHi);
 }
 
 TEST_F(ModbusServerTest, Send_Response2Bytes_CrcOk)
@@ -255,13 +319,13 @@ TEST_F(ModbusServerTest, Send_Response2Bytes_CrcOk)
 
     m_server->Send(response.GetPayload(address, functionCode));
 
-    ASSERT_EQ(m_server->m_uartTx.size(), 7);
-    ASSERT_EQ(m_server->m_uartTx[0], address);
-    ASSERT_EQ(m_server->m_uartTx[1], functionCode);
-    ASSERT_EQ(m_server->m_uartTx[2], data.size());
-    ASSERT_EQ(std::memcmp(&m_server->m_uartTx[3], &data[0], data.size()), 0);
-    ASSERT_EQ(m_server->m_uartTx[5], expectedCrcLo);
-    ASSERT_EQ(m_server->m_uartTx[6], expectedCrcHi);
+    ASSERT_EQ(m_stream.m_tx.size(), 7);
+    ASSERT_EQ(m_stream.m_tx[0], address);
+    ASSERT_EQ(m_stream.m_tx[1], functionCode);
+    ASSERT_EQ(m_stream.m_tx[2], data.size());
+    ASSERT_EQ(std::memcmp(&m_stream.m_tx[3], &data[0], data.size()), 0);
+    ASSERT_EQ(m_stream.m_tx[5], expectedCrcLo);
+    ASSERT_EQ(m_stream.m_tx[6], expectedCrcHi);
 }
 
 TEST_F(ModbusServerTest, ResponseRead_GetPayload_SetSomeData_ResultOk)
@@ -301,3 +365,15 @@ TEST_F(ModbusServerTest, ResponseRead_GetPayload_SetError_ResultIsError)
     ASSERT_EQ(result[1], functionCode | 0x80);
     ASSERT_EQ(result[2], ModbusServer::ResponseRead::ErrorCode::ILLEGAL_VALUE);
 }
+
+TEST_F(ModbusServerTest, ResponseRead_GetPayload_DeviceBusy_ExceptionCode6)
+{
+    ModbusServer::ResponseRead response;
+    response.SetError(ModbusServer::ResponseRead::ErrorCode::DEVICE_BUSY);
+
+    auto result = response.GetPayload(0x42, 0x03);
+
+    ASSERT_EQ(result.size(), 3);
+    ASSERT_EQ(result[1], 0x83);
+    ASSERT_EQ(result[2], 0x06);
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#define ESPDM_HOST
+#include "esphome_mock.h"
+#include "alloc_tracker.h"
+#include "dlms_frame_builder.h"
+#include "../src/esphome-dlms-meter/espdm_obis_decoder.h"
+
+#include <string>
+
+using namespace esphome::espdm;
+
+class ObisDecoderTest : public ::testing::Test
+{
+protected:
+    ObisDecoder m_decoder;
+    MeterData m_data;
+};
+
+TEST_F(ObisDecoderTest, Decode_ValidFrame_AllValuesOk)
+{
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::OK);
+
+    ASSERT_EQ(m_data.voltageL1, 2301);
+    ASSERT_EQ(m_data.voltageL2, 2312);
+    ASSERT_EQ(m_data.voltageL3, 2323);
+    ASSERT_EQ(m_data.currentL1, 123);
+    ASSERT_EQ(m_data.currentL2, 234);
+    ASSERT_EQ(m_data.currentL3, 345);
+    ASSERT_EQ(m_data.activePowerPlus, 1234);
+    ASSERT_EQ(m_data.activePowerMinus, 0);
+    ASSERT_EQ(m_data.activeEnergyPlus, 12345678);
+    ASSERT_EQ(m_data.activeEnergyMinus, 2345678);
+    ASSERT_EQ(m_data.reactiveEnergyPlus, 345678);
+    ASSERT_EQ(m_data.reactiveEnergyMinus, 45678);
+    ASSERT_TRUE(m_data.timestamp.IsValid());
+    ASSERT_EQ(m_data.timestamp.year, 2024);
+    ASSERT_EQ(m_data.timestamp.month, 3);
+    ASSERT_EQ(m_data.timestamp.day, 17);
+    ASSERT_EQ(m_data.timestamp.hour, 12);
+    ASSERT_EQ(m_data.timestamp.minute, 34);
+    ASSERT_EQ(m_data.timestamp.second, 56);
+}
+
+TEST_F(ObisDecoderTest, Decode_ValidFrame_NoHeapAllocation)
+{
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+
+    alloc_tracker::Scope scope;
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::OK);
+    ASSERT_EQ(scope.GetAllocations(), 0);
+}
+
+TEST_F(ObisDecoderTest, Decode_InvalidData_ResultIsError)
+{
+    auto plaintext = dlms_frame_builder::BuildPlaintext();
+    plaintext[0] = 0x0E;
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::INVALID_DATA);
+    ASSERT_EQ(m_data.voltageL1, 0);
+    ASSERT_FALSE(m_data.timestamp.IsValid());
+}
+
+TEST_F(ObisDecoderTest, Decode_ShortPlaintext_ResultIsError)
+{
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+
+    // Shorter than the header, the tag at offset 5 is not read
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), 5, m_data), ObisDecoder::Result::INVALID_DATA);
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), 20, m_data), ObisDecoder::Result::INVALID_DATA);
+}
+
+TEST_F(ObisDecoderTest, Decode_TruncatedPlaintext_NoReadPastEnd)
+{
+    const auto plaintext = dlms_frame_builder::BuildPlaintext();
+
+    // Each prefix is decoded from an own buffer of its size, checked by dlms_fuzz with the address sanitizer
+    for (size_t length = 0; length < plaintext.size(); length++)
+    {
+        const std::vector<uint8_t> truncated(plaintext.begin(), plaintext.begin() + length);
+        MeterData data;
+        const auto result = m_decoder.Decode(truncated.data(), truncated.size(), data);
+        ASSERT_TRUE(result == ObisDecoder::Result::INVALID_DATA || result == ObisDecoder::Result::OK) << length;
+    }
+}
+
+TEST_F(ObisDecoderTest, Decode_UnsupportedMedium_ResultIsError)
+{
+    auto plaintext = dlms_frame_builder::BuildPlaintext();
+    plaintext[20 + 2] = 0x07; // first OBIS code is gas
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data),
+              ObisDecoder::Result::UNSUPPORTED_MEDIUM);
+}
+
+TEST_F(ObisDecoderTest, Decode_EnergyAboveFloatResolution_ExactWh)
+{
+    // float32 has 24 bit mantissa, 2^24 + 1 Wh would be rounded
+    dlms_frame_builder::MeterValues values;
+    values.activeEnergyPlus = 16777217;
+    values.activeEnergyMinus = UINT32_MAX;
+    values.reactiveEnergyPlus = 123456789;
+    const auto plaintext = dlms_frame_builder::BuildPlaintext(values);
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::OK);
+    ObisDecoder::Complete(m_data);
+
+    ASSERT_EQ(m_data.activeEnergyPlus, 16777217u);
+    ASSERT_EQ(m_data.activeEnergyMinus, UINT32_MAX);
+    ASSERT_EQ(m_data.reactiveEnergyPlus, 123456789u);
+}
+
+TEST_F(ObisDecoderTest, Decode_VoltageInVolt_RescaledTo01V)
+{
+    dlms_frame_builder::MeterValues values;
+    values.voltageL1 = 230;
+    values.voltageScaler = 0x00;
+    const auto plaintext = dlms_frame_builder::BuildPlaintext(values);
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::OK);
+
+    ASSERT_EQ(m_data.voltageL1, 2300);
+}
+
+TEST_F(ObisDecoderTest, Decode_EnergyScaler_RescaledToWh)
+{
+    dlms_frame_builder::MeterValues values;
+    values.activeEnergyPlus = 12345; // kWh
+    values.activeEnergyMinus = 5000000; // kWh, more than UINT32_MAX Wh
+    values.energyScaler = 0x03;
+    auto plaintext = dlms_frame_builder::BuildPlaintext(values);
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::OK);
+    ASSERT_EQ(m_data.activeEnergyPlus, 12345000u);
+    ASSERT_EQ(m_data.activeEnergyMinus, UINT32_MAX);
+
+    values.activeEnergyPlus = 123456785; // 0.1Wh
+    values.energyScaler = 0xFF;
+    plaintext = dlms_frame_builder::BuildPlaintext(values);
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::OK);
+    ASSERT_EQ(m_data.activeEnergyPlus, 12345679u);
+}
+
+TEST_F(ObisDecoderTest, Complete_ImpossibleValues_SetToZero)
+{
+    dlms_frame_builder::MeterValues values;
+    values.voltageL2 = 3001; // 300.1V
+    values.currentL3 = 3201; // 32.01A
+    const auto plaintext = dlms_frame_builder::BuildPlaintext(values);
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::OK);
+    ObisDecoder::Complete(m_data);
+
+    ASSERT_EQ(m_data.voltageL1, 2301);
+    ASSERT_EQ(m_data.voltageL2, 0);
+    ASSERT_EQ(m_data.currentL3, 0);
+}
+
+TEST_F(ObisDecoderTest, Complete_ImpossibleValue_ErrorLoggedWithName)
+{
+    static std::string messages;
+    messages.clear();
+    esphome::host::SetLogSink([](char level, const char*, const char* message) {
+        messages += level;
+        messages += message;
+        messages += '\n';
+    });
+    esphome::host::SetLogLevel(esphome::host::LogLevel::ERROR);
+    dlms_frame_builder::MeterValues values;
+    values.voltageL1 = 3001; // 300.1V
+    const auto plaintext = dlms_frame_builder::BuildPlaintext(values);
+
+    ASSERT_EQ(m_decoder.Decode(plaintext.data(), plaintext.size(), m_data), ObisDecoder::Result::OK);
+    ObisDecoder::Complete(m_data);
+    esphome::host::SetLogLevel(esphome::host::LogLevel::NONE);
+    esphome::host::SetLogSink(nullptr);
+
+    ASSERT_EQ(messages, "EVoltage L1 value[3001] is greater than limit[3000]. Set it to 0.\n");
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "../src/persisted_meter_data.h"
+
+using namespace esphome::sm;
+using esphome::espdm::MeterData;
+
+TEST(PersistedMeterDataTest, ToMeterData_EnergyRestored_InstantaneousValuesZero)
+{
+    MeterData data;
+    data.voltageL1 = 2301;
+    data.voltageL2 = 2315;
+    data.voltageL3 = 2298;
+    data.currentL1 = 512;
+    data.currentL2 = -120;
+    data.currentL3 = 33;
+    data.activePowerPlus = 1150;
+    data.activePowerMinus = 0;
+    data.activeEnergyPlus = 4000000007u;
+    data.activeEnergyMinus = 16777217u;
+    data.reactiveEnergyPlus = 123456;
+    data.reactiveEnergyMinus = 654321;
+    data.timestamp.year = 2024;
+    data.timestamp.month = 3;
+    data.timestamp.day = 17;
+    data.UpdateDerived();
+
+    const MeterData restored = PersistedMeterData::FromMeterData(data).ToMeterData();
+
+    ASSERT_EQ(restored.activeEnergyPlus, 4000000007u);
+    ASSERT_EQ(restored.activeEnergyMinus, 16777217u);
+    ASSERT_EQ(restored.reactiveEnergyMinus, 654321u);
+    ASSERT_EQ(restored.timestamp.ToSeconds(), data.timestamp.ToSeconds());
+    // The flash may be an hour old, an inverter must not regulate on the restored power
+    ASSERT_EQ(restored.voltageL2, 0);
+    ASSERT_EQ(restored.currentL2, 0);
+    ASSERT_EQ(restored.activePowerPlus, 0u);
+    ASSERT_EQ(restored.derived.power.total, 0);
+    ASSERT_EQ(restored.derived.current.total, 0);
+    ASSERT_LT(sizeof(PersistedMeterData), sizeof(MeterData));
+}
+
+TEST(PersistThrottleTest, ShouldPersist_FirstValue_True)
+{
+    PersistThrottle throttle;
+
+    ASSERT_TRUE(throttle.ShouldPersist({1, 60000}, 100, 0, 0));
+}
+
+TEST(PersistThrottleTest, ShouldPersist_WithinMinInterval_False)
+{
+    PersistThrottle throttle;
+    const PersistPolicy policy{1, 60000};
+
+    ASSERT_TRUE(throttle.ShouldPersist(policy, 100, 0, 0));
+    ASSERT_FALSE(throttle.ShouldPersist(policy, 200, 0, 59999));
+    ASSERT_TRUE(throttle.ShouldPersist(policy, 200, 0, 60000));
+}
+
+TEST(PersistThrottleTest, ShouldPersist_Unchanged_False)
+{
+    PersistThrottle throttle;
+    const PersistPolicy policy{1, 60000};
+
+    ASSERT_TRUE(throttle.ShouldPersist(policy, 100, 50, 0));
+    ASSERT_FALSE(throttle.ShouldPersist(policy, 100, 50, 120000));
+    ASSERT_TRUE(throttle.ShouldPersist(policy, 100, 51, 180000));
+}
+
+TEST(PersistThrottleTest, ShouldPersist_LargeCounters_OneWhResolved)
+{
+    // Above 2^24 Wh a float can not resolve 1Wh
+    PersistThrottle throttle;
+    const PersistPolicy policy{1, 60000};
+    const uint32_t energy = 3000000000u;
+
+    ASSERT_TRUE(throttle.ShouldPersist(policy, energy, energy, 0));
+    ASSERT_FALSE(throttle.ShouldPersist(policy, energy, energy, 60000));
+    ASSERT_TRUE(throttle.ShouldPersist(policy, energy + 1, energy, 120000));
+    ASSERT_TRUE(throttle.ShouldPersist(policy, energy + 1, energy + 1, 180000));
+}
+
+TEST(PersistThrottleTest, ShouldPersist_ChangeWithinDeadband_False)
+{
+    PersistThrottle throttle;
+    const PersistPolicy policy{10, 0};
+
+    ASSERT_TRUE(throttle.ShouldPersist(policy, 1000, 0, 0));
+    ASSERT_FALSE(throttle.ShouldPersist(policy, 1009, 0, 1));
+    // deadband is relative to the last persisted counters
+    ASSERT_TRUE(throttle.ShouldPersist(policy, 1010, 0, 2));
+    ASSERT_FALSE(throttle.ShouldPersist(policy, 1019, 9, 3));
+}
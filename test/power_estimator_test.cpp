@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+#include "../src/power_estimator.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace esphome::sm;
+
+namespace
+{
+constexpr uint32_t FRAME_INTERVAL_S = 5; // Kaifa
+constexpr uint32_t WARMUP_S = 3 * FRAME_INTERVAL_S;
+
+struct ReplayResult
+{
+    double holdMeanError{0.0};
+    double holdMaxError{0.0};
+    double estimateMeanError{0.0};
+    double estimateMaxError{0.0};
+};
+
+// Replays a 1Hz power trace: the meter sends every 5s, the inverter polls every 1s.
+// Compares the estimate with holding the last value ( as without estimator ).
+ReplayResult Replay(const std::vector<float>& trace)
+{
+    ReplayResult result;
+    PowerEstimator estimator;
+    estimator.SetEnabled(true);
+    size_t count = 0;
+    for (uint32_t second = 0; second < trace.size(); second++)
+    {
+        const uint32_t nowMs = second * 1000;
+        if (second % FRAME_INTERVAL_S == 0)
+        {
+            estimator.AddMeasurement(trace[second], nowMs);
+        }
+        if (second < WARMUP_S)
+        {
+            continue;
+        }
+        const double holdError = std::fabs(estimator.GetLastPower() - trace[second]);
+        const double estimateError = std::fabs(estimator.Estimate(nowMs) - trace[second]);
+        result.holdMeanError += holdError;
+        result.holdMaxError = std::max(result.holdMaxError, holdError);
+        result.estimateMeanError += estimateError;
+        result.estimateMaxError = std::max(result.estimateMaxError, estimateError);
+        count++;
+    }
+    result.holdMeanError /= count;
+    result.estimateMeanError /= count;
+    return result;
+}
+
+void RecordResult(const ReplayResult& result)
+{
+    ::testing::Test::RecordProperty("hold_mean_error_w", std::to_string(result.holdMeanError));
+    ::testing::Test::RecordProperty("estimate_mean_error_w", std::to_string(result.estimateMeanError));
+}
+
+std::vector<float> CreateRampTrace() // pv in the morning, import turns into export
+{
+    std::vector<float> trace;
+    for (uint32_t second = 0; second < 600; second++)
+    {
+        trace.push_back(-2000.0f + second * 5.0f);
+    }
+    return trace;
+}
+
+std::vector<float> CreateCloudTrace() // pv with passing clouds
+{
+    std::vector<float> trace;
+    for (uint32_t second = 0; second < 600; second++)
+    {
+        trace.push_back(1000.0f * std::sin(second / 60.0f));
+    }
+    return trace;
+}
+
+std::vector<float> CreateStepTrace() // appliance switched on and off
+{
+    std::vector<float> trace;
+    for (uint32_t second = 0; second < 600; second++)
+    {
+        trace.push_back((second / 37) % 2 != 0 ? 2500.0f : 300.0f);
+    }
+    return trace;
+}
+
+std::vector<float> CreateHouseholdTrace() // slow drift, appliance and +-100W noise
+{
+    std::vector<float> trace;
+    uint32_t random = 1;
+    float base = 300.0f;
+    for (uint32_t second = 0; second < 3600; second++)
+    {
+        random = random * 1664525u + 1013904223u;
+        const float noise = static_cast<float>((random >> 8) % 200) - 100.0f;
+        if (second % 300 < 120)
+        {
+            base += second % 600 < 300 ? 8.0f : -8.0f;
+        }
+        const float appliance = (second / 90) % 4 == 0 ? 2000.0f : 0.0f;
+        trace.push_back(base + noise + appliance);
+    }
+    return trace;
+}
+
+} // namespace
+
+TEST(PowerEstimatorTest, Estimate_Disabled_LastValue)
+{
+    PowerEstimator estimator;
+    estimator.AddMeasurement(100.0f, 0);
+    estimator.AddMeasurement(200.0f, 5000);
+    estimator.AddMeasurement(300.0f, 10000);
+
+    ASSERT_FLOAT_EQ(estimator.Estimate(14000), 300.0f);
+}
+
+TEST(PowerEstimatorTest, Estimate_Trend_ExtrapolatedAndBounded)
+{
+    PowerEstimator estimator;
+    estimator.SetEnabled(true);
+    estimator.AddMeasurement(100.0f, 0);
+    estimator.AddMeasurement(200.0f, 5000);
+    estimator.AddMeasurement(250.0f, 10000);
+
+    ASSERT_FLOAT_EQ(estimator.Estimate(10000), 250.0f);
+    // smaller change continued, damped
+    ASSERT_FLOAT_EQ(estimator.Estimate(12500), 250.0f + PowerEstimator::DAMPING * 50.0f * 0.5f);
+    ASSERT_FLOAT_EQ(estimator.Estimate(15000), 250.0f + PowerEstimator::DAMPING * 50.0f);
+    // next frame overdue
+    ASSERT_FLOAT_EQ(estimator.Estimate(60000), 250.0f + PowerEstimator::DAMPING * 50.0f);
+}
+
+TEST(PowerEstimatorTest, Estimate_Step_LastValue)
+{
+    PowerEstimator estimator;
+    estimator.SetEnabled(true);
+    estimator.AddMeasurement(300.0f, 0);
+    estimator.AddMeasurement(300.0f, 5000);
+    estimator.AddMeasurement(2500.0f, 10000);
+
+    ASSERT_FLOAT_EQ(estimator.Estimate(14000), 2500.0f);
+
+    estimator.AddMeasurement(300.0f, 15000); // changes in opposite direction
+    ASSERT_FLOAT_EQ(estimator.Estimate(19000), 300.0f);
+}
+
+TEST(PowerEstimatorTest, Estimate_FramesMissing_LastValue)
+{
+    PowerEstimator estimator;
+    estimator.SetEnabled(true);
+    estimator.AddMeasurement(100.0f, 0);
+    estimator.AddMeasurement(200.0f, 5000);
+    estimator.AddMeasurement(300.0f, 5000 + PowerEstimator::MAX_FRAME_INTERVAL_MS + 1);
+
+    ASSERT_FLOAT_EQ(estimator.Estimate(30000), 300.0f);
+}
+
+TEST(PowerEstimatorTest, Replay_Ramp_ErrorHalved)
+{
+    const auto result = Replay(CreateRampTrace());
+    RecordResult(result);
+
+    ASSERT_LT(result.estimateMeanError, 0.6 * result.holdMeanError);
+    ASSERT_LT(result.estimateMaxError, 0.6 * result.holdMaxError);
+}
+
+TEST(PowerEstimatorTest, Replay_Clouds_ErrorHalved)
+{
+    const auto result = Replay(CreateCloudTrace());
+    RecordResult(result);
+
+    ASSERT_LT(result.estimateMeanError, 0.6 * result.holdMeanError);
+    ASSERT_LT(result.estimateMaxError, 0.6 * result.holdMaxError);
+}
+
+TEST(PowerEstimatorTest, Replay_Steps_NotWorseThanHold)
+{
+    const auto result = Replay(CreateStepTrace());
+    RecordResult(result);
+
+    ASSERT_DOUBLE_EQ(result.estimateMeanError, result.holdMeanError);
+    ASSERT_DOUBLE_EQ(result.estimateMaxError, result.holdMaxError);
+}
+
+TEST(PowerEstimatorTest, Replay_NoisyHousehold_ErrorBounded)
+{
+    // Note: white noise can not be predicted, a noise "trend" is continued by mistake
+    const auto result = Replay(CreateHouseholdTrace());
+    RecordResult(result);
+
+    ASSERT_LT(result.estimateMeanError, 1.05 * result.holdMeanError);
+    ASSERT_LE(result.estimateMaxError, result.holdMaxError);
+}
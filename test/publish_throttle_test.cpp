@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include "../src/esphome-dlms-meter/espdm_publish_throttle.h"
+
+using namespace esphome::espdm;
+
+TEST(PublishThrottleTest, ShouldPublish_FirstValue_True)
+{
+    PublishThrottle throttle;
+    const PublishPolicy policy{1.0f, 1000, 0};
+
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 10.0f, 0));
+}
+
+TEST(PublishThrottleTest, ShouldPublish_ChangeWithinDeadband_False)
+{
+    PublishThrottle throttle;
+    const PublishPolicy policy{1.0f, 0, 0};
+
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 10.0f, 0));
+    ASSERT_FALSE(throttle.ShouldPublish(policy, 10.0f, 5000));
+    ASSERT_FALSE(throttle.ShouldPublish(policy, 10.9f, 10000));
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 11.0f, 15000));
+    // deadband is relative to the last published value
+    ASSERT_FALSE(throttle.ShouldPublish(policy, 10.1f, 20000));
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 9.9f, 25000));
+}
+
+TEST(PublishThrottleTest, ShouldPublish_NoDeadband_EveryChange)
+{
+    PublishThrottle throttle;
+    const PublishPolicy policy;
+
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 10.0f, 0));
+    ASSERT_FALSE(throttle.ShouldPublish(policy, 10.0f, 1));
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 10.001f, 2));
+}
+
+TEST(PublishThrottleTest, ShouldPublish_WithinMinInterval_False)
+{
+    PublishThrottle throttle;
+    const PublishPolicy policy{0.0f, 30000, 0};
+
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 1.0f, 1000));
+    ASSERT_FALSE(throttle.ShouldPublish(policy, 2.0f, 30999));
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 3.0f, 31000));
+}
+
+TEST(PublishThrottleTest, ShouldPublish_MaxIntervalExpired_TrueEvenIfUnchanged)
+{
+    PublishThrottle throttle;
+    const PublishPolicy policy{1.0f, 0, 60000};
+
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 1.0f, 0));
+    ASSERT_FALSE(throttle.ShouldPublish(policy, 1.0f, 59999));
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 1.0f, 60000));
+    ASSERT_FALSE(throttle.ShouldPublish(policy, 1.0f, 60001));
+}
+
+TEST(PublishThrottleTest, ShouldPublish_MillisOverflow_IntervalOk)
+{
+    PublishThrottle throttle;
+    const PublishPolicy policy{0.0f, 1000, 0};
+
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 1.0f, 0xFFFFFF00));
+    ASSERT_FALSE(throttle.ShouldPublish(policy, 2.0f, 0x00000010));
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 2.0f, 0x00000300));
+}
+
+TEST(PublishThrottleTest, Reset_NextValuePublished)
+{
+    PublishThrottle throttle;
+    const PublishPolicy policy{1.0f, 1000, 0};
+
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 1.0f, 0));
+    throttle.Reset();
+    ASSERT_TRUE(throttle.ShouldPublish(policy, 1.0f, 1));
+}
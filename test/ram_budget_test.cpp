@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+#include "../src/ram_budget.h"
+
+using namespace esphome::sm;
+
+TEST(RamBudgetTest, Take_LargeHeap_MaxSize)
+{
+    RamBudget budget(4 * 1024 * 1024, 64 * 1024);
+
+    ASSERT_EQ(budget.Take(2048, 96 * 1024, 50), 96 * 1024);
+    ASSERT_EQ(budget.Take(1024, 16 * 1024, 50), 16 * 1024);
+}
+
+TEST(RamBudgetTest, Take_SmallHeap_ShareOfTheRestAboveReserve)
+{
+    // esp32dev without PSRAM
+    RamBudget budget(64 * 1024 + 80000, 64 * 1024);
+
+    ASSERT_EQ(budget.Take(2048, 96 * 1024, 50), 40000);
+    ASSERT_EQ(budget.Take(1024, 16 * 1024, 50), 16 * 1024);
+    ASSERT_EQ(budget.GetAvailable(), 80000 - 40000 - 16 * 1024);
+}
+
+TEST(RamBudgetTest, Take_BelowMinSize_NoneAndBudgetUnchanged)
+{
+    RamBudget budget(70 * 1024, 64 * 1024);
+
+    ASSERT_EQ(budget.Take(8 * 1024, 96 * 1024, 100), 0);
+    ASSERT_EQ(budget.GetAvailable(), 6 * 1024);
+}
+
+TEST(RamBudgetTest, Take_FreeHeapBelowReserve_None)
+{
+    RamBudget budget(40 * 1024, 64 * 1024);
+
+    ASSERT_EQ(budget.Take(0, 96 * 1024, 100), 0);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "esphome_mock.h"
+#include "../src/flash_log.h"
+
+#include <cstring>
+#include <vector>
+
+// FlashDevice in RAM for tests and benchmarks: NOR semantic ( write only clears bits ), counts the erases per sector
+class RamFlash : public esphome::sm::FlashDevice
+{
+public:
+    explicit RamFlash(size_t sectorCount)
+        : m_data(sectorCount * SECTOR_SIZE, 0xFF)
+        , m_eraseCounts(sectorCount, 0)
+    { }
+
+    size_t GetSectorCount() const override
+    {
+        return m_eraseCounts.size();
+    }
+
+    bool Read(size_t offset, void* data, size_t size) override
+    {
+        if (offset + size > m_data.size())
+        {
+            return false;
+        }
+        std::memcpy(data, &m_data[offset], size);
+        return true;
+    }
+
+    bool Write(size_t offset, const void* data, size_t size) override
+    {
+        if (offset + size > m_data.size())
+        {
+            return false;
+        }
+        // A limited write simulates a power loss while writing
+        size = std::min(size, m_writeLimit);
+        m_writeLimit = SIZE_MAX;
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            m_data[offset + i] &= bytes[i];
+        }
+        return true;
+    }
+
+    bool EraseSector(size_t sector) override
+    {
+        if (sector >= m_eraseCounts.size())
+        {
+            return false;
+        }
+        std::memset(&m_data[sector * SECTOR_SIZE], 0xFF, SECTOR_SIZE);
+        m_eraseCounts[sector]++;
+        return true;
+    }
+
+    // Only the first bytes of the next write reach the flash
+    void LimitNextWrite(size_t size)
+    {
+        m_writeLimit = size;
+    }
+
+    const std::vector<uint32_t>& GetEraseCounts() const
+    {
+        return m_eraseCounts;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+    std::vector<uint32_t> m_eraseCounts;
+    size_t m_writeLimit{SIZE_MAX};
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "dlms_frame_builder.h"
+#include "../src/esphome-dlms-meter/espdm_meter_data.h"
+
+// One decoded Kaifa MA309 frame for the tests: the values of dlms_frame_builder::MeterValues, 2024-03-17 12:34:56
+namespace sample_meter_data
+{
+
+inline esphome::espdm::MeterData Create()
+{
+    const dlms_frame_builder::MeterValues values;
+    esphome::espdm::MeterData data;
+    data.voltageL1 = values.voltageL1; // 230.1V
+    data.voltageL2 = values.voltageL2;
+    data.voltageL3 = values.voltageL3;
+    data.currentL1 = values.currentL1; // 1.23A
+    data.currentL2 = values.currentL2;
+    data.currentL3 = values.currentL3;
+    data.activePowerPlus = values.activePowerPlus; // 1234W
+    data.activePowerMinus = values.activePowerMinus;
+    data.activeEnergyPlus = values.activeEnergyPlus; // 12345678Wh
+    data.activeEnergyMinus = values.activeEnergyMinus;
+    data.reactiveEnergyPlus = values.reactiveEnergyPlus;
+    data.reactiveEnergyMinus = values.reactiveEnergyMinus;
+    data.timestamp = {2024, 3, 17, 12, 34, 56};
+    data.UpdateDerived();
+    return data;
+}
+
+} // namespace sample_meter_data
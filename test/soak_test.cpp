@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "alloc_tracker.h"
+#include "encrypted_frame_builder.h"
+#include "energy_interval.h"
+#include "meter_pipeline.h"
+#include "virtual_clock.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+using namespace gateway;
+using esphome::espdm::MeterTimestamp;
+
+namespace
+{
+constexpr uint8_t MODBUS_ADDRESS = 1;
+// Simulated days, SMART_METER_SOAK_DAYS=30 runs a month ( ~15s with a release build )
+constexpr uint32_t DEFAULT_DAYS = 3;
+constexpr uint32_t SECONDS_PER_DAY = 24 * 60 * 60;
+constexpr uint32_t FRAME_INTERVAL_S = 5; // Kaifa MA309
+// Frames of the meter are missing for one minute, in the middle of the simulated days
+constexpr uint32_t OUTAGE_BEGIN_S = 12 * 60 * 60;
+constexpr uint32_t OUTAGE_LENGTH_S = 60;
+// Frames with consecutive frame counters, replayed in a cycle
+constexpr uint32_t FRAME_SET_COUNT = 64;
+// Status led and loop of the SmartMeter
+constexpr uint32_t BLINK_ON_MS = 80;
+constexpr uint32_t LOOP_INTERVAL_MS = 20;
+constexpr uint64_t MILLIS_OVERFLOW_US = (1ULL << 32) * 1000;
+
+// Read the 124 registers of the meter block, as sent by the Fronius inverter
+std::vector<uint8_t> GetModbusRequest()
+{
+    std::vector<uint8_t> request = {MODBUS_ADDRESS, 0x03, 0x9C, 0x86, 0x00, 0x7C, 0x00, 0x00};
+    const auto crc = esphome::crc16(request.data(), request.size() - 2);
+    request[6] = crc & 0xFF;
+    request[7] = crc >> 8;
+    return request;
+}
+
+uint32_t GetDays()
+{
+    const char* days = std::getenv("SMART_METER_SOAK_DAYS");
+    const int value = days != nullptr ? std::atoi(days) : 0;
+    return value >= 2 ? static_cast<uint32_t>(value) : DEFAULT_DAYS;
+}
+
+bool IsOutage(uint32_t day, uint32_t outageDay, uint32_t second)
+{
+    return day == outageDay && second >= OUTAGE_BEGIN_S && second < OUTAGE_BEGIN_S + OUTAGE_LENGTH_S;
+}
+
+double GetAverage(const std::vector<double>& values, size_t begin, size_t end)
+{
+    double sum = 0.0;
+    for (size_t i = begin; i < end; i++)
+    {
+        sum += values[i];
+    }
+    return sum / (end - begin);
+}
+
+} // namespace
+
+// Days of 5s meter frames and 1Hz Modbus polls in virtual time: memory and processing time per day must not grow,
+// the stale policy must follow the virtual clock.
+TEST(SoakTest, Days_5sFramesAnd1HzPolls_MemoryAndLatencyFlat)
+{
+    const uint32_t days = GetDays();
+    const uint32_t outageDay = days / 2;
+    VirtualClock clock;
+    MeterPipeline pipeline(encrypted_frame_builder::KEY, MODBUS_ADDRESS);
+    pipeline.SetClock(clock);
+    esphome::MockByteStream modbus;
+    pipeline.SetModbusStream(modbus);
+    std::vector<std::vector<uint8_t>> frames;
+    for (uint32_t i = 1; i <= FRAME_SET_COUNT; i++)
+    {
+        frames.push_back(encrypted_frame_builder::BuildMbusFrames(i));
+    }
+    const auto request = GetModbusRequest();
+    const size_t chunkSize = MeterPipeline::READ_CHUNK_SIZE;
+    const size_t validResponseLength = 3 + 2 * 124 + 2;
+    const size_t exceptionResponseLength = 5;
+
+    uint32_t frameCount = 0;
+    uint32_t validResponses = 0;
+    uint32_t exceptionResponses = 0;
+    uint32_t invalidResponses = 0;
+    std::vector<double> dayNs(days);
+    std::vector<size_t> dayPeakBytes(days);
+    std::vector<size_t> dayLiveBytes(days);
+    for (uint32_t day = 0; day < days; day++)
+    {
+        alloc_tracker::Scope scope;
+        const auto liveBegin = alloc_tracker::GetCounters().liveBytes;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint32_t second = 0; second < SECONDS_PER_DAY; second++)
+        {
+            if (second % FRAME_INTERVAL_S == 0 && !IsOutage(day, outageDay, second))
+            {
+                const auto& frame = frames[frameCount++ % FRAME_SET_COUNT];
+                // In chunks as read from the link
+                for (size_t offset = 0; offset < frame.size(); offset += chunkSize)
+                {
+                    pipeline.AddMeterData(&frame[offset], std::min(chunkSize, frame.size() - offset));
+                }
+            }
+            modbus.AddRx(request);
+            pipeline.ProcessModbus();
+            const size_t length = modbus.m_tx.size();
+            if (length == validResponseLength)
+            {
+                validResponses++;
+            }
+            else if (length == exceptionResponseLength && modbus.m_tx[2] == 0x04)
+            {
+                exceptionResponses++;
+            }
+            else
+            {
+                invalidResponses++;
+            }
+            modbus.m_tx.clear();
+            clock.Advance(1000);
+        }
+        const auto end = std::chrono::steady_clock::now();
+        dayNs[day] = std::chrono::duration<double, std::nano>(end - start).count();
+        dayPeakBytes[day] = scope.GetPeakBytes();
+        dayLiveBytes[day] = alloc_tracker::GetCounters().liveBytes - liveBegin;
+    }
+
+    const uint32_t polls = days * SECONDS_PER_DAY;
+    const uint32_t outageFrames = OUTAGE_LENGTH_S / FRAME_INTERVAL_S;
+    ASSERT_EQ(pipeline.GetLinkStatistics().decodedFrames, polls / FRAME_INTERVAL_S - outageFrames);
+    ASSERT_EQ(pipeline.GetLinkStatistics().GetAbortCount(), 0);
+    ASSERT_EQ(pipeline.GetResyncCount(), 0);
+    // Stale ( age > 30s ) from 31s after the last frame before the outage until the next frame
+    const uint32_t staleMaxAgeS = MeterPipeline::STALE_MAX_AGE_MS / 1000;
+    const uint32_t stalePolls = OUTAGE_LENGTH_S + FRAME_INTERVAL_S - staleMaxAgeS - 1;
+    ASSERT_EQ(exceptionResponses, stalePolls);
+    ASSERT_EQ(validResponses, polls - stalePolls);
+    ASSERT_EQ(invalidResponses, 0);
+    for (uint32_t day = 0; day < days; day++)
+    {
+        // No growth: everything allocated during a day is freed, the high-water mark is the one of the first day
+        ASSERT_EQ(dayLiveBytes[day], 0) << "day " << day;
+        ASSERT_LE(dayPeakBytes[day], dayPeakBytes[0]) << "day " << day;
+    }
+    // Processing time per day does not grow ( last third compared to the first one, generous for noisy hosts )
+    const size_t third = std::max<size_t>(days / 3, 1);
+    const double first = GetAverage(dayNs, 0, third);
+    const double last = GetAverage(dayNs, days - third, days);
+    ASSERT_LT(last, 3.0 * first);
+}
+
+// The time-dependent status logic of the SmartMeter over days of virtual time, millis() overflows in the middle:
+// a status led blink per 1Hz poll, the uptime, the energy interval and calendar energy of 5s frames with the
+// timestamps of the meter. No memory is allocated.
+TEST(SoakTest, Days_StatusLedUptimeAndEnergyInterval_FollowVirtualClock)
+{
+    const uint32_t days = GetDays();
+    VirtualClock clock(MILLIS_OVERFLOW_US - static_cast<uint64_t>(days / 2) * SECONDS_PER_DAY * 1000 * 1000);
+    esphome::espdm::BlinkTimer blink(BLINK_ON_MS);
+    esphome::espdm::Uptime uptime;
+    esphome::sm::EnergyInterval interval;
+    esphome::sm::CalendarEnergy calendar;
+    MeterTimestamp begin;
+    begin.year = 2024;
+    begin.month = 12;
+    begin.day = 31;
+    interval.SetBeginDate(begin);
+    interval.SetBegin(0, 0);
+    uptime.Update(clock);
+
+    int64_t energyWh = 0;
+    uint32_t blinks = 0;
+    uint32_t wrongBlinks = 0;
+    uint32_t periodsBegan = 0;
+    MeterTimestamp timestamp;
+    for (uint32_t day = 0; day < days; day++)
+    {
+        alloc_tracker::Scope scope;
+        for (uint32_t second = 0; second < SECONDS_PER_DAY; second++)
+        {
+            if (second % FRAME_INTERVAL_S == 0)
+            {
+                timestamp = MeterTimestamp::FromSeconds(begin.ToSeconds() + day * SECONDS_PER_DAY + second);
+                energyWh++;
+                periodsBegan += calendar.Update(timestamp, energyWh, 0) ? 1 : 0;
+                interval.Update(energyWh, 0);
+            }
+            // A Modbus response switches the led on, the loop switches it off
+            blink.Start(clock);
+            const uint32_t onMs = clock.Millis();
+            for (uint32_t ms = 0; ms < 1000; ms += LOOP_INTERVAL_MS)
+            {
+                clock.Advance(LOOP_INTERVAL_MS);
+                if (blink.Expired(clock))
+                {
+                    blinks++;
+                    wrongBlinks += clock.Millis() - onMs == BLINK_ON_MS ? 0 : 1;
+                }
+                uptime.Update(clock);
+            }
+        }
+        ASSERT_EQ(scope.GetAllocations(), 0) << "day " << day;
+    }
+
+    const uint32_t frames = days * SECONDS_PER_DAY / FRAME_INTERVAL_S;
+    ASSERT_LT(clock.Millis(), days * SECONDS_PER_DAY * 1000ULL); // overflowed
+    ASSERT_EQ(blinks, days * SECONDS_PER_DAY);
+    ASSERT_EQ(wrongBlinks, 0);
+    ASSERT_EQ(uptime.GetMs(), days * SECONDS_PER_DAY * 1000ULL);
+    char text[esphome::sm::TIMESPAN_TEXT_SIZE];
+    esphome::sm::FormatTimespan(text, sizeof(text), static_cast<int64_t>(uptime.GetMs() / 1000));
+    ASSERT_EQ(std::string(text), std::to_string(days) + "d 00:00:00");
+    // The last frame is 5s before the end of the last day
+    esphome::sm::FormatTimespan(text, sizeof(text), interval.GetDurationSeconds(timestamp));
+    ASSERT_EQ(std::string(text), std::to_string(days - 1) + "d 23:59:55");
+    ASSERT_EQ(interval.GetPlus(), frames);
+    // The first frame begins all periods, each day a new day, the 2nd a new month and year
+    ASSERT_EQ(periodsBegan, days);
+    ASSERT_EQ(calendar.Get(esphome::sm::CalendarEnergy::Day).GetPlus(), SECONDS_PER_DAY / FRAME_INTERVAL_S - 1);
+    ASSERT_EQ(calendar.Get(esphome::sm::CalendarEnergy::Year).GetPlus(), frames - SECONDS_PER_DAY / FRAME_INTERVAL_S - 1);
+}
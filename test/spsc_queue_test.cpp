@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "../src/esphome-dlms-meter/espdm_spsc_queue.h"
+
+#include <thread>
+
+using namespace esphome::espdm;
+
+namespace
+{
+// Similar size as a dlms-frame snapshot, all fields have the same value to detect tearing
+struct Snapshot
+{
+    uint32_t sequence{0};
+    float values[16]{};
+};
+
+Snapshot CreateSnapshot(uint32_t sequence)
+{
+    Snapshot snapshot;
+    snapshot.sequence = sequence;
+    for (auto& value : snapshot.values)
+    {
+        value = static_cast<float>(sequence);
+    }
+    return snapshot;
+}
+
+} // namespace
+
+TEST(SpscQueueTest, PushPop_SingleThread_FifoOrder)
+{
+    SpscQueue<uint32_t, 4> queue;
+    uint32_t item(0);
+
+    ASSERT_TRUE(queue.Empty());
+    ASSERT_FALSE(queue.Pop(item));
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(queue.Push(i));
+    }
+    ASSERT_FALSE(queue.Push(4)); // full
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        ASSERT_TRUE(queue.Pop(item));
+        ASSERT_EQ(item, i);
+    }
+    ASSERT_TRUE(queue.Empty());
+}
+
+TEST(SpscQueueTest, PushPop_ProducerAndConsumerThread_OrderedAndNotTorn)
+{
+    constexpr uint32_t COUNT = 200000;
+    SpscQueue<Snapshot, 4> queue;
+
+    std::thread producer([&queue]() {
+        for (uint32_t i = 1; i <= COUNT; i++)
+        {
+            const auto snapshot = CreateSnapshot(i);
+            while (!queue.Push(snapshot))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expectedSequence = 1;
+    uint32_t tornCount = 0;
+    uint32_t outOfOrderCount = 0;
+    Snapshot snapshot;
+    while (expectedSequence <= COUNT)
+    {
+        if (!queue.Pop(snapshot))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        outOfOrderCount += snapshot.sequence != expectedSequence ? 1 : 0;
+        for (const auto value : snapshot.values)
+        {
+            tornCount += value != static_cast<float>(snapshot.sequence) ? 1 : 0;
+        }
+        expectedSequence++;
+    }
+    producer.join();
+
+    ASSERT_EQ(outOfOrderCount, 0);
+    ASSERT_EQ(tornCount, 0);
+    ASSERT_TRUE(queue.Empty());
+}
@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "alloc_tracker.h"
+#include "../src/meter_model_bridge.h"
 #include "../src/sunspec_meter_model.h"
 
+#include <cmath>
+
 using namespace sunspec;
 
 namespace
@@ -63,6 +68,63 @@ TEST_F(SunspecMeterModelTest, Constructor_InitializedRegisters)
     }
 }
 
+TEST_F(SunspecMeterModelTest, Constructor_SinglePhase_Model211)
+{
+    MeterModel meter(3, MODEL_SINGLE_PHASE);
+
+    auto reg = meter.GetRegister(40000, 197);
+    ASSERT_EQ(__builtin_bswap16(reg[68]), 3);
+    ASSERT_EQ(__builtin_bswap16(reg[69]), 211);
+    ASSERT_EQ(__builtin_bswap16(reg[70]), 124);
+    ASSERT_EQ(__builtin_bswap16(reg[195]), 0xFFFF);
+}
+
+TEST_F(SunspecMeterModelTest, SetPhaseMeterData_L2_OnlyPhaseAImplemented)
+{
+    esphome::espdm::MeterData data;
+    data.voltageL1 = 2300;
+    data.voltageL2 = 2310;
+    data.voltageL3 = 2320;
+    data.currentL1 = 100;
+    data.currentL2 = 200;
+    data.currentL3 = 300;
+    data.activePowerPlus = 1386;
+    data.activeEnergyPlus = 3000;
+    data.UpdateDerived();
+    MeterModel meter(3, MODEL_SINGLE_PHASE);
+
+    esphome::sm::SetPhaseMeterData(meter, data, 1);
+
+    auto reg = meter.GetRegister(40071, 124);
+    ASSERT_FLOAT_EQ(ToFloatLittleEndian(&reg[0]), 2.0f); // current total
+    ASSERT_FLOAT_EQ(ToFloatLittleEndian(&reg[2]), 2.0f); // current phase A
+    ASSERT_TRUE(std::isnan(ToFloatLittleEndian(&reg[4]))); // current phase B
+    ASSERT_FLOAT_EQ(ToFloatLittleEndian(&reg[79 - 71]), 231.0f); // voltage
+    ASSERT_TRUE(std::isnan(ToFloatLittleEndian(&reg[87 - 71]))); // voltage phase to phase
+    ASSERT_FLOAT_EQ(ToFloatLittleEndian(&reg[97 - 71]), data.derived.power.phase2);
+    ASSERT_FLOAT_EQ(ToFloatLittleEndian(&reg[137 - 71]), 1000.0f); // imported energy
+    ASSERT_TRUE(std::isnan(ToFloatLittleEndian(&reg[137 - 71 + 6]))); // imported energy phase C
+}
+
+TEST_F(SunspecMeterModelTest, SetMeterData_FixedPoint_NearestFloat)
+{
+    esphome::espdm::MeterData data;
+    data.voltageL1 = 2301;
+    data.currentL1 = -123;
+    data.activePowerMinus = 283;
+    data.activeEnergyPlus = 16777217; // 2^24 + 1
+    data.UpdateDerived();
+
+    esphome::sm::SetMeterData(m_meter, data);
+
+    auto reg = m_meter.GetRegister(40071, 124);
+    ASSERT_EQ(ToFloatLittleEndian(&reg[2]), -1.23f); // current phase A
+    ASSERT_EQ(ToFloatLittleEndian(&reg[79 - 71 + 2]), 230.1f); // voltage phase A
+    ASSERT_EQ(ToFloatLittleEndian(&reg[121 - 71]), 1.0f); // power factor, 283W of 283.023VA
+    // The float register is the only place where the energy is rounded
+    ASSERT_EQ(ToFloatLittleEndian(&reg[137 - 71]), 16777216.0f);
+}
+
 TEST_F(SunspecMeterModelTest, GetRegister_InvalidRegisterIndex_NoResult)
 {
     ASSERT_EQ(m_meter.GetRegister(39999, 1).size(), 0);
@@ -158,3 +220,108 @@ TEST_F(SunspecMeterModelTest, SetTotalVaHoursImported)
     m_meter.SetTotalVaHoursImported(VALUE1, VALUE2, VALUE3, VALUE4);
     CheckFloatValues(40153);
 }
+
+TEST_F(SunspecMeterModelTest, SetAllValues_NoHeapAllocation)
+{
+    alloc_tracker::Scope scope;
+    m_meter.SetAcCurrent(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetVoltageToNeutral(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetVoltagePhaseToPhase(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetFrequency(VALUE1);
+    m_meter.SetPower(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetApparentPower(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetReactivePower(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetPowerFactor(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetTotalWattHoursExported(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetTotalWattHoursImported(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetTotalVaHoursExported(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetTotalVaHoursImported(VALUE1, VALUE2, VALUE3, VALUE4);
+
+    ASSERT_EQ(scope.GetAllocations(), 0);
+}
+
+TEST_F(SunspecMeterModelTest, GetRegisterRaw_OneHeapAllocation)
+{
+    alloc_tracker::Scope scope;
+    auto raw = m_meter.GetRegisterRaw(40071, 124);
+
+    ASSERT_EQ(raw.size(), 248);
+    ASSERT_EQ(scope.GetAllocations(), 1);
+    ASSERT_EQ(scope.GetAllocatedBytes(), 248);
+}
+
+TEST_F(SunspecMeterModelTest, GetStaleAction_SimulatedClock_Transitions)
+{
+    const StalePolicy policy = {30000, StaleAction::DEVICE_FAILURE};
+    m_meter.SetStalePolicy(policy);
+    ASSERT_EQ(m_meter.GetStaleAction(0), StaleAction::DEVICE_FAILURE); // never updated
+
+    uint32_t now = 1000;
+    m_meter.SetUpdateTime(now);
+    ASSERT_EQ(m_meter.GetStaleAction(now), StaleAction::SERVE);
+    now += 30000;
+    ASSERT_EQ(m_meter.GetStaleAction(now), StaleAction::SERVE); // at the max. age
+    now += 1;
+    ASSERT_EQ(m_meter.GetStaleAction(now), StaleAction::DEVICE_FAILURE);
+    ASSERT_TRUE(m_meter.IsStale(now));
+
+    m_meter.SetUpdateTime(now); // next frame
+    ASSERT_EQ(m_meter.GetStaleAction(now + 5000), StaleAction::SERVE);
+
+    m_meter.SetStalePolicy({0, StaleAction::DEVICE_FAILURE}); // disabled
+    ASSERT_EQ(m_meter.GetStaleAction(now + 3600000), StaleAction::SERVE);
+}
+
+TEST_F(SunspecMeterModelTest, GetStaleAction_MillisOverflow_NotStale)
+{
+    m_meter.SetStalePolicy({30000, StaleAction::DEVICE_BUSY});
+    const uint32_t updateTime = UINT32_MAX - 10000;
+    m_meter.SetUpdateTime(updateTime);
+
+    ASSERT_EQ(m_meter.GetStaleAction(updateTime + 20000), StaleAction::SERVE); // wrapped
+    ASSERT_EQ(m_meter.GetStaleAction(updateTime + 40000), StaleAction::DEVICE_BUSY);
+}
+
+TEST_F(SunspecMeterModelTest, HasMeasuredValues_StaticBlocks_False)
+{
+    ASSERT_FALSE(m_meter.HasMeasuredValues(40000, 69)); // common block
+    ASSERT_FALSE(m_meter.HasMeasuredValues(40000, 71)); // with the model header
+    ASSERT_TRUE(m_meter.HasMeasuredValues(40000, 72));
+    ASSERT_TRUE(m_meter.HasMeasuredValues(40071, 124)); // values of the meter block
+    ASSERT_TRUE(m_meter.HasMeasuredValues(40194, 1));
+    ASSERT_FALSE(m_meter.HasMeasuredValues(40195, 2)); // end block
+    ASSERT_FALSE(m_meter.HasMeasuredValues(40195, 3)); // invalid range
+}
+
+TEST_F(SunspecMeterModelTest, GetRegisterRaw_ZeroPower_OnlyCurrentAndPowerZero)
+{
+    m_meter.SetAcCurrent(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetVoltageToNeutral(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetPower(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetReactivePower(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetPowerFactor(VALUE1, VALUE2, VALUE3, VALUE4);
+
+    const auto raw = m_meter.GetRegisterRaw(40071, 124, true);
+    const auto unchanged = m_meter.GetRegisterRaw(40071, 124);
+
+    auto* reg = reinterpret_cast<uint16_t*>(const_cast<uint8_t*>(&raw[0]));
+    ASSERT_EQ(ToFloatLittleEndian(&reg[0]), 0.0f); // current
+    ASSERT_EQ(ToFloatLittleEndian(&reg[8]), VALUE1); // voltage
+    ASSERT_EQ(ToFloatLittleEndian(&reg[97 - 71]), 0.0f); // power
+    ASSERT_EQ(ToFloatLittleEndian(&reg[113 - 71 + 6]), 0.0f); // reactive power phase C
+    ASSERT_EQ(ToFloatLittleEndian(&reg[121 - 71]), VALUE1); // power factor
+    auto* unchangedReg = reinterpret_cast<uint16_t*>(const_cast<uint8_t*>(&unchanged[0]));
+    ASSERT_EQ(ToFloatLittleEndian(&unchangedReg[97 - 71]), VALUE1);
+}
+
+TEST_F(SunspecMeterModelTest, GetRegisterRaw_ZeroPowerPartialRange_Ok)
+{
+    m_meter.SetPower(VALUE1, VALUE2, VALUE3, VALUE4);
+    m_meter.SetFrequency(VALUE1);
+
+    const auto raw = m_meter.GetRegisterRaw(40095, 4, true); // frequency and total power
+
+    auto* reg = reinterpret_cast<uint16_t*>(const_cast<uint8_t*>(&raw[0]));
+    ASSERT_EQ(ToFloatLittleEndian(&reg[0]), VALUE1);
+    ASSERT_EQ(ToFloatLittleEndian(&reg[2]), 0.0f);
+}
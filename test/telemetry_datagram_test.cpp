@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "esphome_mock.h"
+#include "alloc_tracker.h"
+#include "sample_meter_data.h"
+#include "telemetry_receiver/telemetry_collector.h"
+
+#include <cstring>
+
+using namespace esphome::sm;
+
+namespace
+{
+TelemetryDatagram CreateDatagram(uint32_t deviceId, uint32_t sequence)
+{
+    TelemetryDatagram datagram;
+    datagram.deviceId = deviceId;
+    datagram.sequence = sequence;
+    datagram.data = sample_meter_data::Create();
+    return datagram;
+}
+
+} // namespace
+
+TEST(TelemetryDatagramTest, EncodeDecode_AllFieldsEqual)
+{
+    const auto datagram = CreateDatagram(0x12345678, 42);
+    uint8_t buffer[TelemetryDatagram::SIZE];
+    datagram.Encode(buffer);
+
+    TelemetryDatagram decoded;
+    ASSERT_TRUE(decoded.Decode(buffer, sizeof(buffer)));
+
+    ASSERT_EQ(decoded.deviceId, 0x12345678);
+    ASSERT_EQ(decoded.sequence, 42);
+    ASSERT_EQ(decoded.data.timestamp.year, 2024);
+    ASSERT_EQ(decoded.data.timestamp.second, 56);
+    ASSERT_EQ(decoded.data.voltageL1, 2301);
+    ASSERT_EQ(decoded.data.currentL1, 123);
+    ASSERT_EQ(decoded.data.activeEnergyPlus, 12345678);
+    ASSERT_EQ(decoded.data.reactiveEnergyMinus, 45678);
+}
+
+TEST(TelemetryDatagramTest, EncodeDecode_FullCounterRange_Exact)
+{
+    auto datagram = CreateDatagram(1, 1);
+    datagram.data.activeEnergyPlus = UINT32_MAX;
+    datagram.data.activeEnergyMinus = 16777217; // not exact as float32 ( version 1 )
+    datagram.data.currentL3 = -3200;
+    uint8_t buffer[TelemetryDatagram::SIZE];
+    datagram.Encode(buffer);
+
+    TelemetryDatagram decoded;
+    ASSERT_TRUE(decoded.Decode(buffer, sizeof(buffer)));
+
+    ASSERT_EQ(decoded.data.activeEnergyPlus, UINT32_MAX);
+    ASSERT_EQ(decoded.data.activeEnergyMinus, 16777217u);
+    ASSERT_EQ(decoded.data.currentL3, -3200);
+}
+
+TEST(TelemetryDatagramTest, Layout_LittleEndianFixedOffsets)
+{
+    const auto datagram = CreateDatagram(0x12345678, 0x01020304);
+    uint8_t buffer[TelemetryDatagram::SIZE];
+    datagram.Encode(buffer);
+
+    ASSERT_EQ(buffer[0], 'S');
+    ASSERT_EQ(buffer[1], 'M');
+    const uint8_t version = TelemetryDatagram::VERSION;
+    ASSERT_EQ(buffer[2], version);
+    ASSERT_EQ(buffer[4], 0x78);
+    ASSERT_EQ(buffer[8], 0x04);
+    ASSERT_EQ(buffer[12] | (buffer[13] << 8), 2024);
+    ASSERT_EQ(buffer[20] | (buffer[21] << 8), 2301); // voltage L1 in 0.1V
+    int32_t currentL1;
+    std::memcpy(&currentL1, &buffer[32], sizeof(currentL1)); // host is little endian
+    ASSERT_EQ(currentL1, 123);
+}
+
+TEST(TelemetryDatagramTest, Decode_Corrupted_Invalid)
+{
+    const auto datagram = CreateDatagram(1, 1);
+    uint8_t buffer[TelemetryDatagram::SIZE];
+    datagram.Encode(buffer);
+    TelemetryDatagram decoded;
+
+    ASSERT_FALSE(decoded.Decode(buffer, sizeof(buffer) - 1));
+    buffer[30] ^= 0x01;
+    ASSERT_FALSE(decoded.Decode(buffer, sizeof(buffer)));
+}
+
+TEST(TelemetryDatagramTest, Encode_NoHeapAllocation)
+{
+    const auto datagram = CreateDatagram(1, 1);
+    uint8_t buffer[TelemetryDatagram::SIZE];
+
+    alloc_tracker::Scope scope;
+    datagram.Encode(buffer);
+
+    ASSERT_EQ(scope.GetAllocations(), 0);
+}
+
+TEST(TelemetryDatagramTest, Collector_SequenceGaps_LostCountedPerDevice)
+{
+    TelemetryCollector collector;
+    uint8_t buffer[TelemetryDatagram::SIZE];
+    for (uint32_t sequence : {1, 2, 5, 6})
+    {
+        CreateDatagram(100, sequence).Encode(buffer);
+        ASSERT_NE(collector.Add(buffer, sizeof(buffer)), nullptr);
+    }
+    CreateDatagram(200, 7).Encode(buffer);
+    collector.Add(buffer, sizeof(buffer));
+    buffer[0] = 0;
+    ASSERT_EQ(collector.Add(buffer, sizeof(buffer)), nullptr);
+
+    ASSERT_EQ(collector.GetDevices().size(), 2);
+    ASSERT_EQ(collector.GetDevices().at(100).received, 4);
+    ASSERT_EQ(collector.GetDevices().at(100).lost, 2);
+    ASSERT_EQ(collector.GetDevices().at(200).lost, 0);
+    ASSERT_EQ(collector.GetInvalidCount(), 1);
+}
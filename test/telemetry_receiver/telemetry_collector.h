@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../../src/telemetry_datagram.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+// Collector side of the telemetry stream: decodes the datagrams and tracks the sequence per device
+class TelemetryCollector
+{
+public:
+    struct Device
+    {
+        uint32_t lastSequence{0};
+        uint64_t received{0};
+        uint64_t lost{0}; // gaps of the sequence number
+        esphome::espdm::MeterData data; // of the last datagram
+    };
+
+    // Returns the device of a valid datagram, nullptr otherwise
+    const Device* Add(const uint8_t* buffer, size_t length)
+    {
+        if (!m_datagram.Decode(buffer, length))
+        {
+            m_invalid++;
+            return nullptr;
+        }
+        auto inserted = m_devices.emplace(m_datagram.deviceId, Device());
+        Device& device = inserted.first->second;
+        if (!inserted.second && m_datagram.sequence > device.lastSequence + 1)
+        {
+            device.lost += m_datagram.sequence - device.lastSequence - 1;
+        }
+        device.lastSequence = m_datagram.sequence;
+        device.received++;
+        device.data = m_datagram.data;
+        return &device;
+    }
+
+    uint32_t GetDeviceId() const
+    {
+        return m_datagram.deviceId;
+    }
+
+    const std::unordered_map<uint32_t, Device>& GetDevices() const
+    {
+        return m_devices;
+    }
+
+    uint64_t GetInvalidCount() const
+    {
+        return m_invalid;
+    }
+
+private:
+    esphome::sm::TelemetryDatagram m_datagram;
+    std::unordered_map<uint32_t, Device> m_devices;
+    uint64_t m_invalid{0};
+};
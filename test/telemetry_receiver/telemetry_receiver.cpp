@@ -0,0 +1,60 @@
+// Receives the telemetry datagrams of the smart meters and prints them as csv
+// Usage: telemetry_receiver [port], default port 5680
+#include "esphome_host.h"
+#include "telemetry_collector.h"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int main(int argc, char* argv[])
+{
+    const int port = argc > 1 ? atoi(argv[1]) : 5680;
+    const int udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (udpSocket < 0 || bind(udpSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        perror("bind");
+        return 1;
+    }
+    fprintf(stderr, "Listening on udp port %d\n", port);
+    printf("device,sequence,lost,timestamp,voltage_l1,voltage_l2,voltage_l3,current_l1,current_l2,current_l3,"
+           "active_power_plus,active_power_minus,active_energy_plus,active_energy_minus,reactive_energy_plus,"
+           "reactive_energy_minus\n");
+    fflush(stdout);
+
+    TelemetryCollector collector;
+    uint8_t buffer[512];
+    for (;;)
+    {
+        const ssize_t length = recv(udpSocket, buffer, sizeof(buffer), 0);
+        if (length < 0)
+        {
+            perror("recv");
+            return 1;
+        }
+        const auto* device = collector.Add(buffer, static_cast<size_t>(length));
+        if (device == nullptr)
+        {
+            fprintf(stderr, "Invalid datagram, %zd bytes\n", length);
+            continue;
+        }
+        const auto& data = device->data;
+        const auto& ts = data.timestamp;
+        using esphome::espdm::MeterData;
+        printf("%08X,%u,%llu,%04u-%02u-%02uT%02u:%02u:%02u,%.1f,%.1f,%.1f,%.2f,%.2f,%.2f,%u,%u,%u,%u,%u,%u\n",
+               collector.GetDeviceId(), device->lastSequence, static_cast<unsigned long long>(device->lost),
+               ts.year, ts.month, ts.day, ts.hour, ts.minute, ts.second, MeterData::ToVolt(data.voltageL1),
+               MeterData::ToVolt(data.voltageL2), MeterData::ToVolt(data.voltageL3),
+               MeterData::ToAmpere(data.currentL1), MeterData::ToAmpere(data.currentL2),
+               MeterData::ToAmpere(data.currentL3), data.activePowerPlus, data.activePowerMinus,
+               data.activeEnergyPlus, data.activeEnergyMinus, data.reactiveEnergyPlus, data.reactiveEnergyMinus);
+        fflush(stdout);
+    }
+}
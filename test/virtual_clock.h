@@ -0,0 +1,36 @@
+#pragma once
+
+#include "./esphome-dlms-meter/espdm_clock.h"
+
+#include <stdint.h>
+
+// Clock of the host tests, time only advances with Advance()
+// The start can be set close to the overflow of millis()/micros() to test the unsigned differences.
+class VirtualClock : public esphome::espdm::Clock
+{
+public:
+    explicit VirtualClock(uint64_t startUs = 0)
+        : m_nowUs(startUs)
+    { }
+
+    uint32_t Millis() const override
+    {
+        return static_cast<uint32_t>(m_nowUs / 1000);
+    }
+    uint32_t Micros() const override
+    {
+        return static_cast<uint32_t>(m_nowUs);
+    }
+
+    void Advance(uint32_t ms)
+    {
+        m_nowUs += static_cast<uint64_t>(ms) * 1000;
+    }
+    void AdvanceUs(uint32_t us)
+    {
+        m_nowUs += us;
+    }
+
+private:
+    uint64_t m_nowUs;
+};